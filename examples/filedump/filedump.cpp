@@ -5,19 +5,38 @@
 * @date     03/01/2023
 *
 * Copyright(c) Quantum Dice. All rights reserved.
-* 
-* This
+*
+* The files are written by 'jobs' pipelines in parallel, each one with
+* a reader filling 'buffers' blocks from the device and a writer
+* thread writing the filled ones, so that the device reads overlap the
+* writes. The output goes through write(2), O_DIRECT (page cache
+* bypassed, the blocks are aligned) or a shared mapping of the file
+* that the device data is read straight into. The text types (udist,
+* hex, base64, u32) are read into a buffer of the job and encoded into
+* the blocks with qrng_format().
 */
 
 #include <algorithm>
-#include <iostream>
-#include <vector>
-#include <fstream>  
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
 #include <cstring>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
 
 #include <qrng_api.h>
-#include <random>
+#include <qrng_ext.h>
 
 #define KB(x)   ((size_t) (x) << 10)
 #define MB(x)   ((size_t) (x) << 20)
@@ -26,11 +45,74 @@
 #define QRNG_UDIST_DATA 2
 #define PRNG_UDIST_DATA 0
 #define PRNG_RAW_DATA 3
+#define QRNG_HEX_DATA 4
+#define QRNG_BASE64_DATA 5
+#define QRNG_U32_DATA 6
+
+/** Line of the udist files, "%.12lf\n" of a value in [0, 1) */
+#define UDIST_LINE_SIZE	15
+#define UDIST_DIGITS	12
+
+/** O_DIRECT alignment, the blocks of the text files are also whole lines or groups */
+#define DIRECT_ALIGN	KB(4)
+
+#define MAX_FILES		100
+#define MAX_RETRIES		5
+
+typedef enum {
+	OUT_WRITE,
+	OUT_DIRECT,
+	OUT_MMAP,
+}Out_mode;
+
+typedef struct {
+	u8* data;
+	size_t len;
+	u64 offset;
+}Dump_buffer;
+
+/** Encoding of a data type, 'out' characters per 'in' values or bytes */
+typedef struct {
+	int format;		/**< Qrng_format, -1 for the raw bytes */
+	int param;
+	size_t in;
+	size_t out;
+}Dump_text;
+
+/** Blocks between the reader and the writer of a file */
+typedef struct {
+	std::mutex mutex;
+	std::condition_variable cv;
+	std::deque<Dump_buffer*> free;
+	std::deque<Dump_buffer*> full;
+	bool done;		/**< the reader queued its last block */
+	bool failed;	/**< the writer stopped on an error */
+}Dump_queue;
+
+typedef struct {
+	QRNG* qrng;
+	std::string prefix;
+	std::string type_str;
+	int data_type;
+	Dump_text text;
+	int64_t length;		/**< bytes, or values for the udist and u32 files */
+	int files;
+	size_t block;
+	size_t buffers;
+	Out_mode mode;
+
+	std::atomic<int> next_file;
+	std::atomic<int> failed_files;
+	std::atomic<u64> generated;		/**< bytes filled by the readers */
+	std::atomic<u64> written;		/**< bytes written */
+	std::atomic<u64> reader_wait_ns;	/**< readers waiting for a free block */
+	std::atomic<u64> writer_wait_ns;	/**< writers waiting for data */
+}Dump_ctx;
 
 void print_help_info(){
 	std::cout << "----------------------------------------------------------------------\n";
 	std::cout << "How to run the program: \n";
-	std::cout << "\t ./filedump filename filesize filecount datatype[qrng_raw/qrng_udist/prng]\n\n";
+	std::cout << "\t ./filedump [options] filename filesize filecount datatype[qrng_raw/qrng_udist/qrng_hex/qrng_base64/qrng_u32/prng]\n\n";
 	std::cout << "e.g.\t ./filedump test_data 1024 5 qrng_raw\n";
 	std::cout << "\t\t This sample command would dump 1kb (1024)\n";
 	std::cout << "\t\t of 8 bit qrng data into 5 files prefixed with 'test_data' \n";
@@ -39,138 +121,427 @@ void print_help_info(){
 	std::cout << "\t qrng_udist: uniform distribution between 0 and 1\n";
 	std::cout << "\t prng_udist: uniform distribution with pseudo random numbers \n";
 	std::cout << "\t prng_raw: raw pseudo random numbers \n";
-	std::cout << "\n\t The filesize is capped at 10000000, this can be changed in the code \n";
+	std::cout << "\t qrng_hex: qrng raw data as hexadecimal text\n";
+	std::cout << "\t qrng_base64: qrng raw data as base64 text\n";
+	std::cout << "\t qrng_u32: 32 bit qrng integers, one per line\n";
+	std::cout << "\n\t The filesize is in bytes of random data for raw, hex and base64,\n";
+	std::cout << "\t in values for udist and u32\n";
+	std::cout << "\t and the file count is capped at " << MAX_FILES << "\n";
+	std::cout << "\n Options:\n";
+	std::cout << "\t -d: device name, any name of qrng_ext_init_param (default /dev/xdma0)\n";
+	std::cout << "\t -j: files written in parallel (default up to 4)\n";
+	std::cout << "\t -n: blocks in flight per file (default 4)\n";
+	std::cout << "\t -b: block size in MB (default 8)\n";
+	std::cout << "\t -o: output, write, direct (O_DIRECT) or mmap (default write)\n";
+	std::cout << "\t -p: prefetch ring depth of the handle in blocks (default 0)\n";
+	std::cout << "\t -q: no progress line\n";
 	std::cout << "----------------------------------------------------------------------\n\n";
-	//std::cout << "int size: " << sizeof(int64_t);
-	
 }
 
+static u64 now_ns()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static Dump_text dump_text(int data_type)
+{
+	switch (data_type) {
+	case QRNG_UDIST_DATA:
+	case PRNG_UDIST_DATA: return { QRNG_FORMAT_DECIMAL, UDIST_DIGITS, 1, UDIST_LINE_SIZE };
+	case QRNG_HEX_DATA: return { QRNG_FORMAT_HEX, 0, 1, 2 };
+	case QRNG_BASE64_DATA: return { QRNG_FORMAT_BASE64, 0, 3, 4 };
+	case QRNG_U32_DATA: return { QRNG_FORMAT_UINT, 4, 1, 11 };
+	default: return { -1, 0, 1, 1 };
+	}
+}
+
+/** Size of a file of 'length' values or bytes */
+static u64 text_size(const Dump_text& t, u64 length)
+{
+	return (length + t.in - 1) / t.in * t.out;
+}
+
+/** Random data of a job, encoded as whole lines or groups */
+typedef struct {
+	Dump_ctx* ctx;
+	std::mt19937 mt;
+	std::uniform_real_distribution<> dist;
+	std::vector<double> values;
+	std::vector<u8> bytes;
+}Dump_source;
+
+static int get_bytes(Dump_ctx* ctx, u8* data, size_t len)
+{
+	size_t done = 0;
+	int ret = QRNG_SUCCESS;
+	for (int retry = 0; done < len && retry <= MAX_RETRIES; retry++) {
+		size_t n = 0;
+		ret = qrng_get64(ctx->qrng, data + done, len - done, &n);
+		done += n;
+		if (ret != QRNG_SUCCESS)
+			printf("\n\t\tERROR! from qrng fn,  error/status code: %d\n", ret);
+	}
+	return (done == len) ? QRNG_SUCCESS : ret;
+}
+
+/** Values of the udist files */
+static int fill_values(Dump_source* src, size_t count)
+{
+	Dump_ctx* ctx = src->ctx;
+
+	src->values.resize(count);
+	if (ctx->data_type == QRNG_UDIST_DATA) {
+		size_t done = 0;
+		int ret = QRNG_SUCCESS;
+		for (int retry = 0; done < count && retry <= MAX_RETRIES; retry++) {
+			size_t n = 0;
+			ret = qrng_get_doubles(ctx->qrng, src->values.data() + done, count - done, &n);
+			done += n;
+			if (ret != QRNG_SUCCESS)
+				printf("\n\t\tERROR! from qrng fn,  error/status code: %d\n", ret);
+		}
+		if (done < count) return ret;
+	}
+	else {
+		for (size_t i = 0; i < count; i++) src->values[i] = src->dist(src->mt);
+	}
+	return QRNG_SUCCESS;
+}
+
+/** Fill 'len' bytes of the file with the text of 'count' values or bytes */
+static int source_fill(Dump_source* src, u8* data, size_t len, size_t count)
+{
+	Dump_ctx* ctx = src->ctx;
+
+	if (ctx->data_type == PRNG_RAW_DATA) {
+		for (size_t i = 0; i < len; i++) data[i] = src->mt() * 0xff;
+		return QRNG_SUCCESS;
+	}
+
+	if (ctx->data_type == QRNG_RAW_DATA) return get_bytes(ctx, data, len);
+
+	const void* in;
+	if (ctx->data_type == QRNG_HEX_DATA || ctx->data_type == QRNG_BASE64_DATA
+			|| ctx->data_type == QRNG_U32_DATA) {
+		size_t bytes = (ctx->data_type == QRNG_U32_DATA) ? count * sizeof(uint32_t) : count;
+		src->bytes.resize(bytes);
+		int ret = get_bytes(ctx, src->bytes.data(), bytes);
+		if (ret != QRNG_SUCCESS) return ret;
+		in = src->bytes.data();
+	}
+	else {
+		int ret = fill_values(src, count);
+		if (ret != QRNG_SUCCESS) return ret;
+		in = src->values.data();
+	}
+
+	size_t done = 0;
+	size_t text_len = 0;
+	int ret = qrng_format(ctx->text.format, ctx->text.param, in, count, (char*)data, len,
+						&done, &text_len);
+	if (ret == QRNG_SUCCESS && (done != count || text_len != len)) ret = QRNG_ERROR_INTERNAL_MEMORY;
+	return ret;
+}
+
+/** 'direct' if the file is really open with O_DIRECT, which may have fallen back to buffered writes */
+static void writer_thread(Dump_ctx* ctx, Dump_queue* q, int fd, bool direct)
+{
+	for (;;) {
+		Dump_buffer* b;
+		{
+			u64 t0 = now_ns();
+			std::unique_lock<std::mutex> lock(q->mutex);
+			q->cv.wait(lock, [&] { return !q->full.empty() || q->done; });
+			ctx->writer_wait_ns += now_ns() - t0;
+			if (q->full.empty()) break;
+			b = q->full.front();
+			q->full.pop_front();
+		}
+
+		bool fail = false;
+		if (ctx->mode == OUT_MMAP) {
+			/** written back by the kernel */
+			munmap(b->data, b->len);
+			b->data = nullptr;
+		}
+		else {
+			/** the tail of an O_DIRECT file is padded, then truncated */
+			size_t len = b->len;
+			if (direct) len = (len + DIRECT_ALIGN - 1) / DIRECT_ALIGN * DIRECT_ALIGN;
+
+			for (size_t done = 0; done < len && !fail;) {
+				ssize_t n = pwrite(fd, b->data + done, len - done, b->offset + done);
+				if (n <= 0) {
+					perror("\nwrite");
+					fail = true;
+				}
+				else done += n;
+			}
+		}
+		ctx->written += b->len;
+
+		std::lock_guard<std::mutex> lock(q->mutex);
+		q->free.push_back(b);
+		if (fail) q->failed = true;
+		q->cv.notify_all();
+		if (fail) break;
+	}
+}
+
+static bool dump_file(Dump_ctx* ctx, Dump_source* src, int index, std::vector<Dump_buffer>& buffers)
+{
+	char fn[200] = { 0 };
+	snprintf(fn, sizeof(fn), "%s_%s_%d", ctx->prefix.c_str(), ctx->type_str.c_str(), index + 1);
+	u64 file_bytes = text_size(ctx->text, ctx->length);
 
-std::mt19937 mt{ std::random_device{}() };
-std::uniform_real_distribution<> dist(0, 1.0);
+	int flags = O_CREAT | O_TRUNC | ((ctx->mode == OUT_MMAP) ? O_RDWR : O_WRONLY);
+	int fd = (ctx->mode == OUT_DIRECT) ? open(fn, flags | O_DIRECT, 0644) : -1;
+	if (ctx->mode == OUT_DIRECT && fd < 0) {
+		std::cout << "\nFile: " << fn << ", O_DIRECT not supported, buffered writes\n";
+	}
+	if (fd < 0) fd = open(fn, flags, 0644);
+	if (fd < 0) {
+		perror(fn);
+		return false;
+	}
+	bool direct = (ctx->mode == OUT_DIRECT) && (fcntl(fd, F_GETFL) & O_DIRECT);
 
-int prng_init(){
-	return 0;
+	if (ctx->mode == OUT_MMAP && ftruncate(fd, file_bytes) != 0) {
+		perror(fn);
+		close(fd);
+		return false;
+	}
+
+	Dump_queue q;
+	q.done = false;
+	q.failed = false;
+	for (Dump_buffer& b : buffers) q.free.push_back(&b);
+
+	bool ok = true;
+	std::thread writer(writer_thread, ctx, &q, fd, direct);
+
+	for (u64 off = 0; off < file_bytes;) {
+		Dump_buffer* b;
+		{
+			u64 t0 = now_ns();
+			std::unique_lock<std::mutex> lock(q.mutex);
+			q.cv.wait(lock, [&] { return !q.free.empty(); });
+			ctx->reader_wait_ns += now_ns() - t0;
+			if (q.failed) break;
+			b = q.free.front();
+			q.free.pop_front();
+		}
+
+		b->offset = off;
+		b->len = (size_t)std::min<u64>(ctx->block, file_bytes - off);
+		if (ctx->mode == OUT_MMAP) {
+			void* p = mmap(nullptr, b->len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, off);
+			if (p == MAP_FAILED) {
+				perror("\nmmap");
+				ok = false;
+				break;
+			}
+			b->data = (u8*)p;
+		}
+
+		/** the blocks hold whole lines or groups, the last one the rest */
+		u64 in_off = off / ctx->text.out * ctx->text.in;
+		size_t count = (size_t)std::min<u64>(b->len / ctx->text.out * ctx->text.in, ctx->length - in_off);
+		int ret = source_fill(src, b->data, b->len, count);
+		if (ret != QRNG_SUCCESS) {
+			printf("\t\tMax retries reached for this file!\n");
+			if (ctx->mode == OUT_MMAP) munmap(b->data, b->len);
+			ok = false;
+			break;
+		}
+		ctx->generated += b->len;
+		off += b->len;
+
+		std::lock_guard<std::mutex> lock(q.mutex);
+		q.full.push_back(b);
+		q.cv.notify_all();
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(q.mutex);
+		q.done = true;
+		q.cv.notify_all();
+	}
+	writer.join();
+	if (q.failed) ok = false;
+
+	if (direct && ftruncate(fd, file_bytes) != 0) ok = false;
+	close(fd);
+	return ok;
 }
 
-int prng_get(u8* data, u32 data_len, s32* read_len){
-	for (u32 i = 0; i < data_len; i++) {
-		data[i] = mt() * 0xff;
-//		data[i] = (mt() * 255 / 0xffffffff);
+static void dump_job(Dump_ctx* ctx)
+{
+	Dump_source src;
+	src.ctx = ctx;
+	src.mt.seed(std::random_device{}());
+	src.dist = std::uniform_real_distribution<>(0, 1.0);
+
+	std::vector<Dump_buffer> buffers(ctx->buffers);
+	for (Dump_buffer& b : buffers) {
+		b.data = nullptr;
+		if (ctx->mode == OUT_MMAP) continue;
+
+		/** aligned for O_DIRECT, locked for the device transfers */
+		b.data = (u8*)qrng_alloc_buffer(ctx->block);
+		if (!b.data) {
+			std::cout << "Error: can't allocate the buffers\n";
+			ctx->failed_files += ctx->files;
+			ctx->next_file = ctx->files;
+			break;
+		}
+		qrng_register_buffer(ctx->qrng, b.data, ctx->block);
 	}
 
-	if (read_len) *read_len = data_len;
-	return 0; 
+	for (int i; (i = ctx->next_file++) < ctx->files;)
+		if (!dump_file(ctx, &src, i, buffers)) ctx->failed_files++;
+
+	for (Dump_buffer& b : buffers) {
+		if (ctx->mode == OUT_MMAP || !b.data) continue;
+		qrng_unregister_buffer(ctx->qrng, b.data);
+		qrng_free_buffer(b.data);
+	}
 }
 
-double prng_rand(){
-	return dist(mt);
+static void print_progress(Dump_ctx* ctx, u64 total, double sec, bool last)
+{
+	u64 written = ctx->written.load();
+	printf("\r Progress: %3.2f percent,  %.2f of %.2f GB,  %.3f GB/s,  time: %.3fs",
+		total ? 100.0 * written / total : 100.0, written / 1e9, total / 1e9, written / 1e9 / sec, sec);
+
+	Qrng_stats stats;
+	if (ctx->data_type != PRNG_RAW_DATA && ctx->data_type != PRNG_UDIST_DATA
+			&& qrng_get_stats(ctx->qrng, &stats) == QRNG_SUCCESS)
+		printf(",  device reads %.3f GB/s", stats.device_bytes / 1e9 / sec);
+	if (last) printf("\n");
+	fflush(stdout);
 }
 
-int main(int argc, char const* argv[])
+int main(int argc, char* argv[])
 {
-	if (argc < 5)
+	const char* device = "/dev/xdma0";
+	Qrng_ext_param ext = {};
+	size_t block_mb = 8;
+	size_t buffers = 4;
+	int jobs = 0;
+	Out_mode mode = OUT_WRITE;
+	bool quiet = false;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "d:j:n:b:o:p:qh")) != -1) {
+		switch (opt) {
+		case 'd': device = optarg; break;
+		case 'j': jobs = atoi(optarg); break;
+		case 'n': buffers = std::max(atoi(optarg), 2); break;
+		case 'b': block_mb = std::max(atoi(optarg), 1); break;
+		case 'o':
+			if (strcmp(optarg, "write") == 0) mode = OUT_WRITE;
+			else if (strcmp(optarg, "direct") == 0) mode = OUT_DIRECT;
+			else if (strcmp(optarg, "mmap") == 0) mode = OUT_MMAP;
+			else {
+				std::cout << "Error: unknown output " << optarg << "\n";
+				return -1;
+			}
+			break;
+		case 'p': ext.prefetch_depth = strtoull(optarg, nullptr, 10); break;
+		case 'q': quiet = true; break;
+		default:
+			print_help_info();
+			return (opt == 'h') ? 0 : -1;
+		}
+	}
+
+	if (argc - optind < 4)
 	{
 		std::cout << "Error: Insufficient parameters!!\n";
 		print_help_info();
 		return -1;
 	}
 
-	int ret = 0;
-
-	/*1. Init qrng and prng */
-	#ifdef __unix__
-		QRNG* qrng = qrng_init_param({ QRNG_VERTEX_B1, "/dev/xdma0" });
-	#else //_WIN32
-		QRNG* qrng = qrng_init_param({ QRNG_VERTEX_B1, "0" });
-	#endif
-	printf("\nqrng init ret: %d \n", qrng_get_status(qrng));
-
-	prng_init();
-	
-	/* 2. get data from driver */
-	std::vector<uint8_t> test_data(MB(8));
-	int data_len = test_data.size();
-	uint8_t* data_r = test_data.data();
-	s32 bytes_read = 0;
-
-	//3. open file to append to file
-	const char* file_name = argv[1];
-	int64_t num_length = atoll(argv[2]);// 2 * 1000 * 1000;//3 million
-	int num_of_files = atoll(argv[3]);
-	int data_type = PRNG_UDIST_DATA; 
-        const char* data_type_str = argv[4]; 
-	if (strcmp(data_type_str, "qrng_raw")==0 ) data_type = QRNG_RAW_DATA; 
-	else if (strcmp(data_type_str, "qrng_udist") == 0) data_type = QRNG_UDIST_DATA;
-	else if (strcmp(data_type_str, "prng_udist") == 0) data_type = PRNG_UDIST_DATA;
-	else if (strcmp(data_type_str, "prng_raw") == 0) data_type = PRNG_RAW_DATA;
-	
+	Dump_ctx ctx;
+	ctx.prefix = argv[optind];
+	ctx.length = atoll(argv[optind + 1]);
+	ctx.files = std::min(atoi(argv[optind + 2]), MAX_FILES);
+	ctx.type_str = argv[optind + 3];
+	ctx.mode = mode;
+	ctx.buffers = buffers;
+	ctx.next_file = 0;
+	ctx.failed_files = 0;
+	ctx.generated = 0;
+	ctx.written = 0;
+	ctx.reader_wait_ns = 0;
+	ctx.writer_wait_ns = 0;
+
+	const char* data_type_str = ctx.type_str.c_str();
+	if (strcmp(data_type_str, "qrng_raw")==0 ) ctx.data_type = QRNG_RAW_DATA;
+	else if (strcmp(data_type_str, "qrng_udist") == 0) ctx.data_type = QRNG_UDIST_DATA;
+	else if (strcmp(data_type_str, "prng_udist") == 0) ctx.data_type = PRNG_UDIST_DATA;
+	else if (strcmp(data_type_str, "prng_raw") == 0) ctx.data_type = PRNG_RAW_DATA;
+	else if (strcmp(data_type_str, "qrng_hex") == 0) ctx.data_type = QRNG_HEX_DATA;
+	else if (strcmp(data_type_str, "qrng_base64") == 0) ctx.data_type = QRNG_BASE64_DATA;
+	else if (strcmp(data_type_str, "qrng_u32") == 0) ctx.data_type = QRNG_U32_DATA;
 	else {
 		std::cout << "Error: No valid data type was selected" << std::endl;
 		print_help_info();
 		return -3;
 	}
+	if (ctx.length < 0 || ctx.files < 1) {
+		std::cout << "Error: invalid file size or count\n";
+		return -1;
+	}
 
-	//if (num_length > 10000000000) num_length = 10000000000;
-	if (num_of_files > 100) num_of_files = 100;
-	
-	std::cout << "To fetch: " << data_type_str << " data "  
-		<< "and write to files with prefix: " << file_name
-		<< ", size: " << num_length
-		<< ", number of files: " << num_of_files 
-		<< std::endl;
+	/** blocks of whole lines or groups and O_DIRECT pages */
+	ctx.text = dump_text(ctx.data_type);
+	size_t unit = DIRECT_ALIGN * ctx.text.out;
+	ctx.block = std::max(MB(block_mb) / unit, (size_t)1) * unit;
+	if (jobs <= 0) jobs = std::min(ctx.files, 4);
+	jobs = std::min(jobs, ctx.files);
 
-	//4. get random number and append to 
-	for (int a = 0; a < num_of_files; a++) {
-
-		char fn[200] = { 0 };
-		snprintf(fn, sizeof(fn), "%s_%s_%d", file_name, data_type_str, a+1);
-		std::ofstream ofs(fn, std::ofstream::out | std::ofstream::binary);
-		std::cout << "\nFile: " << fn << ", " << (a + 1) << " of " << num_of_files << ", is_open? " << ofs.is_open()  << std::endl;
-		int retry_count = 5; //retry 5 times
-
-		auto begin = std::chrono::steady_clock::now();
-
-		int64_t i = 0;
-		while (i < num_length){
-			//5. Fetch data and write to file 
-			int64_t to_read = 0;
-
-			if (data_type == QRNG_RAW_DATA || data_type == PRNG_RAW_DATA){
-				bytes_read = 0;
-				to_read =  num_length-i;
-				to_read = (data_len < to_read)? data_len: to_read;
-				ret = (data_type == QRNG_RAW_DATA)? qrng_get(qrng, data_r, to_read, &bytes_read): prng_get(data_r, to_read, &bytes_read);
-				to_read = bytes_read; 
-				i+=to_read;
-			}else {
-				double ret_double = (data_type==QRNG_UDIST_DATA)? qrng_urand(qrng):prng_rand(); 
-				snprintf((char*)data_r, data_len, "%.12lf\n", ret_double);
-				to_read= strlen((const char*)data_r);
-				i++;
-			}
+	/*1. Init qrng, the extension functions are safe on a handle shared by the jobs */
+	ctx.qrng = qrng_ext_init_param({ QRNG_VERTEX_B1, device }, ext);
+	int status = ctx.qrng ? qrng_get_status(ctx.qrng) : QRNG_ERROR_OPENING_DEVICE;
+	printf("\nqrng init ret: %d \n", status);
+	if (!ctx.qrng) return -1;
 
-			//checks if any error occurred in the function
-			if ( (data_type == QRNG_RAW_DATA || data_type == QRNG_UDIST_DATA) && qrng_get_status(qrng)) {
-				printf("\t\tERROR! from qrng fn,  error/status code: %d, ret: %d\n",  qrng_get_status(qrng), ret);
-				retry_count--;
-				if (retry_count < 0) {
-					printf("\t\tMax retries reached for this file!\n");
-					break;
-				}
-			}
+	static const char* mode_names[] = { "write", "direct", "mmap" };
+	std::cout << "To fetch: " << data_type_str << " data "
+		<< "and write to files with prefix: " << ctx.prefix
+		<< ", size: " << ctx.length
+		<< ", number of files: " << ctx.files
+		<< ", jobs: " << jobs << ", blocks: " << ctx.buffers << " x " << ctx.block
+		<< ", output: " << mode_names[mode]
+		<< std::endl;
 
-			auto end = std::chrono::steady_clock::now();
-			double time_diff = 0.000001 * std::chrono::duration_cast<std::chrono::microseconds> (end - begin).count();
-			printf("\r Progress: %3.2f percent,  time: %.10fs", ((float)i / num_length) * 100, time_diff);
+	/*2. Fetch the data and write the files in parallel */
+	u64 total = text_size(ctx.text, ctx.length) * ctx.files;
+	u64 begin = now_ns();
+	std::vector<std::thread> pool;
+	for (int i = 0; i < jobs; i++) pool.emplace_back(dump_job, &ctx);
 
-			ofs.write((const char*)data_r, to_read);
+	std::atomic<bool> finished{ false };
+	std::thread progress([&] {
+		for (int ticks = 1; !finished.load(); ticks++) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(100));
+			if (!quiet && ticks % 10 == 0 && !finished.load())
+				print_progress(&ctx, total, (now_ns() - begin) * 1e-9, false);
 		}
-		ofs.close();
-	}
-	
-	printf("\n");
-	return 0;
-}
+	});
+	for (std::thread& t : pool) t.join();
+	finished = true;
+	progress.join();
 
+	double sec = (now_ns() - begin) * 1e-9;
+	print_progress(&ctx, total, sec, true);
+	printf(" Readers waited %.2fs for free blocks (writes), writers waited %.2fs for data (device)\n",
+		ctx.reader_wait_ns * 1e-9, ctx.writer_wait_ns * 1e-9);
+	if (ctx.failed_files) printf(" %d of %d files failed\n", ctx.failed_files.load(), ctx.files);
 
+	qrng_deinit(ctx.qrng);
+	return ctx.failed_files ? -1 : 0;
+}
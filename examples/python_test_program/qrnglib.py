@@ -1,17 +1,36 @@
 import platform
 import ctypes
 import os
+import threading
 
-# load the shared library or DLL 
+try:
+    import numpy as np
+except ImportError:
+    np = None
+
+# load the shared library or DLL
+# On Linux the extension library (built with 'make shared' in ./src) is
+# preferred, it exports the QRNG API too and adds the bulk functions.
+# ctypes releases the GIL for the duration of every call, so the device
+# reads of one thread don't block the other Python threads.
 THIS_FILE_DIRECTORY = os.path.join(os.path.dirname(os.path.realpath(__file__)), "../../lib")
-if platform.system() == 'Linux': 
-	qrnglibso =  os.path.join(THIS_FILE_DIRECTORY, 'linux/libqrng_vertex.so') 
-	qrnglibhdlr = ctypes.CDLL(qrnglibso)
-else: 
-	qrnglibdll  = os.path.join(THIS_FILE_DIRECTORY, 'qrng_vertex.dll')
-	qrnglibhdlr = ctypes.WinDLL(qrnglibdll)
-
-# Define the argument and return types for functions 
+EXT_LIBRARY = os.path.join(os.path.dirname(os.path.realpath(__file__)),
+                           "../../src/bin/shared/libqrng_ext.so")
+if platform.system() == 'Linux':
+    qrnglibso =  os.path.join(THIS_FILE_DIRECTORY, 'linux/libqrng_vertex.so')
+    if os.path.exists(EXT_LIBRARY):
+        qrnglibso = EXT_LIBRARY
+    qrnglibhdlr = ctypes.CDLL(qrnglibso)
+else:
+    qrnglibdll  = os.path.join(THIS_FILE_DIRECTORY, 'qrng_vertex.dll')
+    qrnglibhdlr = ctypes.WinDLL(qrnglibdll)
+
+HAS_EXT = hasattr(qrnglibhdlr, "qrng_ext_init_param")
+
+# Largest request of the s32 functions of the QRNG API, a multiple of 8
+GET_MAX_SIZE = 1 << 30
+
+# Define the argument and return types for functions
 # that have a different return type
 
 qrnglibhdlr.qrng_bridge_product_name_to_enum.argtypes = [ctypes.c_char_p]
@@ -29,183 +48,521 @@ qrnglibhdlr.qrng_rand.restype = ctypes.c_int
 qrnglibhdlr.qrng_urand.argtypes = [ctypes.c_void_p]
 qrnglibhdlr.qrng_urand.restype = ctypes.c_double
 
-qrnglibhdlr.qrng_get.argtypes = [ctypes.c_void_p, 
-                                 ctypes.POINTER(ctypes.c_uint8),
-                                 ctypes.c_int32, 
-                                 ctypes.c_void_p]
+qrnglibhdlr.qrng_get.argtypes = [ctypes.c_void_p,
+                                 ctypes.c_void_p,
+                                 ctypes.c_int32,
+                                 ctypes.POINTER(ctypes.c_int32)]
 qrnglibhdlr.qrng_get.restype = ctypes.c_int
 
 qrnglibhdlr.qrng_get_raw_ent.argtypes = [ctypes.c_void_p,
-                                         ctypes.POINTER(ctypes.c_uint16),
+                                         ctypes.c_void_p,
                                          ctypes.c_int32,
-                                         ctypes.c_void_p]
+                                         ctypes.POINTER(ctypes.c_int32)]
 qrnglibhdlr.qrng_get_raw_ent.restype = ctypes.c_int
 
 qrnglibhdlr.qrng_get_with_ec.argtypes = [ctypes.c_void_p,
-                                         ctypes.POINTER(ctypes.c_uint8),
-                                         ctypes.c_int32, 
-                                         ctypes.POINTER(ctypes.c_uint16),
-                                         ctypes.c_int32, 
-                                         ctypes.POINTER(ctypes.c_float),
-                                         ctypes.c_int32] 
+                                         ctypes.c_void_p,
+                                         ctypes.c_int32,
+                                         ctypes.c_void_p,
+                                         ctypes.c_int32,
+                                         ctypes.c_void_p,
+                                         ctypes.c_int32]
 qrnglibhdlr.qrng_get_with_ec.restype = ctypes.c_int
 
 qrnglibhdlr.qrng_deinit.argtypes = [ctypes.c_void_p]
 
 
+class QrngInitParam(ctypes.Structure):
+    """ Qrng_init_param of qrng_api.h """
+    _fields_ = [("board_type", ctypes.c_int),
+                ("dev_name", ctypes.c_char_p)]
+
+
+class QrngExtParam(ctypes.Structure):
+    """ Qrng_ext_param of qrng_ext.h, 0 selects the defaults """
+    _fields_ = [("pool_size", ctypes.c_size_t),
+                ("prefetch_depth", ctypes.c_size_t),
+                ("prefetch_block", ctypes.c_size_t),
+                ("async_workers", ctypes.c_size_t),
+                ("health_tests", ctypes.c_int),
+                ("health_raw_entropy", ctypes.c_double),
+                ("extract_min_entropy", ctypes.c_double),
+                ("extract_threads", ctypes.c_size_t),
+                ("drbg_reseed_bytes", ctypes.c_size_t),
+                ("drbg_reseed_ms", ctypes.c_uint32)]
+
+
+if HAS_EXT:
+    qrnglibhdlr.qrng_ext_init_param.argtypes = [QrngInitParam, QrngExtParam]
+    qrnglibhdlr.qrng_ext_init_param.restype = ctypes.c_void_p
+
+    qrnglibhdlr.qrng_ext_get_status.argtypes = [ctypes.c_void_p]
+    qrnglibhdlr.qrng_ext_get_status.restype = ctypes.c_int
+
+    qrnglibhdlr.qrng_pool_get_error.argtypes = [ctypes.c_void_p]
+    qrnglibhdlr.qrng_pool_get_error.restype = ctypes.c_int
+
+    for fn in ("qrng_get64", "qrng_get_raw_ent64", "qrng_get_doubles"):
+        getattr(qrnglibhdlr, fn).argtypes = [ctypes.c_void_p,
+                                             ctypes.c_void_p,
+                                             ctypes.c_size_t,
+                                             ctypes.POINTER(ctypes.c_size_t)]
+        getattr(qrnglibhdlr, fn).restype = ctypes.c_int
+
+    qrnglibhdlr.qrng_get_range.argtypes = [ctypes.c_void_p,
+                                           ctypes.c_uint64,
+                                           ctypes.c_uint64,
+                                           ctypes.c_void_p,
+                                           ctypes.c_size_t,
+                                           ctypes.POINTER(ctypes.c_size_t)]
+    qrnglibhdlr.qrng_get_range.restype = ctypes.c_int
+
+
+class QrngError(Exception):
+    """ A QRNG function returned an error, 'status' is its QRNG_status """
+    def __init__(self, function: str, status: int):
+        super().__init__(f"Error in cCode: {function} returned {status}")
+        self.status = status
+
+
+def _writable(out, itemsize: int):
+    """
+    Returns a ctypes array over the memory of 'out' (bytearray,
+    memoryview, numpy array...) and its number of elements
+    of 'itemsize' bytes, without copying it
+    """
+    view = memoryview(out)
+    if view.readonly:
+        raise TypeError("The output buffer must be writable")
+    if not view.c_contiguous:
+        raise ValueError("The output buffer must be contiguous")
+    if view.nbytes % itemsize:
+        raise ValueError(f"The output buffer must hold elements of {itemsize} bytes")
+    if view.nbytes == 0:
+        return None, 0
+    return (ctypes.c_char * view.nbytes).from_buffer(view.cast('B')), view.nbytes // itemsize
+
+
+def _new_array(cnt: int, dtype: str, fmt: str):
+    """ numpy array of 'cnt' elements, or a typed memoryview without numpy """
+    if cnt is None or cnt < 0:
+        raise ValueError(f"Invalid count: {cnt}")
+    if np is not None:
+        return np.empty(cnt, dtype=dtype)
+    return memoryview(bytearray(cnt * ctypes.sizeof(
+        {'B': ctypes.c_uint8, 'H': ctypes.c_uint16, 'f': ctypes.c_float}[fmt]))).cast(fmt)
+
+
+def _require_ext(name: str):
+    if not HAS_EXT:
+        raise RuntimeError(f"{name} needs the extension library, build it with 'make shared' in ./src")
+
+
 class QdQrng:
     qrng_cptr = None
-    def __init__(self, product_name: str, dev_name: str) :
+    def __init__(self, product_name: str, dev_name: str, **ext_param) :
         """
-        Initialize the qrng device by specifying the 
+        Initialize the qrng device by specifying the
         product name and device name.
 
-        Parameters: 
+        Parameters:
             Product_name (str): e.g. VERTEX_A1, VERTEX_B1, APEXTREME
-            dev_name (str):     e.g. /dev/xdma0
+            dev_name (str):     e.g. /dev/xdma0, or a backend of the
+                                extension library such as prng:seed=1
+            ext_param:          fields of QrngExtParam, e.g.
+                                prefetch_depth=4 (extension library only)
         """
         #verify the product name and device name are string
-        if not isinstance(product_name, str): 
+        if not isinstance(product_name, str):
               raise TypeError("Only string is allowed for product name")
-        if not isinstance(dev_name, str): 
+        if not isinstance(dev_name, str):
               raise TypeError("Only string is allowed for device name")
         cstr_prod_name = product_name.encode('utf-8')
         cstr_dev_name = dev_name.encode('utf-8')
 
         product_enum_num = qrnglibhdlr.qrng_bridge_product_name_to_enum(
                                             cstr_prod_name)
-        
-        if product_enum_num < 0: 
+
+        if product_enum_num < 0:
             raise ValueError(f"Product '{product_name}' does not exist")
-        
-        self.qrng_cptr = qrnglibhdlr.qrng_bridge_init_param(
-                                            product_enum_num, 
+
+        if HAS_EXT:
+            param = QrngExtParam(**ext_param)
+            self.qrng_cptr = qrnglibhdlr.qrng_ext_init_param(
+                                            QrngInitParam(product_enum_num, cstr_dev_name),
+                                            param)
+        else:
+            if ext_param:
+                _require_ext("ext_param")
+            self.qrng_cptr = qrnglibhdlr.qrng_bridge_init_param(
+                                            product_enum_num,
                                             cstr_dev_name)
+        self._lock = threading.Lock()
+        self._bit_generator = None
 
-        
-    
     def __del__(self):
-        if self.qrng_cptr== None: 
+        if self.qrng_cptr== None:
             return
         qrnglibhdlr.qrng_deinit(self.qrng_cptr)
         self.qrng_cptr = None
 
-    def get_status(self): 
+    def get_status(self):
         """
-        Returns the status info about the last operation 
+        Returns the status info about the last operation
         performed by the API
 
-        Returns: 
+        Returns:
             num (int): status code
         """
         return qrnglibhdlr.qrng_get_status(self.qrng_cptr)
-    
-    def rand(self): 
+
+    def rand(self):
         """
         Returns a random number between 0 and 32767
 
-        Returns: 
-            num (int): A random number between 0 and 32767 
+        Returns:
+            num (int): A random number between 0 and 32767
         """
         return qrnglibhdlr.qrng_rand(self.qrng_cptr)
 
-    def urand(self): 
+    def urand(self):
         """
         Returns a random number between 0 and 1
 
-        Returns: 
-            num (float): A random number between 0 and 1 
+        Returns:
+            num (float): A random number between 0 and 1
         """
         return qrnglibhdlr.qrng_urand(self.qrng_cptr)
 
-    def get(self, cnt): 
-        """
-        Returns 'cnt' dynamicaly hashed random numbers 
-
-        Parameters: 
-            cnt (int): The amount of random numbers to return 
-        
-        Returns: 
-            data_buf (list): A list of 8bits random numbers 
-                            i.e. each number is between 
-                            0 and 255 
-        """
-        ret_len = ctypes.c_uint32(0)
-        
-        data_buf = (ctypes.c_ubyte * cnt)()
-        # ptr_cast = ctypes.cast(data_buf, ctypes.c_char_p) 
-        ret = qrnglibhdlr.qrng_get( self.qrng_cptr, 
-                                    data_buf, 
-                                    cnt, 
-                                    ctypes.byref(ret_len) ) 
-            
-        if ret < 0 :
-             raise Exception(f"Error in cCode: {ret}")
-        
-        return data_buf[:]
-    
-
-    def get_raw_ent(self, cnt: int) -> list: 
-        """
-        Returns 'cnt' raw entropy 
-            
-        Parameters: 
-            cnt (int): The amount of raw entropy numbers to return 
-        
-        Returns: 
-            data_buf (list): A list of 16bits raw entropy 
-                            i.e. each number is between 
-                            0 and 65535 
-        """
-        ret_len = ctypes.c_uint32(0)
-        data_buf = (ctypes.c_uint16 * cnt)()
-        ret = qrnglibhdlr.qrng_get_raw_ent( self.qrng_cptr, 
-                                           data_buf, 
-                                           cnt, 
-                                           ctypes.byref(ret_len) ) 
-            
-        if ret < 0 :
-            raise Exception(f"Error in cCode: {ret}")        
-        return data_buf[:]
-
-    def get_with_ec(self, cnt: int) -> list: 
+    def get(self, cnt=None, out=None):
+        """
+        Returns 'cnt' dynamicaly hashed random bytes, or fills 'out'
+        in place
+
+        Parameters:
+            cnt (int): The amount of random bytes to return
+            out:       Writable buffer to fill instead, e.g. a
+                       bytearray, memoryview or numpy array of any
+                       dtype, filled byte by byte
+
+        Returns:
+            out, or a numpy uint8 array of 'cnt' random numbers
+            (a memoryview without numpy), each between 0 and 255
+        """
+        if out is None:
+            out = _new_array(cnt, np.uint8 if np is not None else None, 'B')
+        buf, size = _writable(out, 1)
+        if not size:
+            return out
+
+        if HAS_EXT:
+            ret_len = ctypes.c_size_t(0)
+            ret = qrnglibhdlr.qrng_get64(self.qrng_cptr, buf, size, ctypes.byref(ret_len))
+            if ret < 0 or ret_len.value != size:
+                raise QrngError("qrng_get64", ret)
+            return out
+
+        addr = ctypes.addressof(buf)
+        for off in range(0, size, GET_MAX_SIZE):
+            chunk = min(size - off, GET_MAX_SIZE)
+            ret_len = ctypes.c_int32(0)
+            ret = qrnglibhdlr.qrng_get(self.qrng_cptr, addr + off, chunk, ctypes.byref(ret_len))
+            if ret < 0 or ret_len.value != chunk:
+                raise QrngError("qrng_get", ret)
+        return out
+
+    def get_raw_ent(self, cnt=None, out=None):
+        """
+        Returns 'cnt' raw entropy samples, or fills 'out' in place
+
+        Parameters:
+            cnt (int): The amount of raw entropy numbers to return
+            out:       Writable buffer of 16 bits elements to fill
+                       instead, e.g. a numpy uint16 array
+
+        Returns:
+            out, or a numpy uint16 array of 'cnt' raw entropy
+            samples (a memoryview without numpy), each between
+            0 and 65535
+        """
+        if out is None:
+            out = _new_array(cnt, np.uint16 if np is not None else None, 'H')
+        buf, count = _writable(out, 2)
+        if not count:
+            return out
+
+        if HAS_EXT:
+            ret_len = ctypes.c_size_t(0)
+            ret = qrnglibhdlr.qrng_get_raw_ent64(self.qrng_cptr, buf, count, ctypes.byref(ret_len))
+            if ret < 0 or ret_len.value != count:
+                raise QrngError("qrng_get_raw_ent64", ret)
+            return out
+
+        addr = ctypes.addressof(buf)
+        for off in range(0, count, GET_MAX_SIZE):
+            chunk = min(count - off, GET_MAX_SIZE)
+            ret_len = ctypes.c_int32(0)
+            ret = qrnglibhdlr.qrng_get_raw_ent(self.qrng_cptr, addr + 2 * off, chunk,
+                                               ctypes.byref(ret_len))
+            if ret < 0:
+                raise QrngError("qrng_get_raw_ent", ret)
+        return out
+
+    def get_with_ec(self, cnt=None, out=None, ent_bits=None, cert_val=None):
         """
         Returns 'cnt' hashed random numbers with their certification
-        information. 
-            
-        Parameters: 
+        information, or fills the buffers passed in place
+
+        Parameters:
             cnt (int): The amount of random numbers to return
-                        NB: this must be a muliple of 8 
-        
-        Returns: 
-            data_buf (list): A list of 8bits random numbers 
-                            i.e. each number is between 
-                            0 and 255 
-            ent_bits (list): A list of 16bits minimum raw entropy
-            cert_val (list): A list of floats certification value 
-        """
-        if cnt < 1 or cnt % 8: 
-             raise ValueError(
-                  f"Function expects multiple of 8, cnt: {cnt} ")
-        
-        cnt2 = int(cnt/8)
-        data_buf = (ctypes.c_uint8 * cnt)()
-        ent_bits = (ctypes.c_uint16 * cnt2)()
-        cert_val = (ctypes.c_float * cnt2)()
-        ret = qrnglibhdlr.qrng_get_with_ec( self.qrng_cptr, 
-                                           data_buf, cnt,
-                                           ent_bits, cnt2, 
-                                           cert_val, cnt2 ) 
-            
-        if ret < 0 :
-            raise Exception(f"Error in cCode: {ret}")        
-        return data_buf[:], ent_bits[:], cert_val[:]
-
-    def shuffle(self, x):	
-        int_class = int
+                        NB: this must be a muliple of 8
+            out:       Writable buffer of bytes to fill instead,
+                       its size must be a multiple of 8
+            ent_bits:  Writable buffer of 16 bits elements, one per
+                       8 bytes of 'out'
+            cert_val:  Writable buffer of 32 bits floats, one per
+                       8 bytes of 'out'
+
+        Returns:
+            data_buf: 8bits random numbers, each between 0 and 255
+            ent_bits: 16bits minimum raw entropy
+            cert_val: floats certification value
+            (numpy arrays, or memoryviews without numpy, when not
+            passed in)
+        """
+        if out is None:
+            if cnt is None or cnt < 1 or cnt % 8:
+                raise ValueError(
+                    f"Function expects multiple of 8, cnt: {cnt} ")
+            out = _new_array(cnt, np.uint8 if np is not None else None, 'B')
+        data, size = _writable(out, 1)
+        if size < 1 or size % 8:
+            raise ValueError(f"Function expects multiple of 8, size: {size} ")
+
+        blocks = size // 8
+        if ent_bits is None:
+            ent_bits = _new_array(blocks, np.uint16 if np is not None else None, 'H')
+        if cert_val is None:
+            cert_val = _new_array(blocks, np.float32 if np is not None else None, 'f')
+        eb, eb_count = _writable(ent_bits, 2)
+        cv, cv_count = _writable(cert_val, 4)
+        if eb_count < blocks or cv_count < blocks:
+            raise ValueError(f"ent_bits and cert_val need {blocks} elements")
+
+        data_addr, eb_addr, cv_addr = (ctypes.addressof(b) for b in (data, eb, cv))
+        for off in range(0, size, GET_MAX_SIZE):
+            chunk = min(size - off, GET_MAX_SIZE)
+            ret = qrnglibhdlr.qrng_get_with_ec(self.qrng_cptr,
+                                               data_addr + off, chunk,
+                                               eb_addr + off // 4, chunk // 8,
+                                               cv_addr + off // 2, chunk // 8)
+            if ret < 0:
+                raise QrngError("qrng_get_with_ec", ret)
+        return out, ent_bits, cert_val
+
+    def random(self, n=None, out=None):
+        """
+        Returns 'n' random doubles (uniform distribution in [0, 1),
+        53 random bits each), or fills 'out' in place
+
+        Parameters:
+            n (int):   The amount of random numbers to return, None
+                       for a single one
+            out:       Writable buffer of 64 bits floats to fill
+                       instead, e.g. a numpy float64 array
+
+        Returns:
+            out, a float if 'n' is None, or a numpy float64 array of
+            'n' random numbers (a memoryview without numpy)
+        """
+        _require_ext("random")
+        if out is None and n is None:
+            return float(self.random(1)[0])
+        if out is None:
+            if np is None:
+                out = memoryview(bytearray(8 * n)).cast('d')
+            else:
+                out = np.empty(n, dtype=np.float64)
+        buf, count = _writable(out, 8)
+        if count:
+            ret_len = ctypes.c_size_t(0)
+            ret = qrnglibhdlr.qrng_get_doubles(self.qrng_cptr, buf, count, ctypes.byref(ret_len))
+            if ret < 0 or ret_len.value != count:
+                raise QrngError("qrng_get_doubles", ret)
+        return out
+
+    def integers(self, lo: int, hi: int, n=None, out=None):
+        """
+        Returns 'n' unbiased random integers in [lo, hi), as
+        numpy.random.Generator.integers(), or fills 'out' in place
+
+        Parameters:
+            lo (int):  Lowest value (inclusive)
+            hi (int):  Highest value (exclusive), hi - lo <= 2^64
+            n (int):   The amount of random numbers to return, None
+                       for a single one
+            out:       Writable buffer of 64 bits integers to fill
+                       instead, e.g. a numpy int64 or uint64 array
+
+        Returns:
+            out, an int if 'n' is None, or a numpy array of 'n'
+            random numbers (a memoryview without numpy), uint64 if
+            'lo' >= 0, int64 otherwise
+        """
+        _require_ext("integers")
+        if hi <= lo or hi - lo > 1 << 64:
+            raise ValueError(f"Invalid range [{lo}, {hi})")
+        if out is None and n is None:
+            return int(self.integers(lo, hi, 1)[0])
+        if out is None:
+            if np is None:
+                out = memoryview(bytearray(8 * n)).cast('Q' if lo >= 0 else 'q')
+            else:
+                out = np.empty(n, dtype=np.uint64 if lo >= 0 else np.int64)
+        buf, count = _writable(out, 8)
+        if not count:
+            return out
+        ret_len = ctypes.c_size_t(0)
+        ret = qrnglibhdlr.qrng_get_range(self.qrng_cptr, 0, hi - lo - 1,
+                                         buf, count, ctypes.byref(ret_len))
+        if ret < 0 or ret_len.value != count:
+            raise QrngError("qrng_get_range", ret)
+
+        # 'lo' is added modulo 2^64, which is also the two's complement
+        # of the signed values
+        offset = lo & ((1 << 64) - 1)
+        if offset and np is not None:
+            values = np.frombuffer(buf, dtype=np.uint64)
+            values += np.uint64(offset)
+        elif offset:
+            values = memoryview(buf).cast('B').cast('Q')
+            for k in range(count):
+                values[k] = (values[k] + offset) & ((1 << 64) - 1)
+        return out
+
+    def bit_generator(self):
+        """
+        Returns the numpy BitGenerator of this device, see
+        QrngBitGenerator
+        """
+        if self._bit_generator is None:
+            self._bit_generator = QrngBitGenerator(self)
+        return self._bit_generator
+
+    def generator(self):
+        """
+        Returns a numpy.random.Generator drawing from this device,
+        e.g. qrng.generator().normal(size=1000), its methods raise
+        QrngError when a device read failed during the draws, see
+        QrngGenerator
+        """
+        _require_numpy("generator")
+        return QrngGenerator(self.bit_generator())
+
+    def shuffle(self, x):
+        """
+        Shuffles the mutable sequence 'x' (list, numpy array) in place
+        """
+        if HAS_EXT and np is not None:
+            self.generator().shuffle(x)
+            return
         for i in reversed(range(1, len(x))):
             # swap current element with a different member in the list
-            j = int_class(self.urand(self.qrng_cptr) * (i+1))
+            j = min(int(self.urand() * (i+1)), i)
             x[i], x[j] = x[j], x[i]
-        
 
+
+def _require_numpy(name: str):
+    if np is None:
+        raise RuntimeError(f"{name} needs numpy")
+
+
+class _Bitgen(ctypes.Structure):
+    """ bitgen_t of numpy/random/bitgen.h """
+    _fields_ = [("state", ctypes.c_void_p),
+                ("next_uint64", ctypes.c_void_p),
+                ("next_uint32", ctypes.c_void_p),
+                ("next_double", ctypes.c_void_p),
+                ("next_raw", ctypes.c_void_p)]
+
+
+class QrngBitGenerator:
+    """
+    numpy BitGenerator over a QdQrng device, for
+    numpy.random.Generator(QrngBitGenerator(qrng))
+
+    The generator calls qrng_pool_u64(), qrng_pool_u32() and
+    qrng_pool_double() of the extension library directly, each
+    thread draws from its own entropy pool of the handle, without
+    going through Python. The device can't be seeded, so the state
+    can't be saved or restored.
+
+    WARNING: numpy calls these functions from C and can't be told of
+    an error, a draw whose device read failed returns 0 (0.0) and the
+    Generator goes on with it. The error is kept until check(), which
+    raises QrngError. QdQrng.generator() and random_raw() check after
+    every call, a Generator built on this object by other code has to
+    call check() after its draws.
+    """
+    def __init__(self, qrng: QdQrng):
+        _require_ext("QrngBitGenerator")
+        _require_numpy("QrngBitGenerator")
+        self._qrng = qrng
+        self.lock = qrng._lock
+        fn = lambda name: ctypes.cast(getattr(qrnglibhdlr, name), ctypes.c_void_p).value
+        self._bitgen = _Bitgen(qrng.qrng_cptr, fn("qrng_pool_u64"), fn("qrng_pool_u32"),
+                               fn("qrng_pool_double"), fn("qrng_pool_u64"))
+        self._name = ctypes.create_string_buffer(b"BitGenerator")
+
+        new_capsule = ctypes.pythonapi.PyCapsule_New
+        new_capsule.restype = ctypes.py_object
+        new_capsule.argtypes = [ctypes.c_void_p, ctypes.c_char_p, ctypes.c_void_p]
+        self.capsule = new_capsule(ctypes.addressof(self._bitgen),
+                                   ctypes.cast(self._name, ctypes.c_char_p), None)
+
+    @property
+    def state(self):
+        return {"bit_generator": type(self).__name__}
+
+    def random_raw(self, size=None):
+        """
+        Raw 64 bits outputs, as numpy BitGenerator.random_raw(),
+        raises QrngError if the read or an earlier draw failed
+        """
+        n = 1 if size is None else size
+        out = self._qrng.get(out=np.empty(n, dtype=np.uint64))
+        self.check()
+        return int(out[0]) if size is None else out
+
+    def check(self):
+        """
+        Raises QrngError if a draw of the calling thread failed since
+        the previous check, and clears the error
+        """
+        ret = qrnglibhdlr.qrng_pool_get_error(self._qrng.qrng_cptr)
+        if ret < 0:
+            raise QrngError("qrng_pool_u64", ret)
+
+
+def _checked(name: str):
+    method = getattr(np.random.Generator, name)
+    def call(self, *args, **kwargs):
+        out = method(self, *args, **kwargs)
+        self.bit_generator.check()
+        return out
+    call.__name__ = name
+    call.__doc__ = method.__doc__
+    return call
+
+
+if np is not None:
+    class QrngGenerator(np.random.Generator):
+        """
+        numpy.random.Generator over a QrngBitGenerator whose methods
+        raise QrngError, after the draws, when a device read failed,
+        instead of returning the zeros numpy got from the bit generator
+        """
+
+    for _name in dir(np.random.Generator):
+        if not _name.startswith("_") and callable(getattr(np.random.Generator, _name)):
+            setattr(QrngGenerator, _name, _checked(_name))
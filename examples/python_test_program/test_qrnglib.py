@@ -1,3 +1,10 @@
+import os
+import socket
+import subprocess
+import sys
+import threading
+import time
+
 import qrnglib
 import pytest
 
@@ -36,3 +43,230 @@ def test_get_fn():
 
 
 
+
+# The tests below run on the prng backend of the extension library,
+# without the device
+needs_ext = pytest.mark.skipif(not qrnglib.HAS_EXT or qrnglib.np is None,
+                               reason="needs libqrng_ext.so ('make shared' in ./src) and numpy")
+
+@needs_ext
+def test_fill_in_place():
+    """
+    Tests that the get functions fill the buffers passed in place
+    """
+    np = qrnglib.np
+    qdQrng = qrnglib.QdQrng("VERTEX_B1", "prng:seed=1")
+    assert qdQrng.get_status() == 0
+
+    buf = bytearray(1000)
+    assert qdQrng.get(out=buf) is buf
+    assert any(buf)
+
+    arr = np.zeros(1 << 20, dtype=np.uint64)
+    qdQrng.get(out=arr)
+    assert np.count_nonzero(arr) > (1 << 20) - 10
+
+    view = memoryview(bytearray(64))
+    qdQrng.get(out=view[8:24])
+    assert not any(view[:8]) and not any(view[24:])
+
+    data = qdQrng.get(100)
+    assert data.dtype == np.uint8 and data.size == 100
+
+    raw = qdQrng.get_raw_ent(out=np.zeros(1000, dtype=np.uint16))
+    assert raw.dtype == np.uint16
+
+    with pytest.raises(TypeError):
+        qdQrng.get(out=bytes(10))
+
+@needs_ext
+def test_bulk_functions():
+    """
+    Tests random(), integers() and the shuffle
+    """
+    np = qrnglib.np
+    qdQrng = qrnglib.QdQrng("VERTEX_B1", "prng:seed=1")
+
+    x = qdQrng.random(100000)
+    assert x.dtype == np.float64 and x.min() >= 0 and x.max() < 1
+    assert abs(x.mean() - 0.5) < 0.01
+
+    i = qdQrng.integers(-3, 4, 100000)
+    assert i.dtype == np.int64 and i.min() == -3 and i.max() == 3
+    assert qdQrng.integers(0, 1 << 64, 10).dtype == np.uint64
+    with pytest.raises(ValueError):
+        qdQrng.integers(5, 5, 10)
+
+    cards = list(range(52))
+    qdQrng.shuffle(cards)
+    assert sorted(cards) == list(range(52)) and cards != list(range(52))
+
+@pytest.mark.skipif(not qrnglib.HAS_EXT, reason="needs libqrng_ext.so ('make shared' in ./src)")
+def test_bulk_functions_without_numpy(monkeypatch):
+    """
+    Tests random() and integers() on the memoryview path, as without
+    numpy installed
+    """
+    monkeypatch.setattr(qrnglib, "np", None)
+    qdQrng = qrnglib.QdQrng("VERTEX_B1", "prng:seed=1")
+
+    x = qdQrng.random()
+    assert isinstance(x, float) and 0 <= x < 1
+    i = qdQrng.integers(-3, 4)
+    assert isinstance(i, int) and -3 <= i <= 3
+
+    xs = qdQrng.random(1000)
+    assert isinstance(xs, memoryview) and len(xs) == 1000 and max(xs) < 1
+    ints = qdQrng.integers(-3, 4, 1000)
+    assert ints.format == 'q' and min(ints) == -3 and max(ints) == 3
+    assert max(qdQrng.integers(0, 10, 1000)) == 9
+
+@needs_ext
+def test_bit_generator():
+    """
+    Tests numpy.random.Generator on the device
+    """
+    qdQrng = qrnglib.QdQrng("VERTEX_B1", "prng:seed=1")
+    gen = qdQrng.generator()
+
+    normal = gen.normal(size=100000)
+    assert abs(normal.mean()) < 0.02 and abs(normal.std() - 1) < 0.02
+    assert gen.integers(0, 10, 1000).max() == 9
+    assert gen.random(10).max() < 1
+    assert gen.bit_generator.random_raw(4).size == 4
+    gen.bit_generator.check()
+
+@needs_ext
+def test_bit_generator_error(tmp_path):
+    """
+    Tests that the generator raises when the device runs dry, instead
+    of drawing from the zeros of the failed reads
+    """
+    path = tmp_path / "short.bin"
+    path.write_bytes(bytes(range(256)) * 256)
+    qdQrng = qrnglib.QdQrng("VERTEX_B1", f"fifo:{path}")
+    gen = qdQrng.generator()
+
+    with pytest.raises(qrnglib.QrngError):
+        gen.random(1 << 20)
+    with pytest.raises(qrnglib.QrngError):
+        gen.bit_generator.random_raw(4)
+    gen.bit_generator.check()
+
+QRNGD = os.path.join(os.path.dirname(os.path.realpath(__file__)), "../qrngd/bin/qrngd")
+
+def _wait_listening(proc, port, path):
+    """
+    Waits until the daemon accepts connections on 'port' and 'path'
+    """
+    for _ in range(100):
+        assert proc.poll() is None, proc.stdout.read()
+        try:
+            socket.create_connection(("127.0.0.1", port), timeout=1).close()
+            if os.path.exists(path):
+                return
+        except OSError:
+            pass
+        time.sleep(0.05)
+    pytest.fail("qrngd doesn't listen")
+
+@needs_ext
+@pytest.mark.skipif(not sys.platform.startswith("linux") or not os.path.exists(QRNGD),
+                    reason="needs qrngd ('make' in ./examples/qrngd)")
+def test_net_loopback(tmp_path):
+    """
+    Serves the prng backend with qrngd and reads it back over tcp: and
+    unix:, the words have to come in the order of the device stream,
+    with gaps only between the device reads of the server (the shared
+    memory ring of the daemon reads the same device)
+    """
+    np = qrnglib.np
+    with socket.socket() as s:
+        s.bind(("127.0.0.1", 0))
+        port = s.getsockname()[1]
+    path = str(tmp_path / "qrng.sock")
+    batch = 64 << 10
+    proc = subprocess.Popen([QRNGD, "-d", "prng:seed=1", "-n", f"/qrng_test_{os.getpid()}",
+                             "-b", "64", "-k", "4", "-r", "4", "-s", "0",
+                             "-l", f"tcp:127.0.0.1:{port};unix:{path}"],
+                            stdout=subprocess.PIPE, stderr=subprocess.STDOUT, text=True)
+    try:
+        _wait_listening(proc, port, path)
+        words = 100003
+        reads = []
+        for spec in (f"tcp:127.0.0.1:{port},batch={batch}", f"unix:{path},batch={batch}"):
+            client = qrnglib.QdQrng("VERTEX_B1", spec)
+            data = np.concatenate([client.get(out=np.zeros(n, dtype=np.uint64))
+                                   for n in (1, words - 1001, 1000)])
+            assert data.size == words and client.get_status() == 0
+            reads.append(data)
+            del client
+    finally:
+        proc.terminate()
+        assert proc.wait(timeout=10) == 0
+
+    # the server reads the device 1 MB at a time (QRNG_NET_DEFAULT_BATCH),
+    # which carries 8 bytes of data in each 16 bytes frame
+    read_words = (1 << 20) // 16
+    ref = qrnglib.QdQrng("VERTEX_B1", "prng:seed=1").get(out=np.zeros(2 << 20, dtype=np.uint64))
+    index = {int(w): i for i, w in enumerate(ref)}
+    seen = set()
+    for data in reads:
+        pos = np.array([index.get(int(w), -1) for w in data])
+        assert pos.min() >= 0
+        steps = np.diff(pos)
+        assert steps.min() > 0
+        jumps = np.flatnonzero(steps != 1) + 1
+        assert np.all(jumps % read_words == 0)
+        assert seen.isdisjoint(pos.tolist())
+        seen.update(pos.tolist())
+
+@needs_ext
+@pytest.mark.skipif(not sys.platform.startswith("linux") or not os.path.exists(QRNGD),
+                    reason="needs qrngd ('make' in ./examples/qrngd)")
+def test_shm_slow_client():
+    """
+    Serves the prng backend with qrngd on a ring of two 64 MB slots and
+    reads it with clients that are slow but alive: they claim a whole
+    slot after the ring sat full for longer than QRNG_SHM_STALL_MS, and
+    no slot may be taken back from them
+    """
+    name = f"/qrng_slow_{os.getpid()}"
+    block = 64 << 20
+    proc = subprocess.Popen([QRNGD, "-d", "prng:seed=1", "-n", name, "-b", str(block >> 10),
+                             "-k", "2", "-s", "1"],
+                            stdout=subprocess.PIPE, stderr=subprocess.STDOUT, text=True)
+    try:
+        # the object exists before the rings are set up
+        for _ in range(100):
+            assert proc.poll() is None, proc.stdout.read()
+            try:
+                qrnglib.QdQrng("VERTEX_B1", f"shm:{name}").get(16)
+                break
+            except qrnglib.QrngError:
+                time.sleep(0.05)
+        clients = [qrnglib.QdQrng("VERTEX_B1", f"shm:{name}") for _ in range(2)]
+        errors = []
+
+        def read(client):
+            try:
+                for _ in range(3):
+                    time.sleep(1.5)
+                    client.get(block)
+            except Exception as e:
+                errors.append(e)
+
+        threads = [threading.Thread(target=read, args=(c,)) for c in clients]
+        for t in threads:
+            t.start()
+        for t in threads:
+            t.join()
+        assert not errors
+        del clients
+        time.sleep(1.2)
+    finally:
+        proc.terminate()
+        out = proc.communicate(timeout=10)[0]
+
+    assert proc.returncode == 0 and "clients" in out
+    assert "reclaimed" not in out
@@ -0,0 +1,165 @@
+/**
+* @file     qrngd.cpp
+* @brief    Entropy daemon: serves a Quantum Dice QRNG to local processes.
+* @date     17/10/2026
+*
+* Copyright(c) Quantum Dice. All rights reserved.
+*
+* The daemon is the only process opening the device. It publishes the
+* device data in a POSIX shared memory object with qrng_shm_start(),
+* the clients open the device "shm:<name>" and use the usual qrng_*
+* functions without root access or contention on the device:
+*
+*	QRNG* qrng = qrng_ext_init_param({ QRNG_VERTEX_B1, "shm:/qrng" }, {});
+*	double x = qrng_urand(qrng);
+*
+* With -l, the device is also served over TCP or unix sockets with
+* qrng_net_start(), to the devices "tcp:<host>:<port>" and "unix:<path>".
+*/
+
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+#include <grp.h>
+#include <unistd.h>
+
+#include <qrng_api.h>
+#include <qrng_ext.h>
+
+static volatile std::sig_atomic_t stop_requested = 0;
+
+static void on_signal(int)
+{
+	stop_requested = 1;
+}
+
+void print_help_info(){
+	std::cout << "----------------------------------------------------------------------\n";
+	std::cout << "How to run the program: \n";
+	std::cout << "\t ./qrngd [-d device] [-n name] [-b block_kb] [-k depth] [-r raw_depth]\n";
+	std::cout << "\t         [-m mode] [-g group] [-l address] [-t] [-s seconds]\n\n";
+	std::cout << "e.g.\t ./qrngd -d /dev/xdma0 -n /qrng -m 0660 -g qrng\n";
+	std::cout << "\t\t Serves /dev/xdma0 to the members of the group 'qrng',\n";
+	std::cout << "\t\t which open the device \"shm:/qrng\"\n";
+	std::cout << "\n NB:";
+	std::cout << "\t -d: device name, any name of qrng_ext_init_param (default /dev/xdma0)\n";
+	std::cout << "\t -n: shared memory object (default " << QRNG_SHM_DEFAULT_NAME << ")\n";
+	std::cout << "\t -b, -k: slot size in KB and slots of the hashed channel ring\n";
+	std::cout << "\t -r: slots of the raw channel ring, 0 doesn't serve it (default)\n";
+	std::cout << "\t -m, -g: permissions and group of the object (default 0660)\n";
+	std::cout << "\t -l: also serve \"tcp:<host>:<port>\" or \"unix:<path>\", several\n";
+	std::cout << "\t     addresses separated by ';' (e.g. \"tcp:127.0.0.1:7000\")\n";
+	std::cout << "\t -t: run the SP 800-90B health tests on the device data\n";
+	std::cout << "\t -s: print the ring counters every 's' seconds, 0 never (default 10)\n";
+	std::cout << "----------------------------------------------------------------------\n\n";
+}
+
+static void print_stats(const Qrng_shm_stats& s, const Qrng_net_stats& n, double mb_per_s)
+{
+	printf("clients %u  hashed %.1f MB/s, %zu/%zu KB ready, %llu underruns, %llu overruns",
+		s.clients, mb_per_s, s.hashed.occupancy >> 10, s.hashed.capacity >> 10,
+		(unsigned long long)s.hashed.underruns, (unsigned long long)s.hashed.overruns);
+	if (s.hashed.reclaimed + s.raw.reclaimed)
+		printf(", %llu slots reclaimed", (unsigned long long)(s.hashed.reclaimed + s.raw.reclaimed));
+	if (s.raw.capacity)
+		printf("  raw %llu MB", (unsigned long long)(s.raw.produced >> 20));
+	if (n.connections)
+		printf("  net %u clients, %llu MB sent", n.clients, (unsigned long long)(n.bytes >> 20));
+	printf("\n");
+	fflush(stdout);
+}
+
+int main(int argc, char* argv[])
+{
+	const char* device = "/dev/xdma0";
+	const char* group = nullptr;
+	Qrng_shm_param shm = {};
+	Qrng_net_param net = {};
+	Qrng_ext_param ext = {};
+	int interval = 10;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "d:n:b:k:r:m:g:l:ts:h")) != -1) {
+		switch (opt) {
+		case 'd': device = optarg; break;
+		case 'n': shm.name = optarg; break;
+		case 'b': shm.block = strtoull(optarg, nullptr, 10) << 10; break;
+		case 'k': shm.depth = strtoull(optarg, nullptr, 10); break;
+		case 'r': shm.raw_depth = strtoull(optarg, nullptr, 10); break;
+		case 'm': shm.mode = (uint32_t)strtoul(optarg, nullptr, 8); break;
+		case 'g': group = optarg; break;
+		case 'l': net.address = optarg; break;
+		case 't': ext.health_tests = 1; break;
+		case 's': interval = atoi(optarg); break;
+		default:
+			print_help_info();
+			return (opt == 'h') ? 0 : -1;
+		}
+	}
+
+	/** the object is created with the group of the daemon */
+	if (group) {
+		struct group* gr = getgrnam(group);
+		if (!gr || setegid(gr->gr_gid) != 0) {
+			std::cout << "Error: can't use the group " << group << "\n";
+			return -1;
+		}
+	}
+
+	QRNG* qrng = qrng_ext_init_param({ QRNG_VERTEX_B1, device }, ext);
+	if (!qrng) {
+		std::cout << "Error: can't open the device " << device << "\n";
+		return -1;
+	}
+
+	int ret = qrng_shm_start(qrng, &shm);
+	if (ret != QRNG_SUCCESS) {
+		std::cout << "Error " << ret << ": can't serve the device, is another daemon running?\n";
+		qrng_deinit(qrng);
+		return -1;
+	}
+
+	net.mode = shm.mode;
+	if (net.address && (ret = qrng_net_start(qrng, &net)) != QRNG_SUCCESS) {
+		std::cout << "Error " << ret << ": can't listen on " << net.address << "\n";
+		qrng_deinit(qrng);
+		return -1;
+	}
+
+	std::signal(SIGINT, on_signal);
+	std::signal(SIGTERM, on_signal);
+	std::cout << "Serving " << device << " on shm:" << (shm.name ? shm.name : QRNG_SHM_DEFAULT_NAME);
+	if (net.address) std::cout << ";" << net.address;
+	std::cout << "\n";
+
+	auto last = std::chrono::steady_clock::now();
+	uint64_t last_produced = 0;
+	int ticks = 0;
+
+	while (!stop_requested) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		if (interval <= 0 || ++ticks < interval * 10) continue;
+		ticks = 0;
+
+		Qrng_shm_stats stats;
+		Qrng_net_stats net_stats;
+		qrng_shm_get_stats(qrng, &stats);
+		qrng_net_get_stats(qrng, &net_stats);
+		auto now = std::chrono::steady_clock::now();
+		double sec = std::chrono::duration<double>(now - last).count();
+		print_stats(stats, net_stats, (stats.hashed.produced - last_produced) / sec / 1e6);
+		last = now;
+		last_produced = stats.hashed.produced;
+	}
+
+	std::cout << "Stopping\n";
+	if (net.address) qrng_net_stop(qrng);
+	qrng_shm_stop(qrng);
+	qrng_deinit(qrng);
+	return 0;
+}
@@ -1,143 +1,479 @@
 /**
-* @file     simple.cpp
-* @brief    Sample program for generating random numbers with Quantum Dice QRNG.
+* @file     speedtest.cpp
+* @brief    Benchmark suite of the QRNG API and of its extensions.
 * @author   Clifford Olawaiye
-* @date     03/01/2023
+* @date     17/10/2026
 *
 * Copyright(c) Quantum Dice. All rights reserved.
+*
+* Each case runs one function of the API for a fixed time on a number of
+* threads, with a request size and a handle sharing mode:
+* - private: one handle per thread
+* - shared: one handle for all the threads, for the extension functions
+*   only (the functions of qrng_api.h need one handle per thread)
+*
+* Every call is timed into a log-linear histogram (1/16 of a power of
+* two per bucket), the latency percentiles are read from it. The CPU
+* cycles are the CPU time of the whole process, library threads
+* included, at the TSC frequency.
+*
+* The results are written as JSON. With a backend standing in for the
+* device, e.g. -d prng:seed=1, the suite runs without the hardware for
+* regression tracking.
 */
 
-#include <stdio.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <memory>
+#include <sstream>
 #include <string>
 #include <thread>
 #include <vector>
-#include <iomanip>
-#include <iostream>
 
-#include "qrng_api.h" 
+#include <unistd.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "qrng_api.h"
+#include "qrng_ext.h"
 
 #define KB(x)   ((size_t) (x) << 10)
 #define MB(x)   ((size_t) (x) << 20)
 
-#define DEBUG_PRINT printf
+/** Histogram buckets: 16 per power of two of nanoseconds */
+#define HIST_SUB_BITS	4
+#define HIST_BUCKETS	(64 << HIST_SUB_BITS)
 
-/**
-* This function prints out the initial portion of an array of unsigned char 
-* defined by the 'x' and 'y' arguments
-* 
-* @param[in]    data    The unsigned char array 
-* @param[in]    size    size of the array 
-* @param[in]    x, y    length and height of the matrix
-*/
-void debug_data_stream(unsigned char* data, int size, int x, int y)
-{
-    DEBUG_PRINT("\n\t Print data, size: %d, row: %d, col: %d", size, x, y);
-
-    for (int i = 0; i < size; i++) {
-        if ((i % x) == 0) DEBUG_PRINT("\n\t");
-        if (i >= y * x) break;
-        DEBUG_PRINT(" %02x", data[i]);
-    }
-    DEBUG_PRINT("\n");
-}
- 
-
-int status_service(std::string thread_name, int run_count) {
-	DEBUG_PRINT("\n Running speed test, reps: %d %s, Thread name: %s",
-			run_count, (run_count == 0) ? "(infinite loop)" : " ",
-			thread_name.c_str());
-
-	std::vector<uint8_t> test_buf(MB(80));
-
-	/**  Define second function */
-	/** Initialize the QRNG api */
-	#ifdef __unix__
-		QRNG* qrng = qrng_init_param({ QRNG_VERTEX_B1, "/dev/xdma0" });
-	#else //_WIN32
-		QRNG* qrng = qrng_init_param({ QRNG_VERTEX_B1, "0" });
-	#endif
-	DEBUG_PRINT("\n QRNG init function status: %d", qrng_get_status(qrng));
-
-	if (qrng_get_status(qrng) != QRNG_SUCCESS) {
-		DEBUG_PRINT("\n QRNG experienced ERROR [%d] during initialization",
-			qrng_get_status(qrng));
-		goto exit;
+typedef std::chrono::steady_clock Clock;
+
+/** Function under test, 'size' in bytes, returns the bytes of the call */
+typedef int (*Bench_fn)(QRNG* qrng, u8* buf, size_t size, size_t* bytes);
+
+typedef struct {
+	const char* name;
+	Bench_fn fn;
+	size_t fixed_size;	/**< bytes of a scalar call, 0 for the sizes sweep */
+	bool shareable;		/**< extension function, safe on a shared handle */
+}Bench_op;
+
+typedef struct {
+	std::string device;
+	std::vector<std::string> ops;
+	std::vector<size_t> sizes;
+	std::vector<int> threads;
+	std::vector<std::string> modes;
+	int duration_ms;
+	size_t prefetch_depth;
+	std::string output;
+}Bench_config;
+
+typedef struct {
+	u64 buckets[HIST_BUCKETS];
+	u64 calls;
+	u64 bytes;
+	u64 errors;
+	u64 max_ns;
+	int status;		/**< first error */
+}Bench_counters;
+
+static int op_get(QRNG* qrng, u8* buf, size_t size, size_t* bytes)
+{
+	s32 n = 0;
+	int ret = qrng_get(qrng, buf, (s32)size, &n);
+	*bytes = (n > 0) ? n : 0;
+	return ret;
+}
+
+static int op_get64(QRNG* qrng, u8* buf, size_t size, size_t* bytes)
+{
+	return qrng_get64(qrng, buf, size, bytes);
+}
+
+static int op_get_with_ec(QRNG* qrng, u8* buf, size_t size, size_t* bytes)
+{
+	thread_local std::vector<u16> ent;
+	thread_local std::vector<float> cert;
+	size_t blocks = size / 8;
+	ent.resize(blocks);
+	cert.resize(blocks);
+
+	int ret = qrng_get_with_ec(qrng, buf, (s32)(blocks * 8), ent.data(), (s32)blocks,
+							cert.data(), (s32)blocks);
+	*bytes = (ret == QRNG_SUCCESS) ? blocks * 8 : 0;
+	return ret;
+}
+
+static int op_raw_ent(QRNG* qrng, u8* buf, size_t size, size_t* bytes)
+{
+	s32 n = 0;
+	int ret = qrng_get_raw_ent(qrng, (u16*)buf, (s32)(size / 2), &n);
+	*bytes = (n > 0) ? n * 2 : 0;
+	return ret;
+}
+
+static int op_rand(QRNG* qrng, u8* buf, size_t size, size_t* bytes)
+{
+	int v = qrng_rand(qrng);
+	memcpy(buf, &v, sizeof(v));
+	*bytes = sizeof(v);
+	return qrng_get_status(qrng);
+}
+
+static int op_urand(QRNG* qrng, u8* buf, size_t size, size_t* bytes)
+{
+	double v = qrng_urand(qrng);
+	memcpy(buf, &v, sizeof(v));
+	*bytes = sizeof(v);
+	return qrng_get_status(qrng);
+}
+
+static int op_pool_urand(QRNG* qrng, u8* buf, size_t size, size_t* bytes)
+{
+	double v = qrng_pool_urand(qrng);
+	memcpy(buf, &v, sizeof(v));
+	*bytes = sizeof(v);
+	return qrng_ext_get_status(qrng);
+}
+
+static const Bench_op bench_ops[] = {
+	{ "get", op_get, 0, false },
+	{ "get64", op_get64, 0, true },
+	{ "get_with_ec", op_get_with_ec, 0, false },
+	{ "raw_ent", op_raw_ent, 0, false },
+	{ "rand", op_rand, sizeof(int), false },
+	{ "urand", op_urand, sizeof(double), false },
+	{ "pool_urand", op_pool_urand, sizeof(double), true },
+};
+
+static inline void hist_add(Bench_counters* c, u64 ns)
+{
+	int b = 0;
+	if (ns < (1u << HIST_SUB_BITS)) {
+		b = (int)ns;
+	}
+	else {
+		int exp = 63 - __builtin_clzll(ns);
+		b = ((exp - HIST_SUB_BITS + 1) << HIST_SUB_BITS)
+			+ (int)((ns >> (exp - HIST_SUB_BITS)) & ((1u << HIST_SUB_BITS) - 1));
+	}
+	c->buckets[std::min(b, HIST_BUCKETS - 1)]++;
+	c->max_ns = std::max(c->max_ns, ns);
+}
+
+/** Lower bound of a bucket in ns */
+static u64 hist_value(int b)
+{
+	if (b < (1 << HIST_SUB_BITS)) return b;
+	int exp = (b >> HIST_SUB_BITS) + HIST_SUB_BITS - 1;
+	u64 sub = b & ((1 << HIST_SUB_BITS) - 1);
+	return ((u64)1 << exp) + (sub << (exp - HIST_SUB_BITS));
+}
+
+static u64 hist_percentile(const Bench_counters* c, double p)
+{
+	if (c->calls == 0) return 0;
+
+	u64 rank = (u64)(p * (c->calls - 1));
+	u64 seen = 0;
+	for (int b = 0; b < HIST_BUCKETS; b++) {
+		seen += c->buckets[b];
+		if (seen > rank) return std::min(hist_value(b), c->max_ns);
 	}
+	return c->max_ns;
+}
+
+static double process_cpu_seconds()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
 
-	
-	for (int i = 0; i < run_count || run_count == 0; i++) {
-		//get speed
-
-		auto start = std::chrono::high_resolution_clock::now();
-		s32 bytes_count = 0;
-		int ret = qrng_get(qrng, test_buf.data(), test_buf.size(), &bytes_count);
-		auto end = std::chrono::high_resolution_clock::now();
-
-		// Calculating total time taken by the program.
-		double time_taken_ns = std::chrono::duration_cast<
-				std::chrono::nanoseconds>(end - start).count();
-		//std::cout << std::setprecision(3) << std::fixed;
-		//std::cout << time_taken_ns / pow(10,6) << "ms, " << bytes_count << "bytes, ";
-		std::cout << "[" << std::setw(6) << i << "]\t" << thread_name
-				<< ", st: " << ret << ", " << std::setprecision(3)
-				<< ((test_buf.size() / time_taken_ns) * 8) << "gbps\n";
-
-		//sleep
-#ifdef _WIN32
-			Sleep(2000);
+/** TSC frequency in Hz, 0 where there is no TSC */
+static double tsc_hz()
+{
+#if defined(__x86_64__) || defined(__i386__)
+	auto t0 = Clock::now();
+	u64 c0 = __rdtsc();
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	u64 c1 = __rdtsc();
+	double sec = std::chrono::duration<double>(Clock::now() - t0).count();
+	return (c1 - c0) / sec;
 #else
-		sleep(2);
+	return 0.0;
 #endif
+}
+
+static QRNG* open_handle(const Bench_config& cfg)
+{
+	Qrng_ext_param ext = {};
+	ext.prefetch_depth = cfg.prefetch_depth;
+	return qrng_ext_init_param({ QRNG_VERTEX_B1, cfg.device.c_str() }, ext);
+}
+
+typedef struct {
+	const Bench_op* op;
+	size_t size;
+	int threads;
+	bool shared;
+	double seconds;
+	double cpu_seconds;
+	Bench_counters total;
+}Bench_result;
+
+static void bench_thread(const Bench_op* op, QRNG* qrng, size_t size, Bench_counters* c,
+						std::atomic<int>* ready, std::atomic<bool>* go, std::atomic<bool>* stop)
+{
+	std::vector<u8> buf(std::max(size, (size_t)16));
+	size_t bytes = 0;
+
+	/** the first call allocates the per thread state of the handle */
+	op->fn(qrng, buf.data(), size, &bytes);
+	ready->fetch_add(1);
+	while (!go->load()) std::this_thread::yield();
+
+	while (!stop->load(std::memory_order_relaxed)) {
+		auto t0 = Clock::now();
+		int ret = op->fn(qrng, buf.data(), size, &bytes);
+		auto t1 = Clock::now();
+
+		hist_add(c, std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count());
+		c->calls++;
+		c->bytes += bytes;
+		if (ret != QRNG_SUCCESS) {
+			if (c->errors++ == 0) c->status = ret;
+			break;
+		}
 	}
+}
 
-	exit:
-		qrng_deinit(qrng); 
-		return 0;
-}
-
-void print_head() {
-	/* Print headers for better presentation */
-	std::cout << "\nStatus descrition: \n";
-	std::cout << -9 << " Internal buffer error \n";
-	std::cout << -8 << " Internal initialization error: insufficient memory\n";
-	std::cout << -7 << " Internal error reading device\n";
-	std::cout << -6 << " Incomplete data was received \n";
-	std::cout << -5
-			<< " Unable to initialize device, could be driver issues or insufficient priviledges\n";
-	std::cout << -4 << " QRNG is not initialized \n";
-	std::cout << -3 << " QRNG is already initialized \n";
-	std::cout << -2 << " Null pointer error\n";
-	std::cout << -1
-			<< " No device found, could also be absense of driver or disconnected hardware\n";
-	std::cout << 0 << " No error \n\n";
-
-	std::cout << std::setw(30) << "QRNG (rand)" << std::setw(30)
-			<< " QRNG (get)" << "\n";
-
-}
-
-/** Main programs */
-int multithread(int argc, char **argv) {
-	int run_count = (argc > 1) ? atoi(argv[1]) : 0; //default run for multithread should be 2
-	int num_of_threads = 1;
-	print_head();
-
-	std::vector<std::thread> threads(num_of_threads);
-	for (int i = 0; i < num_of_threads; i++) {
-		threads[i] = std::thread(status_service, "Thread" + std::to_string(i),
-				run_count);
+static bool bench_run(const Bench_config& cfg, const Bench_op* op, size_t size, int threads,
+					bool shared, Bench_result* res)
+{
+	std::vector<QRNG*> handles(shared ? 1 : threads, nullptr);
+	for (QRNG*& h : handles) {
+		h = open_handle(cfg);
+		if (!h || qrng_get_status(h) != QRNG_SUCCESS) {
+			for (QRNG* o : handles) if (o) qrng_deinit(o);
+			return false;
+		}
 	}
 
-	for (int i = 0; i < num_of_threads; i++) {
-		threads[i].join();
+	std::vector<std::unique_ptr<Bench_counters>> counters;
+	std::vector<std::thread> pool;
+	std::atomic<int> ready{ 0 };
+	std::atomic<bool> go{ false };
+	std::atomic<bool> stop{ false };
+
+	for (int i = 0; i < threads; i++) {
+		counters.emplace_back(new Bench_counters());
+		pool.emplace_back(bench_thread, op, handles[shared ? 0 : i], size, counters.back().get(),
+						&ready, &go, &stop);
 	}
+	while (ready.load() < threads) std::this_thread::sleep_for(std::chrono::milliseconds(1));
 
-	return 0;
+	double cpu0 = process_cpu_seconds();
+	auto t0 = Clock::now();
+	go.store(true);
+	std::this_thread::sleep_for(std::chrono::milliseconds(cfg.duration_ms));
+	stop.store(true);
+	for (std::thread& t : pool) t.join();
+	res->seconds = std::chrono::duration<double>(Clock::now() - t0).count();
+	res->cpu_seconds = process_cpu_seconds() - cpu0;
+
+	res->op = op;
+	res->size = size;
+	res->threads = threads;
+	res->shared = shared;
+	memset(&res->total, 0, sizeof(res->total));
+	for (auto& c : counters) {
+		for (int b = 0; b < HIST_BUCKETS; b++) res->total.buckets[b] += c->buckets[b];
+		res->total.calls += c->calls;
+		res->total.bytes += c->bytes;
+		res->total.max_ns = std::max(res->total.max_ns, c->max_ns);
+		if (c->errors && !res->total.errors) res->total.status = c->status;
+		res->total.errors += c->errors;
+	}
+
+	for (QRNG* h : handles) qrng_deinit(h);
+	return true;
 }
 
-int main(int argc, char **argv)
+static std::string result_json(const Bench_result& r, double hz)
+{
+	const Bench_counters& c = r.total;
+	double mbps = c.bytes / r.seconds / 1e6;
+	std::ostringstream os;
+	os.precision(6);
+
+	os << "{\"op\": \"" << r.op->name << "\", \"mode\": \"" << (r.shared ? "shared" : "private")
+		<< "\", \"threads\": " << r.threads << ", \"size\": " << r.size
+		<< ", \"calls\": " << c.calls << ", \"bytes\": " << c.bytes
+		<< ", \"seconds\": " << r.seconds << ", \"throughput_mbps\": " << mbps
+		<< ", \"calls_per_second\": " << c.calls / r.seconds
+		<< ", \"latency_ns\": {\"p50\": " << hist_percentile(&c, 0.5)
+		<< ", \"p99\": " << hist_percentile(&c, 0.99) << ", \"p999\": " << hist_percentile(&c, 0.999)
+		<< ", \"max\": " << c.max_ns << "}, \"cycles_per_byte\": ";
+	if (hz > 0 && c.bytes) os << r.cpu_seconds * hz / c.bytes;
+	else os << "null";
+	os << ", \"errors\": " << c.errors << ", \"status\": " << (c.errors ? c.status : QRNG_SUCCESS) << "}";
+	return os.str();
+}
+
+static std::vector<std::string> split(const std::string& s)
 {
-	return multithread(argc, argv);
+	std::vector<std::string> out;
+	std::stringstream ss(s);
+	std::string item;
+	while (std::getline(ss, item, ',')) if (!item.empty()) out.push_back(item);
+	return out;
 }
 
+/** Size with an optional K or M suffix */
+static size_t parse_size(const std::string& s)
+{
+	char* end = nullptr;
+	size_t v = strtoull(s.c_str(), &end, 10);
+	if (*end == 'K' || *end == 'k') v <<= 10;
+	else if (*end == 'M' || *end == 'm') v <<= 20;
+	return v;
+}
+
+void print_help_info(){
+	std::cout << "----------------------------------------------------------------------\n";
+	std::cout << "How to run the program: \n";
+	std::cout << "\t ./speedtest [-d device] [-b ops] [-s sizes] [-t threads] [-m modes]\n";
+	std::cout << "\t             [-T ms] [-p depth] [-o file]\n\n";
+	std::cout << "e.g.\t ./speedtest -d prng:seed=1 -b get64,urand -t 1,4 -o results.json\n";
+	std::cout << "\t\t Runs the suite on the prng backend, without the device\n";
+	std::cout << "\n NB:";
+	std::cout << "\t -d: device name, any name of qrng_ext_init_param (default /dev/xdma0)\n";
+	std::cout << "\t -b: functions, among get, get64, get_with_ec, raw_ent, rand, urand\n";
+	std::cout << "\t     and pool_urand (default all)\n";
+	std::cout << "\t -s: request sizes in bytes, K and M suffixes (default 16,4K,64K,1M,8M)\n";
+	std::cout << "\t -t: thread counts (default 1,2,4)\n";
+	std::cout << "\t -m: handle sharing modes, private and shared (default both)\n";
+	std::cout << "\t -T: duration of a case in ms (default 500)\n";
+	std::cout << "\t -p: prefetch depth of the handles (default 0, no prefetch thread)\n";
+	std::cout << "\t -o: JSON output file (default stdout), a summary goes to stderr\n";
+	std::cout << "----------------------------------------------------------------------\n\n";
+}
+
+int main(int argc, char **argv)
+{
+	Bench_config cfg;
+	cfg.device = "/dev/xdma0";
+	for (const Bench_op& op : bench_ops) cfg.ops.push_back(op.name);
+	cfg.sizes = { 16, KB(4), KB(64), MB(1), MB(8) };
+	cfg.threads = { 1, 2, 4 };
+	cfg.modes = { "private", "shared" };
+	cfg.duration_ms = 500;
+	cfg.prefetch_depth = 0;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "d:b:s:t:m:T:p:o:h")) != -1) {
+		switch (opt) {
+		case 'd': cfg.device = optarg; break;
+		case 'b': cfg.ops = split(optarg); break;
+		case 's':
+			cfg.sizes.clear();
+			for (const std::string& s : split(optarg)) cfg.sizes.push_back(parse_size(s));
+			break;
+		case 't':
+			cfg.threads.clear();
+			for (const std::string& s : split(optarg)) cfg.threads.push_back(std::max(atoi(s.c_str()), 1));
+			break;
+		case 'm': cfg.modes = split(optarg); break;
+		case 'T': cfg.duration_ms = std::max(atoi(optarg), 1); break;
+		case 'p': cfg.prefetch_depth = strtoull(optarg, nullptr, 10); break;
+		case 'o': cfg.output = optarg; break;
+		default:
+			print_help_info();
+			return (opt == 'h') ? 0 : -1;
+		}
+	}
+
+	/** fail early without the device */
+	QRNG* probe = open_handle(cfg);
+	if (!probe || qrng_get_status(probe) != QRNG_SUCCESS) {
+		std::cerr << "Error [" << (probe ? qrng_get_status(probe) : QRNG_ERROR_OPENING_DEVICE)
+				<< "]: can't open the device " << cfg.device << "\n";
+		if (probe) qrng_deinit(probe);
+		return -1;
+	}
+	qrng_deinit(probe);
+
+	double hz = tsc_hz();
+	std::vector<std::string> results;
+	fprintf(stderr, "%-12s %-8s %3s %9s %11s %9s %9s %9s %8s\n",
+			"op", "mode", "thr", "size", "MB/s", "p50 ns", "p99 ns", "p999 ns", "cyc/B");
+
+	for (const std::string& name : cfg.ops) {
+		const Bench_op* op = nullptr;
+		for (const Bench_op& o : bench_ops) if (name == o.name) op = &o;
+		if (!op) {
+			std::cerr << "Error: unknown function " << name << "\n";
+			return -1;
+		}
+
+		std::vector<size_t> sizes = op->fixed_size ? std::vector<size_t>{ op->fixed_size } : cfg.sizes;
+		for (const std::string& mode : cfg.modes) {
+			bool shared = (mode == "shared");
+			if (shared && !op->shareable) continue;
+
+			for (int threads : cfg.threads) {
+				/** a single thread is the same case in both modes */
+				if (shared && threads == 1) continue;
+
+				for (size_t size : sizes) {
+					Bench_result r;
+					if (!bench_run(cfg, op, size, threads, shared, &r)) {
+						std::cerr << "Error: can't open the device " << cfg.device << "\n";
+						return -1;
+					}
+					results.push_back(result_json(r, hz));
+
+					const Bench_counters& c = r.total;
+					fprintf(stderr, "%-12s %-8s %3d %9zu %11.1f %9llu %9llu %9llu %8.2f%s\n",
+							op->name, shared ? "shared" : "private", threads, size,
+							c.bytes / r.seconds / 1e6,
+							(unsigned long long)hist_percentile(&c, 0.5),
+							(unsigned long long)hist_percentile(&c, 0.99),
+							(unsigned long long)hist_percentile(&c, 0.999),
+							(hz > 0 && c.bytes) ? r.cpu_seconds * hz / c.bytes : 0.0,
+							c.errors ? " (error)" : "");
+				}
+			}
+		}
+	}
+
+	std::ostringstream os;
+	os << "{\n\"device\": \"" << cfg.device << "\",\n\"duration_ms\": " << cfg.duration_ms
+		<< ",\n\"prefetch_depth\": " << cfg.prefetch_depth
+		<< ",\n\"cpus\": " << std::thread::hardware_concurrency()
+		<< ",\n\"tsc_hz\": " << (u64)hz << ",\n\"results\": [\n";
+	for (size_t i = 0; i < results.size(); i++)
+		os << "  " << results[i] << (i + 1 < results.size() ? ",\n" : "\n");
+	os << "]\n}\n";
+
+	if (cfg.output.empty()) {
+		std::cout << os.str();
+	}
+	else {
+		FILE* f = fopen(cfg.output.c_str(), "w");
+		if (!f) {
+			std::cerr << "Error: can't write " << cfg.output << "\n";
+			return -1;
+		}
+		fputs(os.str().c_str(), f);
+		fclose(f);
+	}
+	return 0;
+}
@@ -0,0 +1,947 @@
+/**
+* @file     stattest.cpp
+* @brief    Streaming statistical tests of the QRNG output (NIST SP 800-22)
+* @author   Clifford Olawaiye
+* @date     17/10/2026
+*
+* Copyright(c) Quantum Dice. All rights reserved.
+*
+* The random bytes are read once, from the device (or any backend of
+* qrng_ext_init_param, e.g. prng:seed=1 or file:<path>) or from a
+* recorded file, as one sequence of n bits, most significant bit of
+* each byte first, and go through the tests of SP 800-22 section 2:
+* - frequency (2.1): the ones count
+* - runs (2.3): the count of bit changes
+* - serial (2.11): the counts of the overlapping m bits patterns
+* - approximate entropy (2.12): the same counts for m - 1 and m bits
+* - spectral (2.6): the DFT test on windows of the sequence
+*
+* The reader thread cuts the stream into blocks of 4 MB, tested by the
+* worker threads in any order: each worker adds its counts into its
+* own shard, the shards are added up at the end. The bits crossing the
+* end of a block are read from the first word of the next one, which
+* the reader copies after the block, the last block getting the first
+* word of the sequence as the serial and approximate entropy tests are
+* cyclic. The ones and the bit changes are counted with POPCNT, 256
+* bits at a time with AVX2 when the CPU has it. Rather than one count
+* per bit offset, the m + s - 1 bits windows at every s bits are
+* counted, s = 8, 4 or 2 for a histogram of at most 2^17 counters, and
+* each window gives the s patterns it holds once per block.
+*
+* A DFT of the whole sequence is out of reach, so the spectral test
+* runs on windows of w bits, one every k windows, and is reported the
+* way SP 800-22 section 4.2 reports the tests of many sequences: the
+* proportion of windows passing, and the uniformity of their p-values.
+* The sequence is truncated to whole 64 bits words.
+*
+* The report is a table on stdout, and JSON with -o. The exit code is
+* 0 when all the tests pass, 1 when one fails, -1 on errors.
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#include "qrng_api.h"
+#include "qrng_ext.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#define STAT_X86_KERNELS
+#endif
+
+#define KB(x)   ((size_t) (x) << 10)
+#define MB(x)   ((size_t) (x) << 20)
+#define GB(x)   ((size_t) (x) << 30)
+
+/** Words of a block, a multiple of the words of the largest window */
+#define BLOCK_WORDS			(MB(4) / 8)
+#define MAX_WINDOW_BITS		(BLOCK_WORDS * 64)
+
+#define MIN_PATTERN_BITS	3
+#define MAX_PATTERN_BITS	16
+
+/** Significance level of the tests, and of the p-values uniformity */
+#define STAT_ALPHA			0.01
+#define STAT_ALPHA_UNIFORM	0.0001
+/** Windows needed to test the uniformity of their p-values */
+#define MIN_UNIFORM_WINDOWS	55
+#define UNIFORM_BINS		10
+
+typedef std::chrono::steady_clock Clock;
+
+typedef struct {
+	std::string device;
+	std::string file;
+	size_t size;
+	int threads;
+	int pattern_bits;		/**< m of the serial test, m - 1 for the approximate entropy */
+	size_t window_bits;
+	size_t window_stride;
+	std::string output;
+}Stat_config;
+
+/** Words of the sequence and, after them, the next word of the sequence */
+typedef struct {
+	std::vector<u64> words;
+	size_t count;
+	u64 first_bit;
+}Stat_block;
+
+/** Counts of one worker */
+typedef struct {
+	u64 ones;
+	u64 changes;			/**< cyclic, the last to first bit change included */
+	std::vector<u64> patterns;
+	u64 windows;
+	u64 windows_passed;
+	double window_bins[UNIFORM_BINS];	/**< p-values, spread over [p_strict, p] */
+}Stat_shard;
+
+typedef struct {
+	std::string name;
+	std::string statistic;
+	double value;
+	double p_value;			/**< NAN for the proportion of the spectral windows */
+	const char* result;		/**< PASS, FAIL or SKIP */
+}Stat_result;
+
+/**
+* Blocks queue between the reader and the workers, the buffers go
+* round from the free list to the full list
+*/
+typedef struct {
+	std::mutex lock;
+	std::condition_variable cond;
+	std::vector<Stat_block*> free;
+	std::vector<Stat_block*> full;
+	bool done;
+}Stat_queue;
+
+typedef void (*Count_fn)(const u64* words, size_t count, u64* ones, u64* changes);
+
+/*==========================================================================*/
+/* Kernels                                                                  */
+/*==========================================================================*/
+
+/**
+* Ones and bit changes of 'count' words, words[count] holding the bits
+* after them. The bit changes are the ones of x ^ (x shifted by one
+* bit, the first bit of the next word coming in).
+*/
+static inline __attribute__((always_inline))
+void count_words(const u64* words, size_t count, u64* ones, u64* changes)
+{
+	u64 o = 0, c = 0;
+	for (size_t i = 0; i < count; i++) {
+		u64 x = words[i];
+		o += __builtin_popcountll(x);
+		c += __builtin_popcountll(x ^ ((x << 1) | (words[i + 1] >> 63)));
+	}
+	*ones += o;
+	*changes += c;
+}
+
+static void count_scalar(const u64* words, size_t count, u64* ones, u64* changes)
+{
+	count_words(words, count, ones, changes);
+}
+
+#ifdef STAT_X86_KERNELS
+
+__attribute__((target("popcnt")))
+static void count_popcnt(const u64* words, size_t count, u64* ones, u64* changes)
+{
+	count_words(words, count, ones, changes);
+}
+
+/** Bytes popcount with one shuffle per nibble, added up per 64 bits lane */
+__attribute__((target("avx2")))
+static inline __m256i popcount_avx2(__m256i v)
+{
+	const __m256i lut = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+										0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+	const __m256i mask = _mm256_set1_epi8(0x0f);
+	__m256i lo = _mm256_shuffle_epi8(lut, _mm256_and_si256(v, mask));
+	__m256i hi = _mm256_shuffle_epi8(lut, _mm256_and_si256(_mm256_srli_epi16(v, 4), mask));
+	return _mm256_sad_epu8(_mm256_add_epi8(lo, hi), _mm256_setzero_si256());
+}
+
+__attribute__((target("avx2,popcnt")))
+static void count_avx2(const u64* words, size_t count, u64* ones, u64* changes)
+{
+	__m256i o = _mm256_setzero_si256(), c = _mm256_setzero_si256();
+	size_t i = 0;
+
+	for (; i + 4 <= count; i += 4) {
+		__m256i x = _mm256_loadu_si256((const __m256i*)(words + i));
+		__m256i next = _mm256_loadu_si256((const __m256i*)(words + i + 1));
+		__m256i shifted = _mm256_or_si256(_mm256_slli_epi64(x, 1), _mm256_srli_epi64(next, 63));
+		o = _mm256_add_epi64(o, popcount_avx2(x));
+		c = _mm256_add_epi64(c, popcount_avx2(_mm256_xor_si256(x, shifted)));
+	}
+
+	u64 lanes[4];
+	_mm256_storeu_si256((__m256i*)lanes, o);
+	*ones += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+	_mm256_storeu_si256((__m256i*)lanes, c);
+	*changes += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+	count_words(words + i, count - i, ones, changes);
+}
+
+#endif
+
+static Count_fn select_count()
+{
+#ifdef STAT_X86_KERNELS
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt")) return count_avx2;
+	if (__builtin_cpu_supports("popcnt")) return count_popcnt;
+#endif
+	return count_scalar;
+}
+
+/** Step between the windows, for a histogram of at most 2^17 counters */
+static int window_step(int m)
+{
+	return (m <= 10) ? 8 : (m <= 14) ? 4 : 2;
+}
+
+/**
+* The m + S - 1 bits windows starting every S bits of 'count' words.
+* The 128 bits of a word and the next one are shifted so that the
+* last window ends at bit 0, the shifts of the others being constants.
+*/
+template <int S>
+static void count_windows(const u64* words, size_t count, int m, u32* hist)
+{
+	u64 mask = ((u64)1 << (m + S - 1)) - 1;
+
+	for (size_t i = 0; i < count; i++) {
+		unsigned __int128 c = ((unsigned __int128)words[i] << 64 | words[i + 1]) >> (65 - m);
+#pragma GCC unroll 32
+		for (int j = 64 - S; j >= 0; j -= S) hist[(u64)(c >> j) & mask]++;
+	}
+}
+
+/**
+* Overlapping 'm' bits patterns starting at each bit of 'count' words,
+* added to 'patterns' from the histogram of their windows, which is
+* cleared
+*/
+static void count_patterns(const u64* words, size_t count, int m, u32* hist, u64* patterns)
+{
+	int step = window_step(m);
+	if (step == 8) count_windows<8>(words, count, m, hist);
+	else if (step == 4) count_windows<4>(words, count, m, hist);
+	else count_windows<2>(words, count, m, hist);
+
+	u64 mask = ((u64)1 << m) - 1;
+	for (size_t v = 0; v < ((size_t)1 << (m + step - 1)); v++) {
+		if (!hist[v]) continue;
+		for (int t = 0; t < step; t++) patterns[(v >> (step - 1 - t)) & mask] += hist[v];
+		hist[v] = 0;
+	}
+}
+
+/*==========================================================================*/
+/* Special functions                                                        */
+/*==========================================================================*/
+
+/**
+* Regularized upper incomplete gamma function Q(a, x), the series of
+* P(a, x) below a + 1, Lentz continued fraction of Q(a, x) above
+*/
+static double igamc(double a, double x)
+{
+	if (x <= 0) return 1.0;
+	if (a <= 0) return 0.0;
+
+	double log_prefix = a * std::log(x) - x - std::lgamma(a);
+	const double eps = 1e-15;
+
+	if (x < a + 1) {
+		double term = 1.0 / a, sum = term;
+		for (int n = 1; n < 100000; n++) {
+			term *= x / (a + n);
+			sum += term;
+			if (term < sum * eps) break;
+		}
+		return std::max(0.0, 1.0 - sum * std::exp(log_prefix));
+	}
+
+	const double tiny = 1e-300;
+	double b = x + 1 - a, c = 1 / tiny, d = 1 / b, h = d;
+	for (int n = 1; n < 100000; n++) {
+		double an = -n * (n - a);
+		b += 2;
+		d = an * d + b;
+		if (std::fabs(d) < tiny) d = tiny;
+		c = b + an / c;
+		if (std::fabs(c) < tiny) c = tiny;
+		d = 1 / d;
+		double delta = d * c;
+		h *= delta;
+		if (std::fabs(delta - 1) < eps) break;
+	}
+	return std::exp(log_prefix) * h;
+}
+
+/*==========================================================================*/
+/* Tests                                                                    */
+/*==========================================================================*/
+
+/** SP 800-22 2.1, n bits with 'ones' ones */
+static double frequency_p(u64 n, u64 ones, double* s_obs)
+{
+	double s = std::fabs(2.0 * (double)ones - (double)n) / std::sqrt((double)n);
+	*s_obs = s;
+	return std::erfc(s / std::sqrt(2.0));
+}
+
+/** SP 800-22 2.3, 'runs' being V_n(obs), 0 when the frequency prerequisite fails */
+static double runs_p(u64 n, u64 ones, u64 runs)
+{
+	long double pi = (long double)ones / n;
+	if (std::fabs(pi - 0.5L) >= 2 / std::sqrt((long double)n)) return 0.0;
+
+	long double v = 2 * (long double)n * pi * (1 - pi);
+	long double z = std::fabs((long double)runs - v) / (2 * std::sqrt(2 * (long double)n) * pi * (1 - pi));
+	return std::erfc((double)z);
+}
+
+/** Counts of the m - 1 bits patterns from the m bits ones, the bit dropped being the last */
+static std::vector<u64> fold_patterns(const std::vector<u64>& nu)
+{
+	std::vector<u64> out(nu.size() / 2);
+	for (size_t i = 0; i < out.size(); i++) out[i] = nu[2 * i] + nu[2 * i + 1];
+	return out;
+}
+
+/**
+* psi^2 of SP 800-22 2.11 from the deviations of the counts, the sum of
+* the squared counts being close to n^2 / 2^m
+*/
+static long double psi2(const std::vector<u64>& nu, u64 n)
+{
+	if (nu.size() <= 1) return 0;
+
+	long double expected = (long double)n / nu.size(), sum = 0;
+	for (u64 v : nu) sum += ((long double)v - expected) * ((long double)v - expected);
+	return sum * nu.size() / n;
+}
+
+/** SP 800-22 2.11, 'nu' the cyclic counts of the m bits patterns */
+static void serial_p(const std::vector<u64>& nu, int m, u64 n, double* del1, double* del2,
+					double* p1, double* p2)
+{
+	std::vector<u64> nu1 = fold_patterns(nu);
+	std::vector<u64> nu2 = fold_patterns(nu1);
+	long double s0 = psi2(nu, n), s1 = psi2(nu1, n), s2 = psi2(nu2, n);
+
+	*del1 = (double)(s0 - s1);
+	*del2 = (double)(s0 - 2 * s1 + s2);
+	*p1 = igamc(std::ldexp(1.0, m - 2), *del1 / 2);
+	*p2 = igamc(std::ldexp(1.0, m - 3), *del2 / 2);
+}
+
+/**
+* SP 800-22 2.12 with m bits, 'nu' the cyclic counts of the m + 1 bits
+* patterns. chi^2 = 2n (ln 2 - ApEn) is summed directly as
+* 2 sum(C_j ln(2 C_j / C_i)), C_i the count of the first m bits of the
+* pattern j, and log1p() keeps the terms precise for counts near n/2^m.
+*/
+static double apen_p(const std::vector<u64>& nu, int m, u64 n, double* apen, double* chi2)
+{
+	std::vector<u64> prefix = fold_patterns(nu);
+	long double sum = 0;
+
+	for (size_t j = 0; j < nu.size(); j++) {
+		if (!nu[j]) continue;
+		long double ci = (long double)prefix[j >> 1];
+		sum += nu[j] * std::log1p((2 * (long double)nu[j] - ci) / ci);
+	}
+	*chi2 = (double)(2 * sum);
+	*apen = (double)(std::log(2.0L) - sum / n);
+	return igamc(std::ldexp(1.0, m - 1), *chi2 / 2);
+}
+
+/*==========================================================================*/
+/* Spectral test                                                            */
+/*==========================================================================*/
+
+/**
+* DFT of the windows: a window of w bits is taken as w/2 complex
+* values, transformed with a radix-2 FFT of w/2 points and split into
+* the w/2 first terms of the real sequence's DFT. The real and the
+* imaginary parts are in two arrays, so that the butterflies of a
+* stage are vectorized.
+*/
+typedef struct {
+	size_t bits;
+	std::vector<double> twiddle_re;		/**< exp(-2 pi i k / w), k < w/2 */
+	std::vector<double> twiddle_im;
+	std::vector<double> stage_re;		/**< exp(-2 pi i k / len) at len/2 + k, k < len/2 */
+	std::vector<double> stage_im;
+	std::vector<u32> reverse;			/**< bit reversal permutation of w/2 points */
+}Stat_fft;
+
+typedef u64 (*Spectral_fn)(const Stat_fft* fft, double* re, double* im);
+
+static void fft_init(Stat_fft* fft, size_t bits)
+{
+	size_t half = bits / 2;
+	int log2_half = 0;
+	while (((size_t)1 << log2_half) < half) log2_half++;
+
+	fft->bits = bits;
+	fft->twiddle_re.resize(half);
+	fft->twiddle_im.resize(half);
+	for (size_t k = 0; k < half; k++) {
+		fft->twiddle_re[k] = std::cos(2 * M_PI * k / bits);
+		fft->twiddle_im[k] = -std::sin(2 * M_PI * k / bits);
+	}
+	fft->stage_re.resize(half);
+	fft->stage_im.resize(half);
+	for (size_t len = 2; len <= half; len <<= 1) {
+		for (size_t k = 0; k < len / 2; k++) {
+			fft->stage_re[len / 2 + k] = std::cos(2 * M_PI * k / len);
+			fft->stage_im[len / 2 + k] = -std::sin(2 * M_PI * k / len);
+		}
+	}
+
+	fft->reverse.resize(half);
+	for (size_t k = 0; k < half; k++) {
+		u32 r = 0;
+		for (int b = 0; b < log2_half; b++) if (k >> b & 1) r |= 1u << (log2_half - 1 - b);
+		fft->reverse[k] = r;
+	}
+}
+
+/**
+* FFT of the w/2 values in bit reversed order, and count of the DFT
+* terms of the real sequence with |X[k]| below the 95 % threshold T
+*/
+static inline __attribute__((always_inline))
+u64 spectral_count(const Stat_fft* fft, double* __restrict re, double* __restrict im)
+{
+	size_t half = fft->bits / 2;
+
+	for (size_t len = 2; len <= half; len <<= 1) {
+		const double* __restrict wr = fft->stage_re.data() + len / 2;
+		const double* __restrict wi = fft->stage_im.data() + len / 2;
+		for (size_t start = 0; start < half; start += len) {
+			double* __restrict ar = re + start;
+			double* __restrict ai = im + start;
+			double* __restrict br = re + start + len / 2;
+			double* __restrict bi = im + start + len / 2;
+			for (size_t k = 0; k < len / 2; k++) {
+				double tr = wr[k] * br[k] - wi[k] * bi[k];
+				double ti = wr[k] * bi[k] + wi[k] * br[k];
+				br[k] = ar[k] - tr;
+				bi[k] = ai[k] - ti;
+				ar[k] += tr;
+				ai[k] += ti;
+			}
+		}
+	}
+
+	/** X[k] = E + w^k O, E = (z[k] + conj(z[w/2 - k])) / 2, O = (z[k] - conj(z[w/2 - k])) / 2i */
+	double threshold2 = std::log(1 / 0.05) * fft->bits;
+	double x0 = re[0] + im[0];
+	u64 below = (x0 * x0 < threshold2);
+	for (size_t k = 1; k < half; k++) {
+		double er = (re[k] + re[half - k]) * 0.5, ei = (im[k] - im[half - k]) * 0.5;
+		double or_ = (im[k] + im[half - k]) * 0.5, oi = (re[half - k] - re[k]) * 0.5;
+		double xr = er + fft->twiddle_re[k] * or_ - fft->twiddle_im[k] * oi;
+		double xi = ei + fft->twiddle_re[k] * oi + fft->twiddle_im[k] * or_;
+		below += (xr * xr + xi * xi < threshold2);
+	}
+	return below;
+}
+
+static u64 spectral_scalar(const Stat_fft* fft, double* re, double* im)
+{
+	return spectral_count(fft, re, im);
+}
+
+#ifdef STAT_X86_KERNELS
+
+/** Without FMA, the counts are the same as the scalar ones */
+__attribute__((target("avx2")))
+static u64 spectral_avx2(const Stat_fft* fft, double* re, double* im)
+{
+	return spectral_count(fft, re, im);
+}
+
+#endif
+
+static Spectral_fn select_spectral()
+{
+#ifdef STAT_X86_KERNELS
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) return spectral_avx2;
+#endif
+	return spectral_scalar;
+}
+
+static double normal_cdf(double z)
+{
+	return 0.5 * std::erfc(-z / std::sqrt(2.0));
+}
+
+/**
+* SP 800-22 2.6 on w bits from 'words', 'z' holding w values
+*
+* The count N1 of terms below T is an integer of standard deviation
+* about sqrt(w) / 9, so the p-values of the windows fall on a grid too
+* coarse for the uniformity test: 'p' is the probability of a count at
+* least as far from the mean as N1, with the continuity correction,
+* and 'p_strict' the one of a count further away. The windows add
+* [p_strict, p] to the uniformity bins, where the randomized p-value
+* would be uniform.
+*/
+static void spectral_window(const Stat_fft* fft, const u64* words, double* z, double* p, double* p_strict)
+{
+	static const Spectral_fn count = select_spectral();
+	size_t half = fft->bits / 2;
+	double* re = z;
+	double* im = z + half;
+
+	/**
+	* X = 2 bit - 1, z[k] = X[2k] + i X[2k + 1], in bit reversed order:
+	* the bits are gathered from the words, which stay in L1
+	*/
+	for (size_t j = 0; j < half; j++) {
+		u32 k = fft->reverse[j];
+		int bit = 63 - 2 * (int)(k & 31);
+		u64 w = words[k >> 5] >> (bit - 1);
+		re[j] = (double)(2 * (int)(w >> 1 & 1) - 1);
+		im[j] = (double)(2 * (int)(w & 1) - 1);
+	}
+
+	/**
+	* The variance of SP 800-22, n 0.95 0.05 / 4, is below the one of the
+	* counts by 5 %, which fails the uniformity of the p-values of a few
+	* thousands windows: n 0.95 0.05 / 3.8 (Kim, Umeno and Hasegawa 2004)
+	*/
+	double mean = 0.95 * fft->bits / 2;
+	double sigma = std::sqrt(fft->bits * 0.95 * 0.05 / 3.8);
+
+	/** the mean being 19 w / 40, a count and its mirror are never equal */
+	double n1 = (double)count(fft, re, im);
+	double lo = (n1 < mean) ? n1 : std::floor(2 * mean - n1);
+	double hi = (n1 < mean) ? std::ceil(2 * mean - n1) : n1;
+	*p = std::min(1.0, normal_cdf((lo + 0.5 - mean) / sigma) + normal_cdf((mean - hi + 0.5) / sigma));
+	if (n1 < mean) lo -= 1;
+	else hi += 1;
+	*p_strict = std::min(*p, normal_cdf((lo + 0.5 - mean) / sigma) + normal_cdf((mean - hi + 0.5) / sigma));
+}
+
+/** Weight 1 spread evenly over [lo, hi] of the p-values */
+static void add_uniform(double lo, double hi, double* bins)
+{
+	if (hi <= lo) {
+		bins[std::min((int)(hi * UNIFORM_BINS), UNIFORM_BINS - 1)] += 1;
+		return;
+	}
+	int last = std::min((int)(hi * UNIFORM_BINS), UNIFORM_BINS - 1);
+	for (int i = (int)(lo * UNIFORM_BINS); i <= last; i++) {
+		double overlap = std::min(hi, (i + 1.0) / UNIFORM_BINS) - std::max(lo, (double)i / UNIFORM_BINS);
+		if (overlap > 0) bins[i] += overlap / (hi - lo);
+	}
+}
+
+/*==========================================================================*/
+/* Pipeline                                                                 */
+/*==========================================================================*/
+
+typedef struct {
+	QRNG* qrng;
+	FILE* file;
+}Stat_source;
+
+/** Bytes read, fewer at the end of a file, 0 and the status on errors */
+static size_t source_read(Stat_source* src, u8* data, size_t size, int* status)
+{
+	if (src->file) return fread(data, 1, size, src->file);
+
+	size_t n = 0;
+	*status = qrng_get64(src->qrng, data, size, &n);
+	return (*status == QRNG_SUCCESS) ? n : 0;
+}
+
+static Stat_block* queue_take(Stat_queue* q, std::vector<Stat_block*>* list)
+{
+	std::unique_lock<std::mutex> lock(q->lock);
+	q->cond.wait(lock, [&] { return !list->empty() || (list == &q->full && q->done); });
+	if (list->empty()) return nullptr;
+	Stat_block* b = list->back();
+	list->pop_back();
+	return b;
+}
+
+static void queue_put(Stat_queue* q, std::vector<Stat_block*>* list, Stat_block* b)
+{
+	{
+		std::lock_guard<std::mutex> lock(q->lock);
+		list->push_back(b);
+	}
+	q->cond.notify_all();
+}
+
+static void test_block(const Stat_config& cfg, const Stat_fft& fft, Stat_block* b,
+					Stat_shard* shard, std::vector<u32>& hist, std::vector<double>& z)
+{
+	static const Count_fn count = select_count();
+	u64* words = b->words.data();
+
+	for (size_t i = 0; i <= b->count; i++) words[i] = __builtin_bswap64(words[i]);
+
+	count(words, b->count, &shard->ones, &shard->changes);
+
+	count_patterns(words, b->count, cfg.pattern_bits, hist.data(), shard->patterns.data());
+
+	/** the windows are aligned on the blocks */
+	size_t window_words = cfg.window_bits / 64;
+	for (size_t i = 0; i + window_words <= b->count; i += window_words) {
+		u64 window = (b->first_bit + i * 64) / cfg.window_bits;
+		if (window % cfg.window_stride) continue;
+
+		double p, p_strict;
+		spectral_window(&fft, words + i, z.data(), &p, &p_strict);
+		shard->windows++;
+		shard->windows_passed += (p >= STAT_ALPHA);
+		add_uniform(p_strict, p, shard->window_bins);
+	}
+}
+
+/**
+* Read the sequence and test it on cfg.threads workers
+*
+* @return	the bits tested, 0 on errors
+*/
+static u64 run_tests(const Stat_config& cfg, Stat_source* src, Stat_shard* total, int* status)
+{
+	Stat_fft fft;
+	fft_init(&fft, cfg.window_bits);
+
+	Stat_queue q;
+	q.done = false;
+	std::vector<Stat_block> blocks(2 * cfg.threads + 2);
+	for (Stat_block& b : blocks) {
+		b.words.resize(BLOCK_WORDS + 1);
+		q.free.push_back(&b);
+	}
+
+	std::vector<Stat_shard> shards(cfg.threads);
+	std::vector<std::thread> workers;
+	for (Stat_shard& shard : shards) {
+		shard = Stat_shard();
+		shard.patterns.assign((size_t)1 << cfg.pattern_bits, 0);
+		workers.emplace_back([&cfg, &fft, &q, &shard] {
+			int bits = cfg.pattern_bits + window_step(cfg.pattern_bits) - 1;
+			std::vector<u32> hist((size_t)1 << bits, 0);
+			std::vector<double> z(cfg.window_bits);
+			while (Stat_block* b = queue_take(&q, &q.full)) {
+				test_block(cfg, fft, b, &shard, hist, z);
+				queue_put(&q, &q.free, b);
+			}
+		});
+	}
+
+	/** a block is queued once the first word of the next one is read */
+	size_t words = 0;
+	u64 first_word = 0, last_word = 0;
+	size_t total_words = cfg.size / 8;
+	Stat_block* prev = nullptr;
+	*status = QRNG_SUCCESS;
+
+	while (words < total_words) {
+		Stat_block* b = queue_take(&q, &q.free);
+		size_t want = std::min((size_t)BLOCK_WORDS, total_words - words);
+		size_t n = source_read(src, (u8*)b->words.data(), want * 8, status) / 8;
+		if (!n) {
+			queue_put(&q, &q.free, b);
+			break;
+		}
+
+		b->count = n;
+		b->first_bit = words * 64;
+		if (prev) {
+			prev->words[prev->count] = b->words[0];
+			queue_put(&q, &q.full, prev);
+		}
+		else {
+			first_word = b->words[0];
+		}
+		prev = b;
+		words += n;
+		if (n < want) break;
+	}
+
+	if (prev) {
+		last_word = prev->words[prev->count - 1];
+		prev->words[prev->count] = first_word;
+		queue_put(&q, &q.full, prev);
+	}
+	{
+		std::lock_guard<std::mutex> lock(q.lock);
+		q.done = true;
+	}
+	q.cond.notify_all();
+	for (std::thread& t : workers) t.join();
+
+	if (*status != QRNG_SUCCESS || !words) return 0;
+
+	*total = Stat_shard();
+	total->patterns.assign((size_t)1 << cfg.pattern_bits, 0);
+	for (const Stat_shard& s : shards) {
+		total->ones += s.ones;
+		total->changes += s.changes;
+		for (size_t i = 0; i < s.patterns.size(); i++) total->patterns[i] += s.patterns[i];
+		total->windows += s.windows;
+		total->windows_passed += s.windows_passed;
+		for (int i = 0; i < UNIFORM_BINS; i++) total->window_bins[i] += s.window_bins[i];
+	}
+
+	/** the runs test doesn't wrap around */
+	u64 first_bit = __builtin_bswap64(first_word) >> 63;
+	u64 last_bit = __builtin_bswap64(last_word) & 1;
+	total->changes -= (first_bit != last_bit);
+	return words * 64;
+}
+
+/*==========================================================================*/
+/* Report                                                                   */
+/*==========================================================================*/
+
+static Stat_result make_result(const std::string& name, const std::string& statistic,
+							double value, double p, double alpha)
+{
+	return { name, statistic, value, p, (p >= alpha) ? "PASS" : "FAIL" };
+}
+
+static std::vector<Stat_result> evaluate(const Stat_config& cfg, const Stat_shard& t, u64 n)
+{
+	std::vector<Stat_result> out;
+	int m = cfg.pattern_bits;
+	double s_obs, del1, del2, p1, p2, apen, chi2;
+
+	double p = frequency_p(n, t.ones, &s_obs);
+	out.push_back(make_result("frequency", "s_obs", s_obs, p, STAT_ALPHA));
+
+	u64 runs = t.changes + 1;
+	out.push_back(make_result("runs", "V_obs", (double)runs, runs_p(n, t.ones, runs), STAT_ALPHA));
+
+	serial_p(t.patterns, m, n, &del1, &del2, &p1, &p2);
+	out.push_back(make_result("serial m=" + std::to_string(m) + " p1", "del_psi2", del1, p1, STAT_ALPHA));
+	out.push_back(make_result("serial m=" + std::to_string(m) + " p2", "del2_psi2", del2, p2, STAT_ALPHA));
+
+	p = apen_p(t.patterns, m - 1, n, &apen, &chi2);
+	out.push_back(make_result("approximate entropy m=" + std::to_string(m - 1), "chi2", chi2, p, STAT_ALPHA));
+
+	/** SP 800-22 4.2.1, proportion of passing windows within 3 sigmas */
+	std::string spectral = "spectral w=" + std::to_string(cfg.window_bits) + " x" + std::to_string(t.windows);
+	double k = (double)t.windows;
+	if (t.windows) {
+		double expected = 1 - STAT_ALPHA;
+		double margin = 3 * std::sqrt(expected * STAT_ALPHA / k);
+		double proportion = t.windows_passed / k;
+		bool ok = (proportion >= expected - margin && proportion <= expected + margin);
+		out.push_back({ spectral + " proportion", "passed", proportion, NAN, ok ? "PASS" : "FAIL" });
+	}
+	else {
+		out.push_back({ spectral + " proportion", "passed", 0, NAN, "SKIP" });
+	}
+
+	/** SP 800-22 4.2.2, chi^2 of the p-values over 10 bins */
+	chi2 = 0;
+	for (int i = 0; i < UNIFORM_BINS; i++) {
+		double d = t.window_bins[i] - k / UNIFORM_BINS;
+		chi2 += d * d / (k / UNIFORM_BINS);
+	}
+	if (t.windows >= MIN_UNIFORM_WINDOWS)
+		out.push_back(make_result(spectral + " uniformity", "chi2", chi2,
+								igamc((UNIFORM_BINS - 1) / 2.0, chi2 / 2), STAT_ALPHA_UNIFORM));
+	else
+		out.push_back({ spectral + " uniformity", "chi2", t.windows ? chi2 : 0, NAN, "SKIP" });
+	return out;
+}
+
+static std::string json_number(double v)
+{
+	if (!std::isfinite(v)) return "null";
+	std::ostringstream os;
+	os.precision(10);
+	os << v;
+	return os.str();
+}
+
+static std::string report_json(const Stat_config& cfg, u64 n, double seconds,
+							const std::vector<Stat_result>& results)
+{
+	std::ostringstream os;
+	os << "{\n\"source\": \"" << (cfg.file.empty() ? cfg.device : cfg.file)
+		<< "\",\n\"bits\": " << n << ",\n\"threads\": " << cfg.threads
+		<< ",\n\"seconds\": " << json_number(seconds)
+		<< ",\n\"throughput_mbps\": " << json_number(n / 8 / seconds / 1e6)
+		<< ",\n\"alpha\": " << STAT_ALPHA << ",\n\"results\": [\n";
+	for (size_t i = 0; i < results.size(); i++) {
+		const Stat_result& r = results[i];
+		os << "  {\"test\": \"" << r.name << "\", \"statistic\": \"" << r.statistic
+			<< "\", \"value\": " << json_number(r.value) << ", \"p_value\": " << json_number(r.p_value)
+			<< ", \"result\": \"" << r.result << "\"}" << (i + 1 < results.size() ? ",\n" : "\n");
+	}
+	os << "]\n}\n";
+	return os.str();
+}
+
+/** Size with an optional K, M or G suffix */
+static size_t parse_size(const std::string& s)
+{
+	char* end = nullptr;
+	size_t v = strtoull(s.c_str(), &end, 10);
+	if (*end == 'K' || *end == 'k') v <<= 10;
+	else if (*end == 'M' || *end == 'm') v <<= 20;
+	else if (*end == 'G' || *end == 'g') v <<= 30;
+	return v;
+}
+
+void print_help_info(){
+	std::cout << "----------------------------------------------------------------------\n";
+	std::cout << "How to run the program: \n";
+	std::cout << "\t ./stattest [-d device | -f file] [-s size] [-t threads] [-m bits]\n";
+	std::cout << "\t            [-w bits] [-k stride] [-o file]\n\n";
+	std::cout << "e.g.\t ./stattest -d prng:seed=1 -s 4G\n";
+	std::cout << "\t\t Tests 4 GB of the prng backend, without the device\n";
+	std::cout << "\t ./stattest -f capture.bin\n";
+	std::cout << "\t\t Tests a recorded file, e.g. a qrng_raw file of filedump\n";
+	std::cout << "\n NB:";
+	std::cout << "\t -d: device name, any name of qrng_ext_init_param (default /dev/xdma0)\n";
+	std::cout << "\t -f: file to test instead of the device\n";
+	std::cout << "\t -s: bytes to test, K, M and G suffixes (default 1G, the whole file\n";
+	std::cout << "\t     with -f)\n";
+	std::cout << "\t -t: worker threads (default the CPU count)\n";
+	std::cout << "\t -m: pattern bits of the serial test, 3 to 16, the approximate\n";
+	std::cout << "\t     entropy test using one bit less (default 12)\n";
+	std::cout << "\t -w: bits of the spectral test windows, a power of two from 4K to\n";
+	std::cout << "\t     32M (default 64K)\n";
+	std::cout << "\t -k: spectral test on one window in k (default 64)\n";
+	std::cout << "\t -o: JSON output file, the table goes to stdout\n";
+	std::cout << "----------------------------------------------------------------------\n\n";
+}
+
+int main(int argc, char **argv)
+{
+	Stat_config cfg;
+	cfg.device = "/dev/xdma0";
+	cfg.size = 0;
+	cfg.threads = std::max((int)std::thread::hardware_concurrency(), 1);
+	cfg.pattern_bits = 12;
+	cfg.window_bits = KB(64);
+	cfg.window_stride = 64;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "d:f:s:t:m:w:k:o:h")) != -1) {
+		switch (opt) {
+		case 'd': cfg.device = optarg; break;
+		case 'f': cfg.file = optarg; break;
+		case 's': cfg.size = parse_size(optarg); break;
+		case 't': cfg.threads = std::max(atoi(optarg), 1); break;
+		case 'm': cfg.pattern_bits = atoi(optarg); break;
+		case 'w': cfg.window_bits = parse_size(optarg); break;
+		case 'k': cfg.window_stride = std::max(strtoull(optarg, nullptr, 10), 1ULL); break;
+		case 'o': cfg.output = optarg; break;
+		default:
+			print_help_info();
+			return (opt == 'h') ? 0 : -1;
+		}
+	}
+
+	if (cfg.pattern_bits < MIN_PATTERN_BITS || cfg.pattern_bits > MAX_PATTERN_BITS) {
+		std::cerr << "Error: the pattern bits must be between " << MIN_PATTERN_BITS
+				<< " and " << MAX_PATTERN_BITS << "\n";
+		return -1;
+	}
+	if (cfg.window_bits < KB(4) || cfg.window_bits > MAX_WINDOW_BITS
+		|| (cfg.window_bits & (cfg.window_bits - 1))) {
+		std::cerr << "Error: the window bits must be a power of two from 4K to 32M\n";
+		return -1;
+	}
+
+	Stat_source src = { nullptr, nullptr };
+	if (!cfg.file.empty()) {
+		src.file = fopen(cfg.file.c_str(), "rb");
+		if (!src.file) {
+			std::cerr << "Error: can't open " << cfg.file << "\n";
+			return -1;
+		}
+		if (!cfg.size) cfg.size = (size_t)-1;
+	}
+	else {
+		src.qrng = qrng_ext_init_param({ QRNG_VERTEX_B1, cfg.device.c_str() }, Qrng_ext_param());
+		if (!src.qrng || qrng_get_status(src.qrng) != QRNG_SUCCESS) {
+			std::cerr << "Error [" << (src.qrng ? qrng_get_status(src.qrng) : QRNG_ERROR_OPENING_DEVICE)
+					<< "]: can't open the device " << cfg.device << "\n";
+			if (src.qrng) qrng_deinit(src.qrng);
+			return -1;
+		}
+		if (!cfg.size) cfg.size = GB(1);
+	}
+
+	Stat_shard total;
+	int status = QRNG_SUCCESS;
+	Clock::time_point start = Clock::now();
+	u64 n = run_tests(cfg, &src, &total, &status);
+	double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+	if (src.file) fclose(src.file);
+	if (src.qrng) qrng_deinit(src.qrng);
+
+	if (!n) {
+		if (status != QRNG_SUCCESS) std::cerr << "Error [" << status << "]: can't read the device\n";
+		else std::cerr << "Error: no data to test\n";
+		return -1;
+	}
+	if (n < ((u64)64 << cfg.pattern_bits)) {
+		std::cerr << "Error: " << n << " bits are too few for " << cfg.pattern_bits << " bits patterns\n";
+		return -1;
+	}
+
+	std::vector<Stat_result> results = evaluate(cfg, total, n);
+	bool failed = false;
+
+	printf("%llu bits in %.2f s, %.1f MB/s on %d threads\n\n", (unsigned long long)n, seconds,
+			n / 8 / seconds / 1e6, cfg.threads);
+	printf("%-36s %-10s %14s %10s  %s\n", "test", "statistic", "value", "p-value", "result");
+	for (const Stat_result& r : results) {
+		char p[32] = "-";
+		if (std::isfinite(r.p_value)) snprintf(p, sizeof(p), "%.6f", r.p_value);
+		printf("%-36s %-10s %14.6g %10s  %s\n", r.name.c_str(), r.statistic.c_str(), r.value, p, r.result);
+		failed |= !strcmp(r.result, "FAIL");
+	}
+
+	if (!cfg.output.empty()) {
+		FILE* f = fopen(cfg.output.c_str(), "w");
+		if (!f) {
+			std::cerr << "Error: can't write " << cfg.output << "\n";
+			return -1;
+		}
+		fputs(report_json(cfg, n, seconds, results).c_str(), f);
+		fclose(f);
+	}
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,226 @@
+/**
+* @file 	qrng.hpp
+* @brief 	QD QRNG C++17 interface: RAII handle and random bit engines
+*
+* @note		Header only, on top of the extension library (link with
+* 			"-lqrng_ext -lqrng_vertex"). Errors are reported with
+* 			qrng::error exceptions carrying the QRNG_status.
+*
+* 			qrng::device owns a handle created by qrng_ext_init_param()
+* 			and releases it with qrng_deinit(). The engines meet the
+* 			UniformRandomBitGenerator requirements and can be passed to
+* 			the <random> distributions, std::shuffle()...:
+*
+* 				qrng::device dev("/dev/xdma0");
+* 				qrng::engine eng(dev);
+* 				std::normal_distribution<double> normal(0.0, 1.0);
+* 				double x = normal(eng);
+*
+* 			An engine serves its values from a block read with one
+* 			qrng_get64() call, so a call costs a few nanoseconds. The
+* 			device may be shared by threads, an engine may not.
+*
+* @date		17/10/2026
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#include "qrng_ext.h"
+
+namespace qrng {
+
+	/** Failure of a QRNG function, status() returns its QRNG_status */
+	class error : public std::runtime_error {
+	public:
+		error(const char* function, int status)
+			: std::runtime_error(std::string(function) + " failed, QRNG status " + std::to_string(status)),
+			status_(status) {}
+
+		int status() const noexcept { return status_; }
+
+	private:
+		int status_;
+	};
+
+	/**
+	* Fill a buffer of any size with random bytes
+	*
+	* @throw	qrng::error on a failed or incomplete read
+	*/
+	inline void read(QRNG* qrng, void* data, size_t size)
+	{
+		size_t n = 0;
+		int ret = qrng_get64(qrng, static_cast<u8*>(data), size, &n);
+		if (ret == QRNG_SUCCESS && n != size) ret = QRNG_ERROR_INCOMPLETE_DATA;
+		if (ret != QRNG_SUCCESS) throw error("qrng_get64", ret);
+	}
+
+	/** Owner of a QRNG handle, movable but not copyable */
+	class device {
+	public:
+		/**
+		* Open a device, or a backend of qrng_ext_init_param() (e.g.
+		* "prng:seed=1", "tcp:host:port")
+		*
+		* @throw	qrng::error if the handle can't be created
+		*/
+		explicit device(const char* dev_name = "/dev/xdma0",
+						Qrng_board_type board = QRNG_VERTEX_B1,
+						const Qrng_ext_param& ext_param = Qrng_ext_param())
+			: device(Qrng_init_param{ board, dev_name }, ext_param) {}
+
+		device(const Qrng_init_param& init_param, const Qrng_ext_param& ext_param)
+			: qrng_(qrng_ext_init_param(init_param, ext_param))
+		{
+			int status = qrng_ ? qrng_get_status(qrng_) : QRNG_ERROR_OPENING_DEVICE;
+			if (status != QRNG_SUCCESS) {
+				if (qrng_) qrng_deinit(qrng_);
+				throw error("qrng_ext_init_param", status);
+			}
+		}
+
+		/** Take ownership of a handle of qrng_init_param() or qrng_ext_init_param() */
+		explicit device(QRNG* qrng) noexcept : qrng_(qrng) {}
+
+		device(device&& other) noexcept : qrng_(std::exchange(other.qrng_, nullptr)) {}
+
+		device& operator=(device&& other) noexcept
+		{
+			if (this != &other) {
+				reset();
+				qrng_ = std::exchange(other.qrng_, nullptr);
+			}
+			return *this;
+		}
+
+		device(const device&) = delete;
+		device& operator=(const device&) = delete;
+
+		~device() { reset(); }
+
+		QRNG* get() const noexcept { return qrng_; }
+
+		/** Give up the ownership, the caller calls qrng_deinit() */
+		QRNG* release() noexcept { return std::exchange(qrng_, nullptr); }
+
+		void reset() noexcept
+		{
+			if (qrng_) qrng_deinit(qrng_);
+			qrng_ = nullptr;
+		}
+
+		/** @see qrng::read() */
+		void read(void* data, size_t size) { qrng::read(qrng_, data, size); }
+
+	private:
+		QRNG* qrng_;
+	};
+
+	/**
+	* UniformRandomBitGenerator over a QRNG handle, returning every
+	* value of 'UIntType' with the same probability
+	*
+	* The values come from a buffer of 'BlockBytes' bytes, refilled
+	* with one read when it runs out. They are the random bytes in host
+	* order, so the block is read straight into an array of results
+	* whatever their width. A copy would return the same values as the
+	* original, so the engines are movable but not copyable.
+	*/
+	template <class UIntType = std::uint64_t, std::size_t BlockBytes = 4096>
+	class basic_engine {
+		static_assert(std::is_integral<UIntType>::value && std::is_unsigned<UIntType>::value
+					&& !std::is_same<UIntType, bool>::value,
+					"qrng::basic_engine needs an unsigned integer type");
+		static_assert(BlockBytes >= sizeof(UIntType) && BlockBytes % sizeof(UIntType) == 0,
+					"qrng::basic_engine needs a block of whole results");
+
+	public:
+		using result_type = UIntType;
+
+		/** Results per read of the device */
+		static constexpr std::size_t block_size = BlockBytes / sizeof(UIntType);
+
+		/** The handle must outlive the engine */
+		explicit basic_engine(QRNG* qrng) noexcept : qrng_(qrng), pos_(block_size) {}
+		explicit basic_engine(const device& dev) noexcept : basic_engine(dev.get()) {}
+
+		basic_engine(basic_engine&& other) noexcept : qrng_(other.qrng_), pos_(other.pos_)
+		{
+			std::memcpy(buf_, other.buf_, sizeof(buf_));
+			other.pos_ = block_size;
+		}
+
+		basic_engine& operator=(basic_engine&& other) noexcept
+		{
+			if (this != &other) {
+				qrng_ = other.qrng_;
+				pos_ = other.pos_;
+				std::memcpy(buf_, other.buf_, sizeof(buf_));
+				other.pos_ = block_size;
+			}
+			return *this;
+		}
+
+		basic_engine(const basic_engine&) = delete;
+		basic_engine& operator=(const basic_engine&) = delete;
+
+		static constexpr result_type min() { return 0; }
+		static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+		/** @throw	qrng::error if the buffer can't be refilled */
+		result_type operator()()
+		{
+			if (pos_ == block_size) refill();
+			return buf_[pos_++];
+		}
+
+		/**
+		* Fill an array, what is left in the buffer first, then straight
+		* from the device
+		*
+		* @throw	qrng::error on a failed or incomplete read
+		*/
+		void generate(result_type* out, std::size_t count)
+		{
+			std::size_t n = (count < block_size - pos_) ? count : block_size - pos_;
+			std::memcpy(out, buf_ + pos_, n * sizeof(result_type));
+			pos_ += n;
+			if (count > n) qrng::read(qrng_, out + n, (count - n) * sizeof(result_type));
+		}
+
+		QRNG* handle() const noexcept { return qrng_; }
+
+	private:
+		void refill()
+		{
+			qrng::read(qrng_, buf_, sizeof(buf_));
+			pos_ = 0;
+		}
+
+		QRNG* qrng_;
+		std::size_t pos_;
+		alignas(64) result_type buf_[block_size];
+	};
+
+	/** Engines of 64, 32, 16 and 8 bits results */
+	using engine = basic_engine<std::uint64_t>;
+	using engine32 = basic_engine<std::uint32_t>;
+	using engine16 = basic_engine<std::uint16_t>;
+	using engine8 = basic_engine<std::uint8_t>;
+
+#ifdef __cpp_lib_concepts
+	static_assert(std::uniform_random_bit_generator<engine>);
+	static_assert(std::uniform_random_bit_generator<engine8>);
+#endif
+
+}
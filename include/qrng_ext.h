@@ -0,0 +1,1235 @@
+/**
+* @file 	qrng_ext.h
+* @brief 	QD QRNG API extensions
+*
+* @note		The extension library (libqrng_ext) is built from the
+* 			sources in ./src on top of the QRNG API library and must
+* 			be linked before it, e.g. "-lqrng_ext -lqrng_vertex".
+*
+* 			Extension state lives with the QRNG object, the handle
+* 			has to be created with qrng_ext_init_param() and is
+* 			released as usual with qrng_deinit().
+*
+* 			The functions below can be called concurrently on the same
+* 			handle, each thread reads through its own pool and keeps
+* 			its own status (qrng_ext_get_status()). The functions of
+* 			qrng_api.h still need one handle per thread.
+*
+* @date		17/10/2026
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "qrng_api.h"
+
+/** Default and maximum size of the per handle entropy pool */
+#define QRNG_POOL_DEFAULT_SIZE	((size_t) 1 << 20)
+#define QRNG_POOL_MIN_SIZE		((size_t) 1 << 12)
+#define QRNG_POOL_MAX_SIZE		((size_t) 64 << 20)
+
+/** Prefetch ring: block size (multiple of 16 bytes) and number of blocks */
+#define QRNG_PREFETCH_DEFAULT_BLOCK	((size_t) 1 << 20)
+#define QRNG_PREFETCH_MIN_BLOCK		((size_t) 1 << 12)
+#define QRNG_PREFETCH_MAX_BLOCK		((size_t) 64 << 20)
+#define QRNG_PREFETCH_MAX_DEPTH		((size_t) 1024)
+
+/** Channels of the device, see Qrng_backend */
+#define QRNG_LL_CHANNEL_HASHED	0
+#define QRNG_LL_CHANNEL_RAW		1
+
+#define QRNG_BACKEND_NAME_MAX	32
+#define QRNG_BACKEND_MAX		16
+
+#define QRNG_MULTI_MAX_DEVICES	16
+#define QRNG_MULTI_RETRY_MS		1000
+
+/** Worker threads serving the asynchronous reads of a handle */
+#define QRNG_ASYNC_DEFAULT_WORKERS	2
+#define QRNG_ASYNC_MAX_WORKERS		64
+
+/**
+* Health tests: false positive rate alpha = 2^-QRNG_HEALTH_ALPHA_LOG2
+* per sample, window of the adaptive proportion test and default
+* min-entropy of a raw sample in bits
+*/
+#define QRNG_HEALTH_ALPHA_LOG2				40
+#define QRNG_HEALTH_APT_WINDOW				512
+#define QRNG_HEALTH_DEFAULT_RAW_ENTROPY		2.0
+
+/**
+* Extractor of qrng_get_extracted(): raw samples hashed per block,
+* security parameter eps = 2^-QRNG_EXTRACT_EPS_LOG2 of the leftover
+* hash lemma, and size of the seed of the Toeplitz matrix
+*/
+#define QRNG_EXTRACT_BLOCK_SAMPLES	1024
+#define QRNG_EXTRACT_EPS_LOG2		64
+#define QRNG_EXTRACT_SEED_SIZE		(QRNG_EXTRACT_BLOCK_SAMPLES * 4)
+#define QRNG_EXTRACT_MAX_THREADS	64
+
+/**
+* DRBG of qrng_get_drbg(): default output and time between two reseeds
+* of an instance, and size of a seed
+*/
+#define QRNG_DRBG_DEFAULT_RESEED_BYTES	((size_t) 1 << 30)
+#define QRNG_DRBG_DEFAULT_RESEED_MS		1000
+#define QRNG_DRBG_SEED_SIZE				32
+
+/**
+* Shared memory rings of qrng_shm_start(): default object name and
+* permissions, default size of a slot and slots per ring, time a slot
+* claimed by a client may stay unreleased before the server takes it
+* back
+*/
+#define QRNG_SHM_DEFAULT_NAME		"/qrng"
+#define QRNG_SHM_DEFAULT_MODE		0660
+#define QRNG_SHM_DEFAULT_BLOCK		((size_t) 1 << 20)
+#define QRNG_SHM_DEFAULT_DEPTH		64
+#define QRNG_SHM_MAX_DEPTH			4096
+#define QRNG_SHM_STALL_MS			1000
+
+/**
+* Network server of qrng_net_start(): default and largest size of a
+* data frame, connections served at once, and defaults of the "tcp" and
+* "unix" clients: timeout of a read and reconnections before giving up
+*/
+#define QRNG_NET_DEFAULT_BATCH		((size_t) 1 << 20)
+#define QRNG_NET_MAX_BATCH			((size_t) 64 << 20)
+#define QRNG_NET_MAX_CLIENTS		256
+#define QRNG_NET_DEFAULT_MODE		0660
+#define QRNG_NET_DEFAULT_TIMEOUT_MS	5000
+#define QRNG_NET_DEFAULT_RETRIES	3
+
+/**
+* Latency histograms of qrng_get_stats(): bucket i counts the calls of
+* at most 2^(i + QRNG_STATS_BUCKET_MIN_LOG2) ns, the last one all the
+* slower calls. The requests of less than QRNG_STATS_SAMPLE_SIZE bytes
+* are timed one in QRNG_STATS_SAMPLE_RATE, the clock costing about as
+* much as the call.
+*/
+#define QRNG_STATS_BUCKETS			28
+#define QRNG_STATS_BUCKET_MIN_LOG2	7
+#define QRNG_STATS_SAMPLE_SIZE		4096
+#define QRNG_STATS_SAMPLE_RATE		64
+
+typedef enum {
+	QRNG_ERROR_CANCELLED = -34,
+	QRNG_ERROR_NOT_EXT_HANDLE = -33,
+	QRNG_ERROR_INVALID_PARAM = -32,
+}Qrng_ext_status;
+
+typedef struct {
+	size_t pool_size;	/**< Entropy pool size in bytes, 0 for default,
+						else between QRNG_POOL_MIN_SIZE and
+						QRNG_POOL_MAX_SIZE */
+	size_t prefetch_depth;	/**< Blocks of the prefetch ring, 0 disables
+							the prefetch thread */
+	size_t prefetch_block;	/**< Prefetch block size in bytes, 0 for default */
+	size_t async_workers;	/**< Threads of qrng_get_async(), 0 for default */
+	int health_tests;		/**< Non zero enables the health tests */
+	double health_raw_entropy;	/**< Min-entropy of a raw sample in bits,
+								0 for default */
+	double extract_min_entropy;	/**< Min-entropy of a raw sample in bits
+								for qrng_get_extracted(), 0 for
+								QRNG_HEALTH_DEFAULT_RAW_ENTROPY */
+	size_t extract_threads;	/**< Threads of qrng_get_extracted(), 0 for
+							one per core */
+	size_t drbg_reseed_bytes;	/**< Output of a qrng_get_drbg() instance
+								between reseeds, 0 for default */
+	uint32_t drbg_reseed_ms;	/**< Time between reseeds in ms, 0 for
+								default */
+}Qrng_ext_param;
+
+/**
+* Device functions of a backend, see qrng_register_backend()
+*
+* get() fills 'buf' with the stream of one channel of the device:
+* - QRNG_LL_CHANNEL_HASHED, 16 bytes frames: the marker 01 02 03 04,
+*   16 bits entropy bits, 16 bits certification value (x 255) and
+*   8 bytes of hashed data. Frames without the marker are 16 bytes of
+*   plain data.
+* - QRNG_LL_CHANNEL_RAW, 32 bits words: the raw entropy sample is the
+*   16 bits value in the upper half.
+* All the values are little endian.
+*/
+typedef struct {
+	const char* name;	/**< Selected by the device names "name:args" */
+	int (*init)(const char* args, void** dev);
+	int (*get)(void* dev, u8* buf, size_t size, size_t* read_len, int channel);
+	void (*deinit)(void* dev);
+}Qrng_backend;
+
+typedef struct {
+	size_t capacity;		/**< Ring size in bytes, 0 if prefetch is disabled */
+	size_t occupancy;		/**< Bytes ready to be read */
+	uint64_t produced;		/**< Bytes read from the device */
+	uint64_t consumed;		/**< Bytes handed to the readers */
+	uint64_t underruns;		/**< Reads that had to wait for the device */
+	uint64_t overruns;		/**< Times the device was idle on a full ring */
+}Qrng_prefetch_stats;
+
+typedef struct {
+	uint32_t rct_cutoff;	/**< Repetitions failing the RCT */
+	uint32_t apt_cutoff;	/**< Occurrences in a window failing the APT */
+	uint64_t samples;		/**< Samples tested */
+	uint64_t rct_failures;	/**< Repetition Count Test failures */
+	uint64_t apt_failures;	/**< Adaptive Proportion Test failures */
+}Qrng_health_channel_stats;
+
+typedef struct {
+	int enabled;		/**< Non zero if the tests run on the handle */
+	int failed;			/**< Non zero until qrng_health_reset() after a failure */
+	Qrng_health_channel_stats raw;		/**< 16 bits raw samples */
+	Qrng_health_channel_stats hashed;	/**< 64 bits hashed data words */
+}Qrng_health_stats;
+
+/**
+* Completion of an asynchronous read, see qrng_get_async()
+*
+* @param[in]	qrng		Handle the read was submitted to
+* @param[in]	data		Buffer of the request
+* @param[in]	size		Size of the request in bytes
+* @param[in]	bytes_read	Bytes written to 'data'
+* @param[in]	status		QRNG_status of the read
+* @param[in]	user		Pointer given to qrng_get_async()
+*/
+typedef void (*Qrng_async_callback)(QRNG* qrng, u8* data, size_t size,
+							size_t bytes_read, int status, void* user);
+
+typedef struct {
+	u8* data;			/**< Buffer of the request */
+	size_t size;		/**< Size of the request in bytes */
+	size_t bytes_read;	/**< Bytes written to 'data' */
+	int status;			/**< QRNG_status of the read */
+	void* user;			/**< Pointer given to qrng_get_async() */
+}Qrng_async_completion;
+
+typedef struct {
+	double min_entropy;		/**< Min-entropy of a raw sample in bits */
+	uint32_t block_bits;	/**< Input bits of a block, 16 per sample */
+	uint32_t output_bits;	/**< Output bits of a block */
+	uint32_t threads;		/**< Threads hashing the blocks */
+	uint64_t samples;		/**< Raw samples hashed */
+	uint64_t bytes;			/**< Bytes returned */
+}Qrng_extract_stats;
+
+typedef struct {
+	uint64_t output_bytes;	/**< Bytes returned by qrng_get_drbg() */
+	uint64_t entropy_bytes;	/**< Device bytes used as seeds */
+	uint64_t reseeds;		/**< Seeds and reseeds of the instances */
+	uint32_t instances;		/**< Threads with a seeded instance */
+}Qrng_drbg_stats;
+
+typedef struct {
+	const char* name;	/**< Shared memory object "/name", NULL for
+						QRNG_SHM_DEFAULT_NAME */
+	size_t block;		/**< Slot size in bytes, 0 for default */
+	size_t depth;		/**< Slots of the hashed channel ring, 0 for
+						default */
+	size_t raw_depth;	/**< Slots of the raw channel ring, 0 doesn't
+						serve the raw channel */
+	uint32_t mode;		/**< Permissions of the object, 0 for
+						QRNG_SHM_DEFAULT_MODE */
+}Qrng_shm_param;
+
+typedef struct {
+	size_t capacity;		/**< Ring size in bytes, 0 if not served */
+	size_t occupancy;		/**< Bytes ready to be read */
+	uint64_t produced;		/**< Bytes read from the device */
+	uint64_t consumed;		/**< Bytes claimed by the clients */
+	uint64_t underruns;		/**< Client reads that had to wait for the device */
+	uint64_t overruns;		/**< Times the device was idle on a full ring */
+	uint64_t reclaimed;		/**< Slots taken back from stalled clients */
+}Qrng_shm_channel_stats;
+
+typedef struct {
+	uint32_t clients;		/**< Handles attached to the object */
+	Qrng_shm_channel_stats hashed;
+	Qrng_shm_channel_stats raw;
+}Qrng_shm_stats;
+
+typedef struct {
+	const char* address;	/**< "tcp:<host>:<port>" or "unix:<path>",
+							several separated by ';' */
+	size_t batch;			/**< Data frame size in bytes, 0 for default */
+	uint32_t max_clients;	/**< Connections served at once, 0 for
+							QRNG_NET_MAX_CLIENTS */
+	uint32_t mode;			/**< Permissions of the unix sockets, 0 for
+							QRNG_NET_DEFAULT_MODE */
+}Qrng_net_param;
+
+typedef struct {
+	uint32_t clients;		/**< Connections open */
+	uint64_t connections;	/**< Connections accepted */
+	uint64_t rejected;		/**< Connections closed over 'max_clients' */
+	uint64_t requests;		/**< Requests of the clients */
+	uint64_t bytes;			/**< Device data sent */
+	uint64_t zerocopy_bytes;	/**< Device data sent with MSG_ZEROCOPY */
+	uint64_t zerocopy_copied;	/**< Zero copy sends copied by the kernel
+								anyway, e.g. on loopback */
+}Qrng_net_stats;
+
+/** Functions timed by qrng_get_stats() */
+typedef enum {
+	QRNG_STATS_FN_CORE,			/**< Device reads of the qrng_api.h functions */
+	QRNG_STATS_FN_GET64,		/**< qrng_get64() */
+	QRNG_STATS_FN_GET_RAW_ENT64,	/**< qrng_get_raw_ent64() */
+	QRNG_STATS_FN_POOL,			/**< Refills of the entropy pools */
+	QRNG_STATS_FN_ASYNC,		/**< qrng_get_async(), submission to completion */
+	QRNG_STATS_FN_CERTIFIED,	/**< qrng_get_certified() */
+	QRNG_STATS_FN_RECORDS,		/**< qrng_get_ec_records() and qrng_get_ec_records_q() */
+	QRNG_STATS_FN_EXTRACTED,	/**< qrng_get_extracted() */
+	QRNG_STATS_FN_DRBG,			/**< qrng_get_drbg() */
+	QRNG_STATS_FN_CONVERT,		/**< qrng_get_u32(), qrng_get_u64(), qrng_get_doubles(),
+								qrng_get_floats() and qrng_get_range() */
+	QRNG_STATS_FN_COUNT
+}Qrng_stats_fn;
+
+typedef struct {
+	uint64_t calls;
+	uint64_t errors;		/**< Calls not returning QRNG_SUCCESS */
+	uint64_t bytes;			/**< Bytes returned, or transferred for the device */
+	uint64_t timed;			/**< Calls timed, see QRNG_STATS_SAMPLE_SIZE */
+	uint64_t total_ns;		/**< Time spent in the timed calls */
+	uint64_t buckets[QRNG_STATS_BUCKETS];	/**< Latency histogram of the timed calls */
+}Qrng_stats_latency;
+
+typedef struct {
+	uint64_t bytes_delivered;	/**< Bytes returned by the extension functions */
+	uint64_t device_reads;		/**< Transfers from the device (backend) */
+	uint64_t device_bytes;		/**< Bytes transferred from the device */
+	uint64_t short_reads;		/**< Transfers shorter than requested, or
+								returning QRNG_ERROR_INCOMPLETE_DATA */
+	uint64_t retries;			/**< Transfers following a short one on the
+								same channel */
+	uint64_t device_errors;		/**< Transfers returning an error */
+	uint64_t device_wait_ns;	/**< Time the readers were blocked on the device,
+								waiting for its lock, a transfer or the
+								prefetch ring */
+	Qrng_stats_latency device;	/**< Transfers from the device */
+	Qrng_stats_latency fn[QRNG_STATS_FN_COUNT];
+}Qrng_stats;
+
+/** Block of qrng_get_with_ec() as a record, see qrng_get_ec_records() */
+typedef struct {
+	u8 data[8];			/**< Hashed data */
+	u16 ent_bits;		/**< Entropy bits of the block */
+	u16 cert_fixed;		/**< Certification value x 255 */
+	float cert_val;		/**< Certification value, 0 to 1 */
+}Qrng_ec_record;
+
+/** Same without the floating point certification value */
+typedef struct {
+	u8 data[8];			/**< Hashed data */
+	u16 ent_bits;		/**< Entropy bits of the block */
+	u16 cert_fixed;		/**< Certification value x 255 */
+}Qrng_ec_record_q;
+
+/** Text encodings of qrng_format() */
+typedef enum {
+	QRNG_FORMAT_DECIMAL,	/**< Doubles, one per line, 'param' digits after the
+							point as "%.<param>f", or the shortest form reading
+							back to the same double if 'param' < 0 */
+	QRNG_FORMAT_HEX,		/**< Bytes, two lower case hexadecimal digits each */
+	QRNG_FORMAT_BASE64,		/**< Bytes, base64 of RFC 4648 with padding, no line
+							breaks */
+	QRNG_FORMAT_UINT,		/**< Unsigned integers of 'param' bytes (1, 2, 4 or 8)
+							in host order, one per line, zero padded to 3, 5,
+							10 or 20 digits */
+}Qrng_format;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+	/**
+	* Initialize the qrng hardware with the parameters passed in and
+	* attach the extension state to the returned QRNG object.
+	*
+	* The returned object is a regular QRNG object, all the functions
+	* in qrng_api.h can be used with it and it is released with
+	* qrng_deinit().
+	*
+	* @param[in] 	init_param	Parameters to initialize the qrng with
+	* @param[in] 	ext_param	Extension parameters, zero initialized
+	* 							fields select the defaults
+	*
+	* @return	QRNG*	pointer to the QRNG object, NULL if a parameter
+	* 					is out of range
+	*/
+	QRNG *qrng_ext_init_param(Qrng_init_param init_param,
+							Qrng_ext_param ext_param);
+
+	/**
+	* Register a device backend
+	*
+	* The QRNG objects created with a device name "name:args" (or
+	* just "name") are then driven by the backend functions instead of
+	* the PCIe driver, 'args' being passed to init(). The built-in
+	* backends are:
+	* - "file:<path>", replays a capture of the device: the hashed
+	* 	channel is read from <path>_c2h_0, or <path>, the raw one from
+	* 	<path>_c2h_1, from the start again at the end of the file
+	* - "fifo:<path>", same for a named pipe or "-" (stdin), which
+	* 	is read once
+	* - "prng:<options>", deterministic generator of device frames at
+	* 	memory speed, options "seed=<n>" (or just "<n>"), "ent=<bits>",
+	* 	"cert=<0..1>" and "frames=0" for frames without header,
+	* 	separated by commas
+	* - "multi:<dev0>;<dev1>;...", aggregates several devices, each one
+	* 	a device name of the PCIe driver or of a backend, up to
+	* 	QRNG_MULTI_MAX_DEVICES. The reads are striped across the
+	* 	devices in parallel and a failing device is taken out until it
+	* 	is tried again QRNG_MULTI_RETRY_MS later. "multi:" alone opens
+	* 	all the /dev/xdma<N> devices.
+	* - "shm:<name>", client of the rings served by another process
+	* 	with qrng_shm_start(), "shm:" alone for QRNG_SHM_DEFAULT_NAME
+	* - "tcp:<host>:<port>" and "unix:<path>", client of a server of
+	* 	qrng_net_start(), options ",timeout=<ms>", ",retries=<n>"
+	* 	(reconnections after an error or timeout) and ",batch=<bytes>"
+	* 	(size of the requests). A read returns QRNG_ERROR_NET_TIMEOUT
+	* 	or QRNG_ERROR_NET_RETRIES_EXCEEDED when the reconnections fail.
+	*
+	* The backends must be registered, or the extensions initialized
+	* by qrng_ext_init_param(), before calling qrng_init_param() with
+	* their device names.
+	*
+	* @param[in]	backend	Backend functions, the name is copied
+	*
+	* @return	QRNG_status, QRNG_ERROR_INVALID_PARAM if the name is
+	* 			already used or the table is full
+	*/
+	int qrng_register_backend(const Qrng_backend* backend);
+
+	/**
+	* Same as qrng_get() with 64 bits sizes
+	*
+	* A single call can fill a buffer of any size, the request is
+	* split into device transfers of the chunk size used by the
+	* QRNG API library (8 MB, aligned on the xdma descriptors).
+	*
+	* @param[in] 	QRNG* 	Pointer to the QRNG object to read from
+	* @param[out]	data	Buffer to receive the random numbers
+	* @param[in]	size	Size of the buffer in bytes
+	* @param[out]	bytes_read 	Returns the size of data read from the qrng
+	*
+	* @return	QRNG_status
+	*/
+	int qrng_get64(QRNG* qrng,
+					u8* data,
+					size_t size,
+					size_t* bytes_read);
+
+	/**
+	* Same as qrng_get_raw_ent() with 64 bits sizes, see qrng_get64()
+	*
+	* @param[in] 	QRNG* 	Pointer to the QRNG object to read from
+	* @param[out]	data	16 bits buffer to receive the raw entropy data
+	* @param[in]	count	Number of elements of the buffer
+	* @param[out]	count_read	Returns the number of elements filled
+	*
+	* @return	QRNG_status
+	*/
+	int qrng_get_raw_ent64(QRNG* qrng,
+						u16* data,
+						size_t count,
+						size_t* count_read);
+
+	/**
+	* Get the status of the last extension call of the calling thread
+	* on this handle
+	*
+	* Unlike qrng_get_status(), the status isn't overwritten by the
+	* other threads sharing the handle.
+	*
+	* @param[in] 	QRNG* 	Pointer to the QRNG object
+	*
+	* @return	QRNG_status, QRNG_ERROR_NOT_EXT_HANDLE if the handle was
+	* 			not created with qrng_ext_init_param()
+	*/
+	int qrng_ext_get_status(QRNG* qrng);
+
+	/**
+	* Get one random number of type 'int' from the entropy pool
+	*
+	* Same as qrng_rand() but served from the entropy pool of the
+	* calling thread, which is refilled in bulk from the device when
+	* it runs empty. Handles that were not created with
+	* qrng_ext_init_param(), or a failed refill, fall back to
+	* qrng_rand(), see qrng_ext_get_status() for the error.
+	*
+	* @param[in] 	QRNG* 	Pointer to the QRNG object to read from
+	*
+	* @return	Random number of type 'int'
+	*/
+	int qrng_pool_rand(QRNG* qrng);
+
+	/**
+	* Get one random number (uniform distribution between 0 and 1)
+	* of type 'double' from the entropy pool, see qrng_urand()
+	*
+	* @param[in] 	QRNG* 	Pointer to the QRNG object to read from
+	*
+	* @return	Random number of type '64 bits float' between 0 and 1
+	*/
+	double qrng_pool_urand(QRNG* qrng);
+
+	/**
+	* Get one random number (uniform distribution between 0 and 1)
+	* of type 'float' from the entropy pool, see qrng_urand2()
+	*
+	* @param[in] 	QRNG* 	Pointer to the QRNG object to read from
+	*
+	* @return	Random number of type '32 bits float' between 0 and 1
+	*/
+	float qrng_pool_urand2(QRNG* qrng);
+
+	/**
+	* Get 32 or 64 random bits, or a double in [0, 1) built from 53
+	* random bits, from the entropy pool
+	*
+	* The handle is the only parameter, so that these functions can be
+	* called through 'uint64_t (*)(void*)' pointers, e.g. as the
+	* next_uint32/next_uint64/next_double functions of a NumPy
+	* bitgen_t. Without the pool they read through qrng_get(). A failed
+	* read returns 0 (or the bytes read before the error), the caller
+	* has to check qrng_pool_get_error() after its draws.
+	*
+	* @param[in] 	QRNG* 	Pointer to the QRNG object to read from
+	*
+	* @return	Random number
+	*/
+	uint32_t qrng_pool_u32(QRNG* qrng);
+	uint64_t qrng_pool_u64(QRNG* qrng);
+	double qrng_pool_double(QRNG* qrng);
+
+	/**
+	* Get and clear the first error of qrng_pool_u32(), qrng_pool_u64()
+	* and qrng_pool_double() on the calling thread since the previous
+	* call
+	*
+	* Unlike qrng_ext_get_status(), the error isn't overwritten by the
+	* later calls, so it can be checked once after a batch of draws.
+	*
+	* @param[in] 	QRNG* 	Pointer to the QRNG object
+	*
+	* @return	QRNG_status, QRNG_ERROR_NOT_EXT_HANDLE if the handle was
+	* 			not created with qrng_ext_init_param()
+	*/
+	int qrng_pool_get_error(QRNG* qrng);
+
+	/**
+	* Discard the unconsumed content of the calling thread's pool
+	*
+	* The pooled bytes are zeroed, the next pool read refills it
+	* from the device.
+	*
+	* @param[in] 	QRNG* 	Pointer to the QRNG object
+	*
+	* @return	QRNG_status
+	*/
+	int qrng_pool_flush(QRNG* qrng);
+
+	/**
+	* Resize the entropy pools, the content of the calling thread's
+	* pool is discarded, the other threads resize theirs on their
+	* next refill
+	*
+	* @param[in] 	QRNG* 	Pointer to the QRNG object
+	* @param[in]	size	New pool size in bytes, between
+	* 						QRNG_POOL_MIN_SIZE and QRNG_POOL_MAX_SIZE,
+	* 						0 selects QRNG_POOL_DEFAULT_SIZE
+	*
+	* @return	QRNG_status
+	*/
+	int qrng_pool_set_size(QRNG* qrng, size_t size);
+
+	/**
+	* Get the state of the prefetch ring
+	*
+	* With a non zero 'prefetch_depth' in Qrng_ext_param, a thread
+	* owned by the handle keeps reading the hashed channel of the
+	* device into a ring of 'prefetch_depth' blocks, and every read of
+	* this channel (qrng_get(), qrng_rand(), the extensions...) is
+	* served from memory. The thread is stopped by qrng_deinit().
+	*
+	* @param[in] 	QRNG* 	Pointer to the QRNG object
+	* @param[out]	stats	Returns the ring state, all zeros when the
+	* 						prefetch is disabled
+	*
+	* @return	QRNG_status
+	*/
+	int qrng_prefetch_get_stats(QRNG* qrng, Qrng_prefetch_stats* stats);
+
+	/**
+	* Submit a read of hashed data without waiting for it
+	*
+	* The request is queued and served by the worker threads of the
+	* handle ('async_workers' in Qrng_ext_param, started by the first
+	* call), several requests can be in flight. 'data' must stay valid
+	* until the completion:
+	* - with a callback, it is called from a worker thread once the
+	* 	read is done. It must not call qrng_deinit() on the handle.
+	* - without, the completion is queued for qrng_async_poll() and
+	* 	the file descriptor of qrng_async_get_fd() becomes readable.
+	*
+	* qrng_deinit() completes the requests not started yet with
+	* QRNG_ERROR_CANCELLED and waits for the others.
+	*
+	* @param[in] 	QRNG* 	Pointer to the QRNG object to read from
+	* @param[out]	data	Buffer to receive the random numbers
+	* @param[in]	size	Size of the buffer in bytes
+	* @param[in]	callback	Completion callback, or NULL
+	* @param[in]	user	Pointer passed back with the completion
+	*
+	* @return	QRNG_status of the submission
+	*/
+	int qrng_get_async(QRNG* qrng,
+					u8* data,
+					size_t size,
+					Qrng_async_callback callback,
+					void* user);
+
+	/**
+	* Get the file descriptor signaling the completions to poll
+	*
+	* An eventfd owned by the handle, readable while the completion
+	* queue is not empty. It can be added to an event loop (epoll,
+	* select...), reading it is left to qrng_async_poll().
+	*
+	* @param[in] 	QRNG* 	Pointer to the QRNG object
+	*
+	* @return	file descriptor, a negative QRNG_status on error
+	*/
+	int qrng_async_get_fd(QRNG* qrng);
+
+	/**
+	* Take the queued completions of the requests without callback
+	*
+	* @param[in] 	QRNG* 	Pointer to the QRNG object
+	* @param[out]	completions	Array to receive the completions
+	* @param[in]	max		Number of elements of the array
+	* @param[out]	count	Returns the number of completions taken
+	*
+	* @return	QRNG_status
+	*/
+	int qrng_async_poll(QRNG* qrng,
+					Qrng_async_completion* completions,
+					size_t max,
+					size_t* count);
+
+	/**
+	* Wait for all the submitted requests to complete
+	*
+	* @param[in] 	QRNG* 	Pointer to the QRNG object
+	*
+	* @return	QRNG_status
+	*/
+	int qrng_async_wait(QRNG* qrng);
+
+	/**
+	* Allocate a buffer backed by 2 MB pages
+	*
+	* Reserved hugepages are used when available, transparent
+	* hugepages otherwise. The pages are faulted in by the allocation,
+	* the reads into the buffer don't pay for them.
+	*
+	* @param[in]	size	Size of the buffer in bytes
+	*
+	* @return	the buffer, NULL on error. Released with qrng_free_buffer().
+	*/
+	void* qrng_alloc_buffer(size_t size);
+
+	/**
+	* Release a buffer of qrng_alloc_buffer()
+	*
+	* @param[in]	data	The buffer, NULL is ignored
+	*/
+	void qrng_free_buffer(void* data);
+
+	/**
+	* Register a buffer that will receive many reads
+	*
+	* The large reads of the extensions (qrng_get64(),
+	* qrng_get_raw_ent64()...) transfer the device data straight into
+	* the caller's buffer. The pages of a registered buffer are faulted
+	* in once and locked in memory, within the RLIMIT_MEMLOCK limit,
+	* until qrng_unregister_buffer() or qrng_deinit(). The buffers may
+	* share pages, a page stays locked while a buffer on it is
+	* registered.
+	*
+	* @param[in] 	QRNG* 	Pointer to the QRNG object
+	* @param[in]	data	The buffer
+	* @param[in]	size	Size of the buffer in bytes
+	*
+	* @return	QRNG_status
+	*/
+	int qrng_register_buffer(QRNG* qrng, void* data, size_t size);
+
+	/**
+	* Unregister a buffer of qrng_register_buffer()
+	*
+	* @param[in] 	QRNG* 	Pointer to the QRNG object
+	* @param[in]	data	The buffer
+	*
+	* @return	QRNG_status, QRNG_ERROR_INVALID_PARAM if not registered
+	*/
+	int qrng_unregister_buffer(QRNG* qrng, void* data);
+
+	/**
+	* Read hashed data certified by the device
+	*
+	* Only the 8 bytes blocks whose entropy bits and certification
+	* value (see qrng_get_with_ec()) reach the thresholds are returned,
+	* packed contiguously. The blocks without certification, 16 bytes
+	* plain blocks of the device, are dropped as two blocks.
+	*
+	* The call fails with QRNG_ERROR_INSUFFICIENT_ENTHROPY when 16
+	* device transfers in a row have no certified block.
+	*
+	* @param[in] 	QRNG* 	Pointer to the QRNG object to read from
+	* @param[out]	data	Buffer to receive the certified blocks
+	* @param[in]	size	Size of the buffer in bytes, multiple of 8
+	* @param[in]	min_cert	Smallest certification value kept, 0 to 1
+	* @param[in]	min_ent		Smallest entropy bits kept, up to 64
+	* @param[out]	bytes_read 	Returns the size of data read
+	* @param[out]	dropped	Returns the number of 8 bytes blocks dropped,
+	* 						can be NULL
+	*
+	* @return	QRNG_status
+	*/
+	int qrng_get_certified(QRNG* qrng,
+					u8* data,
+					size_t size,
+					float min_cert,
+					u16 min_ent,
+					size_t* bytes_read,
+					uint64_t* dropped);
+
+	/**
+	* Read hashed data with entropy bits and certification as records
+	*
+	* The values of qrng_get_with_ec() in one array of 16 bytes
+	* records instead of three arrays. A plain block of the device,
+	* without certification, stops the read with
+	* QRNG_ERROR_WRONG_DATA_FORMAT after the records before it; the
+	* block is consumed and the next call goes on after it.
+	*
+	* @param[in] 	QRNG* 	Pointer to the QRNG object to read from
+	* @param[out]	records	Array to receive the records
+	* @param[in]	count	Number of records to read
+	* @param[out]	count_read 	Returns the number of records read
+	*
+	* @return	QRNG_status
+	*/
+	int qrng_get_ec_records(QRNG* qrng,
+					Qrng_ec_record* records,
+					size_t count,
+					size_t* count_read);
+
+	/**
+	* Same as qrng_get_ec_records() with 12 bytes records, the
+	* certification value in fixed point only (cert_fixed / 255.0f is
+	* the value of qrng_get_with_ec())
+	*/
+	int qrng_get_ec_records_q(QRNG* qrng,
+					Qrng_ec_record_q* records,
+					size_t count,
+					size_t* count_read);
+
+	/**
+	* Read raw entropy samples conditioned on the host
+	*
+	* Blocks of QRNG_EXTRACT_BLOCK_SAMPLES raw samples (see
+	* qrng_get_raw_ent()) are hashed with a seeded Toeplitz matrix,
+	* a strong extractor: with the min-entropy per sample 'h' of
+	* 'extract_min_entropy', a block gives
+	* QRNG_EXTRACT_BLOCK_SAMPLES * h - 2 * QRNG_EXTRACT_EPS_LOG2 bits,
+	* rounded down to a multiple of 64, within 2^-QRNG_EXTRACT_EPS_LOG2
+	* of uniform. qrng_ext_init_param() fails when 'h' is above 16 or
+	* too small to give 64 bits. The blocks are hashed in parallel with carry-less
+	* multiplications (PCLMULQDQ, VPCLMULQDQ).
+	*
+	* The output is independent of the hashing of the device and can
+	* be used to cross-check qrng_get().
+	*
+	* @param[in] 	QRNG* 	Pointer to the QRNG object to read from
+	* @param[out]	data	Buffer to receive the extracted bytes
+	* @param[in]	size	Size of the buffer in bytes
+	* @param[out]	bytes_read 	Returns the size of data read
+	*
+	* @return	QRNG_status
+	*/
+	int qrng_get_extracted(QRNG* qrng,
+					u8* data,
+					size_t size,
+					size_t* bytes_read);
+
+	/**
+	* Set the seed of the Toeplitz matrix of qrng_get_extracted()
+	*
+	* The seed is drawn from /dev/urandom by default. It has to be
+	* independent of the raw samples but can be public, a fixed seed
+	* makes the output reproducible from the samples. The bytes
+	* extracted with the previous seed and not read yet are dropped.
+	*
+	* @param[in] 	QRNG* 	Pointer to the QRNG object
+	* @param[in]	seed	QRNG_EXTRACT_SEED_SIZE bytes
+	* @param[in]	size	Size of 'seed' in bytes
+	*
+	* @return	QRNG_status, QRNG_ERROR_INVALID_PARAM if 'size' is
+	* 			smaller than QRNG_EXTRACT_SEED_SIZE
+	*/
+	int qrng_extract_set_seed(QRNG* qrng, const u8* seed, size_t size);
+
+	/**
+	* Get the parameters and counters of qrng_get_extracted()
+	*
+	* @param[in] 	QRNG* 	Pointer to the QRNG object
+	* @param[out]	stats	Returns the parameters and counters
+	*
+	* @return	QRNG_status
+	*/
+	int qrng_extract_get_stats(QRNG* qrng, Qrng_extract_stats* stats);
+
+	/**
+	* Read from a deterministic generator seeded by the device
+	*
+	* Each thread has its own ChaCha20 instance on the handle, seeded
+	* with QRNG_DRBG_SEED_SIZE bytes of hashed data and reseeded after
+	* 'drbg_reseed_bytes' of output or 'drbg_reseed_ms', whichever
+	* comes first. The key is replaced by keystream after every
+	* request (fast key erasure), so earlier output can't be
+	* recovered from the state.
+	*
+	* A reseed failure is returned with the bytes generated before it,
+	* the instance keeps its key and tries again at the next call.
+	*
+	* @param[in] 	QRNG* 	Pointer to the QRNG object to read from
+	* @param[out]	data	Buffer to receive the bytes
+	* @param[in]	size	Size of the buffer in bytes
+	* @param[out]	bytes_read 	Returns the size of data read
+	*
+	* @return	QRNG_status
+	*/
+	int qrng_get_drbg(QRNG* qrng,
+					u8* data,
+					size_t size,
+					size_t* bytes_read);
+
+	/**
+	* Reseed the qrng_get_drbg() instance of the calling thread now,
+	* e.g. before output that has to be backed by fresh entropy
+	*
+	* @param[in] 	QRNG* 	Pointer to the QRNG object
+	*
+	* @return	QRNG_status
+	*/
+	int qrng_drbg_reseed(QRNG* qrng);
+
+	/**
+	* Get the counters of qrng_get_drbg() over all threads: the output
+	* beyond 'entropy_bytes' is expanded by the generator
+	*
+	* @param[in] 	QRNG* 	Pointer to the QRNG object
+	* @param[out]	stats	Returns the counters
+	*
+	* @return	QRNG_status
+	*/
+	int qrng_drbg_get_stats(QRNG* qrng, Qrng_drbg_stats* stats);
+
+	/**
+	* Serve the device of the handle to other processes
+	*
+	* The hashed channel (and the raw channel with a non zero
+	* 'raw_depth') is read by a thread per channel into a ring of
+	* 'depth' slots of 'block' bytes, in the POSIX shared memory object
+	* 'name'. Any process allowed by 'mode' opens the device
+	* "shm:<name>" and reads the rings with the functions of the QRNG
+	* API and of the extensions, without access to the device itself.
+	*
+	* The rings are lock-free: the clients claim whole frames (whole
+	* words on the raw channel) with an atomic on the shared read
+	* position, so each byte goes to a single client, and copy them
+	* out. The server and the clients only sleep, on a futex, on an
+	* empty or full ring. A slot claimed by a client that died before
+	* releasing it is taken back after QRNG_SHM_STALL_MS; a client that
+	* was only stalled drops what it copied from the slot and reads new
+	* data, the releases being tagged with the generation of the slot.
+	*
+	* The object is removed by qrng_shm_stop() or qrng_deinit(), an
+	* object left by a server that died is replaced, including one the
+	* server didn't finish setting up.
+	*
+	* @param[in] 	QRNG* 	Pointer to the QRNG object to serve
+	* @param[in]	param	Object and rings, NULL for the defaults
+	*
+	* @return	QRNG_status, QRNG_ERROR_OPENING_DEVICE if the object
+	* 			can't be created or is served by another process,
+	* 			QRNG_ERROR_INVALID_PARAM if the handle is already
+	* 			served or on other systems than Linux
+	*/
+	int qrng_shm_start(QRNG* qrng, const Qrng_shm_param* param);
+
+	/**
+	* Stop serving the handle and remove the shared memory object, the
+	* clients still read the data left in the rings and then get
+	* QRNG_ERROR_READING_DEVICE
+	*
+	* @param[in] 	QRNG* 	Pointer to the QRNG object
+	*
+	* @return	QRNG_status, QRNG_ERROR_INVALID_PARAM if not served
+	*/
+	int qrng_shm_stop(QRNG* qrng);
+
+	/**
+	* Get the counters of the rings served by qrng_shm_start()
+	*
+	* @param[in] 	QRNG* 	Pointer to the QRNG object
+	* @param[out]	stats	Returns the counters, all zeros when the
+	* 						handle isn't served
+	*
+	* @return	QRNG_status
+	*/
+	int qrng_shm_get_stats(QRNG* qrng, Qrng_shm_stats* stats);
+
+	/**
+	* Serve the device of the handle over the network
+	*
+	* Each connection of a "tcp" or "unix" client gets a thread of the
+	* server, which reads the device channels in transfers of 'batch'
+	* bytes and sends them as data frames, in the order of the client
+	* requests. The clients keep requests ahead of their reads, so the
+	* server reads and sends the next frames while they consume the
+	* current ones. The TCP data goes out with MSG_ZEROCOPY when the
+	* kernel supports it.
+	*
+	* There is no authentication, a TCP server is meant for a trusted
+	* network or a loopback address.
+	*
+	* @param[in] 	QRNG* 	Pointer to the QRNG object to serve
+	* @param[in]	param	Addresses and frames
+	*
+	* @return	QRNG_status, QRNG_ERROR_OPENING_DEVICE if an address
+	* 			can't be bound, QRNG_ERROR_INVALID_PARAM if an address is
+	* 			invalid, if the handle is already served or on other
+	* 			systems than Linux
+	*/
+	int qrng_net_start(QRNG* qrng, const Qrng_net_param* param);
+
+	/**
+	* Stop serving the handle over the network, the connections are
+	* closed
+	*
+	* @param[in] 	QRNG* 	Pointer to the QRNG object
+	*
+	* @return	QRNG_status, QRNG_ERROR_INVALID_PARAM if not served
+	*/
+	int qrng_net_stop(QRNG* qrng);
+
+	/**
+	* Get the counters of the server of qrng_net_start()
+	*
+	* @param[in] 	QRNG* 	Pointer to the QRNG object
+	* @param[out]	stats	Returns the counters, all zeros when the
+	* 						handle isn't served
+	*
+	* @return	QRNG_status
+	*/
+	int qrng_net_get_stats(QRNG* qrng, Qrng_net_stats* stats);
+
+	/**
+	* Get the counters of the health tests
+	*
+	* With a non zero 'health_tests' in Qrng_ext_param, the
+	* continuous health tests of NIST SP 800-90B (Repetition Count
+	* Test and Adaptive Proportion Test) run on every transfer of both
+	* channels of the device, before the data is used. A failure
+	* discards the transfer and every read of the handle then returns
+	* QRNG_ERROR_INSUFFICIENT_ENTHROPY until qrng_health_reset().
+	*
+	* The cutoffs follow from the false positive rate
+	* 2^-QRNG_HEALTH_ALPHA_LOG2 and the min-entropy per sample: the
+	* 'health_raw_entropy' claimed for the raw samples, full entropy
+	* for the hashed data.
+	*
+	* @param[in] 	QRNG* 	Pointer to the QRNG object
+	* @param[out]	stats	Returns the counters, all zeros when the tests
+	* 						are disabled
+	*
+	* @return	QRNG_status
+	*/
+	int qrng_health_get_stats(QRNG* qrng, Qrng_health_stats* stats);
+
+	/**
+	* Clear the failed state of the health tests, the counters are kept
+	*
+	* @param[in] 	QRNG* 	Pointer to the QRNG object
+	*
+	* @return	QRNG_status, QRNG_ERROR_INVALID_PARAM if the tests are
+	* 			disabled
+	*/
+	int qrng_health_reset(QRNG* qrng);
+
+	/**
+	* Get the counters of the handle
+	*
+	* The device transfers, the time blocked on the device and the
+	* calls of the main reading functions (see Qrng_stats_fn) are
+	* counted from the creation of the handle, by all the threads
+	* using it. The functions of qrng_api.h are counted through their
+	* device reads. The counters are per thread or relaxed atomics,
+	* cheap enough to stay enabled, and the histograms have one bucket
+	* per power of two of nanoseconds. The small requests are sampled
+	* for the histograms, see QRNG_STATS_SAMPLE_SIZE.
+	*
+	* @param[in] 	QRNG* 	Pointer to the QRNG object
+	* @param[out]	stats	Returns the counters
+	*
+	* @return	QRNG_status, QRNG_ERROR_NOT_EXT_HANDLE if the handle was
+	* 			not created with qrng_ext_init_param()
+	*/
+	int qrng_get_stats(QRNG* qrng, Qrng_stats* stats);
+
+	/**
+	* Write the counters of qrng_get_stats() in the Prometheus text
+	* exposition format
+	*
+	* The metrics are named qrng_*, with the labels handle="<n>" and
+	* 'labels' (e.g. "device=\"xdma0\"") on every sample.
+	*
+	* @param[in] 	QRNG* 	Pointer to the QRNG object
+	* @param[in]	labels	Additional labels, or NULL
+	* @param[out]	text	Buffer to receive the text, NUL terminated
+	* @param[in]	size	Size of the buffer in bytes
+	* @param[out]	len		Returns the length of the text without the NUL,
+	* 						also when the buffer is too small
+	*
+	* @return	QRNG_status, QRNG_ERROR_INVALID_PARAM if the buffer is
+	* 			too small
+	*/
+	int qrng_stats_prometheus(QRNG* qrng, const char* labels, char* text,
+							size_t size, size_t* len);
+
+	/**
+	* Fill an array with random 32 bits integers
+	*
+	* @param[in] 	QRNG* 	Pointer to the QRNG object to read from
+	* @param[out]	data	Array to receive the random numbers
+	* @param[in]	count	Number of elements of the array
+	* @param[out]	count_read	Returns the number of elements filled
+	*
+	* @return	QRNG_status
+	*/
+	int qrng_get_u32(QRNG* qrng,
+					uint32_t* data,
+					size_t count,
+					size_t* count_read);
+
+	/**
+	* Fill an array with random 64 bits integers, see qrng_get_u32()
+	*/
+	int qrng_get_u64(QRNG* qrng,
+					uint64_t* data,
+					size_t count,
+					size_t* count_read);
+
+	/**
+	* Fill an array with random doubles (uniform distribution in [0, 1))
+	*
+	* Each number is built from 53 random bits, i.e. it is a multiple
+	* of 2^-53.
+	*
+	* @param[in] 	QRNG* 	Pointer to the QRNG object to read from
+	* @param[out]	data	Array to receive the random numbers
+	* @param[in]	count	Number of elements of the array
+	* @param[out]	count_read	Returns the number of elements filled
+	*
+	* @return	QRNG_status
+	*/
+	int qrng_get_doubles(QRNG* qrng,
+						double* data,
+						size_t count,
+						size_t* count_read);
+
+	/**
+	* Fill an array with random floats (uniform distribution in [0, 1))
+	*
+	* Each number is built from 24 random bits, i.e. it is a multiple
+	* of 2^-24.
+	*
+	* @param[in] 	QRNG* 	Pointer to the QRNG object to read from
+	* @param[out]	data	Array to receive the random numbers
+	* @param[in]	count	Number of elements of the array
+	* @param[out]	count_read	Returns the number of elements filled
+	*
+	* @return	QRNG_status
+	*/
+	int qrng_get_floats(QRNG* qrng,
+						float* data,
+						size_t count,
+						size_t* count_read);
+
+	/**
+	* Fill an array with unbiased random integers between 'lo' and 'hi'
+	*
+	* Use this instead of 'qrng_rand(qrng) % n', which is biased.
+	* Each value costs 8, 16, 32 or 64 random bits depending on the
+	* size of the range, plus a rare (< 1/16) rejection to remove
+	* the bias.
+	*
+	* @param[in] 	QRNG* 	Pointer to the QRNG object to read from
+	* @param[in]	lo		Lowest value (inclusive)
+	* @param[in]	hi		Highest value (inclusive)
+	* @param[out]	data	Array to receive the random numbers
+	* @param[in]	count	Number of elements of the array
+	* @param[out]	count_read	Returns the number of elements filled
+	*
+	* @return	QRNG_status
+	*/
+	int qrng_get_range(QRNG* qrng,
+					u64 lo,
+					u64 hi,
+					u64* data,
+					size_t count,
+					size_t* count_read);
+
+	/**
+	* Get one unbiased random integer between 'lo' and 'hi' (inclusive)
+	*
+	* @param[in] 	QRNG* 	Pointer to the QRNG object to read from
+	* @param[in]	lo		Lowest value
+	* @param[in]	hi		Highest value
+	*
+	* @return	Random number, 'lo' if it couldn't be read, in which
+	* 			case qrng_ext_get_status() returns the error
+	* 			(qrng_get_status() on a handle not created with
+	* 			qrng_ext_init_param())
+	*/
+	u64 qrng_uniform_int(QRNG* qrng, u64 lo, u64 hi);
+
+	/**
+	* Fill an array with normally distributed random numbers
+	*
+	* The numbers are drawn with a ziggurat, one 64 bits word of the
+	* bulk stream per number plus about 1% of extra words for the
+	* rejected ones. This replaces Box-Muller on top of qrng_urand().
+	*
+	* @param[in] 	QRNG* 	Pointer to the QRNG object to read from
+	* @param[in]	mean	Mean of the distribution
+	* @param[in]	stddev	Standard deviation of the distribution
+	* @param[out]	data	Array to receive the random numbers
+	* @param[in]	count	Number of elements of the array
+	* @param[out]	count_read	Returns the number of elements filled
+	* @param[out]	bytes_used	Returns the number of random bytes
+	* 							consumed for these elements, may be NULL
+	*
+	* @return	QRNG_status
+	*/
+	int qrng_get_normal(QRNG* qrng,
+						double mean,
+						double stddev,
+						double* data,
+						size_t count,
+						size_t* count_read,
+						size_t* bytes_used);
+
+	/**
+	* Fill an array with exponentially distributed random numbers of
+	* rate 'lambda' (mean 1 / lambda), see qrng_get_normal()
+	*/
+	int qrng_get_exponential(QRNG* qrng,
+							double lambda,
+							double* data,
+							size_t count,
+							size_t* count_read,
+							size_t* bytes_used);
+
+	/**
+	* Fill an array with Poisson distributed random numbers of mean
+	* 'lambda'
+	*
+	* Means up to 64 cost exactly 8 random bytes per number (alias
+	* table), larger ones about 16 to 20 bytes (transformed rejection).
+	*
+	* @param[in] 	QRNG* 	Pointer to the QRNG object to read from
+	* @param[in]	lambda	Mean of the distribution, up to 1e18
+	* @param[out]	data	Array to receive the random numbers
+	* @param[in]	count	Number of elements of the array
+	* @param[out]	count_read	Returns the number of elements filled
+	* @param[out]	bytes_used	Returns the number of random bytes
+	* 							consumed for these elements, may be NULL
+	*
+	* @return	QRNG_status
+	*/
+	int qrng_get_poisson(QRNG* qrng,
+						double lambda,
+						u64* data,
+						size_t count,
+						size_t* count_read,
+						size_t* bytes_used);
+
+	/**
+	* Fill an array with random indexes between 0 and n_weights - 1,
+	* index i being drawn with probability weights[i] / sum(weights)
+	*
+	* Each number costs exactly 8 random bytes (alias table).
+	*
+	* @param[in] 	QRNG* 	Pointer to the QRNG object to read from
+	* @param[in]	weights	Non negative weights, with a positive sum
+	* @param[in]	n_weights	Number of weights, up to 2^32 - 1
+	* @param[out]	data	Array to receive the random numbers
+	* @param[in]	count	Number of elements of the array
+	* @param[out]	count_read	Returns the number of elements filled
+	* @param[out]	bytes_used	Returns the number of random bytes
+	* 							consumed for these elements, may be NULL
+	*
+	* @return	QRNG_status
+	*/
+	int qrng_get_discrete(QRNG* qrng,
+						const double* weights,
+						size_t n_weights,
+						u64* data,
+						size_t count,
+						size_t* count_read,
+						size_t* bytes_used);
+
+	/**
+	* Encode an array as text, e.g. the output of qrng_get_doubles() or
+	* qrng_get64() for a file
+	*
+	* Only whole elements are written, as many as fit in the buffer, so
+	* a large array can be encoded in several calls. For base64 these
+	* are groups of 3 bytes, the padded last group is written once the
+	* remaining bytes fit. The values of qrng_get_doubles() take
+	* 'param' + 3 characters each in QRNG_FORMAT_DECIMAL.
+	*
+	* @param[in]	format	Qrng_format
+	* @param[in]	param	Digits after the point for QRNG_FORMAT_DECIMAL,
+	* 						up to 100, bytes of the integers for
+	* 						QRNG_FORMAT_UINT, unused otherwise
+	* @param[in]	data	Array to encode
+	* @param[in]	count	Number of elements of the array, doubles,
+	* 						integers or bytes depending on the format
+	* @param[out]	text	Buffer to receive the text, not NUL terminated
+	* @param[in]	size	Size of the buffer in bytes
+	* @param[out]	count_done	Returns the number of elements encoded
+	* @param[out]	len		Returns the length of the text
+	*
+	* @return	QRNG_status, QRNG_ERROR_INVALID_PARAM for an unknown
+	* 			format or parameter
+	*/
+	int qrng_format(int format,
+					int param,
+					const void* data,
+					size_t count,
+					char* text,
+					size_t size,
+					size_t* count_done,
+					size_t* len);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,247 @@
+/**
+* @file 	qrng_async.cpp
+* @brief 	Asynchronous reads served by a pool of worker threads
+*
+* The requests are queued on the handle and read by its workers, each
+* worker reading through its own shard like any other thread sharing
+* the handle. The completions of the requests without callback go to
+* a queue signaled by an eventfd, so that an event loop can wait for
+* them with the rest of its file descriptors.
+*
+* @date		17/10/2026
+*
+* Copyright(c) Quantum Dice. All rights reserved.
+*/
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif
+
+#include "qrng_ext_internal.h"
+
+typedef struct {
+	u8* data;
+	size_t size;
+	Qrng_async_callback callback;
+	void* user;
+	u64 submitted_ns;	/**< for the latency of qrng_get_stats() */
+}Async_request;
+
+struct Qrng_async {
+	QRNG* qrng;
+	std::vector<std::thread> workers;
+	std::deque<Async_request> requests;
+	std::deque<Qrng_async_completion> completions;
+	size_t in_flight;		/**< submitted and not completed */
+	int fd;					/**< eventfd, -1 if not available */
+	bool stop;
+
+	std::mutex mutex;
+	std::condition_variable request_cv;
+	std::condition_variable idle_cv;
+};
+
+static void async_signal(Qrng_async* async)
+{
+#ifdef __linux__
+	if (async->fd >= 0) {
+		uint64_t one = 1;
+		ssize_t ret = write(async->fd, &one, sizeof(one));
+		(void)ret;
+	}
+#endif
+}
+
+/** Hand the completion to the user, the caller doesn't hold the lock */
+static void async_complete(Qrng_async* async, const Async_request& req,
+						size_t bytes_read, int status)
+{
+	if (req.callback) {
+		req.callback(async->qrng, req.data, req.size, bytes_read, status, req.user);
+	}
+	else {
+		Qrng_async_completion c = { req.data, req.size, bytes_read, status, req.user };
+		{
+			std::lock_guard<std::mutex> lock(async->mutex);
+			async->completions.push_back(c);
+		}
+		async_signal(async);
+	}
+
+	std::lock_guard<std::mutex> lock(async->mutex);
+	if (--async->in_flight == 0) async->idle_cv.notify_all();
+}
+
+static void async_worker(Qrng_async* async)
+{
+	std::unique_lock<std::mutex> lock(async->mutex);
+
+	for (;;) {
+		async->request_cv.wait(lock, [&] { return async->stop || !async->requests.empty(); });
+		if (async->stop) break;
+
+		Async_request req = async->requests.front();
+		async->requests.pop_front();
+		lock.unlock();
+
+		size_t bytes_read = 0;
+		int ret = ext_get(async->qrng, req.data, req.size, &bytes_read);
+		ext_stats_call(ext_shard(async->qrng), QRNG_STATS_FN_ASYNC, req.submitted_ns, bytes_read, ret);
+		async_complete(async, req, bytes_read, ret);
+
+		lock.lock();
+	}
+}
+
+static void async_free(Qrng_async* async)
+{
+#ifdef __linux__
+	if (async->fd >= 0) close(async->fd);
+#endif
+	delete async;
+}
+
+/** Workers of the handle, started by the first call */
+static Qrng_async* async_get(QRNG* qrng, Qrng_ext_ctx* ctx)
+{
+	Qrng_async* async = ctx->async.load(std::memory_order_acquire);
+	if (async) return async;
+
+	std::lock_guard<std::mutex> lock(ctx->async_mutex);
+	async = ctx->async.load(std::memory_order_relaxed);
+	if (async) return async;
+
+	async = new (std::nothrow) Qrng_async();
+	if (!async) return nullptr;
+	async->qrng = qrng;
+	async->in_flight = 0;
+	async->stop = false;
+	async->fd = -1;
+#ifdef __linux__
+	async->fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+#endif
+
+	size_t n = ctx->param.async_workers;
+	if (n == 0) n = QRNG_ASYNC_DEFAULT_WORKERS;
+	if (n > QRNG_ASYNC_MAX_WORKERS) n = QRNG_ASYNC_MAX_WORKERS;
+
+	try {
+		for (size_t i = 0; i < n; i++) async->workers.emplace_back(async_worker, async);
+	}
+	catch (...) {
+		if (async->workers.empty()) {
+			async_free(async);
+			return nullptr;
+		}
+	}
+
+	ctx->async.store(async, std::memory_order_release);
+	return async;
+}
+
+void ext_async_stop(Qrng_ext_ctx* ctx)
+{
+	Qrng_async* async = ctx->async.load(std::memory_order_acquire);
+	if (!async) return;
+
+	std::deque<Async_request> cancelled;
+	{
+		std::lock_guard<std::mutex> lock(async->mutex);
+		async->stop = true;
+		cancelled.swap(async->requests);
+	}
+	async->request_cv.notify_all();
+
+	for (const Async_request& req : cancelled)
+		async_complete(async, req, 0, QRNG_ERROR_CANCELLED);
+	for (std::thread& t : async->workers) t.join();
+
+	async_free(async);
+	ctx->async.store(nullptr, std::memory_order_relaxed);
+}
+
+int qrng_get_async(QRNG* qrng, u8* data, size_t size, Qrng_async_callback callback,
+				void* user)
+{
+	if (!data) return QRNG_ERROR_NULL_PTR;
+
+	Qrng_ext_ctx* ctx = ext_ctx(qrng);
+	if (!ctx) return QRNG_ERROR_NOT_EXT_HANDLE;
+
+	Qrng_async* async = async_get(qrng, ctx);
+	if (!async) return QRNG_ERROR_INTERNAL_MEMORY;
+
+	{
+		std::lock_guard<std::mutex> lock(async->mutex);
+		if (async->stop) return QRNG_ERROR_CANCELLED;
+		async->requests.push_back({ data, size, callback, user, ext_stats_now() });
+		async->in_flight++;
+	}
+	async->request_cv.notify_one();
+	return QRNG_SUCCESS;
+}
+
+int qrng_async_get_fd(QRNG* qrng)
+{
+	Qrng_ext_ctx* ctx = ext_ctx(qrng);
+	if (!ctx) return QRNG_ERROR_NOT_EXT_HANDLE;
+
+	Qrng_async* async = async_get(qrng, ctx);
+	if (!async) return QRNG_ERROR_INTERNAL_MEMORY;
+	return (async->fd >= 0) ? async->fd : QRNG_ERROR_INVALID_PARAM;
+}
+
+int qrng_async_poll(QRNG* qrng, Qrng_async_completion* completions, size_t max,
+				size_t* count)
+{
+	if (!completions && max) return QRNG_ERROR_NULL_PTR;
+	if (count) *count = 0;
+
+	Qrng_ext_ctx* ctx = ext_ctx(qrng);
+	if (!ctx) return QRNG_ERROR_NOT_EXT_HANDLE;
+
+	Qrng_async* async = ctx->async.load(std::memory_order_acquire);
+	if (!async) return QRNG_SUCCESS;
+
+#ifdef __linux__
+	/** reset the counter first, a completion queued meanwhile signals again */
+	uint64_t events;
+	if (async->fd >= 0 && read(async->fd, &events, sizeof(events)) < 0) events = 0;
+#endif
+
+	size_t n = 0;
+	bool left;
+	{
+		std::lock_guard<std::mutex> lock(async->mutex);
+		while (n < max && !async->completions.empty()) {
+			completions[n++] = async->completions.front();
+			async->completions.pop_front();
+		}
+		left = !async->completions.empty();
+	}
+	if (left) async_signal(async);
+
+	if (count) *count = n;
+	return QRNG_SUCCESS;
+}
+
+int qrng_async_wait(QRNG* qrng)
+{
+	Qrng_ext_ctx* ctx = ext_ctx(qrng);
+	if (!ctx) return QRNG_ERROR_NOT_EXT_HANDLE;
+
+	Qrng_async* async = ctx->async.load(std::memory_order_acquire);
+	if (!async) return QRNG_SUCCESS;
+
+	std::unique_lock<std::mutex> lock(async->mutex);
+	async->idle_cv.wait(lock, [&] { return async->in_flight == 0; });
+	return QRNG_SUCCESS;
+}
@@ -0,0 +1,308 @@
+/**
+* @file 	qrng_backend.cpp
+* @brief 	Device backends: registry and built-in file, fifo and prng
+*
+* A device name "name:args" selects the registered backend "name", any
+* other name goes to the PCIe driver of the QRNG API library. The
+* built-in backends stand in for the device to test and profile the
+* library without the hardware.
+*
+* @date		17/10/2026
+*
+* Copyright(c) Quantum Dice. All rights reserved.
+*/
+
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#include <string>
+
+#include "qrng_ext_internal.h"
+
+static std::mutex backends_mutex;
+static Qrng_backend_entry backends[QRNG_BACKEND_MAX];
+static size_t backends_count;
+
+bool ext_backend_find(const char* dev_name, Qrng_ll_table* ll, const char** args)
+{
+	if (!dev_name) return false;
+
+	const char* sep = strchr(dev_name, ':');
+	size_t len = sep ? (size_t)(sep - dev_name) : strlen(dev_name);
+
+	std::lock_guard<std::mutex> lock(backends_mutex);
+	for (size_t i = 0; i < backends_count; i++) {
+		if (strlen(backends[i].name) == len && !strncmp(backends[i].name, dev_name, len)) {
+			*ll = backends[i].ll;
+			*args = sep ? sep + 1 : "";
+			return true;
+		}
+	}
+	return false;
+}
+
+static int backend_add(const char* name, const Qrng_ll_table* ll)
+{
+	if (!name || !*name || strchr(name, ':') || strlen(name) >= QRNG_BACKEND_NAME_MAX)
+		return QRNG_ERROR_INVALID_PARAM;
+
+	std::lock_guard<std::mutex> lock(backends_mutex);
+	if (backends_count == QRNG_BACKEND_MAX) return QRNG_ERROR_INVALID_PARAM;
+	for (size_t i = 0; i < backends_count; i++)
+		if (!strcmp(backends[i].name, name)) return QRNG_ERROR_INVALID_PARAM;
+
+	Qrng_backend_entry* e = &backends[backends_count++];
+	strcpy(e->name, name);
+	e->ll = *ll;
+	return QRNG_SUCCESS;
+}
+
+int qrng_register_backend(const Qrng_backend* backend)
+{
+	if (!backend) return QRNG_ERROR_NULL_PTR;
+	if (!backend->init || !backend->get || !backend->deinit)
+		return QRNG_ERROR_INVALID_PARAM;
+
+	ext_install();
+
+	Qrng_ll_table ll = { backend->init, backend->get, backend->deinit };
+	return backend_add(backend->name, &ll);
+}
+
+/**
+* "file" and "fifo": the channels are read from files named like the
+* xdma device files, <path>_c2h_0 and <path>_c2h_1
+*/
+typedef struct {
+	FILE* ch[2];
+	bool loop;		/**< start again at the end of the file */
+}File_dev;
+
+static FILE* file_open_channel(const char* path, int channel)
+{
+	if (!strcmp(path, "-")) return (channel == QRNG_LL_CHANNEL_HASHED) ? stdin : nullptr;
+
+	std::string name = std::string(path) + "_c2h_" + std::to_string(channel);
+	FILE* f = fopen(name.c_str(), "rb");
+	if (!f && channel == QRNG_LL_CHANNEL_HASHED) f = fopen(path, "rb");
+
+	/** the reads are large, no need for stdio buffering */
+	if (f) setvbuf(f, nullptr, _IONBF, 0);
+	return f;
+}
+
+static int file_init_common(const char* args, void** dev, bool loop)
+{
+	if (!args || !*args) return QRNG_ERROR_OPENING_DEVICE;
+
+	File_dev* f = new (std::nothrow) File_dev();
+	if (!f) return QRNG_ERROR_INTERNAL_MEMORY;
+
+	f->loop = loop && strcmp(args, "-");
+	f->ch[QRNG_LL_CHANNEL_HASHED] = file_open_channel(args, QRNG_LL_CHANNEL_HASHED);
+	f->ch[QRNG_LL_CHANNEL_RAW] = file_open_channel(args, QRNG_LL_CHANNEL_RAW);
+
+	*dev = f;
+	return f->ch[QRNG_LL_CHANNEL_HASHED] ? QRNG_SUCCESS : QRNG_ERROR_OPENING_DEVICE;
+}
+
+static int file_init(const char* args, void** dev)
+{
+	return file_init_common(args, dev, true);
+}
+
+static int fifo_init(const char* args, void** dev)
+{
+	return file_init_common(args, dev, false);
+}
+
+static int file_get(void* dev, u8* buf, size_t size, size_t* read_len, int channel)
+{
+	File_dev* f = (File_dev*)dev;
+	FILE* file = (channel == QRNG_LL_CHANNEL_HASHED || channel == QRNG_LL_CHANNEL_RAW)
+			? f->ch[channel] : nullptr;
+	size_t done = 0;
+	bool rewound = false;
+	int ret = file ? QRNG_SUCCESS : QRNG_ERROR_READING_DEVICE;
+
+	while (ret == QRNG_SUCCESS && done < size) {
+		size_t n = fread(buf + done, 1, size - done, file);
+		done += n;
+		if (n > 0) {
+			rewound = false;
+			continue;
+		}
+
+		/** an empty file ends the read instead of looping forever */
+		if (ferror(file)) ret = QRNG_ERROR_READING_DEVICE;
+		else if (!f->loop || rewound || fseek(file, 0, SEEK_SET)) ret = QRNG_ERROR_INCOMPLETE_DATA;
+		else rewound = true;
+	}
+
+	if (read_len) *read_len = done;
+	return ret;
+}
+
+static void file_deinit(void* dev)
+{
+	File_dev* f = (File_dev*)dev;
+	if (!f) return;
+
+	for (FILE* file : f->ch)
+		if (file && file != stdin) fclose(file);
+	delete f;
+}
+
+/**
+* "prng": frames built from splitmix64, one independent stream per
+* channel
+*/
+typedef struct {
+	u64 state[2];
+	bool frames;	/**< false for frames without header */
+	u16 ent;
+	u16 cert;		/**< certification value x 255 */
+}Prng_dev;
+
+static inline u64 splitmix64(u64* state)
+{
+	u64 z = (*state += 0x9e3779b97f4a7c15ull);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+	return z ^ (z >> 31);
+}
+
+/** Parse "seed=<n>,ent=<bits>,cert=<0..1>,frames=<0|1>" or "<n>" */
+static bool prng_parse(Prng_dev* p, const char* args)
+{
+	u64 seed = 0;
+	std::string opts(args ? args : "");
+	size_t start = 0;
+
+	while (start < opts.size()) {
+		size_t end = opts.find(',', start);
+		if (end == std::string::npos) end = opts.size();
+		std::string opt = opts.substr(start, end - start);
+		start = end + 1;
+
+		size_t eq = opt.find('=');
+		std::string key = (eq == std::string::npos) ? "seed" : opt.substr(0, eq);
+		std::string val = (eq == std::string::npos) ? opt : opt.substr(eq + 1);
+		char* stop = nullptr;
+
+		if (key == "seed") {
+			seed = strtoull(val.c_str(), &stop, 0);
+		}
+		else if (key == "ent") {
+			unsigned long ent = strtoul(val.c_str(), &stop, 0);
+			if (ent > 64) return false;
+			p->ent = (u16)ent;
+		}
+		else if (key == "cert") {
+			double cert = strtod(val.c_str(), &stop);
+			if (!(cert >= 0.0 && cert <= 1.0)) return false;
+			p->cert = (u16)(cert * QRNG_CERT_SCALE + 0.5);
+		}
+		else if (key == "frames") {
+			p->frames = strtoul(val.c_str(), &stop, 0) != 0;
+		}
+		else {
+			return false;
+		}
+		if (val.empty() || *stop) return false;
+	}
+
+	p->state[QRNG_LL_CHANNEL_HASHED] = seed;
+	p->state[QRNG_LL_CHANNEL_RAW] = ~seed;
+	return true;
+}
+
+static int prng_init(const char* args, void** dev)
+{
+	Prng_dev* p = new (std::nothrow) Prng_dev();
+	if (!p) return QRNG_ERROR_INTERNAL_MEMORY;
+
+	p->frames = true;
+	p->ent = 64;
+	p->cert = (u16)QRNG_CERT_SCALE;
+
+	*dev = p;
+	return prng_parse(p, args) ? QRNG_SUCCESS : QRNG_ERROR_OPENING_DEVICE;
+}
+
+/** Next 16 bytes of a channel */
+static inline void prng_block(Prng_dev* p, int channel, u8* out)
+{
+	u64* state = &p->state[channel];
+
+	if (channel == QRNG_LL_CHANNEL_RAW) {
+		u64 a = splitmix64(state);
+		u64 b = splitmix64(state);
+		/** four words with the sample in the upper half */
+		a = (a & 0xffff0000ffff0000ull);
+		b = (b & 0xffff0000ffff0000ull);
+		memcpy(out, &a, 8);
+		memcpy(out + 8, &b, 8);
+	}
+	else if (p->frames) {
+		u64 head = QRNG_FRAME_MARKER | ((u64)p->ent << 32) | ((u64)p->cert << 48);
+		u64 data = splitmix64(state);
+		memcpy(out, &head, 8);
+		memcpy(out + QRNG_FRAME_DATA_OFFSET, &data, 8);
+	}
+	else {
+		u64 a = splitmix64(state);
+		u64 b = splitmix64(state);
+		memcpy(out, &a, 8);
+		memcpy(out + 8, &b, 8);
+	}
+}
+
+static int prng_get(void* dev, u8* buf, size_t size, size_t* read_len, int channel)
+{
+	Prng_dev* p = (Prng_dev*)dev;
+
+	if (channel != QRNG_LL_CHANNEL_HASHED && channel != QRNG_LL_CHANNEL_RAW) {
+		if (read_len) *read_len = 0;
+		return QRNG_ERROR_READING_DEVICE;
+	}
+
+	size_t i = 0;
+	for (; i + 16 <= size; i += 16) prng_block(p, channel, buf + i);
+	if (i < size) {
+		u8 last[16];
+		prng_block(p, channel, last);
+		memcpy(buf + i, last, size - i);
+	}
+
+	if (read_len) *read_len = size;
+	return QRNG_SUCCESS;
+}
+
+static void prng_deinit(void* dev)
+{
+	delete (Prng_dev*)dev;
+}
+
+void ext_backends_install()
+{
+	const Qrng_ll_table file = { file_init, file_get, file_deinit };
+	const Qrng_ll_table fifo = { fifo_init, file_get, file_deinit };
+	const Qrng_ll_table prng = { prng_init, prng_get, prng_deinit };
+	Qrng_ll_table multi;
+	Qrng_ll_table shm;
+	Qrng_ll_table tcp;
+	Qrng_ll_table local;
+	ext_multi_table(&multi);
+	ext_shm_table(&shm);
+	ext_net_tables(&tcp, &local);
+
+	backend_add("file", &file);
+	backend_add("fifo", &fifo);
+	backend_add("prng", &prng);
+	backend_add("multi", &multi);
+	backend_add("shm", &shm);
+	backend_add("tcp", &tcp);
+	backend_add("unix", &local);
+}
@@ -0,0 +1,188 @@
+/**
+* @file 	qrng_buffer.cpp
+* @brief 	Hugepage buffers and registration of the caller's buffers
+*
+* The reads of the extensions go straight to the caller's buffer (see
+* qrng_frame.cpp), what is left is the cost of the page faults of a
+* fresh buffer during the transfers. The buffers allocated here are
+* backed by 2 MB pages and faulted in at allocation, the registered
+* buffers are faulted in and locked once instead of at every read.
+*
+* @date		17/10/2026
+*
+* Copyright(c) Quantum Dice. All rights reserved.
+*/
+
+#include <algorithm>
+#include <cstdlib>
+#include <mutex>
+#include <unordered_map>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "qrng_ext_internal.h"
+
+#define HUGE_PAGE_SIZE	MB(2)
+
+static std::mutex alloc_mutex;
+static std::unordered_map<void*, size_t> alloc_sizes;	/**< mapped size per buffer */
+
+/**
+* mlock() doesn't nest, the first munlock() of a page unlocks it, so the
+* registered buffers sharing a page (of any handle) count their locks
+*/
+static std::mutex lock_mutex;
+static std::unordered_map<uintptr_t, size_t> lock_counts;	/**< locks per page */
+
+void* qrng_alloc_buffer(size_t size)
+{
+	if (size == 0) return nullptr;
+
+#ifdef __linux__
+	size_t len = (size + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+	if (len < size) return nullptr;
+
+	/** reserved hugepages first, then transparent ones */
+	void* p = mmap(nullptr, len, PROT_READ | PROT_WRITE,
+				MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_POPULATE, -1, 0);
+	if (p == MAP_FAILED) {
+		p = mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (p == MAP_FAILED) return nullptr;
+		madvise(p, len, MADV_HUGEPAGE);
+		memset(p, 0, len);
+	}
+
+	std::lock_guard<std::mutex> lock(alloc_mutex);
+	alloc_sizes[p] = len;
+	return p;
+#else
+	return malloc(size);
+#endif
+}
+
+void qrng_free_buffer(void* data)
+{
+	if (!data) return;
+
+#ifdef __linux__
+	size_t len = 0;
+	{
+		std::lock_guard<std::mutex> lock(alloc_mutex);
+		auto it = alloc_sizes.find(data);
+		if (it == alloc_sizes.end()) return;
+		len = it->second;
+		alloc_sizes.erase(it);
+	}
+	munmap(data, len);
+#else
+	free(data);
+#endif
+}
+
+/** Fault in the pages of a buffer, writing them back unchanged */
+static void buffer_prefault(u8* data, size_t size)
+{
+#ifdef __linux__
+	size_t page = (size_t)sysconf(_SC_PAGESIZE);
+#ifdef MADV_POPULATE_WRITE
+	uintptr_t start = (uintptr_t)data / page * page;
+	if (!madvise((void*)start, (uintptr_t)data + size - start, MADV_POPULATE_WRITE)) return;
+#endif
+#else
+	size_t page = KB(4);
+#endif
+	for (size_t i = 0; i < size; i += page) {
+		volatile u8* p = data + i;
+		*p = *p;
+	}
+}
+
+#ifdef __linux__
+static bool buffer_lock(void* data, size_t size)
+{
+	uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+	uintptr_t start = (uintptr_t)data / page * page;
+	uintptr_t end = ((uintptr_t)data + size + page - 1) / page * page;
+
+	std::lock_guard<std::mutex> lock(lock_mutex);
+	if (mlock(data, size)) return false;
+	for (uintptr_t p = start; p < end; p += page) lock_counts[p]++;
+	return true;
+}
+
+/** Unlock the pages of the buffer that no other registered buffer locks */
+static void buffer_unlock(void* data, size_t size)
+{
+	uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+	uintptr_t start = (uintptr_t)data / page * page;
+	uintptr_t end = ((uintptr_t)data + size + page - 1) / page * page;
+
+	std::lock_guard<std::mutex> lock(lock_mutex);
+	uintptr_t run = end;	/** start of the pages to unlock, end if none */
+	for (uintptr_t p = start; p < end; p += page) {
+		auto it = lock_counts.find(p);
+		bool last = (it == lock_counts.end() || --it->second == 0);
+		if (last && it != lock_counts.end()) lock_counts.erase(it);
+
+		if (last && run == end) run = p;
+		if (!last && run != end) {
+			munlock((void*)run, p - run);
+			run = end;
+		}
+	}
+	if (run != end) munlock((void*)run, end - run);
+}
+#endif
+
+int qrng_register_buffer(QRNG* qrng, void* data, size_t size)
+{
+	if (!data) return QRNG_ERROR_NULL_PTR;
+	if (size == 0) return QRNG_ERROR_INVALID_PARAM;
+
+	Qrng_ext_ctx* ctx = ext_ctx(qrng);
+	if (!ctx) return QRNG_ERROR_NOT_EXT_HANDLE;
+
+	Qrng_buffer_t buf = { data, size, false };
+#ifdef __linux__
+	/** mlock faults the pages in, within RLIMIT_MEMLOCK */
+	buf.locked = buffer_lock(data, size);
+#endif
+	if (!buf.locked) buffer_prefault((u8*)data, size);
+
+	std::lock_guard<std::mutex> lock(ctx->buffer_mutex);
+	ctx->buffers.push_back(buf);
+	return QRNG_SUCCESS;
+}
+
+static void buffer_release(const Qrng_buffer_t& buf)
+{
+#ifdef __linux__
+	if (buf.locked) buffer_unlock(buf.data, buf.size);
+#endif
+}
+
+int qrng_unregister_buffer(QRNG* qrng, void* data)
+{
+	Qrng_ext_ctx* ctx = ext_ctx(qrng);
+	if (!ctx) return QRNG_ERROR_NOT_EXT_HANDLE;
+
+	std::lock_guard<std::mutex> lock(ctx->buffer_mutex);
+	auto& v = ctx->buffers;
+	auto it = std::find_if(v.begin(), v.end(),
+			[&](const Qrng_buffer_t& b) { return b.data == data; });
+	if (it == v.end()) return QRNG_ERROR_INVALID_PARAM;
+
+	buffer_release(*it);
+	v.erase(it);
+	return QRNG_SUCCESS;
+}
+
+void ext_buffers_release(Qrng_ext_ctx* ctx)
+{
+	std::lock_guard<std::mutex> lock(ctx->buffer_mutex);
+	for (const Qrng_buffer_t& buf : ctx->buffers) buffer_release(buf);
+	ctx->buffers.clear();
+}
@@ -0,0 +1,288 @@
+/**
+* @file 	qrng_cert.cpp
+* @brief 	Certified stream: hashed data filtered on the frame headers
+*
+* The frames of the staging buffer are filtered straight into the
+* caller's buffer, keeping the 8 data bytes of the frames whose entropy
+* bits and certification value reach the thresholds. The plain blocks,
+* without header, carry no certification and are dropped.
+*
+* The filter is a compaction pass: AVX-512 compress stores, or AVX2
+* permutations from a table indexed by the 4 frames mask.
+*
+* @date		17/10/2026
+*
+* Copyright(c) Quantum Dice. All rights reserved.
+*/
+
+#include <algorithm>
+
+#include "qrng_ext_internal.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#	include <immintrin.h>
+#	define QRNG_X86_KERNELS
+#endif
+
+/** Transfers in a row without a certified block before giving up */
+#define CERT_MAX_EMPTY_TRANSFERS	16
+
+/** Size of the qrng_get_with_ec() calls for the other handles */
+#define CERT_FALLBACK_BLOCKS		512
+#define CERT_MAX_EMPTY_BLOCKS		(CERT_MAX_EMPTY_TRANSFERS * QRNG_DMA_CHUNK_SIZE / QRNG_FRAME_SIZE)
+
+typedef struct {
+	u64 min_ent;
+	u64 min_cert;	/**< certification value x 255 */
+}Cert_filter;
+
+/**
+* Filter 'count' frames into 'out', which has room for 'count' blocks
+*
+* @return	blocks kept, 'plain' returns the frames without header
+*/
+typedef size_t (*Cert_filter_fn)(const u8* frames, size_t count, const Cert_filter* f,
+							u8* out, size_t* plain);
+
+static inline bool frame_certified(u64 head, const Cert_filter* f, size_t* plain)
+{
+	if ((uint32_t)head != QRNG_FRAME_MARKER) {
+		(*plain)++;
+		return false;
+	}
+	return ((head >> 32) & 0xffff) >= f->min_ent && (head >> 48) >= f->min_cert;
+}
+
+static size_t cert_filter_scalar(const u8* frames, size_t count, const Cert_filter* f,
+							u8* out, size_t* plain)
+{
+	size_t kept = 0;
+
+	for (size_t i = 0; i < count; i++, frames += QRNG_FRAME_SIZE) {
+		u64 head;
+		memcpy(&head, frames, sizeof(head));
+		if (frame_certified(head, f, plain)) {
+			memcpy(out + kept * 8, frames + QRNG_FRAME_DATA_OFFSET, 8);
+			kept++;
+		}
+	}
+	return kept;
+}
+
+#ifdef QRNG_X86_KERNELS
+
+/** 32 bits lane indexes moving the data words of a 4 frames mask to the front */
+typedef struct {
+	uint32_t idx[16][8];
+}Cert_lut;
+
+static Cert_lut cert_lut_build()
+{
+	Cert_lut lut = {};
+	for (int m = 0; m < 16; m++) {
+		int n = 0;
+		for (int j = 0; j < 4; j++) {
+			if (!(m & (1 << j))) continue;
+			lut.idx[m][2 * n] = 2 * j;
+			lut.idx[m][2 * n + 1] = 2 * j + 1;
+			n++;
+		}
+	}
+	return lut;
+}
+
+__attribute__((target("avx2,popcnt")))
+static size_t cert_filter_avx2(const u8* frames, size_t count, const Cert_filter* f,
+							u8* out, size_t* plain)
+{
+	static const Cert_lut lut = cert_lut_build();
+	const __m256i marker = _mm256_set1_epi64x(QRNG_FRAME_MARKER);
+	const __m256i lo32 = _mm256_set1_epi64x(0xffffffffLL);
+	const __m256i lo16 = _mm256_set1_epi64x(0xffff);
+	const __m256i min_ent = _mm256_set1_epi64x((long long)f->min_ent - 1);
+	const __m256i min_cert = _mm256_set1_epi64x((long long)f->min_cert - 1);
+	size_t kept = 0;
+	size_t i = 0;
+
+	/** a group stores 32 bytes, never more than the room of the frames read so far */
+	for (; i + 4 <= count; i += 4) {
+		const u8* p = frames + i * QRNG_FRAME_SIZE;
+		__m256i v0 = _mm256_loadu_si256((const __m256i*)p);
+		__m256i v1 = _mm256_loadu_si256((const __m256i*)(p + 32));
+		__m256i head = _mm256_permute4x64_epi64(_mm256_unpacklo_epi64(v0, v1), 0xd8);
+		__m256i data = _mm256_permute4x64_epi64(_mm256_unpackhi_epi64(v0, v1), 0xd8);
+
+		__m256i framed = _mm256_cmpeq_epi64(_mm256_and_si256(head, lo32), marker);
+		__m256i ok = _mm256_and_si256(framed, _mm256_and_si256(
+				_mm256_cmpgt_epi64(_mm256_and_si256(_mm256_srli_epi64(head, 32), lo16), min_ent),
+				_mm256_cmpgt_epi64(_mm256_srli_epi64(head, 48), min_cert)));
+
+		int m = _mm256_movemask_pd(_mm256_castsi256_pd(ok));
+		__m256i idx = _mm256_loadu_si256((const __m256i*)lut.idx[m]);
+		_mm256_storeu_si256((__m256i*)(out + kept * 8), _mm256_permutevar8x32_epi32(data, idx));
+
+		kept += __builtin_popcount(m);
+		*plain += 4 - __builtin_popcount(_mm256_movemask_pd(_mm256_castsi256_pd(framed)));
+	}
+
+	return kept + cert_filter_scalar(frames + i * QRNG_FRAME_SIZE, count - i, f,
+								out + kept * 8, plain);
+}
+
+/**
+* gcc 12 takes the _mm512_undefined_* operands of its shift intrinsics
+* for uninitialized values
+*/
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+
+__attribute__((target("avx512f,popcnt")))
+static size_t cert_filter_avx512(const u8* frames, size_t count, const Cert_filter* f,
+							u8* out, size_t* plain)
+{
+	const __m512i marker = _mm512_set1_epi64(QRNG_FRAME_MARKER);
+	const __m512i lo32 = _mm512_set1_epi64(0xffffffffLL);
+	const __m512i lo16 = _mm512_set1_epi64(0xffff);
+	const __m512i min_ent = _mm512_set1_epi64((long long)f->min_ent);
+	const __m512i min_cert = _mm512_set1_epi64((long long)f->min_cert);
+	size_t kept = 0;
+	size_t i = 0;
+
+	/** 4 frames per vector, headers in the even lanes and data in the odd ones */
+	for (; i + 4 <= count; i += 4) {
+		__m512i v = _mm512_loadu_si512(frames + i * QRNG_FRAME_SIZE);
+		__mmask8 framed = _mm512_mask_cmpeq_epi64_mask(0x55, _mm512_and_si512(v, lo32), marker);
+		__mmask8 ok = _mm512_mask_cmpge_epu64_mask(framed,
+				_mm512_and_si512(_mm512_srli_epi64(v, 32), lo16), min_ent);
+		ok = _mm512_mask_cmpge_epu64_mask(ok, _mm512_srli_epi64(v, 48), min_cert);
+
+		_mm512_mask_compressstoreu_epi64(out + kept * 8, (__mmask8)(ok << 1), v);
+		kept += __builtin_popcount(ok);
+		*plain += 4 - __builtin_popcount(framed);
+	}
+
+	return kept + cert_filter_scalar(frames + i * QRNG_FRAME_SIZE, count - i, f,
+								out + kept * 8, plain);
+}
+
+#pragma GCC diagnostic pop
+
+#endif
+
+static Cert_filter_fn select_cert_filter()
+{
+#ifdef QRNG_X86_KERNELS
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f")) return cert_filter_avx512;
+	if (__builtin_cpu_supports("avx2")) return cert_filter_avx2;
+#endif
+	return cert_filter_scalar;
+}
+
+/** Smallest certification value x 255 seen by qrng_get_with_ec() as >= min_cert */
+static u64 cert_fixed(float min_cert)
+{
+	u64 k = 0;
+	while (k <= 0xffff && (float)k / QRNG_CERT_SCALE < min_cert) k++;
+	return k;
+}
+
+/** Same filter on qrng_get_with_ec() for the handles without extension state */
+static int cert_get_core(QRNG* qrng, u8* data, size_t size, float min_cert, u16 min_ent,
+					size_t* bytes_read, u64* dropped)
+{
+	u8 buf[CERT_FALLBACK_BLOCKS * 8];
+	u16 ent[CERT_FALLBACK_BLOCKS];
+	float cert[CERT_FALLBACK_BLOCKS];
+	size_t done = 0;
+	size_t empty = 0;
+	int ret = QRNG_SUCCESS;
+
+	while (done < size) {
+		size_t n = std::min((size - done) / 8, (size_t)CERT_FALLBACK_BLOCKS);
+		ret = qrng_get_with_ec(qrng, buf, (s32)(n * 8), ent, (s32)n, cert, (s32)n);
+		if (ret != QRNG_SUCCESS) break;
+
+		size_t kept = 0;
+		for (size_t i = 0; i < n; i++) {
+			if (ent[i] < min_ent || cert[i] < min_cert) continue;
+			memcpy(data + done + kept * 8, buf + i * 8, 8);
+			kept++;
+		}
+		done += kept * 8;
+		*dropped += n - kept;
+
+		empty = kept ? 0 : empty + n;
+		if (empty >= CERT_MAX_EMPTY_BLOCKS) {
+			ret = QRNG_ERROR_INSUFFICIENT_ENTHROPY;
+			break;
+		}
+	}
+
+	*bytes_read = done;
+	return ret;
+}
+
+int qrng_get_certified(QRNG* qrng, u8* data, size_t size, float min_cert, u16 min_ent,
+					size_t* bytes_read, uint64_t* dropped)
+{
+	static const Cert_filter_fn filter = select_cert_filter();
+
+	if (bytes_read) *bytes_read = 0;
+	if (dropped) *dropped = 0;
+	if (!data) return QRNG_ERROR_NULL_PTR;
+	if (size % 8) return QRNG_ERROR_MULTIPLE_OF_8_REQUIRED;
+	if (!(min_cert >= 0.0f && min_cert <= 1.0f) || min_ent > 64) return QRNG_ERROR_INVALID_PARAM;
+
+	size_t done = 0;
+	u64 drop = 0;
+	int ret = QRNG_SUCCESS;
+
+	Qrng_shard_t* shard = ext_shard(qrng);
+	if (!shard) {
+		ret = cert_get_core(qrng, data, size, min_cert, min_ent, &done, &drop);
+		if (bytes_read) *bytes_read = done;
+		if (dropped) *dropped = drop;
+		return ret;
+	}
+
+	Cert_filter f = { min_ent, cert_fixed(min_cert) };
+	Qrng_pool_t* stage = &shard->stage;
+	u64 t0 = ext_stats_begin(shard, size);
+	int empty = 0;
+
+	while (done < size) {
+		if (stage->pos >= stage->len) {
+			if (empty == CERT_MAX_EMPTY_TRANSFERS) {
+				ret = QRNG_ERROR_INSUFFICIENT_ENTHROPY;
+				break;
+			}
+			ret = ext_stage_refill(shard, stage, QRNG_LL_CHANNEL_HASHED);
+			if (ret != QRNG_SUCCESS) break;
+			empty++;
+		}
+
+		/** the rest of a frame partly read by qrng_get() is skipped */
+		size_t off = stage->pos % QRNG_FRAME_SIZE;
+		size_t count = (off == 0) ? std::min((stage->len - stage->pos) / QRNG_FRAME_SIZE,
+									(size - done) / 8) : 0;
+		if (count == 0) {
+			stage->pos = std::min(stage->pos + QRNG_FRAME_SIZE - off, stage->len);
+			continue;
+		}
+
+		size_t plain = 0;
+		size_t kept = filter(stage->data + stage->pos, count, &f, data + done, &plain);
+		stage->pos += count * QRNG_FRAME_SIZE;
+		done += kept * 8;
+		/** a plain block counts as the two 8 bytes blocks of qrng_get_with_ec() */
+		drop += count - kept + plain;
+		if (kept) empty = 0;
+	}
+
+	if (bytes_read) *bytes_read = done;
+	if (dropped) *dropped = drop;
+	shard->status = ret;
+	ext_stats_call(shard, QRNG_STATS_FN_CERTIFIED, t0, done, ret);
+	return ret;
+}
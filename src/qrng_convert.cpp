@@ -0,0 +1,235 @@
+/**
+* @file 	qrng_convert.cpp
+* @brief 	Bulk typed output: integers, doubles and floats
+*
+* The random bytes are read straight into the caller's array and
+* converted in place. Doubles take the top 53 bits of a 64 bits word
+* and floats the top 24 bits of a 32 bits word, every kernel below
+* returns exactly the same values as the scalar one, the fastest kernel
+* supported by the CPU is selected on the first call.
+*
+* @date		17/10/2026
+*
+* Copyright(c) Quantum Dice. All rights reserved.
+*/
+
+#include "qrng_ext_internal.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#	include <immintrin.h>
+#	define QRNG_X86_KERNELS
+#endif
+
+typedef void (*To_double_fn)(u64* data, size_t count);
+typedef void (*To_float_fn)(uint32_t* data, size_t count);
+
+static void u64_to_double_scalar(u64* data, size_t count)
+{
+	for (size_t i = 0; i < count; i++) {
+		double d = (double)(data[i] >> 11) * 0x1.0p-53;
+		memcpy(&data[i], &d, sizeof(d));
+	}
+}
+
+static void u32_to_float_scalar(uint32_t* data, size_t count)
+{
+	for (size_t i = 0; i < count; i++) {
+		float f = (float)(data[i] >> 8) * 0x1.0p-24f;
+		memcpy(&data[i], &f, sizeof(f));
+	}
+}
+
+#ifdef QRNG_X86_KERNELS
+
+/**
+* 53 bits integer to double without AVX-512: both 32 bits halves are
+* converted exactly with the 2^52 exponent trick and recombined.
+*/
+static void u64_to_double_sse2(u64* data, size_t count)
+{
+	const __m128i magic_i = _mm_set1_epi64x(0x4330000000000000LL);
+	const __m128d magic_d = _mm_set1_pd(0x1.0p52);
+	const __m128i lo_mask = _mm_set1_epi64x(0xffffffffLL);
+	size_t i = 0;
+
+	for (; i + 2 <= count; i += 2) {
+		__m128i v = _mm_srli_epi64(_mm_loadu_si128((__m128i*)(data + i)), 11);
+		__m128d hi = _mm_sub_pd(_mm_castsi128_pd(
+				_mm_or_si128(_mm_srli_epi64(v, 32), magic_i)), magic_d);
+		__m128d lo = _mm_sub_pd(_mm_castsi128_pd(
+				_mm_or_si128(_mm_and_si128(v, lo_mask), magic_i)), magic_d);
+		__m128d d = _mm_add_pd(_mm_mul_pd(hi, _mm_set1_pd(0x1.0p32)), lo);
+		_mm_storeu_pd((double*)(data + i), _mm_mul_pd(d, _mm_set1_pd(0x1.0p-53)));
+	}
+	u64_to_double_scalar(data + i, count - i);
+}
+
+__attribute__((target("avx2")))
+static void u64_to_double_avx2(u64* data, size_t count)
+{
+	const __m256i magic_i = _mm256_set1_epi64x(0x4330000000000000LL);
+	const __m256d magic_d = _mm256_set1_pd(0x1.0p52);
+	const __m256i lo_mask = _mm256_set1_epi64x(0xffffffffLL);
+	size_t i = 0;
+
+	for (; i + 4 <= count; i += 4) {
+		__m256i v = _mm256_srli_epi64(_mm256_loadu_si256((__m256i*)(data + i)), 11);
+		__m256d hi = _mm256_sub_pd(_mm256_castsi256_pd(
+				_mm256_or_si256(_mm256_srli_epi64(v, 32), magic_i)), magic_d);
+		__m256d lo = _mm256_sub_pd(_mm256_castsi256_pd(
+				_mm256_or_si256(_mm256_and_si256(v, lo_mask), magic_i)), magic_d);
+		__m256d d = _mm256_add_pd(_mm256_mul_pd(hi, _mm256_set1_pd(0x1.0p32)), lo);
+		_mm256_storeu_pd((double*)(data + i),
+				_mm256_mul_pd(d, _mm256_set1_pd(0x1.0p-53)));
+	}
+	u64_to_double_scalar(data + i, count - i);
+}
+
+/**
+* The shifts and conversions of the gcc 12 AVX-512 headers start from
+* _mm512_undefined_*, which -Wmaybe-uninitialized reports
+*/
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+
+__attribute__((target("avx512f,avx512dq")))
+static void u64_to_double_avx512(u64* data, size_t count)
+{
+	size_t i = 0;
+
+	for (; i + 8 <= count; i += 8) {
+		__m512i v = _mm512_srli_epi64(_mm512_loadu_si512(data + i), 11);
+		__m512d d = _mm512_cvtepu64_pd(v);
+		_mm512_storeu_pd((double*)(data + i),
+				_mm512_mul_pd(d, _mm512_set1_pd(0x1.0p-53)));
+	}
+	u64_to_double_scalar(data + i, count - i);
+}
+
+#pragma GCC diagnostic pop
+
+static void u32_to_float_sse2(uint32_t* data, size_t count)
+{
+	size_t i = 0;
+
+	for (; i + 4 <= count; i += 4) {
+		__m128i v = _mm_srli_epi32(_mm_loadu_si128((__m128i*)(data + i)), 8);
+		_mm_storeu_ps((float*)(data + i),
+				_mm_mul_ps(_mm_cvtepi32_ps(v), _mm_set1_ps(0x1.0p-24f)));
+	}
+	u32_to_float_scalar(data + i, count - i);
+}
+
+__attribute__((target("avx2")))
+static void u32_to_float_avx2(uint32_t* data, size_t count)
+{
+	size_t i = 0;
+
+	for (; i + 8 <= count; i += 8) {
+		__m256i v = _mm256_srli_epi32(_mm256_loadu_si256((__m256i*)(data + i)), 8);
+		_mm256_storeu_ps((float*)(data + i),
+				_mm256_mul_ps(_mm256_cvtepi32_ps(v), _mm256_set1_ps(0x1.0p-24f)));
+	}
+	u32_to_float_scalar(data + i, count - i);
+}
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+
+__attribute__((target("avx512f")))
+static void u32_to_float_avx512(uint32_t* data, size_t count)
+{
+	size_t i = 0;
+
+	for (; i + 16 <= count; i += 16) {
+		__m512i v = _mm512_srli_epi32(_mm512_loadu_si512(data + i), 8);
+		_mm512_storeu_ps((float*)(data + i),
+				_mm512_mul_ps(_mm512_cvtepi32_ps(v), _mm512_set1_ps(0x1.0p-24f)));
+	}
+	u32_to_float_scalar(data + i, count - i);
+}
+
+#pragma GCC diagnostic pop
+
+#endif
+
+static To_double_fn select_to_double()
+{
+#ifdef QRNG_X86_KERNELS
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512dq"))
+		return u64_to_double_avx512;
+	if (__builtin_cpu_supports("avx2")) return u64_to_double_avx2;
+	return u64_to_double_sse2;
+#else
+	return u64_to_double_scalar;
+#endif
+}
+
+static To_float_fn select_to_float()
+{
+#ifdef QRNG_X86_KERNELS
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f")) return u32_to_float_avx512;
+	if (__builtin_cpu_supports("avx2")) return u32_to_float_avx2;
+	return u32_to_float_sse2;
+#else
+	return u32_to_float_scalar;
+#endif
+}
+
+void ext_u64_to_double(u64* data, size_t count)
+{
+	static const To_double_fn fn = select_to_double();
+	fn(data, count);
+}
+
+void ext_u32_to_float(uint32_t* data, size_t count)
+{
+	static const To_float_fn fn = select_to_float();
+	fn(data, count);
+}
+
+/** Fill 'count' elements of 'size' bytes, only whole elements are reported */
+static int get_elements(QRNG* qrng, void* data, size_t count, size_t size,
+						size_t* count_read)
+{
+	if (!data) return QRNG_ERROR_NULL_PTR;
+	if (count > SIZE_MAX / size) return QRNG_ERROR_INVALID_PARAM;
+
+	Qrng_shard_t* shard = ext_shard(qrng);
+	u64 t0 = ext_stats_begin(shard, count * size);
+	size_t bytes_read = 0;
+	int ret = ext_get(qrng, (u8*)data, count * size, &bytes_read);
+	ext_stats_call(shard, QRNG_STATS_FN_CONVERT, t0, bytes_read - bytes_read % size, ret);
+	if (count_read) *count_read = bytes_read / size;
+	return ret;
+}
+
+int qrng_get_u32(QRNG* qrng, uint32_t* data, size_t count, size_t* count_read)
+{
+	return get_elements(qrng, data, count, sizeof(*data), count_read);
+}
+
+int qrng_get_u64(QRNG* qrng, uint64_t* data, size_t count, size_t* count_read)
+{
+	return get_elements(qrng, data, count, sizeof(*data), count_read);
+}
+
+int qrng_get_doubles(QRNG* qrng, double* data, size_t count, size_t* count_read)
+{
+	size_t n = 0;
+	int ret = get_elements(qrng, data, count, sizeof(*data), &n);
+	if (n) ext_u64_to_double((u64*)data, n);
+	if (count_read) *count_read = n;
+	return ret;
+}
+
+int qrng_get_floats(QRNG* qrng, float* data, size_t count, size_t* count_read)
+{
+	size_t n = 0;
+	int ret = get_elements(qrng, data, count, sizeof(*data), &n);
+	if (n) ext_u32_to_float((uint32_t*)data, n);
+	if (count_read) *count_read = n;
+	return ret;
+}
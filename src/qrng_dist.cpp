@@ -0,0 +1,660 @@
+/**
+* @file 	qrng_dist.cpp
+* @brief 	Non-uniform distributions: normal, exponential, Poisson, discrete
+*
+* Every sample starts from one 64 bits word of the bulk stream, the
+* words are read straight into the caller's array and transformed in
+* place.
+*
+* Normal and exponential numbers use a 256 layers ziggurat: 8 bits of
+* the word select the layer and 52 bits the abscissa, the sample is
+* accepted with a table lookup and a multiplication about 99% of the
+* time. The rare rejections take extra words from the entropy pool.
+*
+* Discrete distributions, and Poisson ones with a small mean, use an
+* alias table: a single multiplication of the word by the table size
+* gives both the bucket and the fraction compared to its threshold,
+* there are no rejections. Large means use the PTRS transformed
+* rejection (Hormann, 1993), fed from the entropy pool.
+*
+* Every kernel returns exactly the same values as the scalar one, the
+* fastest kernel supported by the CPU is selected on the first call.
+*
+* @date		17/10/2026
+*
+* Copyright(c) Quantum Dice. All rights reserved.
+*/
+
+#include <cmath>
+#include <cstdlib>
+
+#include "qrng_ext_internal.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#	include <immintrin.h>
+#	define QRNG_X86_KERNELS
+#endif
+
+#define ZIG_LAYERS			256
+#define ZIG_ABS_BITS		52
+#define ZIG_ABS_MASK		(((u64)1 << ZIG_ABS_BITS) - 1)
+#define ZIG_CHUNK			4096	/** words per pass of the fast path */
+
+/** Largest mean sampled with an alias table, PTRS above */
+#define POISSON_ALIAS_MAX	64.0
+#define POISSON_LAMBDA_MAX	1e18
+
+typedef enum {
+	ZIG_NORMAL,
+	ZIG_EXPONENTIAL,
+}Zig_kind;
+
+typedef struct {
+	u64 k[ZIG_LAYERS];		/**< fast acceptance bound of the abscissa */
+	double w[ZIG_LAYERS];	/**< layer width / 2^52 */
+	double f[ZIG_LAYERS];	/**< density at the layer width */
+	double r;				/**< start of the tail */
+	int shift;				/**< position of the abscissa in the word */
+	u64 sign_mask;			/**< word bit 8 is the sign of normal numbers */
+	Zig_kind kind;
+}Zig_table;
+
+typedef struct {
+	size_t size;
+	u64* thr;		/**< the bucket is kept when the fraction is below */
+	u64* alias;
+	void* mem;
+}Alias_table;
+
+typedef void (*Zig_fn)(const Zig_table* t, u64* data, size_t count, u8* rej);
+typedef void (*Alias_fn)(const Alias_table* t, u64* data, size_t count);
+
+/**
+* Build the layers of the ziggurat (Marsaglia & Tsang, 2000) for a
+* density 'f' with tail start 'r' and layer area 'v'
+*/
+static void zig_build(Zig_table* t, Zig_kind kind, double r, double v)
+{
+	const double m = (double)((u64)1 << ZIG_ABS_BITS);
+	auto f = [kind](double x) { return (kind == ZIG_NORMAL) ? exp(-0.5 * x * x) : exp(-x); };
+	auto f_inv = [kind](double y) { return (kind == ZIG_NORMAL) ? sqrt(-2.0 * log(y)) : -log(y); };
+
+	double x = r, prev = r;
+	double q = v / f(r);
+
+	t->k[0] = (u64)((r / q) * m);
+	t->k[1] = 0;
+	t->w[0] = q / m;
+	t->w[ZIG_LAYERS - 1] = r / m;
+	t->f[0] = 1.0;
+	t->f[ZIG_LAYERS - 1] = f(r);
+
+	for (int i = ZIG_LAYERS - 2; i >= 1; i--) {
+		x = f_inv(v / x + f(x));
+		t->k[i + 1] = (u64)((x / prev) * m);
+		prev = x;
+		t->f[i] = f(x);
+		t->w[i] = x / m;
+	}
+
+	t->r = r;
+	t->kind = kind;
+	t->shift = (kind == ZIG_NORMAL) ? 9 : 8;
+	t->sign_mask = (kind == ZIG_NORMAL) ? (u64)1 << 63 : 0;
+}
+
+static const Zig_table* zig_normal()
+{
+	static const Zig_table* t = [] {
+		static Zig_table tab;
+		zig_build(&tab, ZIG_NORMAL, 3.6541528853610088, 4.92867323399e-3);
+		return &tab;
+	}();
+	return t;
+}
+
+static const Zig_table* zig_exponential()
+{
+	static const Zig_table* t = [] {
+		static Zig_table tab;
+		zig_build(&tab, ZIG_EXPONENTIAL, 7.69711747013104972, 3.949659822581572e-3);
+		return &tab;
+	}();
+	return t;
+}
+
+/**
+* Accept the words that fall inside their layer, the rejected ones are
+* left untouched and flagged in the 'rej' bitmap
+*/
+static void zig_fast_scalar_from(const Zig_table* t, u64* data, size_t i,
+								size_t count, u8* rej)
+{
+	for (; i < count; i++) {
+		u64 r = data[i];
+		int idx = r & 0xff;
+		u64 rabs = (r >> t->shift) & ZIG_ABS_MASK;
+
+		if (rabs < t->k[idx]) {
+			double x = (double)rabs * t->w[idx];
+			u64 bits;
+			memcpy(&bits, &x, sizeof(bits));
+			data[i] = bits ^ ((r << 55) & t->sign_mask);
+		}
+		else {
+			rej[i / 8] |= (u8)(1 << (i % 8));
+		}
+	}
+}
+
+static void zig_fast_scalar(const Zig_table* t, u64* data, size_t count, u8* rej)
+{
+	zig_fast_scalar_from(t, data, 0, count, rej);
+}
+
+static void alias_fast_scalar_from(const Alias_table* t, u64* data, size_t i,
+								size_t count)
+{
+	for (; i < count; i++) {
+		unsigned __int128 m = (unsigned __int128)data[i] * t->size;
+		u64 bucket = (u64)(m >> 64);
+		data[i] = ((u64)m < t->thr[bucket]) ? bucket : t->alias[bucket];
+	}
+}
+
+static void alias_fast_scalar(const Alias_table* t, u64* data, size_t count)
+{
+	alias_fast_scalar_from(t, data, 0, count);
+}
+
+#ifdef QRNG_X86_KERNELS
+
+__attribute__((target("avx2")))
+static void zig_fast_avx2(const Zig_table* t, u64* data, size_t count, u8* rej)
+{
+	const __m256i idx_mask = _mm256_set1_epi64x(0xff);
+	const __m256i abs_mask = _mm256_set1_epi64x(ZIG_ABS_MASK);
+	const __m256i sign_mask = _mm256_set1_epi64x(t->sign_mask);
+	const __m256i magic_i = _mm256_set1_epi64x(0x4330000000000000LL);
+	const __m256d magic_d = _mm256_set1_pd(0x1.0p52);
+	const __m128i shift = _mm_cvtsi32_si128(t->shift);
+	size_t i = 0;
+
+	for (; i + 4 <= count; i += 4) {
+		__m256i r = _mm256_loadu_si256((__m256i*)(data + i));
+		__m256i idx = _mm256_and_si256(r, idx_mask);
+		__m256i rabs = _mm256_and_si256(_mm256_srl_epi64(r, shift), abs_mask);
+		__m256i k = _mm256_i64gather_epi64((const long long*)t->k, idx, 8);
+		__m256d w = _mm256_i64gather_pd(t->w, idx, 8);
+
+		/** both sides are below 2^63, the signed compare is exact */
+		__m256i acc = _mm256_cmpgt_epi64(k, rabs);
+		__m256d xd = _mm256_sub_pd(_mm256_castsi256_pd(
+				_mm256_or_si256(rabs, magic_i)), magic_d);
+		__m256i x = _mm256_xor_si256(_mm256_castpd_si256(_mm256_mul_pd(xd, w)),
+				_mm256_and_si256(_mm256_slli_epi64(r, 55), sign_mask));
+
+		_mm256_storeu_si256((__m256i*)(data + i), _mm256_blendv_epi8(r, x, acc));
+		int m = ~_mm256_movemask_pd(_mm256_castsi256_pd(acc)) & 0xf;
+		rej[i / 8] |= (u8)(m << (i % 8));
+	}
+	zig_fast_scalar_from(t, data, i, count, rej);
+}
+
+/**
+* gcc 12 reports the _mm512_undefined_* sources of its gathers and
+* shifts as uninitialized
+*/
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+
+__attribute__((target("avx512f,avx512dq")))
+static void zig_fast_avx512(const Zig_table* t, u64* data, size_t count, u8* rej)
+{
+	const __m512i idx_mask = _mm512_set1_epi64(0xff);
+	const __m512i abs_mask = _mm512_set1_epi64(ZIG_ABS_MASK);
+	const __m512i sign_mask = _mm512_set1_epi64(t->sign_mask);
+	const __m128i shift = _mm_cvtsi32_si128(t->shift);
+	size_t i = 0;
+
+	for (; i + 8 <= count; i += 8) {
+		__m512i r = _mm512_loadu_si512(data + i);
+		__m512i idx = _mm512_and_si512(r, idx_mask);
+		__m512i rabs = _mm512_and_si512(_mm512_srl_epi64(r, shift), abs_mask);
+		__m512i k = _mm512_i64gather_epi64(idx, t->k, 8);
+		__m512d w = _mm512_i64gather_pd(idx, t->w, 8);
+
+		__mmask8 acc = _mm512_cmplt_epu64_mask(rabs, k);
+		__m512i x = _mm512_castpd_si512(_mm512_mul_pd(_mm512_cvtepu64_pd(rabs), w));
+		x = _mm512_xor_si512(x, _mm512_and_si512(_mm512_slli_epi64(r, 55), sign_mask));
+
+		_mm512_mask_storeu_epi64(data + i, acc, x);
+		rej[i / 8] = (u8)~acc;
+	}
+	zig_fast_scalar_from(t, data, i, count, rej);
+}
+
+#pragma GCC diagnostic pop
+
+/**
+* 64 x 32 bits multiplication for the alias lookup: 'hi' receives the
+* bucket (top 64 bits of the product) and 'lo' the fraction
+*/
+__attribute__((target("avx2")))
+static inline void mul_u64_u32_avx2(__m256i x, __m256i n, __m256i* hi, __m256i* lo)
+{
+	const __m256i lo_mask = _mm256_set1_epi64x(0xffffffffLL);
+	__m256i a = _mm256_mul_epu32(x, n);
+	__m256i b = _mm256_mul_epu32(_mm256_srli_epi64(x, 32), n);
+	__m256i s = _mm256_add_epi64(b, _mm256_srli_epi64(a, 32));
+
+	*hi = _mm256_srli_epi64(s, 32);
+	*lo = _mm256_or_si256(_mm256_slli_epi64(s, 32), _mm256_and_si256(a, lo_mask));
+}
+
+__attribute__((target("avx2")))
+static void alias_fast_avx2(const Alias_table* t, u64* data, size_t count)
+{
+	const __m256i n = _mm256_set1_epi64x(t->size);
+	const __m256i bias = _mm256_set1_epi64x((long long)((u64)1 << 63));
+	size_t i = 0;
+
+	for (; i + 4 <= count; i += 4) {
+		__m256i bucket, frac;
+		mul_u64_u32_avx2(_mm256_loadu_si256((__m256i*)(data + i)), n, &bucket, &frac);
+		__m256i thr = _mm256_i64gather_epi64((const long long*)t->thr, bucket, 8);
+		__m256i alias = _mm256_i64gather_epi64((const long long*)t->alias, bucket, 8);
+
+		/** unsigned frac < thr */
+		__m256i keep = _mm256_cmpgt_epi64(_mm256_xor_si256(thr, bias),
+				_mm256_xor_si256(frac, bias));
+		_mm256_storeu_si256((__m256i*)(data + i), _mm256_blendv_epi8(alias, bucket, keep));
+	}
+	alias_fast_scalar_from(t, data, i, count);
+}
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+
+__attribute__((target("avx512f")))
+static void alias_fast_avx512(const Alias_table* t, u64* data, size_t count)
+{
+	const __m512i n = _mm512_set1_epi64(t->size);
+	const __m512i lo_mask = _mm512_set1_epi64(0xffffffffLL);
+	size_t i = 0;
+
+	for (; i + 8 <= count; i += 8) {
+		__m512i x = _mm512_loadu_si512(data + i);
+		__m512i a = _mm512_mul_epu32(x, n);
+		__m512i b = _mm512_mul_epu32(_mm512_srli_epi64(x, 32), n);
+		__m512i s = _mm512_add_epi64(b, _mm512_srli_epi64(a, 32));
+		__m512i bucket = _mm512_srli_epi64(s, 32);
+		__m512i frac = _mm512_or_si512(_mm512_slli_epi64(s, 32), _mm512_and_si512(a, lo_mask));
+
+		__m512i thr = _mm512_i64gather_epi64(bucket, t->thr, 8);
+		__m512i alias = _mm512_i64gather_epi64(bucket, t->alias, 8);
+		__mmask8 keep = _mm512_cmplt_epu64_mask(frac, thr);
+		_mm512_storeu_si512(data + i, _mm512_mask_blend_epi64(keep, alias, bucket));
+	}
+	alias_fast_scalar_from(t, data, i, count);
+}
+
+#pragma GCC diagnostic pop
+
+#endif
+
+static Zig_fn select_zig()
+{
+#ifdef QRNG_X86_KERNELS
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512dq"))
+		return zig_fast_avx512;
+	if (__builtin_cpu_supports("avx2")) return zig_fast_avx2;
+#endif
+	return zig_fast_scalar;
+}
+
+static Alias_fn select_alias()
+{
+#ifdef QRNG_X86_KERNELS
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f")) return alias_fast_avx512;
+	if (__builtin_cpu_supports("avx2")) return alias_fast_avx2;
+#endif
+	return alias_fast_scalar;
+}
+
+/** Uniform double in [0, 1) built from 53 bits of the source */
+static inline bool src_uniform(Qrng_src_t* src, double* u)
+{
+	u64 x;
+	if (!ext_src_take(src, (u8*)&x, sizeof(x))) return false;
+	*u = (double)(x >> 11) * 0x1.0p-53;
+	return true;
+}
+
+/**
+* Complete a draw rejected by the fast path: tail and wedge tests,
+* then new words from the source until one is accepted
+*
+* @return	false if the source failed
+*/
+static bool zig_slow(const Zig_table* t, Qrng_src_t* src, u64 r, double* out)
+{
+	for (;;) {
+		int idx = r & 0xff;
+		u64 rabs = (r >> t->shift) & ZIG_ABS_MASK;
+		double sign = ((r << 55) & t->sign_mask) ? -1.0 : 1.0;
+		double x = (double)rabs * t->w[idx];
+		double u, v;
+
+		if (rabs < t->k[idx]) {
+			*out = sign * x;
+			return true;
+		}
+
+		if (idx == 0) {
+			/** beyond the base layer */
+			if (t->kind == ZIG_EXPONENTIAL) {
+				if (!src_uniform(src, &u)) return false;
+				*out = t->r - log1p(-u);
+				return true;
+			}
+			do {
+				if (!src_uniform(src, &u) || !src_uniform(src, &v)) return false;
+				x = -log1p(-u) / t->r;
+				v = -log1p(-v);
+			} while (v + v < x * x);
+			*out = sign * (t->r + x);
+			return true;
+		}
+
+		if (!src_uniform(src, &u)) return false;
+		double fx = (t->kind == ZIG_NORMAL) ? exp(-0.5 * x * x) : exp(-x);
+		if ((t->f[idx - 1] - t->f[idx]) * u + t->f[idx] < fx) {
+			*out = sign * x;
+			return true;
+		}
+
+		if (!ext_src_take(src, (u8*)&r, sizeof(r))) return false;
+	}
+}
+
+/** Fill 'data' with standard normal or exponential numbers */
+static int zig_get(QRNG* qrng, const Zig_table* t, double* data, size_t count,
+					size_t* count_read, size_t* bytes_used)
+{
+	static const Zig_fn fast = select_zig();
+	u8 rej[ZIG_CHUNK / 8];
+	Qrng_src_t src;
+	ext_src_init(&src, qrng);
+
+	size_t bytes_read = 0;
+	int ret = ext_get(qrng, (u8*)data, count * sizeof(*data), &bytes_read);
+	size_t n = bytes_read / sizeof(*data);
+	u64* words = (u64*)data;
+
+	for (size_t i = 0; i < n; i += ZIG_CHUNK) {
+		size_t len = (n - i < ZIG_CHUNK) ? n - i : ZIG_CHUNK;
+		memset(rej, 0, sizeof(rej));
+		fast(t, words + i, len, rej);
+
+		for (size_t b = 0; b < (len + 7) / 8; b++) {
+			for (unsigned m = rej[b]; m; m &= m - 1) {
+				size_t j = i + b * 8 + __builtin_ctz(m);
+				u64 r;
+				double x;
+				memcpy(&r, words + j, sizeof(r));
+				if (!zig_slow(t, &src, r, &x)) {
+					ret = src.status;
+					n = j;
+					goto done;
+				}
+				memcpy(words + j, &x, sizeof(x));
+			}
+		}
+	}
+
+done:
+	if (count_read) *count_read = n;
+	if (bytes_used) *bytes_used = n * sizeof(*data) + src.taken;
+	return ret;
+}
+
+static inline u64 alias_threshold(double q)
+{
+	double t = q * 0x1.0p64;
+	return (t >= 0x1.0p64) ? UINT64_MAX : (u64)t;
+}
+
+/**
+* Build the alias table (Vose, 1991) of 'n' non negative weights with
+* a positive sum
+*/
+static int alias_build(Alias_table* t, const double* p, size_t n, double sum)
+{
+	t->mem = malloc(n * (sizeof(u64) * 2 + sizeof(double) + sizeof(size_t)));
+	if (!t->mem) return QRNG_ERROR_INTERNAL_MEMORY;
+
+	t->size = n;
+	t->thr = (u64*)t->mem;
+	t->alias = t->thr + n;
+	double* q = (double*)(t->alias + n);
+	size_t* stack = (size_t*)(q + n);
+	size_t n_small = 0, n_large = 0;
+
+	/** small entries grow from the start of the stack, large ones from the end */
+	for (size_t i = 0; i < n; i++) {
+		q[i] = p[i] * (double)n / sum;
+		if (q[i] < 1.0) stack[n_small++] = i;
+		else stack[n - ++n_large] = i;
+	}
+
+	while (n_small && n_large) {
+		size_t s = stack[--n_small];
+		size_t l = stack[n - n_large];
+
+		t->thr[s] = alias_threshold(q[s]);
+		t->alias[s] = l;
+		q[l] = (q[l] + q[s]) - 1.0;
+		if (q[l] < 1.0) {
+			n_large--;
+			stack[n_small++] = l;
+		}
+	}
+
+	/** left overs are full buckets, up to rounding */
+	while (n_small) {
+		size_t s = stack[--n_small];
+		t->thr[s] = UINT64_MAX;
+		t->alias[s] = s;
+	}
+	while (n_large) {
+		size_t l = stack[n - n_large--];
+		t->thr[l] = UINT64_MAX;
+		t->alias[l] = l;
+	}
+	return QRNG_SUCCESS;
+}
+
+static int alias_get(QRNG* qrng, const Alias_table* t, u64* data, size_t count,
+					size_t* count_read, size_t* bytes_used)
+{
+	static const Alias_fn fast = select_alias();
+
+	size_t bytes_read = 0;
+	int ret = ext_get(qrng, (u8*)data, count * sizeof(*data), &bytes_read);
+	size_t n = bytes_read / sizeof(*data);
+	if (n) fast(t, data, n);
+
+	if (count_read) *count_read = n;
+	if (bytes_used) *bytes_used = n * sizeof(*data);
+	return ret;
+}
+
+/** log(gamma(x)), reentrant unlike lgamma() */
+static double log_gamma(double x)
+{
+	static const double a[10] = {
+		8.333333333333333e-02, -2.777777777777778e-03,
+		7.936507936507937e-04, -5.952380952380952e-04,
+		8.417508417508418e-04, -1.917526917526918e-03,
+		6.410256410256410e-03, -2.955065359477124e-02,
+		1.796443723688307e-01, -1.39243221690590e+00,
+	};
+
+	if (x == 1.0 || x == 2.0) return 0.0;
+
+	/** shift small arguments into the range of the Stirling series */
+	int n = (x < 7.0) ? (int)(7.0 - x) : 0;
+	double x0 = x + n;
+	double x2 = 1.0 / (x0 * x0);
+	double g = a[9];
+	for (int k = 8; k >= 0; k--) g = g * x2 + a[k];
+	g = g / x0 + 0.9189385332046727 + (x0 - 0.5) * log(x0) - x0;
+
+	for (int k = 1; k <= n; k++) {
+		x0 -= 1.0;
+		g -= log(x0);
+	}
+	return g;
+}
+
+/** Poisson number with a large mean (PTRS) */
+static bool poisson_ptrs(Qrng_src_t* src, double lambda, u64* out)
+{
+	double slam = sqrt(lambda);
+	double loglam = log(lambda);
+	double b = 0.931 + 2.53 * slam;
+	double a = -0.059 + 0.02483 * b;
+	double invalpha = 1.1239 + 1.1328 / (b - 3.4);
+	double vr = 0.9277 - 3.6224 / (b - 2.0);
+
+	for (;;) {
+		double u, v;
+		if (!src_uniform(src, &u) || !src_uniform(src, &v)) return false;
+		u -= 0.5;
+		double us = 0.5 - fabs(u);
+		double k = floor((2.0 * a / us + b) * u + lambda + 0.43);
+
+		if (us >= 0.07 && v <= vr) {
+			*out = (u64)k;
+			return true;
+		}
+		if (k < 0.0 || (us < 0.013 && v > us)) continue;
+
+		if (log(v) + log(invalpha) - log(a / (us * us) + b)
+				<= -lambda + k * loglam - log_gamma(k + 1.0)) {
+			*out = (u64)k;
+			return true;
+		}
+	}
+}
+
+int qrng_get_normal(QRNG* qrng, double mean, double stddev, double* data,
+					size_t count, size_t* count_read, size_t* bytes_used)
+{
+	if (!data) return QRNG_ERROR_NULL_PTR;
+	if (count > SIZE_MAX / sizeof(*data) || !std::isfinite(mean)
+			|| !std::isfinite(stddev) || stddev < 0.0)
+		return QRNG_ERROR_INVALID_PARAM;
+
+	size_t n = 0;
+	int ret = zig_get(qrng, zig_normal(), data, count, &n, bytes_used);
+	for (size_t i = 0; i < n; i++) data[i] = mean + stddev * data[i];
+
+	if (count_read) *count_read = n;
+	return ret;
+}
+
+int qrng_get_exponential(QRNG* qrng, double lambda, double* data,
+						size_t count, size_t* count_read, size_t* bytes_used)
+{
+	if (!data) return QRNG_ERROR_NULL_PTR;
+	if (count > SIZE_MAX / sizeof(*data) || !std::isfinite(lambda) || !(lambda > 0.0))
+		return QRNG_ERROR_INVALID_PARAM;
+
+	size_t n = 0;
+	int ret = zig_get(qrng, zig_exponential(), data, count, &n, bytes_used);
+	for (size_t i = 0; i < n; i++) data[i] = data[i] / lambda;
+
+	if (count_read) *count_read = n;
+	return ret;
+}
+
+int qrng_get_poisson(QRNG* qrng, double lambda, u64* data, size_t count,
+					size_t* count_read, size_t* bytes_used)
+{
+	if (!data) return QRNG_ERROR_NULL_PTR;
+	if (count > SIZE_MAX / sizeof(*data) || !(lambda >= 0.0)
+			|| !(lambda <= POISSON_LAMBDA_MAX))
+		return QRNG_ERROR_INVALID_PARAM;
+
+	if (lambda == 0.0) {
+		memset(data, 0, count * sizeof(*data));
+		if (count_read) *count_read = count;
+		if (bytes_used) *bytes_used = 0;
+		return QRNG_SUCCESS;
+	}
+
+	if (lambda <= POISSON_ALIAS_MAX) {
+		/** the probability mass beyond 15 standard deviations is negligible */
+		size_t size = (size_t)(lambda + 15.0 * sqrt(lambda) + 15.0);
+		double* pmf = (double*)malloc(size * sizeof(double));
+		if (!pmf) return QRNG_ERROR_INTERNAL_MEMORY;
+
+		double sum = pmf[0] = exp(-lambda);
+		for (size_t k = 1; k < size; k++) {
+			pmf[k] = pmf[k - 1] * lambda / (double)k;
+			sum += pmf[k];
+		}
+
+		Alias_table t;
+		int ret = alias_build(&t, pmf, size, sum);
+		free(pmf);
+		if (ret != QRNG_SUCCESS) return ret;
+
+		ret = alias_get(qrng, &t, data, count, count_read, bytes_used);
+		free(t.mem);
+		return ret;
+	}
+
+	Qrng_src_t src;
+	ext_src_init(&src, qrng);
+
+	int ret = QRNG_SUCCESS;
+	size_t n = 0;
+	for (; n < count; n++) {
+		if (!poisson_ptrs(&src, lambda, &data[n])) {
+			ret = src.status;
+			break;
+		}
+	}
+
+	if (count_read) *count_read = n;
+	if (bytes_used) *bytes_used = src.taken;
+	return ret;
+}
+
+int qrng_get_discrete(QRNG* qrng, const double* weights, size_t n_weights,
+					u64* data, size_t count, size_t* count_read, size_t* bytes_used)
+{
+	if (!weights || !data) return QRNG_ERROR_NULL_PTR;
+	if (count > SIZE_MAX / sizeof(*data) || n_weights == 0 || n_weights > UINT32_MAX)
+		return QRNG_ERROR_INVALID_PARAM;
+
+	double sum = 0.0;
+	for (size_t i = 0; i < n_weights; i++) {
+		if (!std::isfinite(weights[i]) || weights[i] < 0.0) return QRNG_ERROR_INVALID_PARAM;
+		sum += weights[i];
+	}
+	if (!std::isfinite(sum) || !(sum > 0.0)) return QRNG_ERROR_INVALID_PARAM;
+
+	Alias_table t;
+	int ret = alias_build(&t, weights, n_weights, sum);
+	if (ret != QRNG_SUCCESS) return ret;
+
+	ret = alias_get(qrng, &t, data, count, count_read, bytes_used);
+	free(t.mem);
+	return ret;
+}
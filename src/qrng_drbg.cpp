@@ -0,0 +1,421 @@
+/**
+* @file 	qrng_drbg.cpp
+* @brief 	ChaCha20 generator seeded by the device
+*
+* Each thread reading a handle has its own instance in its shard, so
+* the generators scale with the threads without any shared state. The
+* output is the ChaCha20 keystream of a 256 bits key, the key being
+* replaced by the first keystream block after each request and every
+* QRNG_DRBG_REKEY_BYTES (fast key erasure). A reseed XORs 32 bytes of
+* hashed data of the device into the key.
+*
+* The keystream is computed 8 (AVX2) or 16 (AVX-512) blocks at a time,
+* one block per 32 bits lane, and transposed to the block order.
+*
+* @date		17/10/2026
+*
+* Copyright(c) Quantum Dice. All rights reserved.
+*/
+
+#include <algorithm>
+#include <chrono>
+
+#include "qrng_ext_internal.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#	include <immintrin.h>
+#	define QRNG_X86_KERNELS
+#endif
+
+#define CHACHA_BLOCK_SIZE	64
+
+static_assert(QRNG_DRBG_REKEY_BYTES / CHACHA_BLOCK_SIZE < ((u64)1 << 32),
+			"the block counter is 32 bits");
+
+/** Keystream blocks 'counter' to 'counter + blocks - 1' of a key, nonce 0 */
+typedef void (*Chacha_fn)(const uint32_t* key, uint32_t counter, u8* out, size_t blocks);
+
+static const uint32_t chacha_const[4] = { 0x61707865, 0x3320646e, 0x79622d32, 0x6b206574 };
+
+static inline uint32_t rotl32(uint32_t v, int n)
+{
+	return (v << n) | (v >> (32 - n));
+}
+
+#define CHACHA_QR(a, b, c, d) \
+	a += b; d = rotl32(d ^ a, 16); \
+	c += d; b = rotl32(b ^ c, 12); \
+	a += b; d = rotl32(d ^ a, 8); \
+	c += d; b = rotl32(b ^ c, 7);
+
+static void chacha_scalar(const uint32_t* key, uint32_t counter, u8* out, size_t blocks)
+{
+	for (size_t n = 0; n < blocks; n++, out += CHACHA_BLOCK_SIZE) {
+		uint32_t in[16] = { chacha_const[0], chacha_const[1], chacha_const[2], chacha_const[3],
+				key[0], key[1], key[2], key[3], key[4], key[5], key[6], key[7],
+				counter + (uint32_t)n, 0, 0, 0 };
+		uint32_t x[16];
+		memcpy(x, in, sizeof(x));
+
+		for (int i = 0; i < 10; i++) {
+			CHACHA_QR(x[0], x[4], x[8], x[12])
+			CHACHA_QR(x[1], x[5], x[9], x[13])
+			CHACHA_QR(x[2], x[6], x[10], x[14])
+			CHACHA_QR(x[3], x[7], x[11], x[15])
+			CHACHA_QR(x[0], x[5], x[10], x[15])
+			CHACHA_QR(x[1], x[6], x[11], x[12])
+			CHACHA_QR(x[2], x[7], x[8], x[13])
+			CHACHA_QR(x[3], x[4], x[9], x[14])
+		}
+
+		for (int i = 0; i < 16; i++) x[i] += in[i];
+		memcpy(out, x, sizeof(x));
+	}
+}
+
+#ifdef QRNG_X86_KERNELS
+
+__attribute__((target("avx2")))
+static inline __m256i rotl_avx2(__m256i v, int n)
+{
+	return _mm256_or_si256(_mm256_slli_epi32(v, n), _mm256_srli_epi32(v, 32 - n));
+}
+
+#define CHACHA_QR_AVX2(a, b, c, d) \
+	a = _mm256_add_epi32(a, b); d = _mm256_shuffle_epi8(_mm256_xor_si256(d, a), rot16); \
+	c = _mm256_add_epi32(c, d); b = rotl_avx2(_mm256_xor_si256(b, c), 12); \
+	a = _mm256_add_epi32(a, b); d = _mm256_shuffle_epi8(_mm256_xor_si256(d, a), rot8); \
+	c = _mm256_add_epi32(c, d); b = rotl_avx2(_mm256_xor_si256(b, c), 7);
+
+/** Write 8 words of the 8 blocks held by v[0..7], block i at out + i * 64 */
+__attribute__((target("avx2")))
+static inline void store8_avx2(const __m256i* v, u8* out)
+{
+	__m256i t0 = _mm256_unpacklo_epi32(v[0], v[1]);
+	__m256i t1 = _mm256_unpackhi_epi32(v[0], v[1]);
+	__m256i t2 = _mm256_unpacklo_epi32(v[2], v[3]);
+	__m256i t3 = _mm256_unpackhi_epi32(v[2], v[3]);
+	__m256i t4 = _mm256_unpacklo_epi32(v[4], v[5]);
+	__m256i t5 = _mm256_unpackhi_epi32(v[4], v[5]);
+	__m256i t6 = _mm256_unpacklo_epi32(v[6], v[7]);
+	__m256i t7 = _mm256_unpackhi_epi32(v[6], v[7]);
+
+	__m256i u[8] = {
+		_mm256_unpacklo_epi64(t0, t2), _mm256_unpackhi_epi64(t0, t2),
+		_mm256_unpacklo_epi64(t1, t3), _mm256_unpackhi_epi64(t1, t3),
+		_mm256_unpacklo_epi64(t4, t6), _mm256_unpackhi_epi64(t4, t6),
+		_mm256_unpacklo_epi64(t5, t7), _mm256_unpackhi_epi64(t5, t7) };
+
+	for (int i = 0; i < 4; i++) {
+		_mm256_storeu_si256((__m256i*)(out + i * CHACHA_BLOCK_SIZE),
+				_mm256_permute2x128_si256(u[i], u[i + 4], 0x20));
+		_mm256_storeu_si256((__m256i*)(out + (i + 4) * CHACHA_BLOCK_SIZE),
+				_mm256_permute2x128_si256(u[i], u[i + 4], 0x31));
+	}
+}
+
+__attribute__((target("avx2")))
+static void chacha_avx2(const uint32_t* key, uint32_t counter, u8* out, size_t blocks)
+{
+	const __m256i rot16 = _mm256_setr_epi8(2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13,
+			2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13);
+	const __m256i rot8 = _mm256_setr_epi8(3, 0, 1, 2, 7, 4, 5, 6, 11, 8, 9, 10, 15, 12, 13, 14,
+			3, 0, 1, 2, 7, 4, 5, 6, 11, 8, 9, 10, 15, 12, 13, 14);
+	__m256i in[16];
+	size_t n = 0;
+
+	for (int i = 0; i < 4; i++) in[i] = _mm256_set1_epi32((int)chacha_const[i]);
+	for (int i = 0; i < 8; i++) in[4 + i] = _mm256_set1_epi32((int)key[i]);
+	for (int i = 13; i < 16; i++) in[i] = _mm256_setzero_si256();
+
+	for (; n + 8 <= blocks; n += 8, out += 8 * CHACHA_BLOCK_SIZE) {
+		in[12] = _mm256_add_epi32(_mm256_set1_epi32((int)(counter + (uint32_t)n)),
+				_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+
+		__m256i x[16];
+		for (int i = 0; i < 16; i++) x[i] = in[i];
+
+		for (int i = 0; i < 10; i++) {
+			CHACHA_QR_AVX2(x[0], x[4], x[8], x[12])
+			CHACHA_QR_AVX2(x[1], x[5], x[9], x[13])
+			CHACHA_QR_AVX2(x[2], x[6], x[10], x[14])
+			CHACHA_QR_AVX2(x[3], x[7], x[11], x[15])
+			CHACHA_QR_AVX2(x[0], x[5], x[10], x[15])
+			CHACHA_QR_AVX2(x[1], x[6], x[11], x[12])
+			CHACHA_QR_AVX2(x[2], x[7], x[8], x[13])
+			CHACHA_QR_AVX2(x[3], x[4], x[9], x[14])
+		}
+
+		for (int i = 0; i < 16; i++) x[i] = _mm256_add_epi32(x[i], in[i]);
+		store8_avx2(x, out);
+		store8_avx2(x + 8, out + 32);
+	}
+
+	chacha_scalar(key, counter + (uint32_t)n, out, blocks - n);
+}
+
+#define CHACHA_QR_AVX512(a, b, c, d) \
+	a = _mm512_add_epi32(a, b); d = _mm512_rol_epi32(_mm512_xor_si512(d, a), 16); \
+	c = _mm512_add_epi32(c, d); b = _mm512_rol_epi32(_mm512_xor_si512(b, c), 12); \
+	a = _mm512_add_epi32(a, b); d = _mm512_rol_epi32(_mm512_xor_si512(d, a), 8); \
+	c = _mm512_add_epi32(c, d); b = _mm512_rol_epi32(_mm512_xor_si512(b, c), 7);
+
+/**
+* The rotates and shuffles of the gcc 12 AVX-512 headers read
+* _mm512_undefined_*, a -Wmaybe-uninitialized false positive
+*/
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+
+/**
+* Transpose 4 words of the 16 blocks held by v[0..3]: u[k] has in its
+* 128 bits lane l the words of block 4 * l + k
+*/
+__attribute__((target("avx512f")))
+static inline void transpose4_avx512(const __m512i* v, __m512i* u)
+{
+	__m512i t0 = _mm512_unpacklo_epi32(v[0], v[1]);
+	__m512i t1 = _mm512_unpackhi_epi32(v[0], v[1]);
+	__m512i t2 = _mm512_unpacklo_epi32(v[2], v[3]);
+	__m512i t3 = _mm512_unpackhi_epi32(v[2], v[3]);
+
+	u[0] = _mm512_unpacklo_epi64(t0, t2);
+	u[1] = _mm512_unpackhi_epi64(t0, t2);
+	u[2] = _mm512_unpacklo_epi64(t1, t3);
+	u[3] = _mm512_unpackhi_epi64(t1, t3);
+}
+
+__attribute__((target("avx512f")))
+static void chacha_avx512(const uint32_t* key, uint32_t counter, u8* out, size_t blocks)
+{
+	__m512i in[16];
+	size_t n = 0;
+
+	for (int i = 0; i < 4; i++) in[i] = _mm512_set1_epi32((int)chacha_const[i]);
+	for (int i = 0; i < 8; i++) in[4 + i] = _mm512_set1_epi32((int)key[i]);
+	for (int i = 13; i < 16; i++) in[i] = _mm512_setzero_si512();
+
+	for (; n + 16 <= blocks; n += 16, out += 16 * CHACHA_BLOCK_SIZE) {
+		in[12] = _mm512_add_epi32(_mm512_set1_epi32((int)(counter + (uint32_t)n)),
+				_mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+
+		__m512i x[16];
+		for (int i = 0; i < 16; i++) x[i] = in[i];
+
+		for (int i = 0; i < 10; i++) {
+			CHACHA_QR_AVX512(x[0], x[4], x[8], x[12])
+			CHACHA_QR_AVX512(x[1], x[5], x[9], x[13])
+			CHACHA_QR_AVX512(x[2], x[6], x[10], x[14])
+			CHACHA_QR_AVX512(x[3], x[7], x[11], x[15])
+			CHACHA_QR_AVX512(x[0], x[5], x[10], x[15])
+			CHACHA_QR_AVX512(x[1], x[6], x[11], x[12])
+			CHACHA_QR_AVX512(x[2], x[7], x[8], x[13])
+			CHACHA_QR_AVX512(x[3], x[4], x[9], x[14])
+		}
+
+		__m512i u[16];
+		for (int i = 0; i < 16; i++) x[i] = _mm512_add_epi32(x[i], in[i]);
+		for (int g = 0; g < 4; g++) transpose4_avx512(x + 4 * g, u + 4 * g);
+
+		/** block 4 * l + k: lane l of u[k], u[4 + k], u[8 + k], u[12 + k] */
+		for (int k = 0; k < 4; k++) {
+			__m512i a = _mm512_shuffle_i32x4(u[k], u[4 + k], 0x44);
+			__m512i b = _mm512_shuffle_i32x4(u[k], u[4 + k], 0xee);
+			__m512i c = _mm512_shuffle_i32x4(u[8 + k], u[12 + k], 0x44);
+			__m512i d = _mm512_shuffle_i32x4(u[8 + k], u[12 + k], 0xee);
+
+			_mm512_storeu_si512(out + k * CHACHA_BLOCK_SIZE, _mm512_shuffle_i32x4(a, c, 0x88));
+			_mm512_storeu_si512(out + (4 + k) * CHACHA_BLOCK_SIZE, _mm512_shuffle_i32x4(a, c, 0xdd));
+			_mm512_storeu_si512(out + (8 + k) * CHACHA_BLOCK_SIZE, _mm512_shuffle_i32x4(b, d, 0x88));
+			_mm512_storeu_si512(out + (12 + k) * CHACHA_BLOCK_SIZE, _mm512_shuffle_i32x4(b, d, 0xdd));
+		}
+	}
+
+	chacha_avx2(key, counter + (uint32_t)n, out, blocks - n);
+}
+
+#pragma GCC diagnostic pop
+
+#endif
+
+static Chacha_fn select_chacha()
+{
+#ifdef QRNG_X86_KERNELS
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f")) return chacha_avx512;
+	if (__builtin_cpu_supports("avx2")) return chacha_avx2;
+#endif
+	return chacha_scalar;
+}
+
+static u64 now_ns()
+{
+	return (u64)std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/** Replace the key by the first block of its keystream */
+static void drbg_rekey(Qrng_drbg_t* drbg)
+{
+	u8 block[CHACHA_BLOCK_SIZE];
+	chacha_scalar(drbg->key, drbg->counter, block, 1);
+	memcpy(drbg->key, block, sizeof(drbg->key));
+	memset(block, 0, sizeof(block));
+	drbg->counter = 0;
+}
+
+static int drbg_reseed(Qrng_shard_t* shard)
+{
+	Qrng_drbg_t* drbg = &shard->drbg;
+	u8 seed[QRNG_DRBG_SEED_SIZE];
+	size_t n = 0;
+
+	int ret = ext_read_hashed(shard, seed, sizeof(seed), &n);
+	if (ret == QRNG_SUCCESS && n < sizeof(seed)) ret = QRNG_ERROR_INCOMPLETE_DATA;
+	if (ret != QRNG_SUCCESS) {
+		memset(seed, 0, sizeof(seed));
+		return ret;
+	}
+
+	for (int i = 0; i < 8; i++) {
+		uint32_t w;
+		memcpy(&w, seed + 4 * i, sizeof(w));
+		drbg->key[i] ^= w;
+	}
+	memset(seed, 0, sizeof(seed));
+
+	/** nothing generated with the previous key is served after a reseed */
+	memset(drbg->buf, 0, sizeof(drbg->buf));
+	drbg->buf_pos = sizeof(drbg->buf);
+	drbg->counter = 0;
+	drbg->seeded = true;
+	drbg->since_reseed = 0;
+	drbg->reseed_ns = now_ns();
+	drbg->entropy.store(drbg->entropy.load(std::memory_order_relaxed) + QRNG_DRBG_SEED_SIZE,
+			std::memory_order_relaxed);
+	drbg->reseeds.store(drbg->reseeds.load(std::memory_order_relaxed) + 1,
+			std::memory_order_relaxed);
+	return QRNG_SUCCESS;
+}
+
+/** The clock is only read before a new key, not for each small request */
+static bool drbg_reseed_due(const Qrng_ext_ctx* ctx, const Qrng_drbg_t* drbg, bool new_key)
+{
+	if (!drbg->seeded) return true;
+
+	size_t bytes = ctx->param.drbg_reseed_bytes;
+	if (bytes == 0) bytes = QRNG_DRBG_DEFAULT_RESEED_BYTES;
+	u64 ms = ctx->param.drbg_reseed_ms;
+	if (ms == 0) ms = QRNG_DRBG_DEFAULT_RESEED_MS;
+
+	return drbg->since_reseed >= bytes || (new_key && now_ns() - drbg->reseed_ns >= ms * 1000000);
+}
+
+/** Keystream for the small requests, behind the next key */
+static void drbg_refill(Qrng_drbg_t* drbg, Chacha_fn chacha)
+{
+	chacha(drbg->key, 0, drbg->buf, sizeof(drbg->buf) / CHACHA_BLOCK_SIZE);
+	memcpy(drbg->key, drbg->buf, sizeof(drbg->key));
+	memset(drbg->buf, 0, sizeof(drbg->key));
+	drbg->buf_pos = sizeof(drbg->key);
+	drbg->counter = 0;
+}
+
+int qrng_get_drbg(QRNG* qrng, u8* data, size_t size, size_t* bytes_read)
+{
+	static const Chacha_fn chacha = select_chacha();
+
+	if (bytes_read) *bytes_read = 0;
+	if (!data) return QRNG_ERROR_NULL_PTR;
+
+	Qrng_shard_t* shard = ext_shard(qrng);
+	if (!shard) return QRNG_ERROR_NOT_EXT_HANDLE;
+
+	Qrng_drbg_t* drbg = &shard->drbg;
+	u64 t0 = ext_stats_begin(shard, size);
+	size_t done = 0;
+	int ret = QRNG_SUCCESS;
+
+	while (done < size) {
+		bool small = size - done < QRNG_DRBG_BUFFER_SIZE;
+		bool new_key = !small || drbg->buf_pos == sizeof(drbg->buf);
+		if (drbg_reseed_due(shard->ctx, drbg, new_key) && (ret = drbg_reseed(shard)) != QRNG_SUCCESS)
+			break;
+
+		size_t n;
+		if (small) {
+			if (drbg->buf_pos == sizeof(drbg->buf)) drbg_refill(drbg, chacha);
+			n = std::min(sizeof(drbg->buf) - drbg->buf_pos, size - done);
+
+			/** copied and wiped in one pass, cheaper than two calls for a few bytes */
+			u8* src = drbg->buf + drbg->buf_pos;
+			for (size_t i = 0; i < n; i++) {
+				data[done + i] = src[i];
+				src[i] = 0;
+			}
+			drbg->buf_pos += n;
+		}
+		else {
+			/** whole blocks straight into the caller's buffer, then a new key */
+			n = std::min(size - done, QRNG_DRBG_REKEY_BYTES);
+			n -= n % CHACHA_BLOCK_SIZE;
+			chacha(drbg->key, drbg->counter, data + done, n / CHACHA_BLOCK_SIZE);
+			drbg->counter += (uint32_t)(n / CHACHA_BLOCK_SIZE);
+			drbg_rekey(drbg);
+		}
+
+		done += n;
+		drbg->since_reseed += n;
+	}
+
+	drbg->output.store(drbg->output.load(std::memory_order_relaxed) + done,
+			std::memory_order_relaxed);
+	shard->status = ret;
+	if (bytes_read) *bytes_read = done;
+	ext_stats_call(shard, QRNG_STATS_FN_DRBG, t0, done, ret);
+	return ret;
+}
+
+int qrng_drbg_reseed(QRNG* qrng)
+{
+	Qrng_shard_t* shard = ext_shard(qrng);
+	if (!shard) return QRNG_ERROR_NOT_EXT_HANDLE;
+
+	int ret = drbg_reseed(shard);
+	shard->status = ret;
+	return ret;
+}
+
+static void drbg_stats_add(Qrng_drbg_stats* stats, const Qrng_drbg_t* drbg)
+{
+	stats->output_bytes += drbg->output.load(std::memory_order_relaxed);
+	stats->entropy_bytes += drbg->entropy.load(std::memory_order_relaxed);
+	stats->reseeds += drbg->reseeds.load(std::memory_order_relaxed);
+}
+
+int qrng_drbg_get_stats(QRNG* qrng, Qrng_drbg_stats* stats)
+{
+	if (!stats) return QRNG_ERROR_NULL_PTR;
+
+	Qrng_ext_ctx* ctx = ext_ctx(qrng);
+	if (!ctx) return QRNG_ERROR_NOT_EXT_HANDLE;
+
+	std::lock_guard<std::mutex> lock(ctx->shard_mutex);
+	*stats = ctx->drbg_retired;
+	stats->instances = 0;
+	for (const Qrng_shard_t* shard : ctx->shards) {
+		drbg_stats_add(stats, &shard->drbg);
+		if (shard->drbg.reseeds.load(std::memory_order_relaxed)) stats->instances++;
+	}
+	return QRNG_SUCCESS;
+}
+
+void ext_drbg_release(Qrng_shard_t* shard)
+{
+	Qrng_drbg_t* drbg = &shard->drbg;
+	drbg_stats_add(&shard->ctx->drbg_retired, drbg);
+
+	memset(drbg->key, 0, sizeof(drbg->key));
+	memset(drbg->buf, 0, sizeof(drbg->buf));
+	drbg->seeded = false;
+}
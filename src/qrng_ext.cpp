@@ -0,0 +1,375 @@
+/**
+* @file 	qrng_ext.cpp
+* @brief 	QRNG API extensions: handle registry and low level hooks
+*
+* The extension state is attached to a QRNG object by taking over the
+* low level dispatch table of the QRNG API library. qrng_init_param()
+* calls the hooked qrng_init_ll, which allocates the Qrng_ext_ctx and
+* hands it back as the low level handle, and qrng_deinit() releases it
+* through the hooked qrng_deinit_ll. The device itself is still driven
+* by the original functions.
+*
+* @date		17/10/2026
+*
+* Copyright(c) Quantum Dice. All rights reserved.
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <unordered_map>
+#include <utility>
+
+#include "qrng_ext_internal.h"
+
+Qrng_ll_table ll_default;
+
+static std::once_flag install_flag;
+static std::mutex registry_mutex;
+static std::unordered_map<QRNG*, Qrng_ext_ctx*> registry;
+static std::atomic<u64> registry_gen{ 1 };
+static std::atomic<u64> ctx_next_id{ 1 };
+
+/** Last lookup of the calling thread, valid while registry_gen matches */
+static thread_local struct {
+	QRNG* qrng;
+	Qrng_ext_ctx* ctx;
+	u64 gen;
+} ctx_cache;
+
+/** Last shard lookup of the calling thread, valid while registry_gen matches */
+static thread_local struct {
+	QRNG* qrng;
+	Qrng_shard_t* shard;
+	u64 gen;
+} shard_cache;
+
+/** Shards owned by the calling thread, released when it exits */
+struct Shard_owner {
+	std::vector<std::pair<u64, Qrng_shard_t*>> shards;
+	~Shard_owner();
+};
+static thread_local Shard_owner shard_owner;
+
+/** Parameters and context of the qrng_ext_init_param call in progress */
+static thread_local const Qrng_ext_param* pending_param;
+static thread_local Qrng_ext_ctx* pending_ctx;
+
+static void ext_unregister(Qrng_ext_ctx* ctx)
+{
+	if (!ctx->qrng) return;
+
+	std::lock_guard<std::mutex> lock(registry_mutex);
+	registry.erase(ctx->qrng);
+	registry_gen.fetch_add(1, std::memory_order_release);
+}
+
+static void shard_free(Qrng_shard_t* shard)
+{
+	ext_drbg_release(shard);
+	ext_stats_release(shard);
+	ext_pool_free(&shard->pool);
+	ext_stage_free(shard);
+	delete shard;
+}
+
+/** Registered context with the given id, the caller holds registry_mutex */
+static Qrng_ext_ctx* ctx_find_id(u64 id)
+{
+	for (auto& it : registry)
+		if (it.second->id == id) return it.second;
+	return nullptr;
+}
+
+Shard_owner::~Shard_owner()
+{
+	std::lock_guard<std::mutex> lock(registry_mutex);
+
+	for (auto& it : shards) {
+		Qrng_ext_ctx* ctx = ctx_find_id(it.first);
+		if (!ctx) continue;		/** released with the handle */
+
+		std::lock_guard<std::mutex> shard_lock(ctx->shard_mutex);
+		auto& v = ctx->shards;
+		v.erase(std::remove(v.begin(), v.end(), it.second), v.end());
+		shard_free(it.second);
+	}
+	shards.clear();
+}
+
+static int ext_init_ll(const char* dev_name, void** ll)
+{
+	Qrng_ext_ctx* ctx = new (std::nothrow) Qrng_ext_ctx();
+	if (!ctx) return QRNG_ERROR_INTERNAL_MEMORY;
+
+	if (pending_param) {
+		ctx->param = *pending_param;
+		pending_ctx = ctx;
+	}
+
+	const char* args = dev_name;
+	if (!ext_backend_find(dev_name, &ctx->ll, &args)) ctx->ll = ll_default;
+
+	*ll = ctx;
+	return ctx->ll.init(args, &ctx->dev);
+}
+
+int ext_ll_get(Qrng_ext_ctx* ctx, u8* buf, size_t size, size_t* read_len,
+			int channel)
+{
+	Qrng_health* health = ctx->health;
+	if (health && ext_health_failed(health)) {
+		*read_len = 0;
+		return QRNG_ERROR_INSUFFICIENT_ENTHROPY;
+	}
+
+	*read_len = 0;
+	u64 t0 = ext_stats_now();
+	int ret = ctx->ll.get(ctx->dev, buf, size, read_len, channel);
+	ext_stats_add(&ctx->stats_device, true, ext_stats_now() - t0, *read_len, ret, true);
+
+	/** a short transfer is completed by the next one of the channel */
+	bool short_read = (ret == QRNG_ERROR_INCOMPLETE_DATA || (ret == QRNG_SUCCESS && *read_len < size));
+	std::atomic<bool>& short_last = ctx->stats_short_last[channel == QRNG_LL_CHANNEL_RAW];
+	if (short_read) ctx->stats_short_reads.fetch_add(1, std::memory_order_relaxed);
+	if (short_last.load(std::memory_order_relaxed)) ctx->stats_retries.fetch_add(1, std::memory_order_relaxed);
+	short_last.store(short_read, std::memory_order_relaxed);
+
+	if (health && *read_len) {
+		int check = ext_health_check(health, buf, std::min(*read_len, size), channel);
+		if (check != QRNG_SUCCESS) {
+			*read_len = 0;
+			ret = check;
+		}
+	}
+	return ret;
+}
+
+int ext_dev_get(Qrng_ext_ctx* ctx, u8* buf, size_t size, size_t* read_len,
+			int channel)
+{
+	u64 t0 = ext_stats_now();
+	int ret;
+
+	if (channel == QRNG_LL_CHANNEL_HASHED && ctx->ring) {
+		ret = ext_prefetch_read(ctx->ring, buf, size, read_len);
+	}
+	else {
+		std::lock_guard<std::mutex> lock(ctx->dev_mutex);
+		ret = ext_ll_get(ctx, buf, size, read_len, channel);
+	}
+
+	ctx->stats_wait_ns.fetch_add(ext_stats_now() - t0, std::memory_order_relaxed);
+	return ret;
+}
+
+static int ext_get_ll(void* ll, u8* buf, size_t size, size_t* read_len,
+					int channel)
+{
+	Qrng_ext_ctx* ctx = (Qrng_ext_ctx*)ll;
+	u64 t0 = ext_stats_now();
+	int ret = ext_dev_get(ctx, buf, size, read_len, channel);
+	ext_stats_add(&ctx->stats_core, true, ext_stats_now() - t0, *read_len, ret, true);
+	return ret;
+}
+
+static void ext_deinit_ll(void* ll)
+{
+	Qrng_ext_ctx* ctx = (Qrng_ext_ctx*)ll;
+	if (!ctx) return;
+
+	/** the workers still read through the registered handle */
+	ext_async_stop(ctx);
+	ext_extract_stop(ctx);
+	ext_shm_stop(ctx);
+	ext_net_stop(ctx);
+	ext_unregister(ctx);
+	ext_prefetch_stop(ctx);
+	if (ctx->dev) ctx->ll.deinit(ctx->dev);
+
+	{
+		std::lock_guard<std::mutex> lock(ctx->shard_mutex);
+		for (Qrng_shard_t* shard : ctx->shards) shard_free(shard);
+		ctx->shards.clear();
+	}
+	ext_buffers_release(ctx);
+	ext_health_stop(ctx);
+	delete ctx;
+}
+
+void ext_install()
+{
+	std::call_once(install_flag, []() {
+		ll_default.init = qrng_init_ll;
+		ll_default.get = qrng_get_ll;
+		ll_default.deinit = qrng_deinit_ll;
+
+		qrng_init_ll = ext_init_ll;
+		qrng_get_ll = ext_get_ll;
+		qrng_deinit_ll = ext_deinit_ll;
+
+		ext_backends_install();
+	});
+}
+
+Qrng_ext_ctx* ext_ctx(QRNG* qrng)
+{
+	u64 gen = registry_gen.load(std::memory_order_acquire);
+	if (ctx_cache.qrng == qrng && ctx_cache.gen == gen)
+		return ctx_cache.ctx;
+
+	std::lock_guard<std::mutex> lock(registry_mutex);
+	auto it = registry.find(qrng);
+	ctx_cache.qrng = qrng;
+	ctx_cache.ctx = (it != registry.end()) ? it->second : nullptr;
+	ctx_cache.gen = registry_gen.load(std::memory_order_relaxed);
+	return ctx_cache.ctx;
+}
+
+Qrng_shard_t* ext_shard(QRNG* qrng)
+{
+	u64 gen = registry_gen.load(std::memory_order_acquire);
+	if (shard_cache.qrng == qrng && shard_cache.gen == gen)
+		return shard_cache.shard;
+
+	std::lock_guard<std::mutex> lock(registry_mutex);
+	auto it = registry.find(qrng);
+	Qrng_shard_t* shard = nullptr;
+
+	if (it != registry.end()) {
+		Qrng_ext_ctx* ctx = it->second;
+		std::thread::id self = std::this_thread::get_id();
+		std::lock_guard<std::mutex> shard_lock(ctx->shard_mutex);
+
+		for (Qrng_shard_t* s : ctx->shards)
+			if (s->owner == self) shard = s;
+
+		if (!shard) {
+			shard = new (std::nothrow) Qrng_shard_t();
+			if (!shard) return nullptr;
+			shard->ctx = ctx;
+			shard->owner = self;
+			shard->status = QRNG_SUCCESS;
+			ctx->shards.push_back(shard);
+
+			/** forget the shards of the released handles */
+			auto& owned = shard_owner.shards;
+			owned.erase(std::remove_if(owned.begin(), owned.end(),
+					[](const std::pair<u64, Qrng_shard_t*>& o) {
+						return !ctx_find_id(o.first); }), owned.end());
+			owned.emplace_back(ctx->id, shard);
+		}
+	}
+
+	shard_cache.qrng = qrng;
+	shard_cache.shard = shard;
+	shard_cache.gen = registry_gen.load(std::memory_order_relaxed);
+	return shard;
+}
+
+int qrng_ext_get_status(QRNG* qrng)
+{
+	Qrng_shard_t* shard = ext_shard(qrng);
+	return shard ? shard->status : QRNG_ERROR_NOT_EXT_HANDLE;
+}
+
+int ext_get(QRNG* qrng, u8* data, size_t size, size_t* bytes_read)
+{
+	Qrng_shard_t* shard = ext_shard(qrng);
+	if (shard) return ext_read_hashed(shard, data, size, bytes_read);
+
+	size_t done = 0;
+	int ret = qrng ? QRNG_SUCCESS : QRNG_ERROR_NULL_PTR;
+
+	while (ret == QRNG_SUCCESS && done < size) {
+		s32 chunk = (s32)std::min(size - done, QRNG_GET_MAX_SIZE);
+		s32 n = 0;
+		ret = qrng_get(qrng, data + done, chunk, &n);
+		if (n > 0) done += n;
+	}
+
+	if (bytes_read) *bytes_read = done;
+	return ret;
+}
+
+int ext_get_raw(QRNG* qrng, u16* data, size_t count, size_t* count_read)
+{
+	Qrng_shard_t* shard = ext_shard(qrng);
+	if (shard) return ext_read_raw(shard, data, count, count_read);
+
+	size_t done = 0;
+	int ret = qrng ? QRNG_SUCCESS : QRNG_ERROR_NULL_PTR;
+
+	while (ret == QRNG_SUCCESS && done < count) {
+		s32 chunk = (s32)std::min(count - done, QRNG_GET_MAX_SIZE / sizeof(*data));
+		s32 n = 0;
+		ret = qrng_get_raw_ent(qrng, data + done, chunk, &n);
+		if (n > 0) done += n;
+	}
+
+	if (count_read) *count_read = done;
+	return ret;
+}
+
+int qrng_get64(QRNG* qrng, u8* data, size_t size, size_t* bytes_read)
+{
+	if (!data) return QRNG_ERROR_NULL_PTR;
+
+	Qrng_shard_t* shard = ext_shard(qrng);
+	u64 t0 = ext_stats_begin(shard, size);
+	size_t n = 0;
+	int ret = shard ? ext_read_hashed(shard, data, size, &n) : ext_get(qrng, data, size, &n);
+	ext_stats_call(shard, QRNG_STATS_FN_GET64, t0, n, ret);
+	if (bytes_read) *bytes_read = n;
+	return ret;
+}
+
+int qrng_get_raw_ent64(QRNG* qrng, u16* data, size_t count, size_t* count_read)
+{
+	if (!data) return QRNG_ERROR_NULL_PTR;
+
+	Qrng_shard_t* shard = ext_shard(qrng);
+	u64 t0 = ext_stats_begin(shard, count * sizeof(*data));
+	size_t n = 0;
+	int ret = shard ? ext_read_raw(shard, data, count, &n) : ext_get_raw(qrng, data, count, &n);
+	ext_stats_call(shard, QRNG_STATS_FN_GET_RAW_ENT64, t0, n * sizeof(*data), ret);
+	if (count_read) *count_read = n;
+	return ret;
+}
+
+QRNG *qrng_ext_init_param(Qrng_init_param init_param, Qrng_ext_param ext_param)
+{
+	ext_install();
+	if (!ext_extract_valid(ext_param.extract_min_entropy)) return nullptr;
+	if (ext_param.pool_size && (ext_param.pool_size < QRNG_POOL_MIN_SIZE
+			|| ext_param.pool_size > QRNG_POOL_MAX_SIZE)) return nullptr;
+
+	pending_param = &ext_param;
+	pending_ctx = nullptr;
+	QRNG* qrng = qrng_init_param(init_param);
+	Qrng_ext_ctx* ctx = pending_ctx;
+	pending_param = nullptr;
+	pending_ctx = nullptr;
+
+	if (!qrng || !ctx) return qrng;
+
+	ctx->qrng = qrng;
+	ctx->id = ctx_next_id.fetch_add(1);
+	ctx->pool_size = ext_param.pool_size ? ext_param.pool_size : QRNG_POOL_DEFAULT_SIZE;
+
+	/** the tests are on before any read of the prefetch thread */
+	if (ext_param.health_tests && ext_health_start(ctx, ext_param.health_raw_entropy) != QRNG_SUCCESS) {
+		qrng_deinit(qrng);
+		return nullptr;
+	}
+
+	/** without a ring the handle still works, reading synchronously */
+	if (ext_param.prefetch_depth && qrng_get_status(qrng) == QRNG_SUCCESS)
+		ext_prefetch_start(ctx, ext_param.prefetch_depth, ext_param.prefetch_block);
+
+	std::lock_guard<std::mutex> lock(registry_mutex);
+	registry[qrng] = ctx;
+	registry_gen.fetch_add(1, std::memory_order_release);
+	return qrng;
+}
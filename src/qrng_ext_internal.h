@@ -0,0 +1,396 @@
+/**
+* @file 	qrng_ext_internal.h
+* @brief 	Internal definitions shared by the QRNG API extensions
+*
+* @date		17/10/2026
+*
+* Copyright(c) Quantum Dice. All rights reserved.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "qrng_ext.h"
+
+#define KB(x)   ((size_t) (x) << 10)
+#define MB(x)   ((size_t) (x) << 20)
+
+/**
+* The hashed channel is a stream of 16 bytes frames: the marker
+* 01 02 03 04, 16 bits entropy bits, 16 bits certification value
+* (scaled by QRNG_CERT_SCALE) and 8 bytes of hashed data. Frames
+* without the marker are plain data.
+*/
+#define QRNG_FRAME_SIZE			16
+#define QRNG_FRAME_DATA_OFFSET	8
+#define QRNG_FRAME_MARKER		0x04030201u
+#define QRNG_CERT_SCALE			255.0f
+
+/**
+* The raw channel is a stream of 32 bits words, the sample is the
+* 16 bits little endian value in the upper half
+*/
+#define QRNG_RAW_WORD_SIZE		4
+#define QRNG_RAW_SAMPLE_OFFSET	2
+
+/**
+* Device transfer size of the QRNG API library, a multiple of the
+* xdma descriptor size: the extensions read the device in chunks of
+* this size and split the large requests on its multiples
+*/
+#define QRNG_DMA_CHUNK_SIZE		MB(8)
+#define QRNG_STAGE_SIZE			QRNG_DMA_CHUNK_SIZE
+
+/** Smallest request read from the device straight into the caller's buffer */
+#define QRNG_DIRECT_MIN_SIZE	KB(64)
+
+/**
+* DRBG of qrng_get_drbg(): keystream buffered for the small requests,
+* largest output between two key erasures
+*/
+#define QRNG_DRBG_BUFFER_SIZE	KB(1)
+#define QRNG_DRBG_REKEY_BYTES	MB(1)
+
+/** Largest size passed to a single qrng_get() call (s32 is 32 bits on Windows) */
+#define QRNG_GET_MAX_SIZE		(MB(1024) / QRNG_DMA_CHUNK_SIZE * QRNG_DMA_CHUNK_SIZE)
+
+extern "C" {
+	/**
+	* Low level dispatch table of the QRNG API library, every device
+	* access of the qrng_* functions goes through these pointers.
+	*/
+	extern int (*qrng_init_ll)(const char* dev_name, void** ll);
+	extern int (*qrng_get_ll)(void* ll, u8* buf, size_t size,
+							size_t* read_len, int channel);
+	extern void (*qrng_deinit_ll)(void* ll);
+}
+
+typedef struct {
+	int (*init)(const char* dev_name, void** ll);
+	int (*get)(void* ll, u8* buf, size_t size, size_t* read_len, int channel);
+	void (*deinit)(void* ll);
+}Qrng_ll_table;
+
+/** Registered backend, see qrng_register_backend() */
+typedef struct {
+	char name[QRNG_BACKEND_NAME_MAX];
+	Qrng_ll_table ll;
+}Qrng_backend_entry;
+
+typedef struct {
+	u8* data;
+	size_t size;	/**< allocated size */
+	size_t len;		/**< valid bytes */
+	size_t pos;		/**< consumed bytes */
+}Qrng_pool_t;
+
+/** Buffer registered with qrng_register_buffer() */
+typedef struct {
+	void* data;
+	size_t size;
+	bool locked;	/**< pages locked with mlock() */
+}Qrng_buffer_t;
+
+struct Qrng_ring;
+struct Qrng_async;
+struct Qrng_health;
+struct Qrng_extractor;
+struct Qrng_shm_server;
+struct Qrng_net_server;
+struct Qrng_ext_ctx;
+
+/** ChaCha20 instance of qrng_get_drbg(), one per thread */
+typedef struct {
+	uint32_t key[8];
+	uint32_t counter;	/**< next block, from 0 after each key change */
+	bool seeded;
+	u64 since_reseed;	/**< bytes output since the last reseed */
+	u64 reseed_ns;		/**< steady clock time of the last reseed */
+	size_t buf_pos;
+	u8 buf[QRNG_DRBG_BUFFER_SIZE];	/**< keystream for the small requests */
+
+	/** counters of qrng_drbg_get_stats(), written by the owner thread */
+	std::atomic<u64> output;
+	std::atomic<u64> entropy;
+	std::atomic<u64> reseeds;
+}Qrng_drbg_t;
+
+/**
+* Counters of a Qrng_stats_latency: relaxed atomics, written with
+* load/store by the owner of a shard and with fetch_add on the handle
+*/
+typedef struct {
+	std::atomic<u64> calls;
+	std::atomic<u64> errors;
+	std::atomic<u64> bytes;
+	std::atomic<u64> timed;
+	std::atomic<u64> total_ns;
+	std::atomic<u64> buckets[QRNG_STATS_BUCKETS];
+}Qrng_stats_counter;
+
+/**
+* Per thread state of an extension handle: each thread reading from a
+* shared handle refills its own pool and staging buffer, only the
+* device reads are serialized (or come from the prefetch ring)
+*/
+typedef struct {
+	Qrng_ext_ctx* ctx;
+	std::thread::id owner;
+	int status;			/**< last status of the owner thread */
+	int word_error;		/**< first failed read of pool_word(), cleared by
+						qrng_pool_get_error() */
+	Qrng_pool_t pool;
+	Qrng_pool_t stage;	/**< device frames not consumed yet */
+	Qrng_pool_t raw_stage;	/**< raw channel words not consumed yet */
+	Qrng_drbg_t drbg;
+	Qrng_stats_counter stats[QRNG_STATS_FN_COUNT];	/**< written by the owner thread */
+	uint32_t stats_tick;	/**< small requests since the last one timed */
+}Qrng_shard_t;
+
+/** Source of small amounts of random bytes: the entropy pool or qrng_get() */
+typedef struct {
+	QRNG* qrng;
+	Qrng_shard_t* shard;
+	bool pooled;	/**< false once the pool failed */
+	int status;
+	size_t taken;	/**< bytes taken so far */
+	size_t pos;
+	size_t len;
+	u8 buf[64];
+}Qrng_src_t;
+
+/** Extension state, used as the low level handle of the QRNG object */
+typedef struct Qrng_ext_ctx {
+	QRNG* qrng;
+	void* dev;
+	Qrng_ll_table ll;	/**< backend driving 'dev' */
+	Qrng_ring* ring;	/**< prefetch ring, NULL when disabled */
+	Qrng_health* health;	/**< health tests, NULL when disabled */
+	Qrng_ext_param param;
+	u64 id;				/**< never reused, unlike the address */
+	std::atomic<size_t> pool_size;
+	std::atomic<Qrng_async*> async;	/**< workers of qrng_get_async(), NULL until used */
+	std::atomic<Qrng_extractor*> extractor;	/**< qrng_get_extracted(), NULL until used */
+	Qrng_shm_server* shm;	/**< qrng_shm_start(), under shm_mutex */
+	Qrng_net_server* net;	/**< qrng_net_start(), under net_mutex */
+
+	std::mutex dev_mutex;	/**< device reads without prefetch ring */
+	std::mutex core_mutex;	/**< calls into the QRNG API library */
+	std::mutex shard_mutex;
+	std::mutex async_mutex;
+	std::mutex extract_mutex;
+	std::mutex shm_mutex;
+	std::mutex net_mutex;
+	std::mutex buffer_mutex;
+	std::vector<Qrng_shard_t*> shards;
+	std::vector<Qrng_buffer_t> buffers;
+	Qrng_drbg_stats drbg_retired;	/**< counters of the freed shards, under shard_mutex */
+
+	/** counters of qrng_get_stats() */
+	Qrng_stats_counter stats_device;
+	Qrng_stats_counter stats_core;
+	std::atomic<u64> stats_short_reads;
+	std::atomic<u64> stats_retries;
+	std::atomic<u64> stats_wait_ns;
+	std::atomic<bool> stats_short_last[2];	/**< last transfer of the channel was short */
+	Qrng_stats_latency stats_retired[QRNG_STATS_FN_COUNT];	/**< freed shards, under shard_mutex */
+}Qrng_ext_ctx;
+
+/** Original low level functions of the QRNG API library */
+extern Qrng_ll_table ll_default;
+
+void ext_install();
+
+/** Register the built-in backends, called once by ext_install() */
+void ext_backends_install();
+
+/** Functions of the "multi" backend, see qrng_multi.cpp */
+void ext_multi_table(Qrng_ll_table* ll);
+
+/** Functions of the "shm" backend, the clients of qrng_shm_start() */
+void ext_shm_table(Qrng_ll_table* ll);
+
+/** Functions of the "tcp" and "unix" backends, the clients of qrng_net_start() */
+void ext_net_tables(Qrng_ll_table* tcp, Qrng_ll_table* local);
+
+/**
+* Find the backend of a device name "name:args" (or "name")
+*
+* @return	false for the names of the default backend, 'args' then
+* 			points to the whole name
+*/
+bool ext_backend_find(const char* dev_name, Qrng_ll_table* ll, const char** args);
+Qrng_ext_ctx* ext_ctx(QRNG* qrng);
+
+/** State of the calling thread for an extension handle, NULL for others */
+Qrng_shard_t* ext_shard(QRNG* qrng);
+
+/**
+* Read 'size' bytes of hashed data, from the device frames for
+* extension handles and with qrng_get() for the others
+*/
+int ext_get(QRNG* qrng, u8* data, size_t size, size_t* bytes_read);
+
+/** Read 'count' raw entropy samples, see qrng_get_raw_ent() */
+int ext_get_raw(QRNG* qrng, u16* data, size_t count, size_t* count_read);
+
+void ext_u64_to_double(u64* data, size_t count);
+void ext_u32_to_float(uint32_t* data, size_t count);
+
+/**
+* One transfer from the backend, through the health tests when enabled.
+* The caller serializes the transfers of each channel.
+*/
+int ext_ll_get(Qrng_ext_ctx* ctx, u8* buf, size_t size, size_t* read_len,
+			int channel);
+
+/** Device read of the extension readers, from the prefetch ring if any */
+int ext_dev_get(Qrng_ext_ctx* ctx, u8* buf, size_t size, size_t* read_len,
+			int channel);
+int ext_read_hashed(Qrng_shard_t* shard, u8* data, size_t size,
+			size_t* bytes_read);
+int ext_read_raw(Qrng_shard_t* shard, u16* data, size_t count,
+			size_t* count_read);
+void ext_stage_free(Qrng_shard_t* shard);
+
+/** Refill a staging buffer of the shard with one device transfer */
+int ext_stage_refill(Qrng_shard_t* shard, Qrng_pool_t* stage, int channel);
+
+/** Start the prefetch thread of the handle, see qrng_prefetch_get_stats() */
+int ext_prefetch_start(Qrng_ext_ctx* ctx, size_t depth, size_t block);
+void ext_prefetch_stop(Qrng_ext_ctx* ctx);
+
+/** Cancel the queued asynchronous reads and stop the workers */
+void ext_async_stop(Qrng_ext_ctx* ctx);
+
+/**
+* Add the counters of a shard's DRBG to the handle's and wipe its
+* state, the caller holds the shard_mutex of the handle
+*/
+void ext_drbg_release(Qrng_shard_t* shard);
+
+static inline u64 ext_stats_now()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+* Count a call of 'ns' nanoseconds, or not timed if 'timed' is false,
+* 'shared' for the counters written by several threads
+*/
+void ext_stats_add(Qrng_stats_counter* c, bool timed, u64 ns, size_t bytes, int ret,
+				bool shared);
+
+/**
+* Start time of a call of 'size' bytes by the owner of the shard, 0 if
+* the call isn't timed (a small request between two samples)
+*/
+static inline u64 ext_stats_begin(Qrng_shard_t* shard, size_t size)
+{
+	if (!shard) return 0;
+	if (size < QRNG_STATS_SAMPLE_SIZE) {
+		if (++shard->stats_tick < QRNG_STATS_SAMPLE_RATE) return 0;
+		shard->stats_tick = 0;
+	}
+	return ext_stats_now();
+}
+
+/** Count a call of function 'fn' started with ext_stats_begin() */
+static inline void ext_stats_call(Qrng_shard_t* shard, int fn, u64 t0, size_t bytes, int ret)
+{
+	if (shard)
+		ext_stats_add(&shard->stats[fn], t0 != 0, t0 ? ext_stats_now() - t0 : 0, bytes, ret, false);
+}
+
+/**
+* Add the counters of a shard to the handle's, the caller holds the
+* shard_mutex of the handle
+*/
+void ext_stats_release(Qrng_shard_t* shard);
+
+/** Extractor of qrng_get_extracted(), see qrng_extract.cpp */
+bool ext_extract_valid(double min_entropy);
+void ext_extract_stop(Qrng_ext_ctx* ctx);
+
+/** Stop the server of qrng_shm_start(), if any */
+void ext_shm_stop(Qrng_ext_ctx* ctx);
+
+/** Stop the server of qrng_net_start(), if any */
+void ext_net_stop(Qrng_ext_ctx* ctx);
+
+/** Health tests of the handle, see qrng_health_get_stats() */
+int ext_health_start(Qrng_ext_ctx* ctx, double raw_entropy);
+void ext_health_stop(Qrng_ext_ctx* ctx);
+bool ext_health_failed(const Qrng_health* health);
+
+/**
+* Test a transfer of the device
+*
+* @return	QRNG_SUCCESS, QRNG_ERROR_INSUFFICIENT_ENTHROPY on failure
+*/
+int ext_health_check(Qrng_health* health, const u8* buf, size_t size, int channel);
+
+/** Unlock the buffers registered with the handle */
+void ext_buffers_release(Qrng_ext_ctx* ctx);
+
+/** Read 'size' bytes of the hashed channel from the prefetch ring */
+int ext_prefetch_read(Qrng_ring* ring, u8* buf, size_t size, size_t* read_len);
+
+/**
+* qrng_get() on a handle that may be shared by several threads, the
+* status is copied to the calling thread's shard
+*/
+int ext_core_get(QRNG* qrng, Qrng_shard_t* shard, u8* buf, s32 size, s32* bytes_read);
+
+bool ext_src_take_slow(Qrng_src_t* src, u8* out, size_t n);
+int ext_pool_refill(Qrng_shard_t* shard, size_t n);
+void ext_pool_free(Qrng_pool_t* pool);
+
+/**
+* Take 'n' bytes from the entropy pool
+*
+* @return	pointer to the bytes, NULL if the pool couldn't be refilled
+*/
+static inline const u8* ext_pool_take(Qrng_shard_t* shard, size_t n)
+{
+	Qrng_pool_t* pool = &shard->pool;
+
+	if (pool->len - pool->pos < n && ext_pool_refill(shard, n) != QRNG_SUCCESS)
+		return nullptr;
+
+	const u8* ret = pool->data + pool->pos;
+	pool->pos += n;
+	return ret;
+}
+
+static inline void ext_src_init(Qrng_src_t* src, QRNG* qrng)
+{
+	src->qrng = qrng;
+	src->shard = ext_shard(qrng);
+	src->pooled = (src->shard != nullptr);
+	src->status = QRNG_SUCCESS;
+	src->taken = 0;
+	src->pos = src->len = 0;
+}
+
+/**
+* Take 'n' (up to 64) bytes from the source
+*
+* @return	false if the bytes couldn't be read, the error is in src->status
+*/
+static inline bool ext_src_take(Qrng_src_t* src, u8* out, size_t n)
+{
+	const u8* p = src->pooled ? ext_pool_take(src->shard, n) : nullptr;
+	if (!p) return ext_src_take_slow(src, out, n);
+
+	memcpy(out, p, n);
+	src->taken += n;
+	return true;
+}
@@ -0,0 +1,465 @@
+/**
+* @file 	qrng_extract.cpp
+* @brief 	Toeplitz extractor over the raw entropy samples
+*
+* A block of n = 16 * QRNG_EXTRACT_BLOCK_SAMPLES input bits x gives the
+* m output bits y = T x over GF(2), T the m x n Toeplitz matrix of the
+* seed s: y_i = sum_j s_(i - j + n) x_j. That is the middle of the
+* carry-less product s(z) x(z), computed a 64 bits word of y at a time:
+* each output word is the sum of the 128 bits products of the input
+* words with a window of the seed, the high half carried to the next
+* word. The seed is kept reversed so that both operands of the products
+* are read forward.
+*
+* The blocks are independent and shared between the caller and a pool
+* of worker threads, the raw samples are read by the caller only.
+*
+* @date		17/10/2026
+*
+* Copyright(c) Quantum Dice. All rights reserved.
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <mutex>
+#include <new>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "qrng_ext_internal.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#	include <immintrin.h>
+#	define QRNG_X86_KERNELS
+#endif
+
+#define EXTRACT_IN_WORDS	(QRNG_EXTRACT_BLOCK_SAMPLES * 16 / 64)
+#define EXTRACT_SEED_WORDS	(QRNG_EXTRACT_SEED_SIZE / 8)
+#define EXTRACT_MAX_OUT_WORDS	(EXTRACT_IN_WORDS - 2 * QRNG_EXTRACT_EPS_LOG2 / 64)
+
+/** Blocks read from the device per batch */
+#define EXTRACT_BATCH_BLOCKS	64
+
+static_assert(EXTRACT_IN_WORDS % 16 == 0, "the kernels read 16 input words per step");
+static_assert(EXTRACT_SEED_WORDS >= EXTRACT_IN_WORDS + EXTRACT_MAX_OUT_WORDS,
+			"QRNG_EXTRACT_SEED_SIZE too small for the largest output");
+
+/**
+* Carry-less product of the input words with a window of the reversed
+* seed: sum of r[j] * x[j] for j < EXTRACT_IN_WORDS, as lo and hi words
+*/
+typedef void (*Extract_row_fn)(const u64* r, const u8* x, u64* lo, u64* hi);
+
+struct Qrng_extractor {
+	Extract_row_fn row;
+	double min_entropy;
+	size_t out_words;
+	size_t threads;
+	u64 seed[EXTRACT_SEED_WORDS];	/**< first in + out words of the seed, reversed */
+
+	std::mutex mutex;				/**< one reader at a time */
+	std::vector<u16> samples;
+	u8 tail[EXTRACT_MAX_OUT_WORDS * 8];	/**< output of the last block not read yet */
+	size_t tail_pos;
+	size_t tail_len;
+	std::atomic<u64> samples_hashed;
+	std::atomic<u64> bytes;
+
+	std::vector<std::thread> workers;
+	std::mutex job_mutex;
+	std::condition_variable job_cv;
+	std::condition_variable done_cv;
+	bool stop;
+	u64 job_gen;
+	size_t job_active;			/**< workers still on the job */
+	const u16* job_in;
+	u8* job_out;
+	size_t job_blocks;
+	std::atomic<size_t> job_next;
+};
+
+static inline void clmul64(u64 a, u64 b, u64* lo, u64* hi)
+{
+	u64 l = 0;
+	u64 h = 0;
+	for (int i = 0; i < 64; i++) {
+		if (!((b >> i) & 1)) continue;
+		l ^= a << i;
+		if (i) h ^= a >> (64 - i);
+	}
+	*lo = l;
+	*hi = h;
+}
+
+static void row_scalar(const u64* r, const u8* x, u64* lo, u64* hi)
+{
+	u64 l = 0;
+	u64 h = 0;
+	for (size_t j = 0; j < EXTRACT_IN_WORDS; j++) {
+		u64 w, pl, ph;
+		memcpy(&w, x + j * 8, sizeof(w));
+		clmul64(r[j], w, &pl, &ph);
+		l ^= pl;
+		h ^= ph;
+	}
+	*lo = l;
+	*hi = h;
+}
+
+#ifdef QRNG_X86_KERNELS
+
+__attribute__((target("pclmul")))
+static void row_pclmul(const u64* r, const u8* x, u64* lo, u64* hi)
+{
+	__m128i acc[4] = { _mm_setzero_si128(), _mm_setzero_si128(),
+					_mm_setzero_si128(), _mm_setzero_si128() };
+
+	/** 4 independent sums to cover the latency of the multiplications */
+	for (size_t j = 0; j < EXTRACT_IN_WORDS; j += 8) {
+		for (int k = 0; k < 4; k++) {
+			__m128i s = _mm_loadu_si128((const __m128i*)(r + j + 2 * k));
+			__m128i v = _mm_loadu_si128((const __m128i*)(x + (j + 2 * k) * 8));
+			acc[k] = _mm_xor_si128(acc[k], _mm_xor_si128(
+					_mm_clmulepi64_si128(s, v, 0x00), _mm_clmulepi64_si128(s, v, 0x11)));
+		}
+	}
+
+	__m128i a = _mm_xor_si128(_mm_xor_si128(acc[0], acc[1]), _mm_xor_si128(acc[2], acc[3]));
+	*lo = (u64)_mm_cvtsi128_si64(a);
+	*hi = (u64)_mm_cvtsi128_si64(_mm_unpackhi_epi64(a, a));
+}
+
+__attribute__((target("avx2,vpclmulqdq")))
+static void row_vpclmul_avx2(const u64* r, const u8* x, u64* lo, u64* hi)
+{
+	__m256i acc[2] = { _mm256_setzero_si256(), _mm256_setzero_si256() };
+
+	for (size_t j = 0; j < EXTRACT_IN_WORDS; j += 8) {
+		for (int k = 0; k < 2; k++) {
+			__m256i s = _mm256_loadu_si256((const __m256i*)(r + j + 4 * k));
+			__m256i v = _mm256_loadu_si256((const __m256i*)(x + (j + 4 * k) * 8));
+			acc[k] = _mm256_xor_si256(acc[k], _mm256_xor_si256(
+					_mm256_clmulepi64_epi128(s, v, 0x00), _mm256_clmulepi64_epi128(s, v, 0x11)));
+		}
+	}
+
+	__m256i a = _mm256_xor_si256(acc[0], acc[1]);
+	__m128i b = _mm_xor_si128(_mm256_castsi256_si128(a), _mm256_extracti128_si256(a, 1));
+	*lo = (u64)_mm_cvtsi128_si64(b);
+	*hi = (u64)_mm_cvtsi128_si64(_mm_unpackhi_epi64(b, b));
+}
+
+__attribute__((target("avx512f,vpclmulqdq")))
+static void row_vpclmul_avx512(const u64* r, const u8* x, u64* lo, u64* hi)
+{
+	__m512i acc[2] = { _mm512_setzero_si512(), _mm512_setzero_si512() };
+
+	for (size_t j = 0; j < EXTRACT_IN_WORDS; j += 16) {
+		for (int k = 0; k < 2; k++) {
+			__m512i s = _mm512_loadu_si512(r + j + 8 * k);
+			__m512i v = _mm512_loadu_si512(x + (j + 8 * k) * 8);
+			acc[k] = _mm512_xor_si512(acc[k], _mm512_xor_si512(
+					_mm512_clmulepi64_epi128(s, v, 0x00), _mm512_clmulepi64_epi128(s, v, 0x11)));
+		}
+	}
+
+	alignas(64) u64 a[8];
+	_mm512_store_si512(a, _mm512_xor_si512(acc[0], acc[1]));
+	*lo = a[0] ^ a[2] ^ a[4] ^ a[6];
+	*hi = a[1] ^ a[3] ^ a[5] ^ a[7];
+}
+
+#endif
+
+static Extract_row_fn select_row()
+{
+#ifdef QRNG_X86_KERNELS
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("vpclmulqdq") && __builtin_cpu_supports("avx512f"))
+		return row_vpclmul_avx512;
+	if (__builtin_cpu_supports("vpclmulqdq") && __builtin_cpu_supports("avx2"))
+		return row_vpclmul_avx2;
+	if (__builtin_cpu_supports("pclmul")) return row_pclmul;
+#endif
+	return row_scalar;
+}
+
+/** Output words of a block, 0 if the min-entropy is out of range */
+static size_t extract_out_words(double min_entropy)
+{
+	if (!(min_entropy > 0.0 && min_entropy <= 16.0)) return 0;
+
+	double bits = std::floor(QRNG_EXTRACT_BLOCK_SAMPLES * min_entropy) - 2 * QRNG_EXTRACT_EPS_LOG2;
+	return (bits < 64) ? 0 : std::min((size_t)bits / 64, (size_t)EXTRACT_MAX_OUT_WORDS);
+}
+
+bool ext_extract_valid(double min_entropy)
+{
+	return min_entropy == 0.0 || extract_out_words(min_entropy) > 0;
+}
+
+/** Output word k sums the row of seed window out_words - 1 - k, plus the carry of word k - 1 */
+static void extract_block(const Qrng_extractor* ext, const u16* in, u8* out)
+{
+	const u8* x = (const u8*)in;
+	u64 lo, carry;
+	ext->row(ext->seed + ext->out_words, x, &lo, &carry);
+
+	for (size_t k = 0; k < ext->out_words; k++) {
+		u64 hi;
+		ext->row(ext->seed + ext->out_words - 1 - k, x, &lo, &hi);
+		lo ^= carry;
+		memcpy(out + k * 8, &lo, sizeof(lo));
+		carry = hi;
+	}
+}
+
+static void extract_blocks(Qrng_extractor* ext, const u16* in, u8* out, size_t blocks)
+{
+	size_t out_bytes = ext->out_words * 8;
+	for (size_t b = ext->job_next.fetch_add(1); b < blocks; b = ext->job_next.fetch_add(1))
+		extract_block(ext, in + b * QRNG_EXTRACT_BLOCK_SAMPLES, out + b * out_bytes);
+}
+
+static void extract_worker(Qrng_extractor* ext)
+{
+	u64 seen = 0;
+
+	for (;;) {
+		const u16* in;
+		u8* out;
+		size_t blocks;
+		{
+			std::unique_lock<std::mutex> lock(ext->job_mutex);
+			ext->job_cv.wait(lock, [&]() { return ext->stop || ext->job_gen != seen; });
+			if (ext->stop) return;
+			seen = ext->job_gen;
+			in = ext->job_in;
+			out = ext->job_out;
+			blocks = ext->job_blocks;
+		}
+
+		extract_blocks(ext, in, out, blocks);
+
+		std::lock_guard<std::mutex> lock(ext->job_mutex);
+		if (--ext->job_active == 0) ext->done_cv.notify_one();
+	}
+}
+
+/** Hash 'blocks' blocks, with the workers when there are several */
+static void extract_run(Qrng_extractor* ext, const u16* in, u8* out, size_t blocks)
+{
+	if (ext->workers.empty() || blocks < 2) {
+		ext->job_next.store(0);
+		extract_blocks(ext, in, out, blocks);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(ext->job_mutex);
+		ext->job_in = in;
+		ext->job_out = out;
+		ext->job_blocks = blocks;
+		ext->job_next.store(0);
+		ext->job_active = ext->workers.size();
+		ext->job_gen++;
+	}
+	ext->job_cv.notify_all();
+
+	extract_blocks(ext, in, out, blocks);
+
+	std::unique_lock<std::mutex> lock(ext->job_mutex);
+	ext->done_cv.wait(lock, [&]() { return ext->job_active == 0; });
+}
+
+static void extract_seed(Qrng_extractor* ext, const u8* seed)
+{
+	size_t words = EXTRACT_IN_WORDS + ext->out_words;
+	for (size_t i = 0; i < words; i++)
+		memcpy(&ext->seed[words - 1 - i], seed + i * 8, 8);
+}
+
+/** Seed from the OS, independent of the device */
+static void extract_seed_default(Qrng_extractor* ext)
+{
+	std::vector<u8> seed(QRNG_EXTRACT_SEED_SIZE);
+	auto fill = [&](std::random_device& rd) {
+		for (size_t i = 0; i < seed.size(); i += sizeof(uint32_t)) {
+			uint32_t w = rd();
+			memcpy(&seed[i], &w, sizeof(w));
+		}
+	};
+
+	try {
+		std::random_device rd("/dev/urandom");
+		fill(rd);
+	}
+	catch (const std::exception&) {
+		std::random_device rd;
+		fill(rd);
+	}
+	extract_seed(ext, seed.data());
+}
+
+static void extract_free(Qrng_extractor* ext)
+{
+	{
+		std::lock_guard<std::mutex> lock(ext->job_mutex);
+		ext->stop = true;
+	}
+	ext->job_cv.notify_all();
+	for (std::thread& t : ext->workers) t.join();
+
+	memset(ext->tail, 0, sizeof(ext->tail));
+	delete ext;
+}
+
+static Qrng_extractor* extract_get(Qrng_ext_ctx* ctx)
+{
+	Qrng_extractor* ext = ctx->extractor.load(std::memory_order_acquire);
+	if (ext) return ext;
+
+	std::lock_guard<std::mutex> lock(ctx->extract_mutex);
+	ext = ctx->extractor.load(std::memory_order_relaxed);
+	if (ext) return ext;
+
+	ext = new (std::nothrow) Qrng_extractor();
+	if (!ext) return nullptr;
+
+	ext->row = select_row();
+	ext->min_entropy = ctx->param.extract_min_entropy;
+	if (ext->min_entropy == 0.0) ext->min_entropy = QRNG_HEALTH_DEFAULT_RAW_ENTROPY;
+	ext->out_words = extract_out_words(ext->min_entropy);
+	ext->tail_pos = ext->tail_len = 0;
+	ext->samples_hashed = 0;
+	ext->bytes = 0;
+	ext->stop = false;
+	ext->job_gen = 0;
+	ext->job_active = 0;
+	ext->job_next = 0;
+
+	size_t n = ctx->param.extract_threads;
+	if (n == 0) n = std::max(std::thread::hardware_concurrency(), 1u);
+	n = std::min(n, (size_t)QRNG_EXTRACT_MAX_THREADS);
+
+	try {
+		ext->samples.resize(EXTRACT_BATCH_BLOCKS * QRNG_EXTRACT_BLOCK_SAMPLES);
+		extract_seed_default(ext);
+	}
+	catch (...) {
+		extract_free(ext);
+		return nullptr;
+	}
+
+	try {
+		for (size_t i = 1; i < n; i++) ext->workers.emplace_back(extract_worker, ext);
+	}
+	catch (...) {
+		/** fewer workers than asked still work, the caller hashes too */
+	}
+	ext->threads = ext->workers.size() + 1;
+
+	ctx->extractor.store(ext, std::memory_order_release);
+	return ext;
+}
+
+void ext_extract_stop(Qrng_ext_ctx* ctx)
+{
+	Qrng_extractor* ext = ctx->extractor.load(std::memory_order_acquire);
+	if (!ext) return;
+
+	extract_free(ext);
+	ctx->extractor.store(nullptr, std::memory_order_relaxed);
+}
+
+int qrng_get_extracted(QRNG* qrng, u8* data, size_t size, size_t* bytes_read)
+{
+	if (bytes_read) *bytes_read = 0;
+	if (!data) return QRNG_ERROR_NULL_PTR;
+
+	Qrng_ext_ctx* ctx = ext_ctx(qrng);
+	Qrng_shard_t* shard = ext_shard(qrng);
+	if (!ctx || !shard) return QRNG_ERROR_NOT_EXT_HANDLE;
+
+	Qrng_extractor* ext = extract_get(ctx);
+	if (!ext) return QRNG_ERROR_INTERNAL_MEMORY;
+
+	u64 t0 = ext_stats_begin(shard, size);
+	std::lock_guard<std::mutex> lock(ext->mutex);
+	size_t block_bytes = ext->out_words * 8;
+	size_t done = 0;
+	int ret = QRNG_SUCCESS;
+
+	while (done < size) {
+		if (ext->tail_pos < ext->tail_len) {
+			size_t n = std::min(ext->tail_len - ext->tail_pos, size - done);
+			memcpy(data + done, ext->tail + ext->tail_pos, n);
+			ext->tail_pos += n;
+			done += n;
+			continue;
+		}
+
+		/** whole blocks are hashed straight into the caller's buffer */
+		size_t blocks = std::min((size - done) / block_bytes, (size_t)EXTRACT_BATCH_BLOCKS);
+		bool direct = blocks > 0;
+		if (!direct) blocks = 1;
+
+		size_t n = 0;
+		ret = ext_read_raw(shard, ext->samples.data(), blocks * QRNG_EXTRACT_BLOCK_SAMPLES, &n);
+		blocks = n / QRNG_EXTRACT_BLOCK_SAMPLES;
+
+		extract_run(ext, ext->samples.data(), direct ? data + done : ext->tail, blocks);
+		ext->samples_hashed += blocks * QRNG_EXTRACT_BLOCK_SAMPLES;
+
+		if (direct) done += blocks * block_bytes;
+		else if (blocks) {
+			ext->tail_pos = 0;
+			ext->tail_len = block_bytes;
+		}
+		if (ret != QRNG_SUCCESS) break;
+	}
+
+	ext->bytes += done;
+	if (bytes_read) *bytes_read = done;
+	ext_stats_call(shard, QRNG_STATS_FN_EXTRACTED, t0, done, ret);
+	return ret;
+}
+
+int qrng_extract_set_seed(QRNG* qrng, const u8* seed, size_t size)
+{
+	if (!seed) return QRNG_ERROR_NULL_PTR;
+	if (size < QRNG_EXTRACT_SEED_SIZE) return QRNG_ERROR_INVALID_PARAM;
+
+	Qrng_ext_ctx* ctx = ext_ctx(qrng);
+	if (!ctx) return QRNG_ERROR_NOT_EXT_HANDLE;
+
+	Qrng_extractor* ext = extract_get(ctx);
+	if (!ext) return QRNG_ERROR_INTERNAL_MEMORY;
+
+	std::lock_guard<std::mutex> lock(ext->mutex);
+	extract_seed(ext, seed);
+	ext->tail_pos = ext->tail_len = 0;
+	return QRNG_SUCCESS;
+}
+
+int qrng_extract_get_stats(QRNG* qrng, Qrng_extract_stats* stats)
+{
+	if (!stats) return QRNG_ERROR_NULL_PTR;
+
+	Qrng_ext_ctx* ctx = ext_ctx(qrng);
+	if (!ctx) return QRNG_ERROR_NOT_EXT_HANDLE;
+
+	Qrng_extractor* ext = extract_get(ctx);
+	if (!ext) return QRNG_ERROR_INTERNAL_MEMORY;
+
+	stats->min_entropy = ext->min_entropy;
+	stats->block_bits = QRNG_EXTRACT_BLOCK_SAMPLES * 16;
+	stats->output_bits = (uint32_t)(ext->out_words * 64);
+	stats->threads = (uint32_t)ext->threads;
+	stats->samples = ext->samples_hashed.load();
+	stats->bytes = ext->bytes.load();
+	return QRNG_SUCCESS;
+}
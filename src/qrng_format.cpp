@@ -0,0 +1,397 @@
+/**
+* @file 	qrng_format.cpp
+* @brief 	Bulk text encodings: decimal doubles, hex, base64 and integers
+*
+* The doubles in (-1, 1) with up to 19 digits, i.e. all the values of
+* qrng_get_doubles() and qrng_urand(), are formatted exactly from their
+* mantissa with 128 bits integers, rounded half to even like printf().
+* The other values and the shortest form go through std::to_chars()
+* (Ryu). Hex and base64 have SSSE3 and AVX2 kernels returning exactly
+* the text of the scalar ones, the fastest kernel supported by the CPU
+* is selected on the first call.
+*
+* @date		17/10/2026
+*
+* Copyright(c) Quantum Dice. All rights reserved.
+*/
+
+#include <charconv>
+#include <cstdio>
+
+#include "qrng_ext_internal.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#	include <immintrin.h>
+#	define QRNG_X86_KERNELS
+#endif
+
+/** Digits after the point of QRNG_FORMAT_DECIMAL */
+#define FORMAT_MAX_PRECISION	100
+#define FORMAT_FAST_PRECISION	19
+
+typedef void (*Encode_fn)(const u8* data, size_t size, char* text);
+
+static const char hex_digits[] = "0123456789abcdef";
+static const char base64_digits[] =
+	"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static const char digit_pairs[] =
+	"00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+	"40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+	"8081828384858687888990919293949596979899";
+
+static const u64 pow10_u64[FORMAT_FAST_PRECISION + 1] = {
+	1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL,
+	100000000ULL, 1000000000ULL, 10000000000ULL, 100000000000ULL, 1000000000000ULL,
+	10000000000000ULL, 100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL,
+	100000000000000000ULL, 1000000000000000000ULL, 10000000000000000000ULL,
+};
+
+/** Exactly 'n' digits of 'v' < 10^n, zero padded, 32 bits arithmetic per 8 digits */
+static inline void write_digits(char* out, u64 v, int n)
+{
+	while (n > 8) {
+		n -= 8;
+		uint32_t low = (uint32_t)(v % 100000000);
+		v /= 100000000;
+		for (int k = 6; k >= 0; k -= 2) {
+			memcpy(out + n + k, &digit_pairs[(low % 100) * 2], 2);
+			low /= 100;
+		}
+	}
+	uint32_t w = (uint32_t)v;
+	while (n >= 2) {
+		n -= 2;
+		memcpy(out + n, &digit_pairs[(w % 100) * 2], 2);
+		w /= 100;
+	}
+	if (n) out[0] = (char)('0' + w % 10);
+}
+
+/**
+* "%.<p>f\n" of |v| < 1 with p <= 19: v = m * 2^-shift, so the digits
+* are m * 10^p / 2^shift, which stays below 2^117.
+*/
+static inline size_t format_fixed_small(char* out, u64 bits, int p)
+{
+	int exp = (int)((bits >> 52) & 0x7ff);
+	u64 m = bits & ((1ULL << 52) - 1);
+	int shift = 1074;
+	if (exp) {
+		m |= 1ULL << 52;
+		shift = 1075 - exp;
+	}
+
+	u64 q = 0;
+	if (shift < 118) {
+		unsigned __int128 n = (unsigned __int128)m * pow10_u64[p];
+		q = (u64)(n >> shift);
+		unsigned __int128 rem = n - ((unsigned __int128)q << shift);
+		unsigned __int128 half = (unsigned __int128)1 << (shift - 1);
+		if (rem > half || (rem == half && (q & 1))) q++;
+	}
+
+	char* o = out;
+	if (bits >> 63) *o++ = '-';
+	/** 0.99... may round up to 1 */
+	u64 units = (q >= pow10_u64[p]);
+	*o++ = (char)('0' + units);
+	if (p) {
+		*o++ = '.';
+		write_digits(o, q - units * pow10_u64[p], p);
+		o += p;
+	}
+	*o++ = '\n';
+	return o - out;
+}
+
+/** Any other value, or the shortest form if p < 0 */
+static size_t format_double_any(char* out, size_t size, double v, int p)
+{
+#ifdef __cpp_lib_to_chars
+	std::to_chars_result r = (p < 0) ? std::to_chars(out, out + size, v)
+			: std::to_chars(out, out + size, v, std::chars_format::fixed, p);
+	if (r.ec != std::errc()) return 0;
+	size_t n = r.ptr - out;
+#else
+	int len = (p < 0) ? snprintf(out, size, "%.17g", v) : snprintf(out, size, "%.*f", p, v);
+	if (len < 0 || (size_t)len >= size) return 0;
+	size_t n = len;
+#endif
+	if (n >= size) return 0;
+	out[n] = '\n';
+	return n + 1;
+}
+
+static void format_doubles(const double* values, size_t count, int p, char* text,
+						size_t size, size_t* count_done, size_t* len)
+{
+	/** sign, "0.", digits and newline */
+	const size_t fast_max = p + 4;
+	char tmp[FORMAT_MAX_PRECISION + 320];
+	size_t pos = 0;
+	size_t i = 0;
+
+	for (; i < count; i++) {
+		u64 bits;
+		memcpy(&bits, &values[i], sizeof(bits));
+		bool fast = p >= 0 && p <= FORMAT_FAST_PRECISION && ((bits >> 52) & 0x7ff) < 1023;
+
+		if (fast && size - pos >= fast_max) {
+			pos += format_fixed_small(text + pos, bits, p);
+			continue;
+		}
+		size_t n = fast ? format_fixed_small(tmp, bits, p)
+				: format_double_any(tmp, sizeof(tmp), values[i], p);
+		if (!n || n > size - pos) break;
+		memcpy(text + pos, tmp, n);
+		pos += n;
+	}
+	*count_done = i;
+	*len = pos;
+}
+
+static void format_uints(const u8* data, size_t count, int width, char* text,
+						size_t size, size_t* count_done, size_t* len)
+{
+	/** digits of the largest value of each width */
+	const int digits = (width == 1) ? 3 : (width == 2) ? 5 : (width == 4) ? 10 : 20;
+	size_t n = std::min(count, size / (digits + 1));
+
+	for (size_t i = 0; i < n; i++) {
+		u64 v;
+		if (width == 1) v = data[i];
+		else if (width == 2) { u16 x; memcpy(&x, data + i * 2, 2); v = x; }
+		else if (width == 4) { uint32_t x; memcpy(&x, data + i * 4, 4); v = x; }
+		else memcpy(&v, data + i * 8, 8);
+
+		char* o = text + i * (digits + 1);
+		write_digits(o, v, digits);
+		o[digits] = '\n';
+	}
+	*count_done = n;
+	*len = n * (digits + 1);
+}
+
+static void hex_scalar(const u8* data, size_t size, char* text)
+{
+	for (size_t i = 0; i < size; i++) {
+		text[2 * i] = hex_digits[data[i] >> 4];
+		text[2 * i + 1] = hex_digits[data[i] & 0xf];
+	}
+}
+
+/** Whole groups of 3 bytes */
+static void base64_scalar(const u8* data, size_t size, char* text)
+{
+	for (size_t i = 0; i + 3 <= size; i += 3) {
+		uint32_t t = ((uint32_t)data[i] << 16) | ((uint32_t)data[i + 1] << 8) | data[i + 2];
+		char* o = text + i / 3 * 4;
+		o[0] = base64_digits[t >> 18];
+		o[1] = base64_digits[(t >> 12) & 0x3f];
+		o[2] = base64_digits[(t >> 6) & 0x3f];
+		o[3] = base64_digits[t & 0x3f];
+	}
+}
+
+#ifdef QRNG_X86_KERNELS
+
+/** Nibbles to digits with one byte shuffle per 16 nibbles */
+__attribute__((target("ssse3")))
+static void hex_ssse3(const u8* data, size_t size, char* text)
+{
+	const __m128i lut = _mm_loadu_si128((const __m128i*)hex_digits);
+	const __m128i mask = _mm_set1_epi8(0x0f);
+	size_t i = 0;
+
+	for (; i + 16 <= size; i += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i*)(data + i));
+		__m128i hi = _mm_shuffle_epi8(lut, _mm_and_si128(_mm_srli_epi16(v, 4), mask));
+		__m128i lo = _mm_shuffle_epi8(lut, _mm_and_si128(v, mask));
+		_mm_storeu_si128((__m128i*)(text + 2 * i), _mm_unpacklo_epi8(hi, lo));
+		_mm_storeu_si128((__m128i*)(text + 2 * i + 16), _mm_unpackhi_epi8(hi, lo));
+	}
+	hex_scalar(data + i, size - i, text + 2 * i);
+}
+
+__attribute__((target("avx2")))
+static void hex_avx2(const u8* data, size_t size, char* text)
+{
+	const __m256i lut = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)hex_digits));
+	const __m256i mask = _mm256_set1_epi8(0x0f);
+	size_t i = 0;
+
+	for (; i + 32 <= size; i += 32) {
+		__m256i v = _mm256_loadu_si256((const __m256i*)(data + i));
+		__m256i hi = _mm256_shuffle_epi8(lut, _mm256_and_si256(_mm256_srli_epi16(v, 4), mask));
+		__m256i lo = _mm256_shuffle_epi8(lut, _mm256_and_si256(v, mask));
+		/** the unpacks interleave within each 128 bits lane */
+		__m256i a = _mm256_unpacklo_epi8(hi, lo);
+		__m256i b = _mm256_unpackhi_epi8(hi, lo);
+		_mm256_storeu_si256((__m256i*)(text + 2 * i), _mm256_permute2x128_si256(a, b, 0x20));
+		_mm256_storeu_si256((__m256i*)(text + 2 * i + 32), _mm256_permute2x128_si256(a, b, 0x31));
+	}
+	hex_ssse3(data + i, size - i, text + 2 * i);
+}
+
+/**
+* Base64 after W. Mula and D. Lemire: each group of 3 bytes is spread
+* over 32 bits, the four 6 bits fields are moved to one byte each with
+* two multiplications, then mapped to their digit with an offset table
+* indexed by range (A-Z, a-z, 0-9, '+', '/').
+*/
+__attribute__((target("ssse3")))
+static inline __m128i base64_split_ssse3(__m128i v)
+{
+	const __m128i in = _mm_shuffle_epi8(v, _mm_setr_epi8(
+			1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10));
+	const __m128i t0 = _mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00));
+	const __m128i t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+	const __m128i t2 = _mm_and_si128(in, _mm_set1_epi32(0x003f03f0));
+	const __m128i t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+	return _mm_or_si128(t1, t3);
+}
+
+__attribute__((target("ssse3")))
+static inline __m128i base64_digits_ssse3(__m128i v)
+{
+	const __m128i offsets = _mm_setr_epi8(
+			65, 71, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -19, -16, 0, 0);
+	__m128i idx = _mm_subs_epu8(v, _mm_set1_epi8(51));
+	idx = _mm_sub_epi8(idx, _mm_cmpgt_epi8(v, _mm_set1_epi8(25)));
+	return _mm_add_epi8(v, _mm_shuffle_epi8(offsets, idx));
+}
+
+/** 12 bytes per 16 bytes load */
+__attribute__((target("ssse3")))
+static void base64_ssse3(const u8* data, size_t size, char* text)
+{
+	size_t i = 0;
+
+	for (; i + 16 <= size; i += 12) {
+		__m128i v = _mm_loadu_si128((const __m128i*)(data + i));
+		_mm_storeu_si128((__m128i*)(text + i / 3 * 4), base64_digits_ssse3(base64_split_ssse3(v)));
+	}
+	base64_scalar(data + i, size - i, text + i / 3 * 4);
+}
+
+__attribute__((target("avx2")))
+static void base64_avx2(const u8* data, size_t size, char* text)
+{
+	const __m256i shuffle = _mm256_setr_epi8(
+			1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10,
+			1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+	const __m256i offsets = _mm256_setr_epi8(
+			65, 71, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -19, -16, 0, 0,
+			65, 71, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -19, -16, 0, 0);
+	size_t i = 0;
+
+	/** bytes 0-11 in the low lane and 12-23 in the high one */
+	for (; i + 28 <= size; i += 24) {
+		__m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(
+				_mm_loadu_si128((const __m128i*)(data + i))),
+				_mm_loadu_si128((const __m128i*)(data + i + 12)), 1);
+		__m256i in = _mm256_shuffle_epi8(v, shuffle);
+		__m256i t1 = _mm256_mulhi_epu16(_mm256_and_si256(in, _mm256_set1_epi32(0x0fc0fc00)),
+				_mm256_set1_epi32(0x04000040));
+		__m256i t3 = _mm256_mullo_epi16(_mm256_and_si256(in, _mm256_set1_epi32(0x003f03f0)),
+				_mm256_set1_epi32(0x01000010));
+		__m256i s = _mm256_or_si256(t1, t3);
+
+		__m256i idx = _mm256_subs_epu8(s, _mm256_set1_epi8(51));
+		idx = _mm256_sub_epi8(idx, _mm256_cmpgt_epi8(s, _mm256_set1_epi8(25)));
+		s = _mm256_add_epi8(s, _mm256_shuffle_epi8(offsets, idx));
+		_mm256_storeu_si256((__m256i*)(text + i / 3 * 4), s);
+	}
+	base64_ssse3(data + i, size - i, text + i / 3 * 4);
+}
+
+#endif
+
+static Encode_fn select_hex()
+{
+#ifdef QRNG_X86_KERNELS
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) return hex_avx2;
+	if (__builtin_cpu_supports("ssse3")) return hex_ssse3;
+#endif
+	return hex_scalar;
+}
+
+static Encode_fn select_base64()
+{
+#ifdef QRNG_X86_KERNELS
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) return base64_avx2;
+	if (__builtin_cpu_supports("ssse3")) return base64_ssse3;
+#endif
+	return base64_scalar;
+}
+
+static void format_hex(const u8* data, size_t count, char* text, size_t size,
+					size_t* count_done, size_t* len)
+{
+	static const Encode_fn encode = select_hex();
+	size_t n = std::min(count, size / 2);
+
+	encode(data, n, text);
+	*count_done = n;
+	*len = 2 * n;
+}
+
+/** Whole groups only, the padded last one once all the bytes fit */
+static void format_base64(const u8* data, size_t count, char* text, size_t size,
+						size_t* count_done, size_t* len)
+{
+	static const Encode_fn encode = select_base64();
+	size_t groups = std::min(count / 3, size / 4);
+
+	encode(data, groups * 3, text);
+	size_t n = groups * 3;
+	size_t pos = groups * 4;
+
+	size_t rest = count - n;
+	if (groups == count / 3 && rest && size - pos >= 4) {
+		uint32_t t = (uint32_t)data[n] << 16;
+		if (rest == 2) t |= (uint32_t)data[n + 1] << 8;
+		text[pos] = base64_digits[t >> 18];
+		text[pos + 1] = base64_digits[(t >> 12) & 0x3f];
+		text[pos + 2] = (rest == 2) ? base64_digits[(t >> 6) & 0x3f] : '=';
+		text[pos + 3] = '=';
+		n = count;
+		pos += 4;
+	}
+	*count_done = n;
+	*len = pos;
+}
+
+int qrng_format(int format, int param, const void* data, size_t count, char* text,
+				size_t size, size_t* count_done, size_t* len)
+{
+	if ((!data && count) || (!text && size)) return QRNG_ERROR_NULL_PTR;
+
+	size_t done = 0;
+	size_t text_len = 0;
+	switch (format) {
+	case QRNG_FORMAT_DECIMAL:
+		if (param > FORMAT_MAX_PRECISION) return QRNG_ERROR_INVALID_PARAM;
+		format_doubles((const double*)data, count, param, text, size, &done, &text_len);
+		break;
+	case QRNG_FORMAT_HEX:
+		format_hex((const u8*)data, count, text, size, &done, &text_len);
+		break;
+	case QRNG_FORMAT_BASE64:
+		format_base64((const u8*)data, count, text, size, &done, &text_len);
+		break;
+	case QRNG_FORMAT_UINT:
+		if (param != 1 && param != 2 && param != 4 && param != 8) return QRNG_ERROR_INVALID_PARAM;
+		format_uints((const u8*)data, count, param, text, size, &done, &text_len);
+		break;
+	default:
+		return QRNG_ERROR_INVALID_PARAM;
+	}
+
+	if (count_done) *count_done = done;
+	if (len) *len = text_len;
+	return QRNG_SUCCESS;
+}
@@ -0,0 +1,220 @@
+/**
+* @file 	qrng_frame.cpp
+* @brief 	Hashed and raw data readers working on the device transfers
+*
+* Same output as qrng_get(), the frames are read into a staging buffer
+* and whole frames are unpacked eight bytes at a time instead of going
+* through the per frame memcmp/memcpy loop of the QRNG API library.
+* The raw channel is staged the same way, same output as
+* qrng_get_raw_ent().
+*
+* The staging buffers are refilled with one device transfer of
+* QRNG_DMA_CHUNK_SIZE bytes. Requests of QRNG_DIRECT_MIN_SIZE bytes
+* or more skip them: the device data is read straight into the
+* caller's buffer and unpacked in place, the output of a transfer
+* being never larger than its input.
+*
+* @date		17/10/2026
+*
+* Copyright(c) Quantum Dice. All rights reserved.
+*/
+
+#include <algorithm>
+#include <cstdlib>
+
+#include "qrng_ext_internal.h"
+
+static inline bool frame_has_marker(const u8* frame)
+{
+	uint32_t marker;
+	memcpy(&marker, frame, sizeof(marker));
+	return marker == QRNG_FRAME_MARKER;
+}
+
+/**
+* Unpack whole frames, 'out' can be 'frames' to unpack in place
+*
+* @return	number of data bytes written to 'out', 8 per framed
+* 			block and 16 per unframed block
+*/
+static size_t frames_unpack(const u8* frames, size_t count, u8* out)
+{
+	u8* p = out;
+
+	for (size_t i = 0; i < count; i++, frames += QRNG_FRAME_SIZE) {
+		if (frame_has_marker(frames)) {
+			memcpy(p, frames + QRNG_FRAME_DATA_OFFSET, 8);
+			p += 8;
+		}
+		else {
+			memmove(p, frames, QRNG_FRAME_SIZE);
+			p += QRNG_FRAME_SIZE;
+		}
+	}
+	return p - out;
+}
+
+int ext_stage_refill(Qrng_shard_t* shard, Qrng_pool_t* stage, int channel)
+{
+	if (!stage->data) {
+		stage->size = QRNG_STAGE_SIZE;
+		stage->data = (u8*)malloc(stage->size);
+		if (!stage->data) return QRNG_ERROR_INTERNAL_MEMORY;
+	}
+
+	stage->len = stage->pos = 0;
+	size_t read_len = 0;
+	int ret = ext_dev_get(shard->ctx, stage->data, stage->size, &read_len, channel);
+	if (ret != QRNG_SUCCESS) return ret;
+	if (read_len == 0) return QRNG_ERROR_INCOMPLETE_DATA;
+
+	stage->len = read_len;
+	return QRNG_SUCCESS;
+}
+
+/** One device transfer of frames into 'data', unpacked in place */
+static int hashed_read_direct(Qrng_shard_t* shard, u8* data, size_t size,
+							size_t* bytes_read)
+{
+	size_t n = std::min(size, QRNG_DMA_CHUNK_SIZE);
+	n -= n % QRNG_FRAME_SIZE;
+
+	size_t read_len = 0;
+	int ret = ext_dev_get(shard->ctx, data, n, &read_len, QRNG_LL_CHANNEL_HASHED);
+	if (ret == QRNG_SUCCESS && read_len == 0) ret = QRNG_ERROR_INCOMPLETE_DATA;
+
+	/** the partial frame of a short transfer is dropped */
+	*bytes_read = frames_unpack(data, std::min(read_len, n) / QRNG_FRAME_SIZE, data);
+	return ret;
+}
+
+/** Same for the raw channel, the 16 bits samples are packed in place */
+static int raw_read_direct(Qrng_shard_t* shard, u16* data, size_t count,
+						size_t* count_read)
+{
+	/** 'count' samples of output hold count / 2 words */
+	size_t n = std::min(count / 2, QRNG_DMA_CHUNK_SIZE / QRNG_RAW_WORD_SIZE);
+	u8* words = (u8*)data;
+
+	size_t read_len = 0;
+	int ret = ext_dev_get(shard->ctx, words, n * QRNG_RAW_WORD_SIZE, &read_len,
+						QRNG_LL_CHANNEL_RAW);
+	if (ret == QRNG_SUCCESS && read_len == 0) ret = QRNG_ERROR_INCOMPLETE_DATA;
+
+	n = std::min(read_len / QRNG_RAW_WORD_SIZE, n);
+	for (size_t i = 0; i < n; i++) {
+		uint32_t word;
+		memcpy(&word, words + i * QRNG_RAW_WORD_SIZE, sizeof(word));
+		data[i] = (u16)(word >> (QRNG_RAW_SAMPLE_OFFSET * 8));
+	}
+	*count_read = n;
+	return ret;
+}
+
+int ext_read_hashed(Qrng_shard_t* shard, u8* data, size_t size,
+				size_t* bytes_read)
+{
+	Qrng_pool_t* stage = &shard->stage;
+	size_t done = 0;
+	int ret = QRNG_SUCCESS;
+
+	while (done < size) {
+		if (stage->pos >= stage->len && size - done >= QRNG_DIRECT_MIN_SIZE) {
+			size_t n = 0;
+			ret = hashed_read_direct(shard, data + done, size - done, &n);
+			done += n;
+			if (ret != QRNG_SUCCESS) break;
+			continue;
+		}
+
+		if (stage->pos >= stage->len && (ret = ext_stage_refill(shard, stage, QRNG_LL_CHANNEL_HASHED)) != QRNG_SUCCESS)
+			break;
+
+		size_t off = stage->pos % QRNG_FRAME_SIZE;
+		size_t avail = stage->len - stage->pos;
+
+		/** whole frames, each one yields 8 or 16 bytes */
+		if (off == 0 && avail >= QRNG_FRAME_SIZE
+				&& size - done >= QRNG_FRAME_SIZE) {
+			size_t count = std::min(avail, size - done) / QRNG_FRAME_SIZE;
+			done += frames_unpack(stage->data + stage->pos, count, data + done);
+			stage->pos += count * QRNG_FRAME_SIZE;
+			continue;
+		}
+
+		/** partial frame, same rules as qrng_get() */
+		const u8* frame = stage->data + stage->pos - off;
+		if (off < QRNG_FRAME_DATA_OFFSET && frame_has_marker(frame)) {
+			stage->pos += QRNG_FRAME_DATA_OFFSET - off;
+			off = QRNG_FRAME_DATA_OFFSET;
+		}
+
+		size_t n = std::min(QRNG_FRAME_SIZE - off, size - done);
+		n = std::min(n, stage->len - std::min(stage->pos, stage->len));
+		memcpy(data + done, stage->data + stage->pos, n);
+		stage->pos += n;
+		done += n;
+	}
+
+	if (bytes_read) *bytes_read = done;
+	shard->status = ret;
+	return ret;
+}
+
+int ext_read_raw(Qrng_shard_t* shard, u16* data, size_t count,
+				size_t* count_read)
+{
+	Qrng_pool_t* stage = &shard->raw_stage;
+	size_t done = 0;
+	int ret = QRNG_SUCCESS;
+
+	while (done < count) {
+		if (stage->len - stage->pos < QRNG_RAW_WORD_SIZE
+				&& (count - done) * sizeof(*data) >= QRNG_DIRECT_MIN_SIZE) {
+			size_t n = 0;
+			ret = raw_read_direct(shard, data + done, count - done, &n);
+			done += n;
+			if (ret != QRNG_SUCCESS) break;
+			continue;
+		}
+
+		if (stage->len - stage->pos < QRNG_RAW_WORD_SIZE) {
+			ret = ext_stage_refill(shard, stage, QRNG_LL_CHANNEL_RAW);
+			if (ret != QRNG_SUCCESS) break;
+			if (stage->len < QRNG_RAW_WORD_SIZE) {
+				ret = QRNG_ERROR_INCOMPLETE_DATA;
+				break;
+			}
+		}
+
+		size_t n = std::min((stage->len - stage->pos) / QRNG_RAW_WORD_SIZE, count - done);
+		const u8* src = stage->data + stage->pos;
+		for (size_t i = 0; i < n; i++) {
+			uint32_t word;
+			memcpy(&word, src + i * QRNG_RAW_WORD_SIZE, sizeof(word));
+			data[done + i] = (u16)(word >> (QRNG_RAW_SAMPLE_OFFSET * 8));
+		}
+		stage->pos += n * QRNG_RAW_WORD_SIZE;
+		done += n;
+	}
+
+	if (count_read) *count_read = done;
+	shard->status = ret;
+	return ret;
+}
+
+static void stage_free(Qrng_pool_t* stage)
+{
+	if (stage->data) {
+		memset(stage->data, 0, stage->size);
+		free(stage->data);
+	}
+	stage->data = nullptr;
+	stage->len = stage->pos = 0;
+}
+
+void ext_stage_free(Qrng_shard_t* shard)
+{
+	stage_free(&shard->stage);
+	stage_free(&shard->raw_stage);
+}
@@ -0,0 +1,452 @@
+/**
+* @file 	qrng_health.cpp
+* @brief 	Continuous health tests of NIST SP 800-90B (section 4.4)
+*
+* Every device transfer is tested before it is used, on both channels:
+* the 16 bits samples of the raw channel and the 64 bits data words of
+* the hashed channel (marker frames carry one, plain blocks two).
+*
+* - Repetition Count Test: fails when a sample is repeated C times in
+*   a row, C = 1 + ceil(-log2(alpha) / H).
+* - Adaptive Proportion Test: fails when the first sample of a window
+*   of W samples appears C times in the window, C being the smallest
+*   count reached with a probability below alpha.
+*
+* H is the min-entropy per sample claimed for the source: the value
+* of Qrng_ext_param for the raw samples, full entropy for the hashed
+* words. A failure discards the transfer and latches the handle in
+* the QRNG_ERROR_INSUFFICIENT_ENTHROPY status until qrng_health_reset().
+*
+* The raw kernel tests 64 samples at a time with AVX2: the repeated
+* neighbours form a bit mask, searched for runs of C - 1 bits, and the
+* window counts are vector compares. The rare groups with a long run
+* go through the scalar test, the counters are the same either way.
+* The hashed words take the same shortcuts, 4 words per compare.
+*
+* @date		17/10/2026
+*
+* Copyright(c) Quantum Dice. All rights reserved.
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <new>
+
+#include "qrng_ext_internal.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#	include <immintrin.h>
+#	define QRNG_X86_KERNELS
+#endif
+
+/** Full entropy of a hashed data word */
+#define HEALTH_HASHED_ENTROPY	64.0
+
+typedef struct {
+	u32 rct_cutoff;
+	u32 apt_cutoff;
+
+	u64 last;		/**< previous sample */
+	u32 run;		/**< repetitions of 'last', 0 before the first sample */
+	u64 apt_ref;	/**< first sample of the window */
+	u32 apt_pos;	/**< position in the window */
+	u32 apt_count;	/**< occurrences of 'apt_ref' in the window */
+
+	std::atomic<u64> samples;
+	std::atomic<u64> rct_failures;
+	std::atomic<u64> apt_failures;
+}Health_test;
+
+struct Qrng_health {
+	Health_test raw;
+	Health_test hashed;
+	std::atomic<bool> failed;
+};
+
+/** Failures found by one call, added to the counters at the end */
+typedef struct {
+	u64 rct;
+	u64 apt;
+}Health_result;
+
+static u32 rct_cutoff(double h)
+{
+	return 1 + (u32)std::ceil(QRNG_HEALTH_ALPHA_LOG2 / h);
+}
+
+/**
+* Smallest C with P(B >= C) <= alpha, B = 1 + Binomial(W - 1, 2^-H)
+* being the count of the first sample of a window
+*/
+static u32 apt_cutoff(double h)
+{
+	const int n = QRNG_HEALTH_APT_WINDOW - 1;
+	const double p = std::exp2(-h);
+	const double log_alpha = -QRNG_HEALTH_ALPHA_LOG2 * std::log(2.0);
+
+	/** upper tail P(X > k), summed from the top */
+	double tail = 0.0;
+	for (int k = n; k >= 0; k--) {
+		double log_pmf = std::lgamma(n + 1.0) - std::lgamma(k + 1.0) - std::lgamma(n - k + 1.0)
+				+ k * std::log(p) + (n - k) * std::log1p(-p);
+		double next = tail + std::exp(log_pmf);
+		/** P(X > k - 1) above alpha: k matches are the cutoff */
+		if (std::log(next) > log_alpha) return (u32)k + 2;
+		tail = next;
+	}
+	return 2;
+}
+
+static void test_init(Health_test* t, double h)
+{
+	t->rct_cutoff = rct_cutoff(h);
+	t->apt_cutoff = apt_cutoff(h);
+}
+
+static inline void test_rct(Health_test* t, u64 s, Health_result* res)
+{
+	if (t->run && s == t->last) {
+		if (++t->run == t->rct_cutoff) res->rct++;
+	}
+	else {
+		t->last = s;
+		t->run = 1;
+	}
+}
+
+static inline void test_apt(Health_test* t, u64 s, Health_result* res)
+{
+	if (t->apt_pos == 0) {
+		t->apt_ref = s;
+		t->apt_count = 1;
+	}
+	else if (s == t->apt_ref) {
+		t->apt_count++;
+	}
+
+	if (++t->apt_pos == QRNG_HEALTH_APT_WINDOW) {
+		if (t->apt_count >= t->apt_cutoff) res->apt++;
+		t->apt_pos = 0;
+	}
+}
+
+static inline u16 raw_sample(const u8* words, size_t i)
+{
+	u16 s;
+	memcpy(&s, words + i * QRNG_RAW_WORD_SIZE + QRNG_RAW_SAMPLE_OFFSET, sizeof(s));
+	return s;
+}
+
+static void raw_test_scalar(Health_test* t, const u8* words, size_t count, Health_result* res)
+{
+	for (size_t i = 0; i < count; i++) {
+		u16 s = raw_sample(words, i);
+		test_rct(t, s, res);
+		test_apt(t, s, res);
+	}
+}
+
+#ifdef QRNG_X86_KERNELS
+
+/** RCT of 64 samples */
+__attribute__((target("avx2,bmi")))
+static void raw_rct_group_avx2(Health_test* t, const u8* words, Health_result* res)
+{
+	const __m256i rotate = _mm256_setr_epi32(0, 0, 1, 2, 3, 4, 5, 6);
+	u64 m = 0;
+
+	/** bit i: sample i equals sample i - 1 */
+	for (int c = 0; c < 8; c++) {
+		const u8* p = words + c * 8 * QRNG_RAW_WORD_SIZE;
+		__m256i cur = _mm256_srli_epi32(_mm256_loadu_si256((const __m256i*)p), 16);
+		__m256i prev = (c == 0) ? _mm256_permutevar8x32_epi32(cur, rotate)
+				: _mm256_srli_epi32(_mm256_loadu_si256((const __m256i*)(p - QRNG_RAW_WORD_SIZE)), 16);
+		u32 bits = (u32)_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(cur, prev)));
+		m |= (u64)bits << (c * 8);
+	}
+	m &= ~(u64)1;
+	if (t->run && raw_sample(words, 0) == t->last) m |= 1;
+
+	/** runs of C - 1 set bits, within the group or continuing the last run */
+	u32 need = t->rct_cutoff - 1;
+	u64 lead = _tzcnt_u64(~m);
+	bool slow = t->run + lead >= t->rct_cutoff;
+	if (!slow && need < 64) {
+		u64 x = m;
+		for (u32 len = 1; len < need;) {
+			u32 s = std::min(len, need - len);
+			x &= x >> s;
+			len += s;
+		}
+		slow = x != 0;
+	}
+
+	if (slow) {
+		for (size_t i = 0; i < 64; i++) test_rct(t, raw_sample(words, i), res);
+		return;
+	}
+
+	t->last = raw_sample(words, 63);
+	t->run = (~m == 0) ? t->run + 64 : (u32)__builtin_clzll(~m) + 1;
+}
+
+/** APT count of a whole window */
+__attribute__((target("avx2")))
+static u32 raw_apt_window_avx2(const u8* words, u16 ref)
+{
+	const __m256i r = _mm256_set1_epi32(ref);
+	u32 count = 0;
+
+	for (size_t i = 0; i < QRNG_HEALTH_APT_WINDOW; i += 8) {
+		__m256i v = _mm256_srli_epi32(
+				_mm256_loadu_si256((const __m256i*)(words + i * QRNG_RAW_WORD_SIZE)), 16);
+		count += __builtin_popcount(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(v, r))));
+	}
+	return count;
+}
+
+__attribute__((target("avx2,bmi")))
+static void raw_test_avx2(Health_test* t, const u8* words, size_t count, Health_result* res)
+{
+	size_t i = 0;
+
+	/** up to the start of a window */
+	for (; i < count && t->apt_pos != 0; i++) {
+		u16 s = raw_sample(words, i);
+		test_rct(t, s, res);
+		test_apt(t, s, res);
+	}
+
+	for (; count - i >= QRNG_HEALTH_APT_WINDOW; i += QRNG_HEALTH_APT_WINDOW) {
+		const u8* w = words + i * QRNG_RAW_WORD_SIZE;
+		for (size_t g = 0; g < QRNG_HEALTH_APT_WINDOW; g += 64)
+			raw_rct_group_avx2(t, w + g * QRNG_RAW_WORD_SIZE, res);
+		if (raw_apt_window_avx2(w, raw_sample(w, 0)) >= t->apt_cutoff) res->apt++;
+	}
+
+	raw_test_scalar(t, words + i * QRNG_RAW_WORD_SIZE, count - i, res);
+}
+
+#endif
+
+typedef void (*Raw_test_fn)(Health_test* t, const u8* words, size_t count, Health_result* res);
+
+static Raw_test_fn select_raw_test()
+{
+#ifdef QRNG_X86_KERNELS
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("bmi")) return raw_test_avx2;
+#endif
+	return raw_test_scalar;
+}
+
+/**
+* Scan of words p[1..len): repetitions of the previous word and
+* occurrences of 'ref'
+*/
+typedef void (*Words_scan_fn)(const u64* p, size_t len, u64 ref, bool* rep, u32* count);
+
+static void words_scan_scalar(const u64* p, size_t len, u64 ref, bool* rep, u32* count)
+{
+	u64 r = 0;
+	u32 n = 0;
+	for (size_t j = 1; j < len; j++) {
+		r |= p[j] == p[j - 1];
+		n += p[j] == ref;
+	}
+	*rep = r != 0;
+	*count = n;
+}
+
+#ifdef QRNG_X86_KERNELS
+
+__attribute__((target("avx2")))
+static void words_scan_avx2(const u64* p, size_t len, u64 ref, bool* rep, u32* count)
+{
+	const __m256i r = _mm256_set1_epi64x((long long)ref);
+	__m256i eq = _mm256_setzero_si256();
+	__m256i n = _mm256_setzero_si256();
+	size_t j = 1;
+
+	for (; j + 4 <= len; j += 4) {
+		__m256i cur = _mm256_loadu_si256((const __m256i*)(p + j));
+		__m256i prev = _mm256_loadu_si256((const __m256i*)(p + j - 1));
+		eq = _mm256_or_si256(eq, _mm256_cmpeq_epi64(cur, prev));
+		n = _mm256_sub_epi64(n, _mm256_cmpeq_epi64(cur, r));
+	}
+
+	u64 lanes[4];
+	_mm256_storeu_si256((__m256i*)lanes, n);
+	bool tail_rep;
+	u32 tail_count;
+	words_scan_scalar(p + j - 1, len - j + 1, ref, &tail_rep, &tail_count);
+
+	*rep = !_mm256_testz_si256(eq, eq) || tail_rep;
+	*count = (u32)(lanes[0] + lanes[1] + lanes[2] + lanes[3]) + tail_count;
+}
+
+#endif
+
+static Words_scan_fn select_words_scan()
+{
+#ifdef QRNG_X86_KERNELS
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) return words_scan_avx2;
+#endif
+	return words_scan_scalar;
+}
+
+/**
+* RCT and APT of 64 bits words, window by window: the repetitions and
+* the occurrences of the window's first word are counted by a vector
+* scan, the scalar test only sees the rare spans with a repetition
+*/
+static void words_test(Health_test* t, const u64* x, size_t count, Health_result* res)
+{
+	static const Words_scan_fn words_scan = select_words_scan();
+	size_t i = 0;
+
+	while (i < count) {
+		size_t len = std::min(count - i, (size_t)(QRNG_HEALTH_APT_WINDOW - t->apt_pos));
+		const u64* p = x + i;
+		i += len;
+
+		if (t->apt_pos == 0) {
+			t->apt_ref = p[0];
+			t->apt_count = 0;
+		}
+
+		bool rep;
+		u32 n;
+		words_scan(p, len, t->apt_ref, &rep, &n);
+		t->apt_count += n + (p[0] == t->apt_ref);
+		t->apt_pos += (u32)len;
+
+		if (rep || (t->run && p[0] == t->last)) {
+			for (size_t j = 0; j < len; j++) test_rct(t, p[j], res);
+		}
+		else {
+			t->last = p[len - 1];
+			t->run = 1;
+		}
+
+		if (t->apt_pos == QRNG_HEALTH_APT_WINDOW) {
+			if (t->apt_count >= t->apt_cutoff) res->apt++;
+			t->apt_pos = 0;
+		}
+	}
+}
+
+/** @return	number of data words tested, one per marker frame and two per plain block */
+static size_t hashed_test(Health_test* t, const u8* frames, size_t count, Health_result* res)
+{
+	u64 words[2 * QRNG_HEALTH_APT_WINDOW];
+	size_t samples = 0;
+
+	while (count) {
+		size_t n = 0;
+		size_t frames_n = std::min(count, (size_t)QRNG_HEALTH_APT_WINDOW);
+
+		/** data words of the frames, the plain blocks give both halves */
+		for (size_t i = 0; i < frames_n; i++, frames += QRNG_FRAME_SIZE) {
+			u64 w[2];
+			memcpy(w, frames, sizeof(w));
+			words[n] = w[0];
+			n += (uint32_t)w[0] != QRNG_FRAME_MARKER;
+			words[n++] = w[1];
+		}
+
+		words_test(t, words, n, res);
+		samples += n;
+		count -= frames_n;
+	}
+	return samples;
+}
+
+int ext_health_start(Qrng_ext_ctx* ctx, double raw_entropy)
+{
+	if (raw_entropy == 0.0) raw_entropy = QRNG_HEALTH_DEFAULT_RAW_ENTROPY;
+	if (!(raw_entropy > 0.0 && raw_entropy <= 16.0)) return QRNG_ERROR_INVALID_PARAM;
+
+	Qrng_health* health = new (std::nothrow) Qrng_health();
+	if (!health) return QRNG_ERROR_INTERNAL_MEMORY;
+
+	test_init(&health->raw, raw_entropy);
+	test_init(&health->hashed, HEALTH_HASHED_ENTROPY);
+	ctx->health = health;
+	return QRNG_SUCCESS;
+}
+
+void ext_health_stop(Qrng_ext_ctx* ctx)
+{
+	delete ctx->health;
+	ctx->health = nullptr;
+}
+
+int ext_health_check(Qrng_health* health, const u8* buf, size_t size, int channel)
+{
+	static const Raw_test_fn raw_test = select_raw_test();
+	Health_result res = { 0, 0 };
+	Health_test* t;
+	size_t samples;
+
+	if (channel == QRNG_LL_CHANNEL_RAW) {
+		t = &health->raw;
+		samples = size / QRNG_RAW_WORD_SIZE;
+		raw_test(t, buf, samples, &res);
+	}
+	else {
+		t = &health->hashed;
+		samples = hashed_test(t, buf, size / QRNG_FRAME_SIZE, &res);
+	}
+
+	t->samples.fetch_add(samples, std::memory_order_relaxed);
+	if (!res.rct && !res.apt) return QRNG_SUCCESS;
+
+	t->rct_failures.fetch_add(res.rct, std::memory_order_relaxed);
+	t->apt_failures.fetch_add(res.apt, std::memory_order_relaxed);
+	health->failed.store(true);
+	return QRNG_ERROR_INSUFFICIENT_ENTHROPY;
+}
+
+bool ext_health_failed(const Qrng_health* health)
+{
+	return health->failed.load(std::memory_order_relaxed);
+}
+
+int qrng_health_get_stats(QRNG* qrng, Qrng_health_stats* stats)
+{
+	if (!stats) return QRNG_ERROR_NULL_PTR;
+
+	Qrng_ext_ctx* ctx = ext_ctx(qrng);
+	if (!ctx) return QRNG_ERROR_NOT_EXT_HANDLE;
+
+	memset(stats, 0, sizeof(*stats));
+	Qrng_health* health = ctx->health;
+	if (!health) return QRNG_SUCCESS;
+
+	stats->enabled = 1;
+	stats->failed = health->failed.load() ? 1 : 0;
+
+	Qrng_health_channel_stats* out[2] = { &stats->raw, &stats->hashed };
+	const Health_test* in[2] = { &health->raw, &health->hashed };
+	for (int i = 0; i < 2; i++) {
+		out[i]->rct_cutoff = in[i]->rct_cutoff;
+		out[i]->apt_cutoff = in[i]->apt_cutoff;
+		out[i]->samples = in[i]->samples.load(std::memory_order_relaxed);
+		out[i]->rct_failures = in[i]->rct_failures.load(std::memory_order_relaxed);
+		out[i]->apt_failures = in[i]->apt_failures.load(std::memory_order_relaxed);
+	}
+	return QRNG_SUCCESS;
+}
+
+int qrng_health_reset(QRNG* qrng)
+{
+	Qrng_ext_ctx* ctx = ext_ctx(qrng);
+	if (!ctx) return QRNG_ERROR_NOT_EXT_HANDLE;
+	if (!ctx->health) return QRNG_ERROR_INVALID_PARAM;
+
+	ctx->health->failed.store(false);
+	return QRNG_SUCCESS;
+}
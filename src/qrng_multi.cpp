@@ -0,0 +1,327 @@
+/**
+* @file 	qrng_multi.cpp
+* @brief 	"multi" backend: several devices aggregated in one handle
+*
+* Each device has its own worker thread. A read is split into one
+* stripe per working device, multiple of the 16 bytes frames, the
+* workers read their stripes in parallel and the data of the devices
+* that came short is compacted so that the caller gets a contiguous
+* stream of whole frames. The bytes still missing are striped again
+* across the devices left, a device that returned an error is skipped
+* until it is tried again QRNG_MULTI_RETRY_MS later.
+*
+* On Linux the worker of an xdma device runs on the CPUs local to the
+* PCIe root of the board and reads into a staging buffer first touched
+* by that thread, so the DMA lands in memory of the same NUMA node.
+*
+* The reads of a handle are serialized by the caller (device mutex or
+* prefetch thread), a single request is in flight at a time.
+*
+* @date		17/10/2026
+*
+* Copyright(c) Quantum Dice. All rights reserved.
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <thread>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#endif
+
+#include "qrng_ext_internal.h"
+
+typedef std::chrono::steady_clock Multi_clock;
+
+typedef struct {
+	std::string name;
+	Qrng_ll_table ll;
+	void* dev;
+	std::thread thread;
+	int node;				/**< NUMA node of the board, -1 if unknown */
+#ifdef __linux__
+	cpu_set_t cpus;			/**< CPUs local to the board */
+#endif
+	u8* stage;				/**< node local staging buffer, or NULL */
+
+	/** request of the worker, under Multi_dev::mutex while 'busy' is false */
+	bool busy;
+	u8* buf;
+	size_t size;
+	int channel;
+	size_t done;
+	int ret;
+
+	bool failed;
+	Multi_clock::time_point retry_at;
+}Multi_member;
+
+typedef struct {
+	std::vector<std::unique_ptr<Multi_member>> members;
+	std::mutex mutex;
+	std::condition_variable job_cv;
+	std::condition_variable done_cv;
+	size_t pending;
+	bool stop;
+}Multi_dev;
+
+#ifdef __linux__
+/** Parse a sysfs CPU list, "0-3,8-11" */
+static bool parse_cpulist(const std::string& list, cpu_set_t* cpus)
+{
+	CPU_ZERO(cpus);
+	size_t start = 0;
+
+	while (start < list.size()) {
+		size_t end = list.find(',', start);
+		if (end == std::string::npos) end = list.size();
+		std::string range = list.substr(start, end - start);
+		start = end + 1;
+
+		int lo = 0, hi = 0;
+		int n = sscanf(range.c_str(), "%d-%d", &lo, &hi);
+		if (n < 1) continue;
+		if (n == 1) hi = lo;
+		for (int cpu = lo; cpu <= hi && cpu < CPU_SETSIZE; cpu++)
+			if (cpu >= 0) CPU_SET(cpu, cpus);
+	}
+	return CPU_COUNT(cpus) > 0;
+}
+
+/** NUMA node and local CPUs of an xdma device, from its PCIe device in sysfs */
+static void member_locate(Multi_member* mb)
+{
+	mb->node = -1;
+	if (mb->name.find(':') != std::string::npos) return;	/** not a PCIe device */
+
+	size_t slash = mb->name.rfind('/');
+	std::string base = (slash == std::string::npos) ? mb->name : mb->name.substr(slash + 1);
+	std::string dir = "/sys/class/xdma/" + base + "_c2h_0/device/";
+
+	int node = -1;
+	std::string cpulist;
+	std::ifstream(dir + "numa_node") >> node;
+	std::ifstream(dir + "local_cpulist") >> cpulist;
+
+	if (node >= 0 && parse_cpulist(cpulist, &mb->cpus)) mb->node = node;
+}
+#else
+static void member_locate(Multi_member* mb)
+{
+	mb->node = -1;
+}
+#endif
+
+static void member_read(Multi_member* mb)
+{
+	mb->done = 0;
+
+	if (!mb->stage) {
+		mb->ret = mb->ll.get(mb->dev, mb->buf, mb->size, &mb->done, mb->channel);
+		return;
+	}
+
+	mb->ret = QRNG_SUCCESS;
+	while (mb->ret == QRNG_SUCCESS && mb->done < mb->size) {
+		size_t n = std::min(mb->size - mb->done, QRNG_DMA_CHUNK_SIZE);
+		size_t read_len = 0;
+		mb->ret = mb->ll.get(mb->dev, mb->stage, n, &read_len, mb->channel);
+		read_len = std::min(read_len, n);
+		memcpy(mb->buf + mb->done, mb->stage, read_len);
+		mb->done += read_len;
+		if (read_len < n) break;
+	}
+}
+
+static void member_worker(Multi_dev* m, Multi_member* mb)
+{
+#ifdef __linux__
+	if (mb->node >= 0) {
+		pthread_setaffinity_np(pthread_self(), sizeof(mb->cpus), &mb->cpus);
+		/** first touch from the pinned thread places the pages on its node */
+		mb->stage = (u8*)malloc(QRNG_DMA_CHUNK_SIZE);
+		if (mb->stage) memset(mb->stage, 0, QRNG_DMA_CHUNK_SIZE);
+	}
+#endif
+
+	std::unique_lock<std::mutex> lock(m->mutex);
+	for (;;) {
+		m->job_cv.wait(lock, [&] { return mb->busy || m->stop; });
+		if (m->stop) break;
+
+		lock.unlock();
+		member_read(mb);
+		lock.lock();
+
+		mb->busy = false;
+		if (--m->pending == 0) m->done_cv.notify_one();
+	}
+}
+
+/** Open all the /dev/xdma<N> devices */
+static std::string multi_discover()
+{
+	std::string list;
+#ifdef __linux__
+	for (int i = 0; i < QRNG_MULTI_MAX_DEVICES; i++) {
+		std::string name = "/dev/xdma" + std::to_string(i);
+		if (access((name + "_c2h_0").c_str(), R_OK)) continue;
+		if (!list.empty()) list += ';';
+		list += name;
+	}
+#endif
+	return list;
+}
+
+static void multi_deinit(void* dev)
+{
+	Multi_dev* m = (Multi_dev*)dev;
+	if (!m) return;
+
+	{
+		std::lock_guard<std::mutex> lock(m->mutex);
+		m->stop = true;
+	}
+	m->job_cv.notify_all();
+
+	for (auto& mb : m->members) {
+		if (mb->thread.joinable()) mb->thread.join();
+		if (mb->dev) mb->ll.deinit(mb->dev);
+		free(mb->stage);
+	}
+	delete m;
+}
+
+static int multi_init(const char* args, void** dev)
+{
+	Multi_dev* m = new (std::nothrow) Multi_dev();
+	if (!m) return QRNG_ERROR_INTERNAL_MEMORY;
+	*dev = m;
+
+	std::string list = (args && *args) ? args : multi_discover();
+	size_t start = 0;
+
+	while (start < list.size()) {
+		size_t end = list.find(';', start);
+		if (end == std::string::npos) end = list.size();
+		std::string name = list.substr(start, end - start);
+		start = end + 1;
+		if (name.empty()) continue;
+
+		if (m->members.size() == QRNG_MULTI_MAX_DEVICES) return QRNG_ERROR_INVALID_PARAM;
+
+		Multi_member* mb = new (std::nothrow) Multi_member();
+		if (!mb) return QRNG_ERROR_INTERNAL_MEMORY;
+		m->members.emplace_back(mb);
+		mb->name = name;
+
+		const char* member_args = mb->name.c_str();
+		if (!ext_backend_find(member_args, &mb->ll, &member_args)) mb->ll = ll_default;
+		if (mb->ll.init == multi_init) return QRNG_ERROR_INVALID_PARAM;
+
+		int ret = mb->ll.init(member_args, &mb->dev);
+		if (ret != QRNG_SUCCESS) return ret;
+		member_locate(mb);
+	}
+
+	if (m->members.empty()) return QRNG_NO_DEVICE_FOUND;
+
+	for (auto& mb : m->members) {
+		try {
+			mb->thread = std::thread(member_worker, m, mb.get());
+		}
+		catch (...) {
+			return QRNG_ERROR_INTERNAL_MEMORY;
+		}
+	}
+	return QRNG_SUCCESS;
+}
+
+static int multi_get(void* dev, u8* buf, size_t size, size_t* read_len, int channel)
+{
+	Multi_dev* m = (Multi_dev*)dev;
+	size_t done = 0;
+	int ret = QRNG_SUCCESS;
+	std::vector<Multi_member*> active;
+
+	while (done < size) {
+		Multi_clock::time_point now = Multi_clock::now();
+		active.clear();
+		for (auto& mb : m->members)
+			if (!mb->failed || now >= mb->retry_at) active.push_back(mb.get());
+
+		if (active.empty()) {
+			if (ret == QRNG_SUCCESS) ret = QRNG_ERROR_READING_DEVICE;
+			break;
+		}
+
+		/** one stripe of whole frames per device */
+		size_t left = size - done;
+		size_t stripe = (left + active.size() - 1) / active.size();
+		stripe = (stripe + QRNG_FRAME_SIZE - 1) / QRNG_FRAME_SIZE * QRNG_FRAME_SIZE;
+
+		size_t off = done;
+		size_t n_jobs = 0;
+		{
+			std::lock_guard<std::mutex> lock(m->mutex);
+			for (Multi_member* mb : active) {
+				if (off == size) break;
+				mb->buf = buf + off;
+				mb->size = std::min(stripe, size - off);
+				mb->channel = channel;
+				mb->busy = true;
+				off += mb->size;
+				n_jobs++;
+			}
+			m->pending = n_jobs;
+		}
+		m->job_cv.notify_all();
+
+		{
+			std::unique_lock<std::mutex> lock(m->mutex);
+			m->done_cv.wait(lock, [&] { return m->pending == 0; });
+		}
+
+		/** close the gaps left by the short stripes */
+		for (size_t i = 0; i < n_jobs; i++) {
+			Multi_member* mb = active[i];
+			size_t got = std::min(mb->done, mb->size);
+
+			if (mb->ret != QRNG_SUCCESS || got == 0) {
+				/** partial frames of a failed stripe are dropped */
+				got -= got % QRNG_FRAME_SIZE;
+				ret = (mb->ret != QRNG_SUCCESS) ? mb->ret : QRNG_ERROR_INCOMPLETE_DATA;
+				mb->failed = true;
+				mb->retry_at = now + std::chrono::milliseconds(QRNG_MULTI_RETRY_MS);
+			}
+			else {
+				if (got < mb->size) got -= got % QRNG_FRAME_SIZE;
+				mb->failed = false;
+			}
+
+			if (buf + done != mb->buf) memmove(buf + done, mb->buf, got);
+			done += got;
+		}
+	}
+
+	if (read_len) *read_len = done;
+	return (done == size) ? QRNG_SUCCESS : ret;
+}
+
+void ext_multi_table(Qrng_ll_table* ll)
+{
+	ll->init = multi_init;
+	ll->get = multi_get;
+	ll->deinit = multi_deinit;
+}
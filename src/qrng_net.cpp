@@ -0,0 +1,938 @@
+/**
+* @file 	qrng_net.cpp
+* @brief 	Device served over TCP and unix sockets
+*
+* qrng_net_start() listens on TCP and unix stream sockets, the "tcp"
+* and "unix" backends connect to it, one connection per channel of the
+* client handle.
+*
+* The client sends requests, 16 bytes: magic, channel and a number of
+* bytes. The server answers each request in order with data frames of
+* up to 'batch' bytes, a 16 bytes header (magic, status and length)
+* followed by the bytes of the channel stream. A device error is sent
+* as a frame without data and drops the rest of the request. The client
+* keeps requests for one batch more than it reads, so that the next
+* frame is already on its way.
+*
+* The server reads the device into buffers of 'batch' bytes mapped for
+* the connection and, on TCP, sends them with MSG_ZEROCOPY: a buffer is
+* only filled again once the kernel reported the completion of its
+* sends on the error queue. The buffers are unmapped, not recycled, so
+* that pages still referenced by the network stack are never reused.
+*
+* All the values are little endian.
+*
+* @date		17/10/2026
+*
+* Copyright(c) Quantum Dice. All rights reserved.
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <list>
+#include <memory>
+#include <new>
+#include <string>
+
+#ifdef __linux__
+#include <cerrno>
+#include <fcntl.h>
+#include <linux/errqueue.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#include "qrng_ext_internal.h"
+
+#ifdef __linux__
+
+/** "QNET" */
+#define NET_MAGIC			0x54454e51u
+
+/** Buffers of a connection, shared by the channels */
+#define NET_BUFFERS			4
+
+/** Smallest send worth the page pinning of MSG_ZEROCOPY */
+#define NET_ZEROCOPY_MIN	KB(16)
+
+/** Poll period of the blocked server threads, checking for stop */
+#define NET_POLL_MS			100
+
+/** Longest wait for the completions of the zero copy sends of a buffer */
+#define NET_ZEROCOPY_WAIT_MS	10000
+
+/** Delay before a reconnection, times the number of the attempt */
+#define NET_RETRY_DELAY		std::chrono::milliseconds(100)
+
+#ifndef SO_ZEROCOPY
+#define SO_ZEROCOPY			60
+#endif
+#ifndef MSG_ZEROCOPY
+#define MSG_ZEROCOPY		0x4000000
+#endif
+
+typedef struct {
+	uint32_t magic;
+	uint32_t channel;
+	u64 bytes;
+}Net_request;
+
+typedef struct {
+	uint32_t magic;
+	int32_t status;
+	u64 len;
+}Net_frame;
+
+static_assert(sizeof(Net_request) == 16 && sizeof(Net_frame) == 16, "16 bytes headers");
+
+typedef struct {
+	u8* data;		/**< 'batch' bytes, mapped */
+	size_t len;		/**< valid bytes */
+	size_t pos;		/**< sent bytes */
+	uint32_t zc_id;	/**< last zero copy send of the buffer */
+	bool zc;		/**< 'zc_id' is set */
+}Net_buf;
+
+typedef struct {
+	int channel;
+	u64 bytes;		/**< not sent yet */
+}Net_pending;
+
+struct Net_conn {
+	Qrng_net_server* srv;
+	int fd;
+	bool zerocopy;
+	uint32_t zc_next;	/**< id of the next zero copy send */
+	uint32_t zc_done;	/**< the sends before this id are completed */
+	Net_buf bufs[NET_BUFFERS];
+	int cur[2];			/**< buffer of each channel, -1 if none */
+	size_t next_buf;
+	std::deque<Net_pending> queue;
+	u8 in[sizeof(Net_request)];	/**< request being received */
+	size_t in_len;
+	std::thread thread;
+	std::atomic<bool> done{ false };
+};
+
+struct Qrng_net_server {
+	Qrng_ext_ctx* ctx;
+	size_t batch;
+	uint32_t max_clients;
+	uint32_t mode;
+	std::vector<int> listeners;
+	std::vector<std::string> paths;	/**< of the unix sockets */
+	int wake[2];
+	std::thread thread;
+	std::atomic<bool> stop{ false };
+
+	std::mutex mutex;
+	std::list<std::unique_ptr<Net_conn>> conns;
+
+	std::atomic<uint32_t> clients{ 0 };
+	std::atomic<u64> connections{ 0 };
+	std::atomic<u64> rejected{ 0 };
+	std::atomic<u64> requests{ 0 };
+	std::atomic<u64> bytes{ 0 };
+	std::atomic<u64> zerocopy_bytes{ 0 };
+	std::atomic<u64> zerocopy_copied{ 0 };
+};
+
+/** Split "<host>:<port>", the host may be empty or "[<ipv6>]" */
+static bool net_split_host(const std::string& addr, std::string* host, std::string* port)
+{
+	size_t colon = addr.rfind(':');
+	if (colon == std::string::npos || colon + 1 == addr.size()) return false;
+
+	*host = addr.substr(0, colon);
+	*port = addr.substr(colon + 1);
+	if (host->size() >= 2 && host->front() == '[' && host->back() == ']')
+		*host = host->substr(1, host->size() - 2);
+	return true;
+}
+
+static bool net_unix_addr(const std::string& path, struct sockaddr_un* sa)
+{
+	memset(sa, 0, sizeof(*sa));
+	sa->sun_family = AF_UNIX;
+	if (path.empty() || path.size() >= sizeof(sa->sun_path)) return false;
+	memcpy(sa->sun_path, path.c_str(), path.size());
+	return true;
+}
+
+/********************************** Server **********************************/
+
+/**
+* Collect the zero copy completions of the error queue
+*
+* @return	false if the socket has an error
+*/
+static bool net_zc_reap(Net_conn* c)
+{
+	Qrng_net_server* srv = c->srv;
+	char control[256];
+
+	for (;;) {
+		struct msghdr msg = {};
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+		if (recvmsg(c->fd, &msg, MSG_ERRQUEUE) < 0)
+			return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+
+		for (struct cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+			if (!(cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR)
+					&& !(cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR))
+				continue;
+
+			struct sock_extended_err err;
+			memcpy(&err, CMSG_DATA(cm), sizeof(err));
+			if (err.ee_origin != SO_EE_ORIGIN_ZEROCOPY || err.ee_errno != 0) continue;
+
+			/**
+			* range [ee_info, ee_data] of send ids, completed in order. The
+			* kernel copies on the paths without zero copy (loopback), the
+			* pinning is then pure overhead and the connection goes back to
+			* regular sends.
+			*/
+			if (err.ee_code & SO_EE_CODE_ZEROCOPY_COPIED) {
+				srv->zerocopy_copied.fetch_add(err.ee_data - err.ee_info + 1, std::memory_order_relaxed);
+				c->zerocopy = false;
+			}
+			if ((int32_t)(err.ee_data + 1 - c->zc_done) > 0) c->zc_done = err.ee_data + 1;
+		}
+	}
+}
+
+/** Wait until the network stack is done with the pages of a buffer */
+static bool net_zc_wait(Net_conn* c, Net_buf* b)
+{
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(NET_ZEROCOPY_WAIT_MS);
+
+	while (b->zc && (int32_t)(c->zc_done - b->zc_id) <= 0) {
+		if (c->srv->stop.load() || std::chrono::steady_clock::now() > deadline) return false;
+
+		/** POLLERR is reported while the error queue isn't empty */
+		struct pollfd p = { c->fd, 0, 0 };
+		poll(&p, 1, NET_POLL_MS);
+		if (!net_zc_reap(c)) return false;
+	}
+	b->zc = false;
+	return true;
+}
+
+static bool net_send(Net_conn* c, const u8* p, size_t n, Net_buf* b)
+{
+	while (n) {
+		bool zc = b && c->zerocopy && n >= NET_ZEROCOPY_MIN;
+		ssize_t r = send(c->fd, p, n, MSG_NOSIGNAL | (zc ? MSG_ZEROCOPY : 0));
+		if (r < 0) {
+			if (errno == EINTR) continue;
+			/** out of locked memory for the pinned pages, copy from now on */
+			if (zc && errno == ENOBUFS) {
+				c->zerocopy = false;
+				continue;
+			}
+			return false;
+		}
+		if (zc) {
+			b->zc_id = c->zc_next++;
+			b->zc = true;
+			c->srv->zerocopy_bytes.fetch_add(r, std::memory_order_relaxed);
+		}
+		p += r;
+		n -= r;
+	}
+	return true;
+}
+
+static bool net_send_frame(Net_conn* c, int status, const u8* data, size_t len, Net_buf* b)
+{
+	Net_frame f = { NET_MAGIC, status, len };
+	if (send(c->fd, &f, sizeof(f), MSG_NOSIGNAL | (len ? MSG_MORE : 0)) != (ssize_t)sizeof(f))
+		return false;
+	return net_send(c, data, len, b);
+}
+
+/**
+* Send one frame of the request at the front of the queue, the buffer
+* of its channel is refilled from the device when empty
+*/
+static bool net_serve_front(Net_conn* c)
+{
+	Qrng_net_server* srv = c->srv;
+	Net_pending* req = &c->queue.front();
+	int ch = req->channel;
+	Net_buf* b = (c->cur[ch] >= 0) ? &c->bufs[c->cur[ch]] : nullptr;
+
+	if (!b || b->pos == b->len) {
+		int other = c->cur[1 - ch];
+		size_t i = c->next_buf++ % NET_BUFFERS;
+		if ((int)i == other) i = c->next_buf++ % NET_BUFFERS;
+
+		b = &c->bufs[i];
+		c->cur[ch] = (int)i;
+		b->len = b->pos = 0;
+		if (!net_zc_wait(c, b)) return false;
+
+		size_t read_len = 0;
+		int ret = ext_dev_get(srv->ctx, b->data, srv->batch, &read_len, ch);
+		b->len = std::min(read_len, srv->batch);
+		if (ret != QRNG_SUCCESS || b->len == 0) {
+			b->len = 0;
+			c->queue.pop_front();
+			return net_send_frame(c, (ret != QRNG_SUCCESS) ? ret : QRNG_ERROR_INCOMPLETE_DATA,
+								nullptr, 0, nullptr);
+		}
+	}
+
+	size_t n = (size_t)std::min((u64)(b->len - b->pos), req->bytes);
+	if (!net_send_frame(c, QRNG_SUCCESS, b->data + b->pos, n, b)) return false;
+
+	b->pos += n;
+	srv->bytes.fetch_add(n, std::memory_order_relaxed);
+	req->bytes -= n;
+	if (req->bytes == 0) c->queue.pop_front();
+	return true;
+}
+
+/**
+* Receive the pending requests, waiting for one if the queue is empty
+*
+* @return	false when the connection is over
+*/
+static bool net_recv_requests(Net_conn* c)
+{
+	Qrng_net_server* srv = c->srv;
+
+	for (;;) {
+		bool wait = c->queue.empty();
+		if (wait) {
+			struct pollfd p = { c->fd, POLLIN, 0 };
+			int r = poll(&p, 1, NET_POLL_MS);
+			if (srv->stop.load()) return false;
+			if (r == 0) continue;
+		}
+
+		ssize_t r = recv(c->fd, c->in + c->in_len, sizeof(c->in) - c->in_len, MSG_DONTWAIT);
+		if (r == 0) return false;
+		if (r < 0) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+				if (wait) continue;
+				return true;
+			}
+			return false;
+		}
+
+		c->in_len += r;
+		if (c->in_len < sizeof(c->in)) continue;
+		c->in_len = 0;
+
+		Net_request req;
+		memcpy(&req, c->in, sizeof(req));
+		if (req.magic != NET_MAGIC || req.channel > QRNG_LL_CHANNEL_RAW) return false;
+		srv->requests.fetch_add(1, std::memory_order_relaxed);
+		if (req.bytes) c->queue.push_back({ (int)req.channel, req.bytes });
+	}
+}
+
+static void net_conn_run(Net_conn* c)
+{
+	while (!c->srv->stop.load(std::memory_order_relaxed)) {
+		if (!net_recv_requests(c)) break;
+		if (!c->queue.empty() && !net_serve_front(c)) break;
+	}
+
+	/** drop the unsent data, so that no page of the buffers stays referenced */
+	if (c->zc_next != c->zc_done) net_zc_reap(c);
+	if (c->zc_next != c->zc_done) {
+		struct linger l = { 1, 0 };
+		setsockopt(c->fd, SOL_SOCKET, SO_LINGER, &l, sizeof(l));
+	}
+	shutdown(c->fd, SHUT_RDWR);
+	c->srv->clients.fetch_sub(1);
+	c->done.store(true);
+}
+
+static void net_conn_free(Net_conn* c)
+{
+	if (c->thread.joinable()) c->thread.join();
+	close(c->fd);
+	for (Net_buf& b : c->bufs)
+		if (b.data) munmap(b.data, c->srv->batch);
+}
+
+static void net_accept(Qrng_net_server* srv, int lfd)
+{
+	int fd = accept4(lfd, nullptr, nullptr, SOCK_CLOEXEC);
+	if (fd < 0) return;
+
+	std::lock_guard<std::mutex> lock(srv->mutex);
+
+	/** join the connections that are over */
+	for (auto it = srv->conns.begin(); it != srv->conns.end();) {
+		if (!(*it)->done.load()) {
+			++it;
+			continue;
+		}
+		net_conn_free(it->get());
+		it = srv->conns.erase(it);
+	}
+
+	if (srv->clients.load() >= srv->max_clients) {
+		srv->rejected.fetch_add(1, std::memory_order_relaxed);
+		close(fd);
+		return;
+	}
+
+	std::unique_ptr<Net_conn> c(new (std::nothrow) Net_conn());
+	if (!c) {
+		close(fd);
+		return;
+	}
+	c->srv = srv;
+	c->fd = fd;
+	c->cur[0] = c->cur[1] = -1;
+
+	for (Net_buf& b : c->bufs) {
+		void* p = mmap(nullptr, srv->batch, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		b.data = (p != MAP_FAILED) ? (u8*)p : nullptr;
+	}
+
+	int one = 1;
+	struct sockaddr_storage sa;
+	socklen_t len = sizeof(sa);
+	if (getsockname(fd, (struct sockaddr*)&sa, &len) == 0 && sa.ss_family != AF_UNIX) {
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+		c->zerocopy = setsockopt(fd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) == 0;
+	}
+
+	srv->clients.fetch_add(1);
+	bool ok = true;
+	for (Net_buf& b : c->bufs) ok &= (b.data != nullptr);
+	if (ok) {
+		try {
+			c->thread = std::thread(net_conn_run, c.get());
+		}
+		catch (...) {
+			ok = false;
+		}
+	}
+	if (!ok) {
+		srv->clients.fetch_sub(1);
+		net_conn_free(c.get());
+		return;
+	}
+
+	srv->connections.fetch_add(1, std::memory_order_relaxed);
+	srv->conns.push_back(std::move(c));
+}
+
+static void net_listen_run(Qrng_net_server* srv)
+{
+	std::vector<struct pollfd> fds;
+	fds.push_back({ srv->wake[0], POLLIN, 0 });
+	for (int fd : srv->listeners) fds.push_back({ fd, POLLIN, 0 });
+
+	while (!srv->stop.load()) {
+		if (poll(fds.data(), fds.size(), -1) < 0 && errno != EINTR) break;
+		for (size_t i = 1; i < fds.size(); i++)
+			if (fds[i].revents & POLLIN) net_accept(srv, fds[i].fd);
+	}
+}
+
+static int net_listen_tcp(const std::string& addr, int* out)
+{
+	std::string host, port;
+	if (!net_split_host(addr, &host, &port)) return QRNG_ERROR_INVALID_PARAM;
+
+	struct addrinfo hints = {};
+	struct addrinfo* res = nullptr;
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_flags = AI_PASSIVE;
+	if (getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &res) != 0)
+		return QRNG_ERROR_INVALID_PARAM;
+
+	int fd = socket(res->ai_family, res->ai_socktype | SOCK_CLOEXEC, res->ai_protocol);
+	int one = 1;
+	bool ok = fd >= 0 && setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) == 0
+			&& bind(fd, res->ai_addr, res->ai_addrlen) == 0 && listen(fd, SOMAXCONN) == 0;
+	freeaddrinfo(res);
+
+	if (!ok) {
+		if (fd >= 0) close(fd);
+		return QRNG_ERROR_OPENING_DEVICE;
+	}
+	*out = fd;
+	return QRNG_SUCCESS;
+}
+
+static int net_listen_unix(const std::string& path, uint32_t mode, int* out)
+{
+	struct sockaddr_un sa;
+	if (!net_unix_addr(path, &sa)) return QRNG_ERROR_INVALID_PARAM;
+
+	int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0) return QRNG_ERROR_OPENING_DEVICE;
+
+	/** a socket left by a server that is gone refuses connections, it is replaced */
+	struct stat st;
+	if (stat(path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)
+			&& connect(fd, (struct sockaddr*)&sa, sizeof(sa)) < 0 && errno == ECONNREFUSED) {
+		unlink(path.c_str());
+		close(fd);
+		fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+		if (fd < 0) return QRNG_ERROR_OPENING_DEVICE;
+	}
+
+	if (bind(fd, (struct sockaddr*)&sa, sizeof(sa)) != 0 || chmod(path.c_str(), mode) != 0
+			|| listen(fd, SOMAXCONN) != 0) {
+		close(fd);
+		return QRNG_ERROR_OPENING_DEVICE;
+	}
+	*out = fd;
+	return QRNG_SUCCESS;
+}
+
+static void net_server_free(Qrng_net_server* srv)
+{
+	srv->stop.store(true);
+	if (srv->wake[1] >= 0) {
+		ssize_t w = write(srv->wake[1], "", 1);
+		(void)w;
+	}
+	if (srv->thread.joinable()) srv->thread.join();
+
+	/** unblock the connections waiting on their sockets */
+	{
+		std::lock_guard<std::mutex> lock(srv->mutex);
+		for (auto& c : srv->conns) shutdown(c->fd, SHUT_RDWR);
+		for (auto& c : srv->conns) net_conn_free(c.get());
+		srv->conns.clear();
+	}
+
+	for (int fd : srv->listeners) close(fd);
+	for (const std::string& path : srv->paths) unlink(path.c_str());
+	for (int fd : srv->wake)
+		if (fd >= 0) close(fd);
+	delete srv;
+}
+
+static int net_server_start(Qrng_ext_ctx* ctx, const Qrng_net_param* param,
+							Qrng_net_server** out)
+{
+	if (!param->address || !*param->address) return QRNG_ERROR_INVALID_PARAM;
+
+	Qrng_net_server* srv = new (std::nothrow) Qrng_net_server();
+	if (!srv) return QRNG_ERROR_INTERNAL_MEMORY;
+
+	size_t batch = param->batch ? param->batch : QRNG_NET_DEFAULT_BATCH;
+	batch = std::min(std::max(batch, (size_t)NET_ZEROCOPY_MIN), QRNG_NET_MAX_BATCH);
+	srv->ctx = ctx;
+	srv->batch = (batch + KB(4) - 1) / KB(4) * KB(4);
+	srv->max_clients = param->max_clients ? param->max_clients : QRNG_NET_MAX_CLIENTS;
+	srv->mode = param->mode ? param->mode : QRNG_NET_DEFAULT_MODE;
+	srv->wake[0] = srv->wake[1] = -1;
+
+	int ret = (pipe2(srv->wake, O_CLOEXEC) == 0) ? QRNG_SUCCESS : QRNG_ERROR_INTERNAL_MEMORY;
+	std::string list(param->address);
+	size_t start = 0;
+
+	while (ret == QRNG_SUCCESS && start < list.size()) {
+		size_t end = list.find(';', start);
+		if (end == std::string::npos) end = list.size();
+		std::string addr = list.substr(start, end - start);
+		start = end + 1;
+
+		int fd = -1;
+		if (!addr.compare(0, 4, "tcp:")) {
+			ret = net_listen_tcp(addr.substr(4), &fd);
+		}
+		else if (!addr.compare(0, 5, "unix:")) {
+			ret = net_listen_unix(addr.substr(5), srv->mode, &fd);
+			if (ret == QRNG_SUCCESS) srv->paths.push_back(addr.substr(5));
+		}
+		else {
+			ret = QRNG_ERROR_INVALID_PARAM;
+		}
+		if (ret == QRNG_SUCCESS) srv->listeners.push_back(fd);
+	}
+
+	if (ret == QRNG_SUCCESS) {
+		try {
+			srv->thread = std::thread(net_listen_run, srv);
+		}
+		catch (...) {
+			ret = QRNG_ERROR_INTERNAL_MEMORY;
+		}
+	}
+	if (ret != QRNG_SUCCESS) {
+		net_server_free(srv);
+		return ret;
+	}
+
+	*out = srv;
+	return QRNG_SUCCESS;
+}
+
+/********************************** Client **********************************/
+
+/** Connection of one channel of a client handle */
+typedef struct {
+	int fd;
+	u64 owed;		/**< requested and not received yet */
+	u64 frame_left;	/**< data of the current frame not received yet */
+}Net_link;
+
+typedef struct {
+	bool local;		/**< unix socket */
+	std::string host;
+	std::string port;
+	std::string path;
+	int timeout_ms;
+	int retries;
+	size_t batch;
+	Net_link links[2];
+}Net_dev;
+
+/** Parse "<address>,timeout=<ms>,retries=<n>,batch=<bytes>" */
+static bool net_parse(Net_dev* d, const char* args)
+{
+	std::string opts(args ? args : "");
+	size_t end = opts.find(',');
+	std::string addr = opts.substr(0, end);
+
+	if (d->local) {
+		struct sockaddr_un sa;
+		if (!net_unix_addr(addr, &sa)) return false;
+		d->path = addr;
+	}
+	else if (!net_split_host(addr, &d->host, &d->port) || d->host.empty()) {
+		return false;
+	}
+
+	size_t start = (end == std::string::npos) ? opts.size() : end + 1;
+	while (start < opts.size()) {
+		end = opts.find(',', start);
+		if (end == std::string::npos) end = opts.size();
+		std::string opt = opts.substr(start, end - start);
+		start = end + 1;
+
+		size_t eq = opt.find('=');
+		if (eq == std::string::npos) return false;
+		std::string key = opt.substr(0, eq);
+		std::string val = opt.substr(eq + 1);
+		char* stop = nullptr;
+		unsigned long long v = strtoull(val.c_str(), &stop, 0);
+		if (val.empty() || *stop) return false;
+
+		if (key == "timeout" && v > 0 && v <= INT32_MAX) d->timeout_ms = (int)v;
+		else if (key == "retries" && v <= 1000) d->retries = (int)v;
+		else if (key == "batch" && v >= QRNG_FRAME_SIZE && v <= QRNG_NET_MAX_BATCH)
+			d->batch = (size_t)v / QRNG_FRAME_SIZE * QRNG_FRAME_SIZE;
+		else return false;
+	}
+	return true;
+}
+
+static int net_connect(const Net_dev* d)
+{
+	struct timeval tv = { d->timeout_ms / 1000, (d->timeout_ms % 1000) * 1000 };
+	int fd = -1;
+
+	if (d->local) {
+		struct sockaddr_un sa;
+		net_unix_addr(d->path, &sa);
+		fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+		if (fd >= 0 && connect(fd, (struct sockaddr*)&sa, sizeof(sa)) != 0) {
+			close(fd);
+			fd = -1;
+		}
+	}
+	else {
+		struct addrinfo hints = {};
+		struct addrinfo* res = nullptr;
+		hints.ai_family = AF_UNSPEC;
+		hints.ai_socktype = SOCK_STREAM;
+		if (getaddrinfo(d->host.c_str(), d->port.c_str(), &hints, &res) != 0) return -1;
+
+		for (struct addrinfo* ai = res; ai && fd < 0; ai = ai->ai_next) {
+			fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+			if (fd < 0) continue;
+			/** the send timeout also bounds connect() */
+			setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+			if (connect(fd, ai->ai_addr, ai->ai_addrlen) != 0) {
+				close(fd);
+				fd = -1;
+			}
+		}
+		freeaddrinfo(res);
+
+		int one = 1;
+		if (fd >= 0) setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+	}
+
+	if (fd >= 0) {
+		setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+		setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+	}
+	return fd;
+}
+
+static void net_link_close(Net_link* l)
+{
+	if (l->fd >= 0) close(l->fd);
+	l->fd = -1;
+	l->owed = 0;
+	l->frame_left = 0;
+}
+
+/**
+* Receive up to 'n' bytes
+*
+* @return	bytes received, 0 on error, 'timeout' set if the socket timed out
+*/
+static size_t net_recv(Net_link* l, void* buf, size_t n, bool* timeout)
+{
+	for (;;) {
+		ssize_t r = recv(l->fd, buf, n, MSG_WAITALL);
+		if (r > 0) return r;
+		if (r < 0 && errno == EINTR) continue;
+		*timeout = r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+		return 0;
+	}
+}
+
+static int net_get(void* dev, u8* buf, size_t size, size_t* read_len, int channel)
+{
+	Net_dev* d = (Net_dev*)dev;
+	if (!d || (channel != QRNG_LL_CHANNEL_HASHED && channel != QRNG_LL_CHANNEL_RAW)) {
+		*read_len = 0;
+		return QRNG_ERROR_READING_DEVICE;
+	}
+
+	Net_link* l = &d->links[channel];
+	u64 unit = (channel == QRNG_LL_CHANNEL_HASHED) ? QRNG_FRAME_SIZE : QRNG_RAW_WORD_SIZE;
+	size_t done = 0;
+	int failures = 0;
+	bool timeout = false;
+	int ret = QRNG_SUCCESS;
+
+	while (done < size) {
+		if (l->fd < 0) {
+			if (failures > d->retries) {
+				ret = timeout ? QRNG_ERROR_NET_TIMEOUT : QRNG_ERROR_NET_RETRIES_EXCEEDED;
+				break;
+			}
+			if (failures) std::this_thread::sleep_for(NET_RETRY_DELAY * failures);
+
+			l->fd = net_connect(d);
+			if (l->fd < 0) {
+				failures++;
+				timeout = false;
+				continue;
+			}
+		}
+
+		/** keep one batch requested ahead of this read */
+		u64 want = (size - done) + d->batch;
+		if (l->owed < want) {
+			u64 n = (want - l->owed + d->batch - 1) / d->batch * d->batch;
+			Net_request req = { NET_MAGIC, (uint32_t)channel, n };
+			if (send(l->fd, &req, sizeof(req), MSG_NOSIGNAL) != (ssize_t)sizeof(req)) {
+				timeout = (errno == EAGAIN || errno == EWOULDBLOCK);
+				net_link_close(l);
+				failures++;
+				continue;
+			}
+			l->owed += n;
+		}
+
+		if (l->frame_left == 0) {
+			Net_frame f;
+			if (net_recv(l, &f, sizeof(f), &timeout) != sizeof(f) || f.magic != NET_MAGIC) {
+				net_link_close(l);
+				failures++;
+				continue;
+			}
+
+			/** the server dropped the rest of the request */
+			if (f.status != QRNG_SUCCESS) {
+				net_link_close(l);
+				ret = f.status;
+				break;
+			}
+			l->frame_left = f.len;
+			continue;
+		}
+
+		size_t n = net_recv(l, buf + done, (size_t)std::min(l->frame_left, (u64)(size - done)), &timeout);
+		if (n == 0) {
+			/** the new connection starts on a frame boundary */
+			done -= done % unit;
+			net_link_close(l);
+			failures++;
+			continue;
+		}
+		done += n;
+		l->frame_left -= n;
+		l->owed -= n;
+		failures = 0;
+	}
+
+	*read_len = done;
+	return ret;
+}
+
+static int net_init_common(const char* args, void** dev, bool local)
+{
+	Net_dev* d = new (std::nothrow) Net_dev();
+	if (!d) return QRNG_ERROR_INTERNAL_MEMORY;
+
+	d->local = local;
+	d->timeout_ms = QRNG_NET_DEFAULT_TIMEOUT_MS;
+	d->retries = QRNG_NET_DEFAULT_RETRIES;
+	d->batch = QRNG_NET_DEFAULT_BATCH;
+	for (Net_link& l : d->links) {
+		l.fd = -1;
+		l.owed = l.frame_left = 0;
+	}
+
+	if (!net_parse(d, args)) {
+		delete d;
+		*dev = nullptr;
+		return QRNG_ERROR_OPENING_DEVICE;
+	}
+
+	/** the hashed channel is connected now to report a missing server, the reads will try again */
+	*dev = d;
+	d->links[QRNG_LL_CHANNEL_HASHED].fd = net_connect(d);
+	return (d->links[QRNG_LL_CHANNEL_HASHED].fd >= 0) ? QRNG_SUCCESS : QRNG_ERROR_OPENING_DEVICE;
+}
+
+static int net_tcp_init(const char* args, void** dev)
+{
+	return net_init_common(args, dev, false);
+}
+
+static int net_unix_init(const char* args, void** dev)
+{
+	return net_init_common(args, dev, true);
+}
+
+static void net_deinit(void* dev)
+{
+	Net_dev* d = (Net_dev*)dev;
+	if (!d) return;
+
+	for (Net_link& l : d->links) net_link_close(&l);
+	delete d;
+}
+
+static void net_stats(Qrng_net_server* srv, Qrng_net_stats* stats)
+{
+	stats->clients = srv->clients.load(std::memory_order_relaxed);
+	stats->connections = srv->connections.load(std::memory_order_relaxed);
+	stats->rejected = srv->rejected.load(std::memory_order_relaxed);
+	stats->requests = srv->requests.load(std::memory_order_relaxed);
+	stats->bytes = srv->bytes.load(std::memory_order_relaxed);
+	stats->zerocopy_bytes = srv->zerocopy_bytes.load(std::memory_order_relaxed);
+	stats->zerocopy_copied = srv->zerocopy_copied.load(std::memory_order_relaxed);
+}
+
+#else
+
+struct Qrng_net_server {
+};
+
+static int net_tcp_init(const char* args, void** dev)
+{
+	*dev = nullptr;
+	return QRNG_ERROR_OPENING_DEVICE;
+}
+
+static int net_unix_init(const char* args, void** dev)
+{
+	*dev = nullptr;
+	return QRNG_ERROR_OPENING_DEVICE;
+}
+
+static int net_get(void* dev, u8* buf, size_t size, size_t* read_len, int channel)
+{
+	*read_len = 0;
+	return QRNG_ERROR_READING_DEVICE;
+}
+
+static void net_deinit(void* dev)
+{
+}
+
+#endif
+
+void ext_net_tables(Qrng_ll_table* tcp, Qrng_ll_table* local)
+{
+	tcp->init = net_tcp_init;
+	local->init = net_unix_init;
+	tcp->get = local->get = net_get;
+	tcp->deinit = local->deinit = net_deinit;
+}
+
+void ext_net_stop(Qrng_ext_ctx* ctx)
+{
+	std::lock_guard<std::mutex> lock(ctx->net_mutex);
+#ifdef __linux__
+	if (ctx->net) net_server_free(ctx->net);
+#endif
+	ctx->net = nullptr;
+}
+
+int qrng_net_start(QRNG* qrng, const Qrng_net_param* param)
+{
+	if (!param) return QRNG_ERROR_NULL_PTR;
+
+	Qrng_ext_ctx* ctx = ext_ctx(qrng);
+	if (!ctx) return QRNG_ERROR_NOT_EXT_HANDLE;
+
+#ifdef __linux__
+	std::lock_guard<std::mutex> lock(ctx->net_mutex);
+	if (ctx->net) return QRNG_ERROR_INVALID_PARAM;
+	return net_server_start(ctx, param, &ctx->net);
+#else
+	return QRNG_ERROR_INVALID_PARAM;
+#endif
+}
+
+int qrng_net_stop(QRNG* qrng)
+{
+	Qrng_ext_ctx* ctx = ext_ctx(qrng);
+	if (!ctx) return QRNG_ERROR_NOT_EXT_HANDLE;
+
+	{
+		std::lock_guard<std::mutex> lock(ctx->net_mutex);
+		if (!ctx->net) return QRNG_ERROR_INVALID_PARAM;
+	}
+	ext_net_stop(ctx);
+	return QRNG_SUCCESS;
+}
+
+int qrng_net_get_stats(QRNG* qrng, Qrng_net_stats* stats)
+{
+	if (!stats) return QRNG_ERROR_NULL_PTR;
+
+	Qrng_ext_ctx* ctx = ext_ctx(qrng);
+	if (!ctx) return QRNG_ERROR_NOT_EXT_HANDLE;
+
+	memset(stats, 0, sizeof(*stats));
+#ifdef __linux__
+	std::lock_guard<std::mutex> lock(ctx->net_mutex);
+	if (ctx->net) net_stats(ctx->net, stats);
+#endif
+	return QRNG_SUCCESS;
+}
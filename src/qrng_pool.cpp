@@ -0,0 +1,207 @@
+/**
+* @file 	qrng_pool.cpp
+* @brief 	Per handle entropy pool for the scalar functions
+*
+* The pool is refilled in bulk from the device frames once it runs
+* empty, so a scalar draw costs a few loads instead of a call into the
+* QRNG API library. The values are built exactly like qrng_rand(),
+* qrng_urand() and qrng_urand2() build theirs, when the pool can't be
+* refilled the call falls back to these functions so that the error
+* is reported by qrng_get_status().
+*
+* @date		17/10/2026
+*
+* Copyright(c) Quantum Dice. All rights reserved.
+*/
+
+#include <cstdlib>
+
+#include "qrng_ext_internal.h"
+
+/**
+* Call into the QRNG API library for a handle that may be shared by
+* several threads, the status is copied to the calling thread's shard
+*/
+template <typename F>
+static auto core_call(QRNG* qrng, Qrng_shard_t* shard, F fn) -> decltype(fn())
+{
+	if (!shard) return fn();
+
+	std::lock_guard<std::mutex> lock(shard->ctx->core_mutex);
+	auto ret = fn();
+	shard->status = qrng_get_status(qrng);
+	return ret;
+}
+
+int ext_core_get(QRNG* qrng, Qrng_shard_t* shard, u8* buf, s32 size, s32* bytes_read)
+{
+	return core_call(qrng, shard, [&] { return qrng_get(qrng, buf, size, bytes_read); });
+}
+
+int ext_pool_refill(Qrng_shard_t* shard, size_t n)
+{
+	Qrng_pool_t* pool = &shard->pool;
+	size_t size = shard->ctx->pool_size.load(std::memory_order_relaxed);
+
+	/** resized by qrng_pool_set_size() */
+	if (pool->data && pool->size != size) ext_pool_free(pool);
+
+	if (!pool->data) {
+		pool->data = (u8*)malloc(size);
+		if (!pool->data) return shard->status = QRNG_ERROR_INTERNAL_MEMORY;
+		pool->size = size;
+		pool->len = pool->pos = 0;
+	}
+
+	/** keep the unconsumed tail, it is still fresh */
+	size_t left = pool->len - pool->pos;
+	memmove(pool->data, pool->data + pool->pos, left);
+	pool->len = left;
+	pool->pos = 0;
+
+	u64 t0 = ext_stats_begin(shard, pool->size - left);
+	size_t bytes_read = 0;
+	int ret = ext_read_hashed(shard, pool->data + left, pool->size - left,
+							&bytes_read);
+	pool->len += bytes_read;
+	ext_stats_call(shard, QRNG_STATS_FN_POOL, t0, bytes_read, ret);
+
+	if (pool->len < n)
+		return shard->status = (ret != QRNG_SUCCESS) ? ret : QRNG_ERROR_INCOMPLETE_DATA;
+	return QRNG_SUCCESS;
+}
+
+bool ext_src_take_slow(Qrng_src_t* src, u8* out, size_t n)
+{
+	/** the pool couldn't be refilled, let qrng_get() report the error */
+	src->pooled = false;
+
+	if (src->len - src->pos < n) {
+		s32 bytes_read = 0;
+		src->status = ext_core_get(src->qrng, src->shard, src->buf,
+								sizeof(src->buf), &bytes_read);
+		src->pos = 0;
+		src->len = (bytes_read > 0) ? bytes_read : 0;
+		if (src->len < n) {
+			if (src->status == QRNG_SUCCESS) src->status = QRNG_ERROR_INCOMPLETE_DATA;
+			return false;
+		}
+	}
+	memcpy(out, src->buf + src->pos, n);
+	src->pos += n;
+	src->taken += n;
+	return true;
+}
+
+void ext_pool_free(Qrng_pool_t* pool)
+{
+	if (pool->data) {
+		memset(pool->data, 0, pool->size);
+		free(pool->data);
+	}
+	pool->data = nullptr;
+	pool->len = pool->pos = 0;
+}
+
+int qrng_pool_rand(QRNG* qrng)
+{
+	Qrng_shard_t* shard = ext_shard(qrng);
+	const u8* p = shard ? ext_pool_take(shard, 4) : nullptr;
+	if (!p) return core_call(qrng, shard, [&] { return qrng_rand(qrng); });
+
+	u32 val = ((u32)p[0] << 24) | ((u32)p[1] << 16) | ((u32)p[2] << 8) | p[3];
+	return (int)(val & 0x7fffffff);
+}
+
+double qrng_pool_urand(QRNG* qrng)
+{
+	Qrng_shard_t* shard = ext_shard(qrng);
+	const u8* p = shard ? ext_pool_take(shard, 6) : nullptr;
+	if (!p) return core_call(qrng, shard, [&] { return qrng_urand(qrng); });
+
+	u64 val = 0;
+	for (int i = 0; i < 6; i++) val = (val << 8) | p[i];
+	return (double)val / 281474976710656.0;		/** 2^48 */
+}
+
+float qrng_pool_urand2(QRNG* qrng)
+{
+	Qrng_shard_t* shard = ext_shard(qrng);
+	const u8* p = shard ? ext_pool_take(shard, 3) : nullptr;
+	if (!p) return core_call(qrng, shard, [&] { return qrng_urand2(qrng); });
+
+	u32 val = ((u32)p[0] << 16) | ((u32)p[1] << 8) | p[2];
+	return (float)val / 16777216.0f;		/** 2^24 */
+}
+
+/** Same from qrng_get() without the pool */
+template <typename T>
+static T pool_word(QRNG* qrng)
+{
+	Qrng_shard_t* shard = ext_shard(qrng);
+	const u8* p = shard ? ext_pool_take(shard, sizeof(T)) : nullptr;
+	T val = 0;
+	if (p) {
+		memcpy(&val, p, sizeof(T));
+		return val;
+	}
+
+	s32 bytes_read = 0;
+	int ret = ext_core_get(qrng, shard, (u8*)&val, sizeof(T), &bytes_read);
+	if (ret == QRNG_SUCCESS && bytes_read != (s32)sizeof(T)) ret = QRNG_ERROR_INCOMPLETE_DATA;
+	/** the callers (bitgen_t) can't see a status, keep the first error */
+	if (ret != QRNG_SUCCESS && shard && shard->word_error == QRNG_SUCCESS)
+		shard->word_error = ret;
+	return val;
+}
+
+uint32_t qrng_pool_u32(QRNG* qrng)
+{
+	return pool_word<uint32_t>(qrng);
+}
+
+uint64_t qrng_pool_u64(QRNG* qrng)
+{
+	return pool_word<uint64_t>(qrng);
+}
+
+double qrng_pool_double(QRNG* qrng)
+{
+	return (double)(pool_word<uint64_t>(qrng) >> 11) * 0x1.0p-53;
+}
+
+int qrng_pool_get_error(QRNG* qrng)
+{
+	Qrng_shard_t* shard = ext_shard(qrng);
+	if (!shard) return QRNG_ERROR_NOT_EXT_HANDLE;
+
+	int ret = shard->word_error;
+	shard->word_error = QRNG_SUCCESS;
+	return ret;
+}
+
+int qrng_pool_flush(QRNG* qrng)
+{
+	Qrng_shard_t* shard = ext_shard(qrng);
+	if (!shard) return QRNG_ERROR_NOT_EXT_HANDLE;
+
+	Qrng_pool_t* pool = &shard->pool;
+	if (pool->data) memset(pool->data, 0, pool->size);
+	pool->len = pool->pos = 0;
+	return QRNG_SUCCESS;
+}
+
+int qrng_pool_set_size(QRNG* qrng, size_t size)
+{
+	Qrng_shard_t* shard = ext_shard(qrng);
+	if (!shard) return QRNG_ERROR_NOT_EXT_HANDLE;
+
+	if (size == 0) size = QRNG_POOL_DEFAULT_SIZE;
+	if (size < QRNG_POOL_MIN_SIZE || size > QRNG_POOL_MAX_SIZE)
+		return QRNG_ERROR_INVALID_PARAM;
+
+	/** the new pools are allocated by the next refill of each thread */
+	ext_pool_free(&shard->pool);
+	shard->ctx->pool_size.store(size, std::memory_order_relaxed);
+	return QRNG_SUCCESS;
+}
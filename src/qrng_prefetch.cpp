@@ -0,0 +1,256 @@
+/**
+* @file 	qrng_prefetch.cpp
+* @brief 	Prefetch thread and lock-free ring of the hashed channel
+*
+* A thread owned by the handle reads the device one block at a time
+* into a ring of 'depth' blocks, so that the device stays busy while
+* the readers work on the previous blocks.
+*
+* The ring is single producer, multiple consumers. Positions are byte
+* counts since the start of the stream: the producer publishes whole
+* blocks by moving 'write_pos', the readers claim byte ranges with a
+* CAS on 'read_pos' and, once copied, add them to the 'freed' counter
+* of each block slot. A slot is rewritten when its counter reaches the
+* bytes of all its previous generations. Claims are multiples of the
+* 16 bytes frames, the readers always see whole frames.
+*
+* The lock and the condition variables are only used to sleep on an
+* empty or full ring, the flags *_waiting avoid notifying otherwise.
+*
+* @date		17/10/2026
+*
+* Copyright(c) Quantum Dice. All rights reserved.
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+
+#include "qrng_ext_internal.h"
+
+/** Delay before reading again from a device that returned an error */
+#define PREFETCH_RETRY_DELAY	std::chrono::milliseconds(10)
+
+struct Qrng_ring {
+	Qrng_ext_ctx* ctx;
+	u8* data;
+	size_t block;
+	size_t depth;
+	size_t capacity;
+	std::unique_ptr<std::atomic<u64>[]> freed;	/**< released bytes per slot */
+
+	alignas(64) std::atomic<u64> write_pos{ 0 };
+	alignas(64) std::atomic<u64> read_pos{ 0 };
+	alignas(64) std::atomic<u64> underruns{ 0 };
+	std::atomic<u64> overruns{ 0 };
+	std::atomic<int> status{ QRNG_SUCCESS };	/**< last device error */
+	std::atomic<int> readers_waiting{ 0 };
+	std::atomic<bool> writer_waiting{ false };
+	std::atomic<bool> stop{ false };
+
+	std::mutex mutex;
+	std::condition_variable data_cv;
+	std::condition_variable space_cv;
+	std::thread thread;
+};
+
+static inline void wake(Qrng_ring* ring, std::condition_variable* cv)
+{
+	/** the lock orders the notification after the sleeper's check */
+	{ std::lock_guard<std::mutex> lock(ring->mutex); }
+	cv->notify_all();
+}
+
+/** Release the claimed range [pos, pos + n) to the producer */
+static void ring_release(Qrng_ring* ring, u64 pos, u64 n)
+{
+	while (n) {
+		u64 blk = pos / ring->block;
+		u64 part = std::min(n, (blk + 1) * ring->block - pos);
+		ring->freed[blk % ring->depth].fetch_add(part);
+		pos += part;
+		n -= part;
+	}
+	if (ring->writer_waiting.load()) wake(ring, &ring->space_cv);
+}
+
+static void ring_copy(Qrng_ring* ring, u64 pos, u8* out, size_t n)
+{
+	size_t off = pos % ring->capacity;
+	size_t first = std::min(n, ring->capacity - off);
+	memcpy(out, ring->data + off, first);
+	memcpy(out + first, ring->data, n - first);
+}
+
+static void producer(Qrng_ring* ring)
+{
+	u64 blk = 0;
+	size_t filled = 0;
+
+	while (!ring->stop.load(std::memory_order_relaxed)) {
+		size_t slot = blk % ring->depth;
+		u64 expected = (blk / ring->depth) * ring->block;
+
+		if (ring->freed[slot].load(std::memory_order_acquire) != expected) {
+			ring->overruns.fetch_add(1, std::memory_order_relaxed);
+			ring->writer_waiting.store(true);
+			std::unique_lock<std::mutex> lock(ring->mutex);
+			ring->space_cv.wait(lock, [&] {
+				return ring->stop.load() || ring->freed[slot].load() == expected;
+			});
+			ring->writer_waiting.store(false);
+			continue;
+		}
+
+		u8* dst = ring->data + slot * ring->block;
+		size_t read_len = 0;
+		int ret = ext_ll_get(ring->ctx, dst + filled, ring->block - filled,
+							&read_len, QRNG_LL_CHANNEL_HASHED);
+		filled += std::min(read_len, ring->block - filled);
+
+		if (ret != QRNG_SUCCESS || read_len == 0) {
+			ring->status.store((ret != QRNG_SUCCESS) ? ret : QRNG_ERROR_INCOMPLETE_DATA);
+			if (ring->readers_waiting.load()) wake(ring, &ring->data_cv);
+
+			std::unique_lock<std::mutex> lock(ring->mutex);
+			ring->space_cv.wait_for(lock, PREFETCH_RETRY_DELAY,
+					[&] { return ring->stop.load(); });
+			continue;
+		}
+		if (filled < ring->block) continue;
+
+		ring->status.store(QRNG_SUCCESS, std::memory_order_relaxed);
+		ring->write_pos.store((blk + 1) * ring->block);
+		if (ring->readers_waiting.load()) wake(ring, &ring->data_cv);
+		blk++;
+		filled = 0;
+	}
+}
+
+int ext_prefetch_read(Qrng_ring* ring, u8* buf, size_t size, size_t* read_len)
+{
+	/** whole frames are claimed, the tail of the last one is dropped */
+	u64 want = (size + QRNG_FRAME_SIZE - 1) / QRNG_FRAME_SIZE * QRNG_FRAME_SIZE;
+	u64 claimed = 0;
+	bool waited = false;
+	int ret = QRNG_SUCCESS;
+
+	while (claimed < want) {
+		u64 r = ring->read_pos.load(std::memory_order_relaxed);
+		u64 w = ring->write_pos.load(std::memory_order_acquire);
+
+		if (r == w) {
+			int status = ring->status.load();
+			if (status != QRNG_SUCCESS) {
+				ret = status;
+				break;
+			}
+			if (!waited) ring->underruns.fetch_add(1, std::memory_order_relaxed);
+			waited = true;
+
+			ring->readers_waiting.fetch_add(1);
+			std::unique_lock<std::mutex> lock(ring->mutex);
+			ring->data_cv.wait(lock, [&] {
+				return ring->write_pos.load() != w || ring->status.load() != QRNG_SUCCESS
+					|| ring->stop.load();
+			});
+			ring->readers_waiting.fetch_sub(1);
+			if (ring->stop.load()) {
+				ret = QRNG_ERROR_INCOMPLETE_DATA;
+				break;
+			}
+			continue;
+		}
+
+		u64 n = std::min(w - r, want - claimed);
+		if (!ring->read_pos.compare_exchange_weak(r, r + n, std::memory_order_acq_rel))
+			continue;
+
+		if (claimed < size) ring_copy(ring, r, buf + claimed, std::min(n, size - claimed));
+		ring_release(ring, r, n);
+		claimed += n;
+	}
+
+	if (read_len) *read_len = std::min(claimed, (u64)size);
+	return ret;
+}
+
+int ext_prefetch_start(Qrng_ext_ctx* ctx, size_t depth, size_t block)
+{
+	if (block == 0 || block < QRNG_PREFETCH_MIN_BLOCK || block > QRNG_PREFETCH_MAX_BLOCK)
+		block = QRNG_PREFETCH_DEFAULT_BLOCK;
+	block -= block % QRNG_FRAME_SIZE;
+	depth = std::min(std::max(depth, (size_t)2), QRNG_PREFETCH_MAX_DEPTH);
+
+	Qrng_ring* ring = new (std::nothrow) Qrng_ring();
+	if (!ring) return QRNG_ERROR_INTERNAL_MEMORY;
+
+	ring->ctx = ctx;
+	ring->block = block;
+	ring->depth = depth;
+	ring->capacity = block * depth;
+	ring->data = (u8*)malloc(ring->capacity);
+	ring->freed.reset(new (std::nothrow) std::atomic<u64>[depth]);
+	if (!ring->data || !ring->freed) {
+		free(ring->data);
+		delete ring;
+		return QRNG_ERROR_INTERNAL_MEMORY;
+	}
+	for (size_t i = 0; i < depth; i++) ring->freed[i].store(0);
+
+	try {
+		ring->thread = std::thread(producer, ring);
+	}
+	catch (...) {
+		free(ring->data);
+		delete ring;
+		return QRNG_ERROR_INTERNAL_MEMORY;
+	}
+
+	ctx->ring = ring;
+	return QRNG_SUCCESS;
+}
+
+void ext_prefetch_stop(Qrng_ext_ctx* ctx)
+{
+	Qrng_ring* ring = ctx->ring;
+	if (!ring) return;
+
+	ring->stop.store(true);
+	wake(ring, &ring->space_cv);
+	wake(ring, &ring->data_cv);
+	ring->thread.join();
+
+	memset(ring->data, 0, ring->capacity);
+	free(ring->data);
+	delete ring;
+	ctx->ring = nullptr;
+}
+
+int qrng_prefetch_get_stats(QRNG* qrng, Qrng_prefetch_stats* stats)
+{
+	if (!stats) return QRNG_ERROR_NULL_PTR;
+
+	Qrng_ext_ctx* ctx = ext_ctx(qrng);
+	if (!ctx) return QRNG_ERROR_NOT_EXT_HANDLE;
+
+	memset(stats, 0, sizeof(*stats));
+	Qrng_ring* ring = ctx->ring;
+	if (!ring) return QRNG_SUCCESS;
+
+	u64 r = ring->read_pos.load(std::memory_order_relaxed);
+	u64 w = ring->write_pos.load(std::memory_order_relaxed);
+	stats->capacity = ring->capacity;
+	stats->occupancy = (w > r) ? w - r : 0;
+	stats->produced = w;
+	stats->consumed = r;
+	stats->underruns = ring->underruns.load(std::memory_order_relaxed);
+	stats->overruns = ring->overruns.load(std::memory_order_relaxed);
+	return QRNG_SUCCESS;
+}
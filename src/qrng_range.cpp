@@ -0,0 +1,138 @@
+/**
+* @file 	qrng_range.cpp
+* @brief 	Unbiased bounded integers (Lemire's multiply-shift rejection)
+*
+* A word x of L bits is mapped to (x * s) >> L for a range of s values,
+* the draw is rejected when the low half of the product falls below
+* 2^L mod s. The word is 8, 16, 32 or 64 bits long, the shortest one
+* that keeps the rejections rare.
+*
+* Bulk draws read all the words in one go into the output array and
+* expand them in place from the last element to the first, rejected
+* words are replaced from the entropy pool.
+*
+* @date		17/10/2026
+*
+* Copyright(c) Quantum Dice. All rights reserved.
+*/
+
+#include "qrng_ext_internal.h"
+
+/**
+* Word size in bytes for a range of 's' values: the smallest one with
+* s <= 2^(L - 4), which keeps the rejection probability below 1/16
+*/
+static inline int word_size(u64 s)
+{
+	if (s <= ((u64)1 << 4)) return 1;
+	if (s <= ((u64)1 << 12)) return 2;
+	if (s <= ((u64)1 << 28)) return 4;
+	return 8;
+}
+
+static inline u64 load_word(const u8* p, int size)
+{
+	switch (size) {
+	case 1: return p[0];
+	case 2: { uint16_t v; memcpy(&v, p, 2); return v; }
+	case 4: { uint32_t v; memcpy(&v, p, 4); return v; }
+	default: { uint64_t v; memcpy(&v, p, 8); return v; }
+	}
+}
+
+/**
+* Map one word into [0, s), drawing replacement words while rejected
+*
+* @return	false if no replacement word could be read
+*/
+static bool bounded(Qrng_src_t* src, u64 x, u64 s, int size, u64* out)
+{
+	if (size == 8) {
+		unsigned __int128 m = (unsigned __int128)x * s;
+		if ((u64)m < s) {
+			u64 t = (0 - s) % s;
+			while ((u64)m < t) {
+				u8 w[8];
+				if (!ext_src_take(src, w, 8)) return false;
+				m = (unsigned __int128)load_word(w, 8) * s;
+			}
+		}
+		*out = (u64)(m >> 64);
+		return true;
+	}
+
+	int bits = size * 8;
+	u64 mask = ((u64)1 << bits) - 1;
+	u64 m = x * s;
+	if ((m & mask) < s) {
+		u64 t = (((u64)1 << bits) - s) % s;
+		while ((m & mask) < t) {
+			u8 w[8];
+			if (!ext_src_take(src, w, size)) return false;
+			m = load_word(w, size) * s;
+		}
+	}
+	*out = m >> bits;
+	return true;
+}
+
+int qrng_get_range(QRNG* qrng, u64 lo, u64 hi, u64* data, size_t count,
+				size_t* count_read)
+{
+	if (!data) return QRNG_ERROR_NULL_PTR;
+	if (lo > hi || count > SIZE_MAX / 8) return QRNG_ERROR_INVALID_PARAM;
+
+	Qrng_src_t src;
+	ext_src_init(&src, qrng);
+	u64 t0 = ext_stats_begin(src.shard, count * sizeof(*data));
+
+	u64 s = hi - lo + 1;
+	int size = (s == 0) ? 8 : word_size(s);
+
+	size_t bytes_read = 0;
+	int ret = ext_get(qrng, (u8*)data, count * size, &bytes_read);
+	size_t n = bytes_read / size;
+
+	/** the words are packed at the start of 'data', expand backwards */
+	for (size_t i = n; i-- > 0;) {
+		u64 x = load_word((u8*)data + i * size, size);
+		u64 val = x;
+		if (s != 0 && !bounded(&src, x, s, size, &val)) {
+			ret = src.status;
+			/** the elements above 'i' are complete, move them down */
+			n -= i + 1;
+			memmove(data, data + i + 1, n * sizeof(*data));
+			break;
+		}
+		data[i] = lo + val;
+	}
+
+	if (count_read) *count_read = n;
+	ext_stats_call(src.shard, QRNG_STATS_FN_CONVERT, t0, n * sizeof(*data), ret);
+	return ret;
+}
+
+u64 qrng_uniform_int(QRNG* qrng, u64 lo, u64 hi)
+{
+	if (lo >= hi) return lo;
+
+	Qrng_src_t src;
+	ext_src_init(&src, qrng);
+
+	u64 s = hi - lo + 1;
+	int size = (s == 0) ? 8 : word_size(s);
+
+	u8 w[8];
+	u64 val = 0;
+	bool ok = ext_src_take(&src, w, size);
+	if (ok) {
+		val = load_word(w, size);
+		if (s != 0) ok = bounded(&src, val, s, size, &val);
+	}
+	if (!ok) {
+		/** a short read can leave a success in the shard, report it there */
+		if (src.shard) src.shard->status = src.status;
+		return lo;
+	}
+	return lo + val;
+}
@@ -0,0 +1,241 @@
+/**
+* @file 	qrng_record.cpp
+* @brief 	Hashed data with entropy bits and certification value as records
+*
+* Same values as qrng_get_with_ec(), interleaved: each frame of the
+* staging buffer becomes one record, its 8 data bytes followed by the
+* entropy bits and the certification value of the header. A record has
+* the size of a frame, or 12 bytes with the certification value kept in
+* fixed point only.
+*
+* @date		17/10/2026
+*
+* Copyright(c) Quantum Dice. All rights reserved.
+*/
+
+#include <algorithm>
+
+#include "qrng_ext_internal.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#	include <immintrin.h>
+#	define QRNG_X86_KERNELS
+#endif
+
+static_assert(sizeof(Qrng_ec_record) == 16, "Qrng_ec_record must be 16 bytes");
+static_assert(sizeof(Qrng_ec_record_q) == 12, "Qrng_ec_record_q must be 12 bytes");
+
+/** Size of the qrng_get_with_ec() calls for the other handles */
+#define RECORD_FALLBACK_BLOCKS		512
+
+/**
+* Convert whole frames to records, up to the first frame without header
+*
+* @return	number of records written
+*/
+typedef size_t (*Record_fn)(const u8* frames, size_t count, u8* out);
+
+static inline bool frame_to_record_q(const u8* frame, Qrng_ec_record_q* r)
+{
+	u64 head;
+	memcpy(&head, frame, sizeof(head));
+	if ((uint32_t)head != QRNG_FRAME_MARKER) return false;
+
+	memcpy(r->data, frame + QRNG_FRAME_DATA_OFFSET, sizeof(r->data));
+	r->ent_bits = (u16)(head >> 32);
+	r->cert_fixed = (u16)(head >> 48);
+	return true;
+}
+
+static size_t records_scalar(const u8* frames, size_t count, u8* out)
+{
+	size_t i = 0;
+	for (; i < count; i++, frames += QRNG_FRAME_SIZE) {
+		Qrng_ec_record r;
+		Qrng_ec_record_q q;
+		if (!frame_to_record_q(frames, &q)) break;
+
+		memcpy(r.data, q.data, sizeof(r.data));
+		r.ent_bits = q.ent_bits;
+		r.cert_fixed = q.cert_fixed;
+		r.cert_val = (float)q.cert_fixed / QRNG_CERT_SCALE;
+		memcpy(out + i * sizeof(r), &r, sizeof(r));
+	}
+	return i;
+}
+
+static size_t records_q_scalar(const u8* frames, size_t count, u8* out)
+{
+	size_t i = 0;
+	for (; i < count; i++, frames += QRNG_FRAME_SIZE) {
+		Qrng_ec_record_q q;
+		if (!frame_to_record_q(frames, &q)) break;
+		memcpy(out + i * sizeof(q), &q, sizeof(q));
+	}
+	return i;
+}
+
+#ifdef QRNG_X86_KERNELS
+
+/**
+* Two frames per vector, one per 128 bits lane: the bytes are moved to
+* the record layout by a shuffle, the certification value is converted
+* with the same division as the scalar code
+*/
+__attribute__((target("avx2")))
+static size_t records_avx2(const u8* frames, size_t count, u8* out)
+{
+	const __m256i layout = _mm256_setr_epi8(
+			8, 9, 10, 11, 12, 13, 14, 15, 4, 5, 6, 7, -1, -1, -1, -1,
+			8, 9, 10, 11, 12, 13, 14, 15, 4, 5, 6, 7, -1, -1, -1, -1);
+	const __m256i cert = _mm256_setr_epi8(
+			-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 6, 7, -1, -1,
+			-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 6, 7, -1, -1);
+	const __m256i marker = _mm256_setr_epi32(QRNG_FRAME_MARKER, 0, 0, 0, QRNG_FRAME_MARKER, 0, 0, 0);
+	const __m256 scale = _mm256_set1_ps(QRNG_CERT_SCALE);
+	size_t i = 0;
+
+	for (; i + 2 <= count; i += 2) {
+		__m256i v = _mm256_loadu_si256((const __m256i*)(frames + i * QRNG_FRAME_SIZE));
+		int framed = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(v, marker)));
+		if ((framed & 0x11) != 0x11) break;
+
+		__m256 c = _mm256_div_ps(_mm256_cvtepi32_ps(_mm256_shuffle_epi8(v, cert)), scale);
+		__m256i r = _mm256_blend_epi32(_mm256_shuffle_epi8(v, layout), _mm256_castps_si256(c), 0x88);
+		_mm256_storeu_si256((__m256i*)(out + i * sizeof(Qrng_ec_record)), r);
+	}
+
+	return i + records_scalar(frames + i * QRNG_FRAME_SIZE, count - i,
+							out + i * sizeof(Qrng_ec_record));
+}
+
+/** Same with 12 bytes records, each 16 bytes store is overwritten by the next */
+__attribute__((target("avx2")))
+static size_t records_q_avx2(const u8* frames, size_t count, u8* out)
+{
+	const __m128i layout = _mm_setr_epi8(8, 9, 10, 11, 12, 13, 14, 15, 4, 5, 6, 7, -1, -1, -1, -1);
+	const __m128i marker = _mm_setr_epi32(QRNG_FRAME_MARKER, 0, 0, 0);
+	size_t i = 0;
+
+	for (; i + 1 < count; i++) {
+		__m128i v = _mm_loadu_si128((const __m128i*)(frames + i * QRNG_FRAME_SIZE));
+		if (!(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(v, marker))) & 1)) break;
+		_mm_storeu_si128((__m128i*)(out + i * sizeof(Qrng_ec_record_q)), _mm_shuffle_epi8(v, layout));
+	}
+
+	return i + records_q_scalar(frames + i * QRNG_FRAME_SIZE, count - i,
+							out + i * sizeof(Qrng_ec_record_q));
+}
+
+#endif
+
+static Record_fn select_records()
+{
+#ifdef QRNG_X86_KERNELS
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) return records_avx2;
+#endif
+	return records_scalar;
+}
+
+static Record_fn select_records_q()
+{
+#ifdef QRNG_X86_KERNELS
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) return records_q_avx2;
+#endif
+	return records_q_scalar;
+}
+
+/** Records from qrng_get_with_ec() for the handles without extension state */
+static int records_core(QRNG* qrng, u8* out, size_t count, size_t rec_size,
+					size_t* count_read)
+{
+	u8 data[RECORD_FALLBACK_BLOCKS * 8];
+	u16 ent[RECORD_FALLBACK_BLOCKS];
+	float cert[RECORD_FALLBACK_BLOCKS];
+	size_t done = 0;
+	int ret = QRNG_SUCCESS;
+
+	while (ret == QRNG_SUCCESS && done < count) {
+		size_t n = std::min(count - done, (size_t)RECORD_FALLBACK_BLOCKS);
+		ret = qrng_get_with_ec(qrng, data, (s32)(n * 8), ent, (s32)n, cert, (s32)n);
+		if (ret != QRNG_SUCCESS) break;
+
+		for (size_t i = 0; i < n; i++, done++) {
+			Qrng_ec_record r;
+			memcpy(r.data, data + i * 8, 8);
+			r.ent_bits = ent[i];
+			r.cert_fixed = (u16)(cert[i] * QRNG_CERT_SCALE + 0.5f);
+			r.cert_val = cert[i];
+			memcpy(out + done * rec_size, &r, rec_size);
+		}
+	}
+
+	*count_read = done;
+	return ret;
+}
+
+static int records_read(QRNG* qrng, u8* out, size_t count, size_t rec_size, Record_fn convert,
+					size_t* count_read)
+{
+	size_t done = 0;
+	int ret = QRNG_SUCCESS;
+
+	Qrng_shard_t* shard = ext_shard(qrng);
+	if (!shard) {
+		ret = records_core(qrng, out, count, rec_size, &done);
+		if (count_read) *count_read = done;
+		return ret;
+	}
+
+	Qrng_pool_t* stage = &shard->stage;
+	u64 t0 = ext_stats_begin(shard, count * rec_size);
+
+	while (done < count) {
+		if (stage->pos >= stage->len) {
+			ret = ext_stage_refill(shard, stage, QRNG_LL_CHANNEL_HASHED);
+			if (ret != QRNG_SUCCESS) break;
+		}
+
+		/** the rest of a frame partly read by qrng_get() is skipped */
+		size_t off = stage->pos % QRNG_FRAME_SIZE;
+		size_t n = (off == 0) ? std::min((stage->len - stage->pos) / QRNG_FRAME_SIZE, count - done) : 0;
+		if (n == 0) {
+			stage->pos = std::min(stage->pos + QRNG_FRAME_SIZE - off, stage->len);
+			continue;
+		}
+
+		size_t m = convert(stage->data + stage->pos, n, out + done * rec_size);
+		done += m;
+		stage->pos += m * QRNG_FRAME_SIZE;
+
+		/** a block without header has no entropy bits, it is consumed */
+		if (m < n) {
+			stage->pos += QRNG_FRAME_SIZE;
+			ret = QRNG_ERROR_WRONG_DATA_FORMAT;
+			break;
+		}
+	}
+
+	if (count_read) *count_read = done;
+	shard->status = ret;
+	ext_stats_call(shard, QRNG_STATS_FN_RECORDS, t0, done * rec_size, ret);
+	return ret;
+}
+
+int qrng_get_ec_records(QRNG* qrng, Qrng_ec_record* records, size_t count, size_t* count_read)
+{
+	static const Record_fn convert = select_records();
+
+	if (!records) return QRNG_ERROR_NULL_PTR;
+	return records_read(qrng, (u8*)records, count, sizeof(*records), convert, count_read);
+}
+
+int qrng_get_ec_records_q(QRNG* qrng, Qrng_ec_record_q* records, size_t count, size_t* count_read)
+{
+	static const Record_fn convert = select_records_q();
+
+	if (!records) return QRNG_ERROR_NULL_PTR;
+	return records_read(qrng, (u8*)records, count, sizeof(*records), convert, count_read);
+}
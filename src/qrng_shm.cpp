@@ -0,0 +1,680 @@
+/**
+* @file 	qrng_shm.cpp
+* @brief 	Device served to other processes through shared memory rings
+*
+* qrng_shm_start() creates a POSIX shared memory object holding one ring
+* per served channel, filled by a thread of the handle straight from
+* the device transfers. The "shm" backend maps the object in the client
+* processes, which read the rings as their device.
+*
+* The rings work as the prefetch ring, in shared memory: single
+* producer, multiple consumers, positions counted in bytes since the
+* start of the stream. The server publishes whole slots by moving
+* 'write_pos', the clients claim ranges of whole frames with a CAS on
+* 'read_pos' and, once copied, add them to the 'freed' word of each
+* slot. The word holds the generation of the slot and the bytes of it
+* released, and a slot is rewritten when its previous generation is
+* all released.
+*
+* A slot whose bytes are all claimed and that gets no release for
+* QRNG_SHM_STALL_MS from then on is taken back: its word moves to the next generation before
+* the data is rewritten, so the late releases of the previous one are
+* dropped, and a client checks the generations of the slots after its
+* copy (as the reader of a seqlock), dropping a copy the server wrote
+* over and claiming new data instead. A byte still goes to one client.
+*
+* Sleeping on an empty or full ring is a futex wait on a sequence
+* counter bumped at each publication or release, with a timeout so that
+* a client notices a server that is gone and the server a slot that a
+* dead client claimed and will never release.
+*
+* @date		17/10/2026
+*
+* Copyright(c) Quantum Dice. All rights reserved.
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstddef>
+#include <ctime>
+#include <new>
+#include <string>
+
+#ifdef __linux__
+#include <cerrno>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "qrng_ext_internal.h"
+
+#ifdef __linux__
+
+/** "QSHM", stored last by the server once the object is ready */
+#define SHM_MAGIC		0x4d485351u
+#define SHM_VERSION		2
+
+#define SHM_PAGE		KB(4)
+
+/** Largest slot, the released bytes being counted on 32 bits */
+#define SHM_MAX_BLOCK	((size_t) 1 << 30)
+
+/** Age of an object without magic, and without pid, taken as left by a crash */
+#define SHM_SETUP_S		5
+
+/** Longest futex wait before checking the other side again */
+#define SHM_WAIT_MS		100
+
+/** Delay before reading again from a device that returned an error */
+#define SHM_RETRY_DELAY	std::chrono::milliseconds(10)
+
+static_assert(std::atomic<u64>::is_always_lock_free, "shared atomics must be lock-free");
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "futex words must be 32 bits");
+
+enum {
+	SHM_SERVING = 1,
+	SHM_STOPPED = 2,
+};
+
+/** Ring of one channel, in the shared object */
+typedef struct {
+	u64 data_offset;	/**< from the start of the object */
+	u64 freed_offset;	/**< 'depth' released bytes counters */
+	u64 block;
+	u64 depth;
+	u64 capacity;		/**< 0 if the channel isn't served */
+
+	alignas(64) std::atomic<u64> write_pos;
+	alignas(64) std::atomic<u64> read_pos;
+
+	/** futex of the clients, bumped when data is published */
+	alignas(64) std::atomic<uint32_t> data_seq;
+	std::atomic<uint32_t> readers_waiting;
+	std::atomic<int32_t> status;	/**< last device error */
+	std::atomic<u64> underruns;
+
+	/** futex of the server, bumped when slots are released */
+	alignas(64) std::atomic<uint32_t> space_seq;
+	std::atomic<uint32_t> writer_waiting;
+	std::atomic<u64> overruns;
+	std::atomic<u64> reclaimed;
+}Shm_channel;
+
+typedef struct {
+	std::atomic<uint32_t> magic;
+	uint32_t version;
+	u64 size;			/**< of the object */
+	int32_t pid;		/**< of the server */
+	std::atomic<uint32_t> state;
+	std::atomic<uint32_t> clients;
+	Shm_channel ch[2];
+}Shm_header;
+
+struct Qrng_shm_server {
+	Qrng_ext_ctx* ctx;
+	std::string name;
+	Shm_header* hdr;
+	std::atomic<bool> stop{ false };
+	std::thread threads[2];
+};
+
+/** Mapping of a client, the device of the "shm" backend */
+typedef struct {
+	Shm_header* hdr;
+	size_t size;
+}Shm_dev;
+
+static inline u8* shm_data(Shm_header* hdr, const Shm_channel* c)
+{
+	return (u8*)hdr + c->data_offset;
+}
+
+static inline std::atomic<u64>* shm_freed(Shm_header* hdr, const Shm_channel* c)
+{
+	return (std::atomic<u64>*)((u8*)hdr + c->freed_offset);
+}
+
+/** Word of a slot: generation on the high 32 bits, released bytes on the low ones */
+static inline u64 shm_slot_word(u64 gen, u64 released)
+{
+	return (gen << 32) | released;
+}
+
+static inline bool shm_slot_gen_is(u64 word, u64 gen)
+{
+	return (uint32_t)(word >> 32) == (uint32_t)gen;
+}
+
+static void futex_wait(std::atomic<uint32_t>* word, uint32_t val)
+{
+	struct timespec ts = { SHM_WAIT_MS / 1000, (SHM_WAIT_MS % 1000) * 1000000L };
+	syscall(SYS_futex, (uint32_t*)word, FUTEX_WAIT, val, &ts, nullptr, 0);
+}
+
+static void futex_wake(std::atomic<uint32_t>* word)
+{
+	syscall(SYS_futex, (uint32_t*)word, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+}
+
+static bool shm_pid_alive(int32_t pid)
+{
+	return kill(pid, 0) == 0 || errno != ESRCH;
+}
+
+static bool shm_server_alive(const Shm_header* hdr)
+{
+	return hdr->state.load() == SHM_SERVING && shm_pid_alive(hdr->pid);
+}
+
+static void shm_producer(Qrng_shm_server* srv, int channel)
+{
+	typedef std::chrono::steady_clock Clock;
+
+	Shm_header* hdr = srv->hdr;
+	Shm_channel* c = &hdr->ch[channel];
+	u8* data = shm_data(hdr, c);
+	std::atomic<u64>* freed = shm_freed(hdr, c);
+	u64 blk = 0;
+	size_t filled = 0;
+	bool full = false;
+	bool claimed = false;	/** all the bytes of the awaited slot claimed, since 'claimed_since' */
+	u64 claimed_word = 0;
+	Clock::time_point claimed_since;
+
+	while (!srv->stop.load(std::memory_order_relaxed)) {
+		size_t slot = blk % c->depth;
+		u64 gen = blk / c->depth;
+		u64 word = freed[slot].load(std::memory_order_acquire);
+
+		/** being filled, or the previous generation all released */
+		if (!shm_slot_gen_is(word, gen) && word != shm_slot_word(gen - 1, c->block)) {
+			if (!full) {
+				c->overruns.fetch_add(1, std::memory_order_relaxed);
+				full = true;
+			}
+
+			/**
+			* All the bytes of the slot claimed and none released for
+			* QRNG_SHM_STALL_MS, the client is gone or stalled. The clock
+			* starts at the claim, not when the ring filled, and again at
+			* every release.
+			*/
+			u64 slot_end = (blk - c->depth + 1) * c->block;
+			Clock::time_point now = Clock::now();
+			if (c->read_pos.load() < slot_end) {
+				claimed = false;
+			}
+			else if (!claimed || claimed_word != word) {
+				claimed = true;
+				claimed_word = word;
+				claimed_since = now;
+			}
+
+			if (claimed && now - claimed_since >= std::chrono::milliseconds(QRNG_SHM_STALL_MS)) {
+				c->reclaimed.fetch_add(1, std::memory_order_relaxed);
+			}
+			else {
+				uint32_t seq = c->space_seq.load();
+				c->writer_waiting.store(1);
+				if (freed[slot].load() == word) futex_wait(&c->space_seq, seq);
+				c->writer_waiting.store(0);
+				continue;
+			}
+		}
+		full = false;
+		claimed = false;
+
+		/**
+		* Generation moved before the data is written: the fence orders the
+		* store before the writes, a client whose copy saw them sees it
+		*/
+		if (!shm_slot_gen_is(word, gen)) {
+			freed[slot].store(shm_slot_word(gen, 0), std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+		}
+
+		size_t read_len = 0;
+		int ret = ext_dev_get(srv->ctx, data + slot * c->block + filled, c->block - filled,
+							&read_len, channel);
+		filled += std::min(read_len, (size_t)c->block - filled);
+
+		if (ret != QRNG_SUCCESS || read_len == 0) {
+			c->status.store((ret != QRNG_SUCCESS) ? ret : QRNG_ERROR_INCOMPLETE_DATA);
+			c->data_seq.fetch_add(1);
+			if (c->readers_waiting.load()) futex_wake(&c->data_seq);
+			std::this_thread::sleep_for(SHM_RETRY_DELAY);
+			continue;
+		}
+		if (filled < c->block) continue;
+
+		c->status.store(QRNG_SUCCESS, std::memory_order_relaxed);
+		c->write_pos.store((blk + 1) * c->block);
+		c->data_seq.fetch_add(1);
+		if (c->readers_waiting.load()) futex_wake(&c->data_seq);
+		blk++;
+		filled = 0;
+	}
+}
+
+/** Release the claimed range [pos, pos + n) to the server */
+static void shm_release(Shm_header* hdr, Shm_channel* c, u64 pos, u64 n)
+{
+	std::atomic<u64>* freed = shm_freed(hdr, c);
+
+	while (n) {
+		u64 blk = pos / c->block;
+		u64 part = std::min(n, (blk + 1) * c->block - pos);
+		std::atomic<u64>* word = &freed[blk % c->depth];
+
+		/** dropped if the server took the slot back meanwhile */
+		u64 w = word->load(std::memory_order_relaxed);
+		while (shm_slot_gen_is(w, blk / c->depth)
+				&& !word->compare_exchange_weak(w, w + part, std::memory_order_acq_rel)) {
+		}
+		pos += part;
+		n -= part;
+	}
+	c->space_seq.fetch_add(1);
+	if (c->writer_waiting.load()) futex_wake(&c->space_seq);
+}
+
+static void shm_copy(Shm_header* hdr, const Shm_channel* c, u64 pos, u8* out, size_t n)
+{
+	const u8* data = shm_data(hdr, c);
+	size_t off = pos % c->capacity;
+	size_t first = std::min(n, (size_t)c->capacity - off);
+	memcpy(out, data + off, first);
+	memcpy(out + first, data, n - first);
+}
+
+/** Whether the slots of the copied range [pos, pos + n) still hold the claimed generation */
+static bool shm_copy_valid(Shm_header* hdr, const Shm_channel* c, u64 pos, u64 n)
+{
+	std::atomic<u64>* freed = shm_freed(hdr, c);
+
+	std::atomic_thread_fence(std::memory_order_acquire);
+	for (u64 blk = pos / c->block; blk * c->block < pos + n; blk++) {
+		if (!shm_slot_gen_is(freed[blk % c->depth].load(std::memory_order_relaxed), blk / c->depth))
+			return false;
+	}
+	return true;
+}
+
+static int shm_get(void* dev, u8* buf, size_t size, size_t* read_len, int channel)
+{
+	/** no mapping if the object couldn't be opened */
+	Shm_header* hdr = dev ? ((Shm_dev*)dev)->hdr : nullptr;
+	Shm_channel* c = (hdr && (channel == QRNG_LL_CHANNEL_HASHED || channel == QRNG_LL_CHANNEL_RAW))
+			? &hdr->ch[channel] : nullptr;
+	if (!c || !c->capacity) {
+		*read_len = 0;
+		return QRNG_ERROR_READING_DEVICE;
+	}
+
+	/** whole frames or words are claimed, the tail of the last one is dropped */
+	u64 unit = (channel == QRNG_LL_CHANNEL_HASHED) ? QRNG_FRAME_SIZE : QRNG_RAW_WORD_SIZE;
+	u64 want = (size + unit - 1) / unit * unit;
+	u64 claimed = 0;
+	bool waited = false;
+	int ret = QRNG_SUCCESS;
+
+	while (claimed < want) {
+		u64 r = c->read_pos.load(std::memory_order_relaxed);
+		uint32_t seq = c->data_seq.load();
+		u64 w = c->write_pos.load(std::memory_order_acquire);
+
+		if (r == w) {
+			int status = c->status.load();
+			if (status != QRNG_SUCCESS) {
+				ret = status;
+				break;
+			}
+			if (!shm_server_alive(hdr)) {
+				ret = QRNG_ERROR_READING_DEVICE;
+				break;
+			}
+			if (!waited) c->underruns.fetch_add(1, std::memory_order_relaxed);
+			waited = true;
+
+			c->readers_waiting.fetch_add(1);
+			futex_wait(&c->data_seq, seq);
+			c->readers_waiting.fetch_sub(1);
+			continue;
+		}
+
+		u64 n = std::min(w - r, want - claimed);
+		if (!c->read_pos.compare_exchange_weak(r, r + n, std::memory_order_acq_rel))
+			continue;
+
+		/** a copy the server wrote over after a stall is claimed again */
+		bool valid = true;
+		if (claimed < size) {
+			u64 copied = std::min(n, size - claimed);
+			shm_copy(hdr, c, r, buf + claimed, copied);
+			valid = shm_copy_valid(hdr, c, r, copied);
+		}
+		shm_release(hdr, c, r, n);
+		if (valid) claimed += n;
+	}
+
+	*read_len = std::min(claimed, (u64)size);
+	return ret;
+}
+
+static int shm_init(const char* args, void** dev)
+{
+	*dev = nullptr;
+
+	const char* name = (args && *args) ? args : QRNG_SHM_DEFAULT_NAME;
+	int fd = shm_open(name, O_RDWR, 0);
+	if (fd < 0) return QRNG_ERROR_OPENING_DEVICE;
+
+	struct stat st;
+	void* map = MAP_FAILED;
+	if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(Shm_header))
+		map = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) return QRNG_ERROR_OPENING_DEVICE;
+
+	Shm_header* hdr = (Shm_header*)map;
+	if (hdr->magic.load() != SHM_MAGIC || hdr->version != SHM_VERSION
+			|| hdr->size != (u64)st.st_size || !shm_server_alive(hdr)) {
+		munmap(map, st.st_size);
+		return QRNG_ERROR_OPENING_DEVICE;
+	}
+
+	Shm_dev* d = new (std::nothrow) Shm_dev();
+	if (!d) {
+		munmap(map, st.st_size);
+		return QRNG_ERROR_INTERNAL_MEMORY;
+	}
+	d->hdr = hdr;
+	d->size = st.st_size;
+	hdr->clients.fetch_add(1);
+
+	*dev = d;
+	return QRNG_SUCCESS;
+}
+
+static void shm_deinit(void* dev)
+{
+	Shm_dev* d = (Shm_dev*)dev;
+	if (!d) return;
+
+	d->hdr->clients.fetch_sub(1);
+	munmap(d->hdr, d->size);
+	delete d;
+}
+
+static bool shm_name_valid(const char* name)
+{
+	size_t len = strlen(name);
+	return len > 1 && len < NAME_MAX && name[0] == '/' && !strchr(name + 1, '/');
+}
+
+/**
+* Create the object, replacing one left by a server that is gone
+*
+* @return	file descriptor, -1 if the name is served by another process
+*/
+static int shm_create(const char* name, uint32_t mode)
+{
+	for (int attempt = 0; attempt < 2; attempt++) {
+		int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, mode);
+		if (fd >= 0) {
+			/** the permissions without the umask */
+			fchmod(fd, mode);
+			return fd;
+		}
+		if (errno != EEXIST) return -1;
+
+		fd = shm_open(name, O_RDONLY, 0);
+		if (fd < 0) return -1;
+
+		/**
+		* An object without magic may still be set up by its server: it is
+		* stale once its pid is dead, or without pid after SHM_SETUP_S
+		*/
+		struct stat st;
+		bool stale = false;
+		if (fstat(fd, &st) == 0) {
+			bool old = time(nullptr) - st.st_mtime >= SHM_SETUP_S;
+			void* map = ((size_t)st.st_size >= sizeof(Shm_header))
+					? mmap(nullptr, sizeof(Shm_header), PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+			if (map != MAP_FAILED) {
+				const Shm_header* hdr = (const Shm_header*)map;
+				if (hdr->magic.load() == SHM_MAGIC) stale = !shm_server_alive(hdr);
+				else stale = hdr->pid ? !shm_pid_alive(hdr->pid) : old;
+				munmap(map, sizeof(Shm_header));
+			}
+			else {
+				stale = old;
+			}
+		}
+		close(fd);
+
+		if (!stale) return -1;
+		shm_unlink(name);
+	}
+	return -1;
+}
+
+/** Layout of the ring of a channel, 'offset' is the end of the object so far */
+static void shm_channel_layout(Shm_channel* c, size_t block, size_t depth, size_t* offset)
+{
+	c->block = block;
+	c->depth = depth;
+	c->capacity = block * depth;
+	c->freed_offset = *offset;
+	*offset += (depth * sizeof(std::atomic<u64>) + SHM_PAGE - 1) / SHM_PAGE * SHM_PAGE;
+	c->data_offset = *offset;
+	*offset += c->capacity;
+}
+
+static void shm_server_free(Qrng_shm_server* srv)
+{
+	Shm_header* hdr = srv->hdr;
+
+	srv->stop.store(true);
+	if (hdr) {
+		hdr->state.store(SHM_STOPPED);
+		for (Shm_channel& c : hdr->ch) {
+			c.space_seq.fetch_add(1);
+			futex_wake(&c.space_seq);
+			c.data_seq.fetch_add(1);
+			futex_wake(&c.data_seq);
+		}
+	}
+	for (std::thread& t : srv->threads)
+		if (t.joinable()) t.join();
+
+	/** the clients keep their mapping and read the data left */
+	if (hdr) {
+		shm_unlink(srv->name.c_str());
+		munmap(hdr, hdr->size);
+	}
+	delete srv;
+}
+
+static int shm_server_start(Qrng_ext_ctx* ctx, const Qrng_shm_param* param,
+							Qrng_shm_server** out)
+{
+	const char* name = param->name ? param->name : QRNG_SHM_DEFAULT_NAME;
+	if (!shm_name_valid(name)) return QRNG_ERROR_INVALID_PARAM;
+
+	size_t block = param->block ? param->block : QRNG_SHM_DEFAULT_BLOCK;
+	block = (std::min(block, SHM_MAX_BLOCK) + SHM_PAGE - 1) / SHM_PAGE * SHM_PAGE;
+	size_t depth = param->depth ? param->depth : QRNG_SHM_DEFAULT_DEPTH;
+	depth = std::min(std::max(depth, (size_t)2), (size_t)QRNG_SHM_MAX_DEPTH);
+	size_t raw_depth = param->raw_depth
+			? std::min(std::max(param->raw_depth, (size_t)2), (size_t)QRNG_SHM_MAX_DEPTH) : 0;
+	uint32_t mode = param->mode ? param->mode : QRNG_SHM_DEFAULT_MODE;
+
+	Qrng_shm_server* srv = new (std::nothrow) Qrng_shm_server();
+	if (!srv) return QRNG_ERROR_INTERNAL_MEMORY;
+	srv->ctx = ctx;
+	srv->name = name;
+	srv->hdr = nullptr;
+
+	Shm_header layout = {};
+	size_t size = (sizeof(Shm_header) + SHM_PAGE - 1) / SHM_PAGE * SHM_PAGE;
+	shm_channel_layout(&layout.ch[QRNG_LL_CHANNEL_HASHED], block, depth, &size);
+	if (raw_depth) shm_channel_layout(&layout.ch[QRNG_LL_CHANNEL_RAW], block, raw_depth, &size);
+
+	int fd = shm_create(name, mode);
+	if (fd < 0) {
+		delete srv;
+		return QRNG_ERROR_OPENING_DEVICE;
+	}
+
+	/** the pid first, for shm_create() of another server if this one dies in the setup */
+	int32_t pid = getpid();
+	void* map = MAP_FAILED;
+	if (ftruncate(fd, size) == 0
+			&& pwrite(fd, &pid, sizeof(pid), offsetof(Shm_header, pid)) == (ssize_t)sizeof(pid))
+		map = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		shm_unlink(name);
+		delete srv;
+		return QRNG_ERROR_INTERNAL_MEMORY;
+	}
+
+	/** a new object is zero filled: positions, counters and seqs start at 0 */
+	Shm_header* hdr = (Shm_header*)map;
+	for (int ch = 0; ch < 2; ch++) {
+		Shm_channel* c = &hdr->ch[ch];
+		c->data_offset = layout.ch[ch].data_offset;
+		c->freed_offset = layout.ch[ch].freed_offset;
+		c->block = layout.ch[ch].block;
+		c->depth = layout.ch[ch].depth;
+		c->capacity = layout.ch[ch].capacity;
+		c->status.store(QRNG_SUCCESS);
+	}
+	hdr->version = SHM_VERSION;
+	hdr->size = size;
+	hdr->state.store(SHM_SERVING);
+	srv->hdr = hdr;
+
+	try {
+		for (int ch = 0; ch < 2; ch++)
+			if (hdr->ch[ch].capacity) srv->threads[ch] = std::thread(shm_producer, srv, ch);
+	}
+	catch (...) {
+		shm_server_free(srv);
+		return QRNG_ERROR_INTERNAL_MEMORY;
+	}
+
+	hdr->magic.store(SHM_MAGIC);
+	*out = srv;
+	return QRNG_SUCCESS;
+}
+
+static void shm_channel_stats(const Shm_channel* c, Qrng_shm_channel_stats* stats)
+{
+	if (!c->capacity) return;
+
+	u64 r = c->read_pos.load(std::memory_order_relaxed);
+	u64 w = c->write_pos.load(std::memory_order_relaxed);
+	stats->capacity = c->capacity;
+	stats->occupancy = (w > r) ? w - r : 0;
+	stats->produced = w;
+	stats->consumed = r;
+	stats->underruns = c->underruns.load(std::memory_order_relaxed);
+	stats->overruns = c->overruns.load(std::memory_order_relaxed);
+	stats->reclaimed = c->reclaimed.load(std::memory_order_relaxed);
+}
+
+#else
+
+struct Qrng_shm_server {
+};
+
+static int shm_init(const char* args, void** dev)
+{
+	*dev = nullptr;
+	return QRNG_ERROR_OPENING_DEVICE;
+}
+
+static int shm_get(void* dev, u8* buf, size_t size, size_t* read_len, int channel)
+{
+	*read_len = 0;
+	return QRNG_ERROR_READING_DEVICE;
+}
+
+static void shm_deinit(void* dev)
+{
+}
+
+#endif
+
+void ext_shm_table(Qrng_ll_table* ll)
+{
+	ll->init = shm_init;
+	ll->get = shm_get;
+	ll->deinit = shm_deinit;
+}
+
+void ext_shm_stop(Qrng_ext_ctx* ctx)
+{
+	std::lock_guard<std::mutex> lock(ctx->shm_mutex);
+#ifdef __linux__
+	if (ctx->shm) shm_server_free(ctx->shm);
+#endif
+	ctx->shm = nullptr;
+}
+
+int qrng_shm_start(QRNG* qrng, const Qrng_shm_param* param)
+{
+	Qrng_ext_ctx* ctx = ext_ctx(qrng);
+	if (!ctx) return QRNG_ERROR_NOT_EXT_HANDLE;
+
+#ifdef __linux__
+	Qrng_shm_param p = param ? *param : Qrng_shm_param();
+
+	std::lock_guard<std::mutex> lock(ctx->shm_mutex);
+	if (ctx->shm) return QRNG_ERROR_INVALID_PARAM;
+	return shm_server_start(ctx, &p, &ctx->shm);
+#else
+	return QRNG_ERROR_INVALID_PARAM;
+#endif
+}
+
+int qrng_shm_stop(QRNG* qrng)
+{
+	Qrng_ext_ctx* ctx = ext_ctx(qrng);
+	if (!ctx) return QRNG_ERROR_NOT_EXT_HANDLE;
+
+	{
+		std::lock_guard<std::mutex> lock(ctx->shm_mutex);
+		if (!ctx->shm) return QRNG_ERROR_INVALID_PARAM;
+	}
+	ext_shm_stop(ctx);
+	return QRNG_SUCCESS;
+}
+
+int qrng_shm_get_stats(QRNG* qrng, Qrng_shm_stats* stats)
+{
+	if (!stats) return QRNG_ERROR_NULL_PTR;
+
+	Qrng_ext_ctx* ctx = ext_ctx(qrng);
+	if (!ctx) return QRNG_ERROR_NOT_EXT_HANDLE;
+
+	memset(stats, 0, sizeof(*stats));
+#ifdef __linux__
+	std::lock_guard<std::mutex> lock(ctx->shm_mutex);
+	if (!ctx->shm) return QRNG_SUCCESS;
+
+	Shm_header* hdr = ctx->shm->hdr;
+	stats->clients = hdr->clients.load(std::memory_order_relaxed);
+	shm_channel_stats(&hdr->ch[QRNG_LL_CHANNEL_HASHED], &stats->hashed);
+	shm_channel_stats(&hdr->ch[QRNG_LL_CHANNEL_RAW], &stats->raw);
+#endif
+	return QRNG_SUCCESS;
+}
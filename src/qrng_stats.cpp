@@ -0,0 +1,225 @@
+/**
+* @file 	qrng_stats.cpp
+* @brief 	Counters and latency histograms of the handles
+*
+* The calls of the extension functions are counted in the shard of
+* the calling thread, written by this thread only with relaxed loads
+* and stores, so a call costs two clock reads and a few uncontended
+* stores. The device transfers, which may come from several threads
+* (prefetch, shm or net server, readers of the other channel), are
+* counted on the handle with relaxed fetch_add. qrng_get_stats() adds
+* up the shards under the shard lock, the counters of the freed shards
+* being kept on the handle.
+*
+* @date		17/10/2026
+*
+* Copyright(c) Quantum Dice. All rights reserved.
+*/
+
+#include <cinttypes>
+#include <cstdarg>
+#include <cstdio>
+#include <string>
+
+#include "qrng_ext_internal.h"
+
+static const char* const stats_fn_names[QRNG_STATS_FN_COUNT] = {
+	"core", "get64", "get_raw_ent64", "pool_refill", "async", "certified",
+	"records", "extracted", "drbg", "convert",
+};
+
+static inline int stats_bucket(u64 ns)
+{
+	if (ns <= ((u64)1 << QRNG_STATS_BUCKET_MIN_LOG2)) return 0;
+
+	/** smallest power of two >= ns */
+	int log2 = 64 - __builtin_clzll(ns - 1);
+	int b = log2 - QRNG_STATS_BUCKET_MIN_LOG2;
+	return (b < QRNG_STATS_BUCKETS) ? b : QRNG_STATS_BUCKETS - 1;
+}
+
+static inline void counter_add(std::atomic<u64>& c, u64 v, bool shared)
+{
+	if (shared) c.fetch_add(v, std::memory_order_relaxed);
+	else c.store(c.load(std::memory_order_relaxed) + v, std::memory_order_relaxed);
+}
+
+void ext_stats_add(Qrng_stats_counter* c, bool timed, u64 ns, size_t bytes, int ret,
+				bool shared)
+{
+	counter_add(c->calls, 1, shared);
+	counter_add(c->bytes, bytes, shared);
+	if (ret != QRNG_SUCCESS) counter_add(c->errors, 1, shared);
+	if (timed) {
+		counter_add(c->timed, 1, shared);
+		counter_add(c->total_ns, ns, shared);
+		counter_add(c->buckets[stats_bucket(ns)], 1, shared);
+	}
+}
+
+static void latency_add(Qrng_stats_latency* out, const Qrng_stats_counter* c)
+{
+	out->calls += c->calls.load(std::memory_order_relaxed);
+	out->errors += c->errors.load(std::memory_order_relaxed);
+	out->bytes += c->bytes.load(std::memory_order_relaxed);
+	out->timed += c->timed.load(std::memory_order_relaxed);
+	out->total_ns += c->total_ns.load(std::memory_order_relaxed);
+	for (int b = 0; b < QRNG_STATS_BUCKETS; b++)
+		out->buckets[b] += c->buckets[b].load(std::memory_order_relaxed);
+}
+
+static void latency_merge(Qrng_stats_latency* out, const Qrng_stats_latency* in)
+{
+	out->calls += in->calls;
+	out->errors += in->errors;
+	out->bytes += in->bytes;
+	out->timed += in->timed;
+	out->total_ns += in->total_ns;
+	for (int b = 0; b < QRNG_STATS_BUCKETS; b++) out->buckets[b] += in->buckets[b];
+}
+
+void ext_stats_release(Qrng_shard_t* shard)
+{
+	for (int fn = 0; fn < QRNG_STATS_FN_COUNT; fn++)
+		latency_add(&shard->ctx->stats_retired[fn], &shard->stats[fn]);
+}
+
+int qrng_get_stats(QRNG* qrng, Qrng_stats* stats)
+{
+	if (!stats) return QRNG_ERROR_NULL_PTR;
+
+	Qrng_ext_ctx* ctx = ext_ctx(qrng);
+	if (!ctx) return QRNG_ERROR_NOT_EXT_HANDLE;
+
+	memset(stats, 0, sizeof(*stats));
+	{
+		std::lock_guard<std::mutex> lock(ctx->shard_mutex);
+		for (int fn = 0; fn < QRNG_STATS_FN_COUNT; fn++) {
+			latency_merge(&stats->fn[fn], &ctx->stats_retired[fn]);
+			for (const Qrng_shard_t* shard : ctx->shards)
+				latency_add(&stats->fn[fn], &shard->stats[fn]);
+		}
+	}
+	latency_add(&stats->fn[QRNG_STATS_FN_CORE], &ctx->stats_core);
+	latency_add(&stats->device, &ctx->stats_device);
+
+	for (int fn = 0; fn < QRNG_STATS_FN_COUNT; fn++)
+		if (fn != QRNG_STATS_FN_CORE && fn != QRNG_STATS_FN_POOL)
+			stats->bytes_delivered += stats->fn[fn].bytes;
+	stats->device_reads = stats->device.calls;
+	stats->device_bytes = stats->device.bytes;
+	stats->device_errors = stats->device.errors;
+	stats->short_reads = ctx->stats_short_reads.load(std::memory_order_relaxed);
+	stats->retries = ctx->stats_retries.load(std::memory_order_relaxed);
+	stats->device_wait_ns = ctx->stats_wait_ns.load(std::memory_order_relaxed);
+	return QRNG_SUCCESS;
+}
+
+static void prom_append(std::string& out, const char* fmt, ...)
+{
+	char line[256];
+	va_list args, again;
+	va_start(args, fmt);
+	va_copy(again, args);
+	int n = vsnprintf(line, sizeof(line), fmt, args);
+
+	/** long user labels */
+	if (n >= (int)sizeof(line)) {
+		size_t pos = out.size();
+		out.resize(pos + n + 1);
+		vsnprintf(&out[pos], n + 1, fmt, again);
+		out.resize(pos + n);
+	}
+	else if (n > 0) {
+		out.append(line, n);
+	}
+	va_end(again);
+	va_end(args);
+}
+
+static void prom_header(std::string& out, const char* name, const char* type, const char* help)
+{
+	prom_append(out, "# HELP qrng_%s %s\n# TYPE qrng_%s %s\n", name, help, name, type);
+}
+
+/** Samples of one histogram series */
+static void prom_histogram(std::string& out, const char* name, const std::string& labels,
+						const Qrng_stats_latency* h)
+{
+	const char* l = labels.c_str();
+	u64 cumulative = 0;
+
+	for (int b = 0; b < QRNG_STATS_BUCKETS - 1; b++) {
+		cumulative += h->buckets[b];
+		double le = (double)((u64)1 << (b + QRNG_STATS_BUCKET_MIN_LOG2)) * 1e-9;
+		prom_append(out, "qrng_%s_bucket{%s,le=\"%.9g\"} %" PRIu64 "\n", name, l, le, cumulative);
+	}
+	/** the count from the buckets, 'timed' may be ahead of them */
+	cumulative += h->buckets[QRNG_STATS_BUCKETS - 1];
+	prom_append(out, "qrng_%s_bucket{%s,le=\"+Inf\"} %" PRIu64 "\n", name, l, cumulative);
+	prom_append(out, "qrng_%s_sum{%s} %.9f\n", name, l, h->total_ns * 1e-9);
+	prom_append(out, "qrng_%s_count{%s} %" PRIu64 "\n", name, l, cumulative);
+}
+
+int qrng_stats_prometheus(QRNG* qrng, const char* labels, char* text, size_t size, size_t* len)
+{
+	if (!text && size) return QRNG_ERROR_NULL_PTR;
+
+	Qrng_ext_ctx* ctx = ext_ctx(qrng);
+	if (!ctx) return QRNG_ERROR_NOT_EXT_HANDLE;
+
+	Qrng_stats s;
+	int ret = qrng_get_stats(qrng, &s);
+	if (ret != QRNG_SUCCESS) return ret;
+
+	std::string base = "handle=\"" + std::to_string(ctx->id) + "\"";
+	if (labels && *labels) base += std::string(",") + labels;
+	const char* l = base.c_str();
+	std::string out;
+
+	prom_header(out, "bytes_delivered_total", "counter", "Bytes returned by the extension functions");
+	prom_append(out, "qrng_bytes_delivered_total{%s} %" PRIu64 "\n", l, s.bytes_delivered);
+	prom_header(out, "device_reads_total", "counter", "Transfers from the device");
+	prom_append(out, "qrng_device_reads_total{%s} %" PRIu64 "\n", l, s.device_reads);
+	prom_header(out, "device_bytes_total", "counter", "Bytes transferred from the device");
+	prom_append(out, "qrng_device_bytes_total{%s} %" PRIu64 "\n", l, s.device_bytes);
+	prom_header(out, "device_short_reads_total", "counter", "Transfers shorter than requested");
+	prom_append(out, "qrng_device_short_reads_total{%s} %" PRIu64 "\n", l, s.short_reads);
+	prom_header(out, "device_retries_total", "counter", "Transfers following a short one");
+	prom_append(out, "qrng_device_retries_total{%s} %" PRIu64 "\n", l, s.retries);
+	prom_header(out, "device_errors_total", "counter", "Transfers returning an error");
+	prom_append(out, "qrng_device_errors_total{%s} %" PRIu64 "\n", l, s.device_errors);
+	prom_header(out, "device_wait_seconds_total", "counter", "Time the readers were blocked on the device");
+	prom_append(out, "qrng_device_wait_seconds_total{%s} %.9f\n", l, s.device_wait_ns * 1e-9);
+
+	prom_header(out, "device_read_duration_seconds", "histogram", "Duration of the device transfers");
+	prom_histogram(out, "device_read_duration_seconds", base, &s.device);
+
+	/** only the functions in use, the series appear with their first call */
+	prom_header(out, "call_duration_seconds", "histogram", "Duration of the calls per function");
+	for (int fn = 0; fn < QRNG_STATS_FN_COUNT; fn++) {
+		if (!s.fn[fn].calls) continue;
+		prom_histogram(out, "call_duration_seconds",
+					base + ",function=\"" + stats_fn_names[fn] + "\"", &s.fn[fn]);
+	}
+	prom_header(out, "calls_total", "counter", "Calls per function, the small ones are sampled by the histogram");
+	for (int fn = 0; fn < QRNG_STATS_FN_COUNT; fn++)
+		if (s.fn[fn].calls)
+			prom_append(out, "qrng_calls_total{%s,function=\"%s\"} %" PRIu64 "\n", l,
+						stats_fn_names[fn], s.fn[fn].calls);
+	prom_header(out, "call_errors_total", "counter", "Calls not returning QRNG_SUCCESS per function");
+	for (int fn = 0; fn < QRNG_STATS_FN_COUNT; fn++)
+		if (s.fn[fn].calls)
+			prom_append(out, "qrng_call_errors_total{%s,function=\"%s\"} %" PRIu64 "\n", l,
+						stats_fn_names[fn], s.fn[fn].errors);
+	prom_header(out, "call_bytes_total", "counter", "Bytes returned per function");
+	for (int fn = 0; fn < QRNG_STATS_FN_COUNT; fn++)
+		if (s.fn[fn].calls)
+			prom_append(out, "qrng_call_bytes_total{%s,function=\"%s\"} %" PRIu64 "\n", l,
+						stats_fn_names[fn], s.fn[fn].bytes);
+
+	if (len) *len = out.size();
+	if (out.size() >= size) return QRNG_ERROR_INVALID_PARAM;
+	memcpy(text, out.c_str(), out.size() + 1);
+	return QRNG_SUCCESS;
+}